@@ -0,0 +1,356 @@
+// instrument.c
+//
+// See instrument.h. One event per region instance, appended to the buffer
+// of the thread that opened it; the tree and the trace are built from the
+// buffers only at the end, so instr_begin/instr_end cost a timestamp and a
+// few stores.
+
+#define _GNU_SOURCE
+#include "instrument.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define INSTR_HAVE_RDTSC 1
+#endif
+
+#define MAX_DEPTH      64
+#define INITIAL_EVENTS 4096
+#define NAME_WIDTH     40
+
+typedef struct {
+  const char* name;
+  uint64_t begin, end;        /* end == 0: still open */
+  int parent;                 /* enclosing event of the same thread, or -1 */
+} event;
+
+typedef struct buffer {
+  event* events;
+  int count, capacity;
+  int stack[MAX_DEPTH];
+  int depth;
+  int overflow;               /* regions opened beyond MAX_DEPTH, not recorded */
+  int tid;
+  struct buffer* next;
+} buffer;
+
+static buffer* buffers = NULL;        /* every thread's, newest first */
+static int nbuffers = 0;
+static __thread buffer* mine = NULL;
+
+static int initialised = 0;
+static int the_rank = -1;
+static int use_tsc = 0;
+static double seconds_per_tick = 1.e-9;
+static uint64_t origin = 0;           /* ticks at instr_init */
+static double origin_epoch = 0.;      /* CLOCK_REALTIME at instr_init */
+
+static void die(const char* message) {
+  fprintf(stderr, "instrument: %s\n", message);
+  exit(EXIT_FAILURE);
+}
+
+/* ========================================================================== */
+/* Clocks                                                                     */
+/* ========================================================================== */
+
+double walltime(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return 1. * t.tv_sec + 1.e-9 * t.tv_nsec;
+}
+
+uint64_t instr_ticks(void) {
+#ifdef INSTR_HAVE_RDTSC
+  if (use_tsc) return __rdtsc();
+#endif
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t) t.tv_sec * 1000000000u + (uint64_t) t.tv_nsec;
+}
+
+double instr_seconds(uint64_t ticks) {
+  return seconds_per_tick * (double) ticks;
+}
+
+/* The TSC counts wall-clock time only if its rate is fixed and it keeps
+   running in the sleep states. */
+static int invariant_tsc(void) {
+  FILE* f = fopen("/proc/cpuinfo", "r");
+  if (f == NULL) return 0;
+  char line[4096];
+  int found = 0;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (strncmp(line, "flags", 5) != 0) continue;
+    found = strstr(line, " constant_tsc") != NULL && strstr(line, " nonstop_tsc") != NULL;
+    break;
+  }
+  fclose(f);
+  return found;
+}
+
+static void calibrate(void) {
+  const char* env = getenv("INSTR_TSC");
+  use_tsc = 0;
+  seconds_per_tick = 1.e-9;
+#ifdef INSTR_HAVE_RDTSC
+  if ((env != NULL && strcmp(env, "0") == 0) || !invariant_tsc()) return;
+  double t0 = walltime();
+  uint64_t c0 = __rdtsc();
+  while (walltime() - t0 < 0.02) {}
+  double t1 = walltime();
+  uint64_t c1 = __rdtsc();
+  if (c1 <= c0) return;
+  seconds_per_tick = (t1 - t0) / (double) (c1 - c0);
+  use_tsc = 1;
+#else
+  (void) env;
+#endif
+}
+
+void instr_init(int rank) {
+  the_rank = rank;
+  if (initialised) return;
+  initialised = 1;
+  calibrate();
+  struct timespec t;
+  clock_gettime(CLOCK_REALTIME, &t);
+  origin = instr_ticks();
+  origin_epoch = 1. * t.tv_sec + 1.e-9 * t.tv_nsec;
+}
+
+/* ========================================================================== */
+/* Regions                                                                    */
+/* ========================================================================== */
+
+static buffer* this_thread(void) {
+  if (mine != NULL) return mine;
+  if (!initialised) instr_init(-1);
+  buffer* b = (buffer*) calloc(1, sizeof(buffer));
+  if (b == NULL) die("Failed to allocate a thread buffer.");
+  b->capacity = INITIAL_EVENTS;
+  b->events = (event*) malloc(b->capacity * sizeof(event));
+  if (b->events == NULL) die("Failed to allocate the events.");
+  b->tid = __atomic_fetch_add(&nbuffers, 1, __ATOMIC_RELAXED);
+  b->next = __atomic_load_n(&buffers, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&buffers, &b->next, b, 0,
+                                      __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {}
+  mine = b;
+  return b;
+}
+
+void instr_begin(const char* name) {
+  buffer* b = this_thread();
+  if (b->depth == MAX_DEPTH) {
+    ++b->overflow;
+    return;
+  }
+  if (b->count == b->capacity) {
+    b->capacity *= 2;
+    b->events = (event*) realloc(b->events, b->capacity * sizeof(event));
+    if (b->events == NULL) die("Failed to grow the events.");
+  }
+  event* e = &b->events[b->count];
+  e->name = name;
+  e->end = 0;
+  e->parent = b->depth ? b->stack[b->depth - 1] : -1;
+  b->stack[b->depth++] = b->count++;
+  e->begin = instr_ticks();   /* last: the bookkeeping is not timed */
+}
+
+void instr_end(void) {
+  uint64_t t = instr_ticks();
+  buffer* b = mine;
+  if (b == NULL || b->depth == 0) return;
+  if (b->overflow > 0) {
+    --b->overflow;
+    return;
+  }
+  b->events[b->stack[--b->depth]].end = t;
+}
+
+/* ========================================================================== */
+/* Report                                                                     */
+/* ========================================================================== */
+
+typedef struct {
+  const char* name;
+  int parent, first_child, next_sibling, depth;
+  long calls;
+  int threads, last_tid;
+  double total;               /* summed over threads */
+  double children;            /* total of the children */
+  double thread_total, thread_max;
+} node;
+
+typedef struct {
+  node* nodes;
+  int count, capacity;
+  int first_root;
+} tree;
+
+static int add_node(tree* t, int parent, const char* name) {
+  if (t->count == t->capacity) {
+    t->capacity = t->capacity ? 2 * t->capacity : 64;
+    t->nodes = (node*) realloc(t->nodes, t->capacity * sizeof(node));
+    if (t->nodes == NULL) die("Failed to allocate the region tree.");
+  }
+  node* n = &t->nodes[t->count];
+  memset(n, 0, sizeof(node));
+  n->name = name;
+  n->parent = parent;
+  n->first_child = n->next_sibling = -1;
+  n->last_tid = -1;
+  n->depth = (parent >= 0) ? t->nodes[parent].depth + 1 : 0;
+  /* append, so that siblings print in order of first appearance */
+  int* link = (parent >= 0) ? &t->nodes[parent].first_child : &t->first_root;
+  while (*link >= 0) link = &t->nodes[*link].next_sibling;
+  *link = t->count;
+  return t->count++;
+}
+
+/* Node of the region `name` under parent (-1: the roots). */
+static int find_node(tree* t, int parent, const char* name) {
+  int k = (parent >= 0) ? t->nodes[parent].first_child : t->first_root;
+  for (; k >= 0; k = t->nodes[k].next_sibling) {
+    if (t->nodes[k].name == name || strcmp(t->nodes[k].name, name) == 0) return k;
+  }
+  return add_node(t, parent, name);
+}
+
+/* Buffers in thread order (the list is newest first). */
+static buffer** sorted_buffers(int* count) {
+  int n = __atomic_load_n(&nbuffers, __ATOMIC_ACQUIRE);
+  buffer** all = (buffer**) calloc(n > 0 ? n : 1, sizeof(buffer*));
+  if (all == NULL) die("Failed to allocate the buffer list.");
+  for (buffer* b = __atomic_load_n(&buffers, __ATOMIC_ACQUIRE); b != NULL; b = b->next) {
+    if (b->tid < n) all[b->tid] = b;
+  }
+  *count = n;
+  return all;
+}
+
+static void build_tree(tree* t, int* nthreads) {
+  int nb;
+  buffer** all = sorted_buffers(&nb);
+  const uint64_t now = instr_ticks();
+  *nthreads = 0;
+  for (int k = 0; k < nb; ++k) {
+    buffer* b = all[k];
+    if (b == NULL || b->count == 0) continue;
+    ++*nthreads;
+    int* map = (int*) malloc(b->count * sizeof(int));
+    if (map == NULL) die("Failed to allocate the event map.");
+    for (int i = 0; i < b->count; ++i) {
+      const event* e = &b->events[i];
+      int parent = (e->parent >= 0) ? map[e->parent] : -1;
+      int id = map[i] = find_node(t, parent, e->name);
+      node* n = &t->nodes[id];
+      double s = instr_seconds((e->end ? e->end : now) - e->begin);
+      n->calls++;
+      n->total += s;
+      n->thread_total += s;
+      if (n->last_tid != b->tid) {
+        n->threads++;
+        n->last_tid = b->tid;
+      }
+      if (parent >= 0) t->nodes[parent].children += s;
+    }
+    for (int id = 0; id < t->count; ++id) {
+      node* n = &t->nodes[id];
+      if (n->thread_total > n->thread_max) n->thread_max = n->thread_total;
+      n->thread_total = 0.;
+    }
+    free(map);
+  }
+  free(all);
+}
+
+static void print_node(FILE* out, const tree* t, int id) {
+  const node* n = &t->nodes[id];
+  double parent = (n->parent >= 0) ? t->nodes[n->parent].total : 0.;
+  fprintf(out, "%*s%-*s %10ld %7d %12.6f %12.6f %12.6f", 2 * n->depth, "",
+          NAME_WIDTH - 2 * n->depth, n->name, n->calls, n->threads, n->total,
+          n->total - n->children, n->thread_max);
+  if (parent > 0.) fprintf(out, " %8.1f\n", 100. * n->total / parent);
+  else fprintf(out, " %8s\n", "");
+  for (int c = n->first_child; c >= 0; c = t->nodes[c].next_sibling) print_node(out, t, c);
+}
+
+void instr_report(FILE* out) {
+  tree t = {NULL, 0, 0, -1};
+  int nthreads;
+  build_tree(&t, &nthreads);
+  if (t.count == 0) return;
+  fprintf(out, "# Regions");
+  if (the_rank >= 0) fprintf(out, " of rank %d", the_rank);
+  fprintf(out, ", %d thread(s), %s clock; times summed over threads\n",
+          nthreads, use_tsc ? "TSC" : "monotonic");
+  fprintf(out, "# %-*s %10s %7s %12s %12s %12s %8s\n", NAME_WIDTH - 2, "region", "calls",
+          "threads", "total [s]", "self [s]", "max/thr [s]", "% parent");
+  for (int id = t.first_root; id >= 0; id = t.nodes[id].next_sibling) print_node(out, &t, id);
+  free(t.nodes);
+}
+
+/* ========================================================================== */
+/* Trace                                                                      */
+/* ========================================================================== */
+
+static void write_name(FILE* f, const char* s) {
+  fputc('"', f);
+  for (; *s; ++s) {
+    if (*s == '"' || *s == '\\') fputc('\\', f);
+    if ((unsigned char) *s >= 0x20) fputc(*s, f);
+  }
+  fputc('"', f);
+}
+
+int instr_write_trace(const char* prefix) {
+  char path[1024];
+  if (the_rank >= 0) snprintf(path, sizeof(path), "%s.%d.json", prefix, the_rank);
+  else snprintf(path, sizeof(path), "%s.json", prefix);
+  FILE* f = fopen(path, "w");
+  if (f == NULL) {
+    perror(path);
+    return -1;
+  }
+
+  const int pid = the_rank >= 0 ? the_rank : 0;
+  const uint64_t now = instr_ticks();
+  int nb;
+  buffer** all = sorted_buffers(&nb);
+  fprintf(f, "{\"otherData\": {\"rank\": %d, \"origin_epoch_s\": %.6f, \"clock\": \"%s\"},\n",
+          the_rank, origin_epoch, use_tsc ? "tsc" : "monotonic");
+  fprintf(f, "\"displayTimeUnit\": \"ms\",\n\"traceEvents\": [\n");
+  fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": 0, "
+             "\"args\": {\"name\": \"rank %d\"}}", pid, pid);
+  for (int k = 0; k < nb; ++k) {
+    buffer* b = all[k];
+    if (b == NULL) continue;
+    fprintf(f, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, "
+               "\"args\": {\"name\": \"thread %d\"}}", pid, b->tid, b->tid);
+    for (int i = 0; i < b->count; ++i) {
+      const event* e = &b->events[i];
+      uint64_t end = e->end ? e->end : now;
+      fprintf(f, ",\n{\"name\": ");
+      write_name(f, e->name);
+      fprintf(f, ", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+              pid, b->tid, 1.e6 * instr_seconds(e->begin - origin),
+              1.e6 * instr_seconds(end - e->begin));
+    }
+  }
+  fprintf(f, "\n]}\n");
+  free(all);
+  fclose(f);
+  return 0;
+}
+
+void instr_finalize(void) {
+  const char* report = getenv("INSTR_REPORT");
+  const char* trace = getenv("INSTR_TRACE");
+  if (the_rank <= 0 && !(report != NULL && strcmp(report, "0") == 0)) instr_report(stderr);
+  if (trace != NULL && trace[0] != '\0') instr_write_trace(trace);
+}
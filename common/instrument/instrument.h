@@ -0,0 +1,83 @@
+// instrument.h
+//
+// Low-overhead timing regions, shared by the projects instead of one
+// walltime.c/h copy each.
+//
+//   instr_init(rank);                 // once, after MPI_Init (rank -1: no MPI)
+//   instr_begin("cg"); ... instr_end();
+//   { INSTR_SCOPE("diffusion"); ... }  // C++: ends with the scope
+//   instr_finalize();                 // report and trace, before MPI_Finalize
+//
+// Regions nest: every thread keeps its own stack and its own event buffer
+// (no locks on the hot path, a buffer is registered once per thread), and
+// the report merges the threads into one tree of region paths with calls,
+// total and self time, and the largest time of a single thread. A region
+// that a worker thread opens inside an OpenMP parallel region is a root of
+// that thread's tree: nothing tells it which region of the master thread
+// spawned the team. Region names must outlive the program (string
+// literals): only the pointer is stored.
+//
+// Timestamps come from rdtsc when the TSC is invariant (constant_tsc in
+// /proc/cpuinfo), converted to seconds with a rate calibrated against
+// CLOCK_MONOTONIC in instr_init; otherwise from clock_gettime.
+//
+// instr_finalize prints the region tree of rank 0 (or of the process when
+// there is no MPI) to stderr, unless INSTR_REPORT=0, and with
+// INSTR_TRACE=prefix writes prefix.<rank>.json (prefix.json without MPI) in
+// the Chrome trace format: open it in chrome://tracing or ui.perfetto.dev,
+// one process per rank and one track per thread. merge_traces.py puts the
+// files of all ranks into one timeline.
+//
+// Call instr_report / instr_write_trace / instr_finalize from one thread
+// outside parallel regions, when the other threads have closed theirs.
+
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Wall-clock seconds since an arbitrary origin (CLOCK_MONOTONIC), the
+   drop-in for the old walltime.c. */
+double walltime(void);
+
+/* Raw timestamps and their conversion. */
+uint64_t instr_ticks(void);
+double instr_seconds(uint64_t ticks);
+
+void instr_init(int rank);
+void instr_begin(const char* name);
+void instr_end(void);
+
+/* Region tree of the calling process; trace file as described above.
+   instr_write_trace returns 0 on success. */
+void instr_report(FILE* out);
+int instr_write_trace(const char* prefix);
+void instr_finalize(void);
+
+#ifdef __cplusplus
+}
+
+namespace instr {
+
+// Region that ends where the scope does, also on return and exceptions.
+class scope {
+public:
+    explicit scope(const char* name) { instr_begin(name); }
+    ~scope() { instr_end(); }
+    scope(const scope&) = delete;
+    scope& operator=(const scope&) = delete;
+};
+
+} // namespace instr
+
+#define INSTR_CONCAT_(a, b) a##b
+#define INSTR_CONCAT(a, b) INSTR_CONCAT_(a, b)
+#define INSTR_SCOPE(name) instr::scope INSTR_CONCAT(instr_scope_, __LINE__)(name)
+#endif
+
+#endif /* INSTRUMENT_H */
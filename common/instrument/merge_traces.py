@@ -0,0 +1,34 @@
+"""Merge the per-rank Chrome traces of instr_write_trace into one timeline.
+
+    python3 merge_traces.py trace.0.json trace.1.json ... -o trace.json
+
+Every rank counts time from its own instr_init; the files are aligned with
+the wall-clock time of that instant (origin_epoch_s), which is as good as
+the clock synchronisation between the nodes (NTP: about a millisecond).
+"""
+import argparse
+import json
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("traces", nargs="+")
+    parser.add_argument("-o", "--output", default="trace.json")
+    args = parser.parse_args()
+
+    traces = []
+    for path in args.traces:
+        with open(path) as f:
+            traces.append(json.load(f))
+    start = min(t["otherData"]["origin_epoch_s"] for t in traces)
+
+    events = []
+    for t in traces:
+        shift = 1.e6 * (t["otherData"]["origin_epoch_s"] - start)
+        for e in t["traceEvents"]:
+            if "ts" in e:
+                e["ts"] += shift
+            events.append(e)
+
+    with open(args.output, "w") as f:
+        json.dump({"displayTimeUnit": "ms", "traceEvents": events}, f)
+    print(f"{len(events)} events of {len(traces)} rank(s) written to {args.output}")
@@ -0,0 +1,156 @@
+// layout.c
+//
+// See layout.h. The recursions stop at LAYOUT_LEAF and hand the block to
+// the leaf kernels of layout_tile.c, in the variant picked at the first
+// call.
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <xmmintrin.h>
+#endif
+
+#include "layout.h"
+#include "layout_tile.h"
+
+typedef void (*tile_fn)(const double*, size_t, double*, size_t, int, int, int);
+typedef void (*swap_fn)(double*, double*, size_t, int, int);
+typedef void (*inplace_fn)(double*, size_t, int);
+
+static tile_fn tile_kernel(void) {
+  static tile_fn f = NULL;
+  if (f == NULL) f = SIMD_SELECT(layout_tile);
+  return f;
+}
+
+static swap_fn swap_kernel(void) {
+  static swap_fn f = NULL;
+  if (f == NULL) f = SIMD_SELECT(layout_tile_swap);
+  return f;
+}
+
+static inplace_fn inplace_kernel(void) {
+  static inplace_fn f = NULL;
+  if (f == NULL) f = SIMD_SELECT(layout_tile_inplace);
+  return f;
+}
+
+const char* layout_isa(void) {
+  return simd_isa_name(simd_detect());
+}
+
+/* ========================================================================== */
+/* Out of place                                                               */
+/* ========================================================================== */
+
+/* halves at a multiple of 8, so the tiles stay whole away from the edges */
+static int half(int n) {
+  int h = (n / 2 + 7) & ~7;
+  return (h < n) ? h : n / 2;
+}
+
+static void transpose_rec(tile_fn leaf, const double* A, size_t lda, double* B, size_t ldb,
+                          int m, int n, int stream) {
+  if (m <= LAYOUT_LEAF && n <= LAYOUT_LEAF) {
+    leaf(A, lda, B, ldb, m, n, stream);
+  } else if (m >= n) {
+    int m1 = half(m);
+    transpose_rec(leaf, A, lda, B, ldb, m1, n, stream);
+    transpose_rec(leaf, A + m1 * lda, lda, B + m1, ldb, m - m1, n, stream);
+  } else {
+    int n1 = half(n);
+    transpose_rec(leaf, A, lda, B, ldb, m, n1, stream);
+    transpose_rec(leaf, A + n1, lda, B + n1 * ldb, ldb, m, n - n1, stream);
+  }
+}
+
+void layout_transpose_stream(const double* A, size_t lda, double* B, size_t ldb,
+                             int m, int n, int stream) {
+  tile_fn leaf = tile_kernel();
+  if (m <= 0 || n <= 0) return;
+  if (stream < 0) stream = (double) m * n * sizeof(double) >= LAYOUT_STREAM_BYTES;
+  transpose_rec(leaf, A, lda, B, ldb, m, n, stream);
+#if defined(__x86_64__) || defined(__i386__)
+  if (stream) _mm_sfence();
+#endif
+}
+
+void layout_transpose(const double* A, size_t lda, double* B, size_t ldb, int m, int n) {
+  layout_transpose_stream(A, lda, B, ldb, m, n, -1);
+}
+
+/* ========================================================================== */
+/* In place                                                                   */
+/* ========================================================================== */
+
+/* X (r x c) <- Y^T and Y (c x r) <- X^T */
+static void swap_rec(swap_fn leaf, double* X, double* Y, size_t lda, int r, int c) {
+  if (r <= LAYOUT_LEAF && c <= LAYOUT_LEAF) {
+    leaf(X, Y, lda, r, c);
+  } else if (r >= c) {
+    int r1 = half(r);
+    swap_rec(leaf, X, Y, lda, r1, c);
+    swap_rec(leaf, X + r1 * lda, Y + r1, lda, r - r1, c);
+  } else {
+    int c1 = half(c);
+    swap_rec(leaf, X, Y, lda, r, c1);
+    swap_rec(leaf, X + c1, Y + c1 * lda, lda, r, c - c1);
+  }
+}
+
+static void inplace_rec(inplace_fn leaf, swap_fn swap, double* A, size_t lda, int n) {
+  if (n <= LAYOUT_LEAF) {
+    leaf(A, lda, n);
+    return;
+  }
+  int h = half(n);
+  inplace_rec(leaf, swap, A, lda, h);
+  inplace_rec(leaf, swap, A + h * lda + h, lda, n - h);
+  swap_rec(swap, A + h, A + h * lda, lda, h, n - h);
+}
+
+void layout_transpose_inplace(double* A, size_t lda, int n) {
+  if (n <= 1) return;
+  inplace_rec(inplace_kernel(), swap_kernel(), A, lda, n);
+}
+
+/* ========================================================================== */
+/* Blocked                                                                    */
+/* ========================================================================== */
+
+size_t layout_blocked_size(int m, int n, int mb, int nb) {
+  size_t tm = (m + mb - 1) / mb, tn = (n + nb - 1) / nb;
+  return tm * tn * mb * nb;
+}
+
+void layout_to_blocked(const double* A, size_t lda, int m, int n, int mb, int nb,
+                       double* P) {
+  int tn = (n + nb - 1) / nb;
+  for (int I = 0; I * mb < m; ++I) {
+    for (int J = 0; J < tn; ++J) {
+      double* tile = P + ((size_t) I * tn + J) * mb * nb;
+      int rows = (m - I * mb < mb) ? m - I * mb : mb;
+      int cols = (n - J * nb < nb) ? n - J * nb : nb;
+      for (int i = 0; i < rows; ++i) {
+        memcpy(tile + i * nb, A + (I * mb + i) * lda + J * nb, cols * sizeof(double));
+        memset(tile + i * nb + cols, 0, (nb - cols) * sizeof(double));
+      }
+      memset(tile + rows * nb, 0, (size_t) (mb - rows) * nb * sizeof(double));
+    }
+  }
+}
+
+void layout_from_blocked(const double* P, int m, int n, int mb, int nb,
+                         double* A, size_t lda) {
+  int tn = (n + nb - 1) / nb;
+  for (int I = 0; I * mb < m; ++I) {
+    for (int J = 0; J < tn; ++J) {
+      const double* tile = P + ((size_t) I * tn + J) * mb * nb;
+      int rows = (m - I * mb < mb) ? m - I * mb : mb;
+      int cols = (n - J * nb < nb) ? n - J * nb : nb;
+      for (int i = 0; i < rows; ++i) {
+        memcpy(A + (I * mb + i) * lda + J * nb, tile + i * nb, cols * sizeof(double));
+      }
+    }
+  }
+}
@@ -0,0 +1,78 @@
+// layout.h
+//
+// Conversions between the layouts the projects pass dense matrices in:
+// row-major, column-major and blocked (tile after tile, as GEMM packing and
+// block distributions want them).
+//
+//   layout_transpose(A, lda, B, ldb, m, n);            // B (n x m) = A^T
+//   layout_transpose_parallel(A, lda, B, ldb, m, n);   // same, OpenMP
+//   layout_transpose_inplace(A, lda, n);               // A = A^T, square
+//   layout_to_blocked(A, lda, m, n, mb, nb, P);        // and back
+//
+// Matrices are row-major with leading dimension ld (elements between the
+// starts of two rows, >= the number of columns). A column-major matrix is
+// the row-major storage of its transpose, so converting between the two is
+// one transpose with the dimensions read accordingly.
+//
+// The transposes are cache-oblivious: the larger dimension is halved until
+// the block has at most LAYOUT_LEAF rows and columns (two such blocks fit
+// in any L1), so every level of the hierarchy sees blocks it can hold
+// without knowing its size. A leaf is transposed in registers, in 8x8
+// (AVX-512), 4x4 (AVX) or 2x2 (SSE) tiles, by the variant of layout_tile.c
+// for this CPU (common/simd dispatch; SIMD_ISA=scalar|sse4|avx2|avx512
+// forces a narrower one). Large matrices are written with non-temporal
+// stores (LAYOUT_STREAM_BYTES). A and B must not overlap.
+//
+// layout_transpose_parallel is in its own object: only the programs that
+// call it need OpenMP.
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LAYOUT_LEAF 32
+
+/* From this size on, the out-of-place transposes write B with
+   non-temporal stores: B would not stay in the caches anyway. */
+#define LAYOUT_STREAM_BYTES (16 << 20)
+
+/* B = A^T: A is m x n, B is n x m. */
+void layout_transpose(const double* A, size_t lda, double* B, size_t ldb, int m, int n);
+
+/* Same, choosing the stores: stream = 1 non-temporal, 0 cached, -1 by
+   LAYOUT_STREAM_BYTES as layout_transpose does. */
+void layout_transpose_stream(const double* A, size_t lda, double* B, size_t ldb,
+                             int m, int n, int stream);
+
+/* B = A^T with the OpenMP threads of the caller's team size: panels of B
+   rows, each transposed cache-obliviously. Worth it beyond a few MiB. */
+void layout_transpose_parallel(const double* A, size_t lda, double* B, size_t ldb,
+                               int m, int n);
+
+/* A = A^T for the n x n matrix A, swapping the blocks across the diagonal
+   with the same recursion. */
+void layout_transpose_inplace(double* A, size_t lda, int n);
+
+/* Blocked layout of an m x n matrix: ceil(m/mb) x ceil(n/nb) tiles of
+   mb x nb, row of tiles after row of tiles, each tile row-major and
+   contiguous (mb * nb elements), the tiles on the right and bottom edges
+   padded with zeros. Tile (I, J) starts at P + (I * ceil(n/nb) + J) * mb * nb. */
+size_t layout_blocked_size(int m, int n, int mb, int nb);
+void layout_to_blocked(const double* A, size_t lda, int m, int n, int mb, int nb,
+                       double* P);
+void layout_from_blocked(const double* P, int m, int n, int mb, int nb,
+                         double* A, size_t lda);
+
+/* Name of the ISA the transposes run with. */
+const char* layout_isa(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LAYOUT_H */
@@ -0,0 +1,186 @@
+// layout_bench.c
+//
+// Bandwidth of the transposes of layout.h against the naive loops and
+// against memcpy, the ceiling of any out-of-place copy:
+//
+//   ./layout_bench [n ...]        (default 1000 2048 4096)
+//
+// For every n x n matrix of doubles the best of LAYOUT_REPEATS (default 5)
+// runs is reported in GB/s of useful traffic, 2 * 8 * n^2 bytes (one read
+// and one write per element; the write-allocate reads of the destination
+// are not counted, as in STREAM). Powers of two are the worst case of the
+// naive loops: every column access hits the same cache sets. Every result
+// is checked against A^T first, and odd shapes are checked once at start.
+
+#define _GNU_SOURCE
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "layout.h"
+
+static double seconds(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + 1.e-9 * t.tv_nsec;
+}
+
+static double* alloc(size_t count) {
+  void* p = NULL;
+  if (posix_memalign(&p, 64, count * sizeof(double) + 64) != 0) {
+    perror("posix_memalign");
+    exit(EXIT_FAILURE);
+  }
+  return (double*) p;
+}
+
+static void fill(double* A, int m, int n) {
+  for (size_t k = 0; k < (size_t) m * n; ++k) A[k] = (double) k;
+}
+
+/* B (n x m) == A^T for A filled by fill() */
+static int check(const double* B, int m, int n, const char* what) {
+  for (int j = 0; j < n; ++j) {
+    for (int i = 0; i < m; ++i) {
+      if (B[(size_t) j * m + i] != (double) ((size_t) i * n + j)) {
+        fprintf(stderr, "%s: wrong element (%d, %d) for %d x %d\n", what, j, i, n, m);
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+/* ========================================================================== */
+/* Naive loops                                                                */
+/* ========================================================================== */
+
+/* reads A by rows, writes B by columns */
+static void naive_rows(const double* A, double* B, int n) {
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) B[(size_t) j * n + i] = A[(size_t) i * n + j];
+  }
+}
+
+/* reads A by columns, writes B by rows */
+static void naive_cols(const double* A, double* B, int n) {
+  for (int j = 0; j < n; ++j) {
+    for (int i = 0; i < n; ++i) B[(size_t) j * n + i] = A[(size_t) i * n + j];
+  }
+}
+
+/* ========================================================================== */
+/* Benchmark                                                                  */
+/* ========================================================================== */
+
+enum { MEMCPY, NAIVE_ROWS, NAIVE_COLS, OBLIVIOUS, PARALLEL, INPLACE, NMETHODS };
+
+static const char* const names[NMETHODS] = {
+  "memcpy", "naive rows", "naive cols", "oblivious", "parallel", "in-place",
+};
+
+static void run(int method, const double* A, double* B, int n) {
+  switch (method) {
+  case MEMCPY:     memcpy(B, A, (size_t) n * n * sizeof(double)); break;
+  case NAIVE_ROWS: naive_rows(A, B, n); break;
+  case NAIVE_COLS: naive_cols(A, B, n); break;
+  case OBLIVIOUS:  layout_transpose(A, n, B, n, n, n); break;
+  case PARALLEL:   layout_transpose_parallel(A, n, B, n, n, n); break;
+  case INPLACE:    layout_transpose_inplace(B, n, n); break;
+  }
+}
+
+/* odd shapes, leading dimensions larger than the rows, blocked round trip */
+static int self_test(void) {
+  static const int shapes[][2] = {{1, 1}, {1, 100}, {100, 1}, {37, 61}, {61, 37},
+                                  {257, 129}, {300, 300}, {33, 8}};
+  int ok = 1;
+  for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); ++s) {
+    int m = shapes[s][0], n = shapes[s][1];
+    double* A = alloc((size_t) m * n);
+    double* B = alloc((size_t) m * n);
+    fill(A, m, n);
+    layout_transpose(A, n, B, m, m, n);
+    ok &= check(B, m, n, "layout_transpose");
+    memset(B, 0, (size_t) m * n * sizeof(double));
+    layout_transpose_parallel(A, n, B, m, m, n);
+    ok &= check(B, m, n, "layout_transpose_parallel");
+    if (m == n) {
+      memcpy(B, A, (size_t) m * n * sizeof(double));
+      layout_transpose_inplace(B, n, n);
+      ok &= check(B, m, n, "layout_transpose_inplace");
+    }
+
+    /* blocked and back, with a leading dimension larger than n */
+    size_t lda = n + 3;
+    double* P = alloc(layout_blocked_size(m, n, 8, 6));
+    double* C = alloc((size_t) m * lda);
+    double* D = alloc((size_t) m * lda);
+    for (int i = 0; i < m; ++i) memcpy(C + i * lda, A + (size_t) i * n, n * sizeof(double));
+    layout_to_blocked(C, lda, m, n, 8, 6, P);
+    layout_from_blocked(P, m, n, 8, 6, D, lda);
+    for (int i = 0; i < m; ++i) {
+      if (memcmp(C + i * lda, D + i * lda, n * sizeof(double)) != 0) {
+        fprintf(stderr, "blocked round trip: wrong row %d for %d x %d\n", i, m, n);
+        ok = 0;
+        break;
+      }
+    }
+    free(A);
+    free(B);
+    free(P);
+    free(C);
+    free(D);
+  }
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  int default_sizes[] = {1000, 2048, 4096};
+  int nsizes = argc > 1 ? argc - 1 : (int) (sizeof(default_sizes) / sizeof(default_sizes[0]));
+  int repeats = getenv("LAYOUT_REPEATS") ? atoi(getenv("LAYOUT_REPEATS")) : 5;
+  if (repeats < 1) repeats = 1;
+
+  printf("# ISA:\t\t%s\n# Threads:\t%d\n# Repeats:\t%d\n", layout_isa(),
+         omp_get_max_threads(), repeats);
+  if (!self_test()) return EXIT_FAILURE;
+  printf("# Self test:\tpassed\n\n");
+
+  printf("%8s %10s", "n", "MiB");
+  for (int k = 0; k < NMETHODS; ++k) printf(" %11s", names[k]);
+  printf("   [GB/s]\n");
+
+  for (int s = 0; s < nsizes; ++s) {
+    int n = argc > 1 ? atoi(argv[s + 1]) : default_sizes[s];
+    if (n <= 0) {
+      fprintf(stderr, "invalid size %s\n", argv[s + 1]);
+      return EXIT_FAILURE;
+    }
+    size_t count = (size_t) n * n;
+    double* A = alloc(count);
+    double* B = alloc(count);
+    fill(A, n, n);
+    memset(B, 0, count * sizeof(double));
+
+    printf("%8d %10.1f", n, count * sizeof(double) / 1048576.);
+    for (int k = 0; k < NMETHODS; ++k) {
+      double best = 1.e30;
+      for (int r = 0; r < repeats; ++r) {
+        if (k == INPLACE) memcpy(B, A, count * sizeof(double));
+        double t = seconds();
+        run(k, A, B, n);
+        t = seconds() - t;
+        if (t < best) best = t;
+        if (k != MEMCPY && !check(B, n, n, names[k])) return EXIT_FAILURE;
+      }
+      printf(" %11.2f", 2. * count * sizeof(double) / best * 1.e-9);
+      fflush(stdout);
+    }
+    printf("\n");
+    free(A);
+    free(B);
+  }
+  return 0;
+}
@@ -0,0 +1,31 @@
+// layout_parallel.c
+//
+// layout_transpose_parallel, see layout.h: B is cut in panels of
+// LAYOUT_PANEL x LAYOUT_PANEL, statically over the threads, and each panel
+// is a cache-oblivious transpose of its own. Every thread writes whole
+// panels of B, so no two threads share a cache line of the output except
+// at the panel edges.
+
+#include "layout.h"
+
+#define LAYOUT_PANEL 256
+
+void layout_transpose_parallel(const double* A, size_t lda, double* B, size_t ldb,
+                               int m, int n) {
+  int pm = (m + LAYOUT_PANEL - 1) / LAYOUT_PANEL;
+  int pn = (n + LAYOUT_PANEL - 1) / LAYOUT_PANEL;
+
+  /* empty call: picks the leaf kernel before the threads race for it */
+  layout_transpose(A, lda, B, ldb, 0, 0);
+  int stream = (double) m * n * sizeof(double) >= LAYOUT_STREAM_BYTES;
+
+#pragma omp parallel for collapse(2) schedule(static)
+  for (int J = 0; J < pn; ++J) {
+    for (int I = 0; I < pm; ++I) {
+      int i = I * LAYOUT_PANEL, j = J * LAYOUT_PANEL;
+      int rows = (m - i < LAYOUT_PANEL) ? m - i : LAYOUT_PANEL;
+      int cols = (n - j < LAYOUT_PANEL) ? n - j : LAYOUT_PANEL;
+      layout_transpose_stream(A + i * lda + j, lda, B + j * ldb + i, ldb, rows, cols, stream);
+    }
+  }
+}
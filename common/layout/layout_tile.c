@@ -0,0 +1,170 @@
+// layout_tile.c
+//
+// Leaf kernels of the transposes (layout.c), compiled once per ISA with
+// the flags of common/simd/simd.mk: a block of at most LAYOUT_LEAF x
+// LAYOUT_LEAF is cut in TILE x TILE tiles, each loaded as TILE rows,
+// transposed in registers and stored as TILE rows; the edges that do not
+// fill a tile go element by element.
+//
+// With stream set (large matrices, see layout.c) the tiles of B are written
+// with non-temporal stores when B is aligned to the vector: no read for
+// ownership of the destination, which otherwise costs a third of the
+// traffic, and no eviction of A from the caches. The tiles go down the
+// columns of A, so consecutive stores fill the same TILE lines of B and
+// the write-combining buffers flush whole lines. The caller fences.
+
+#include <stdint.h>
+
+#include "dispatch.h"
+#include "layout_tile.h"
+
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+#define TILE 8
+typedef __m512d row_t;
+#define LOAD(p)     _mm512_loadu_pd(p)
+#define STORE(p, v) _mm512_storeu_pd(p, v)
+#define STREAM(p, v) _mm512_stream_pd(p, v)
+
+/* pairs of rows, then 128-bit lanes of pairs, then lanes of quadruples */
+static inline void transpose_tile(row_t r[8]) {
+  row_t t[8], u[8];
+  for (int k = 0; k < 8; k += 2) {
+    t[k]     = _mm512_unpacklo_pd(r[k], r[k + 1]);   /* a0 b0 a2 b2 a4 b4 a6 b6 */
+    t[k + 1] = _mm512_unpackhi_pd(r[k], r[k + 1]);   /* a1 b1 a3 b3 a5 b5 a7 b7 */
+  }
+  for (int k = 0; k < 8; k += 4) {
+    u[k]     = _mm512_shuffle_f64x2(t[k],     t[k + 2], 0x88);  /* a0 b0 a4 b4 c0 d0 c4 d4 */
+    u[k + 1] = _mm512_shuffle_f64x2(t[k],     t[k + 2], 0xdd);  /* a2 b2 a6 b6 c2 d2 c6 d6 */
+    u[k + 2] = _mm512_shuffle_f64x2(t[k + 1], t[k + 3], 0x88);  /* a1 b1 a5 b5 c1 d1 c5 d5 */
+    u[k + 3] = _mm512_shuffle_f64x2(t[k + 1], t[k + 3], 0xdd);  /* a3 b3 a7 b7 c3 d3 c7 d7 */
+  }
+  r[0] = _mm512_shuffle_f64x2(u[0], u[4], 0x88);
+  r[4] = _mm512_shuffle_f64x2(u[0], u[4], 0xdd);
+  r[2] = _mm512_shuffle_f64x2(u[1], u[5], 0x88);
+  r[6] = _mm512_shuffle_f64x2(u[1], u[5], 0xdd);
+  r[1] = _mm512_shuffle_f64x2(u[2], u[6], 0x88);
+  r[5] = _mm512_shuffle_f64x2(u[2], u[6], 0xdd);
+  r[3] = _mm512_shuffle_f64x2(u[3], u[7], 0x88);
+  r[7] = _mm512_shuffle_f64x2(u[3], u[7], 0xdd);
+}
+
+#elif defined(__AVX__)
+
+#include <immintrin.h>
+#define TILE 4
+typedef __m256d row_t;
+#define LOAD(p)     _mm256_loadu_pd(p)
+#define STORE(p, v) _mm256_storeu_pd(p, v)
+#define STREAM(p, v) _mm256_stream_pd(p, v)
+
+static inline void transpose_tile(row_t r[4]) {
+  row_t t0 = _mm256_unpacklo_pd(r[0], r[1]);   /* a0 b0 a2 b2 */
+  row_t t1 = _mm256_unpackhi_pd(r[0], r[1]);   /* a1 b1 a3 b3 */
+  row_t t2 = _mm256_unpacklo_pd(r[2], r[3]);   /* c0 d0 c2 d2 */
+  row_t t3 = _mm256_unpackhi_pd(r[2], r[3]);   /* c1 d1 c3 d3 */
+  r[0] = _mm256_permute2f128_pd(t0, t2, 0x20);
+  r[1] = _mm256_permute2f128_pd(t1, t3, 0x20);
+  r[2] = _mm256_permute2f128_pd(t0, t2, 0x31);
+  r[3] = _mm256_permute2f128_pd(t1, t3, 0x31);
+}
+
+#elif defined(__SSE4_1__)
+
+#include <immintrin.h>
+#define TILE 2
+typedef __m128d row_t;
+#define LOAD(p)     _mm_loadu_pd(p)
+#define STORE(p, v) _mm_storeu_pd(p, v)
+#define STREAM(p, v) _mm_stream_pd(p, v)
+
+static inline void transpose_tile(row_t r[2]) {
+  row_t t = _mm_unpacklo_pd(r[0], r[1]);
+  r[1] = _mm_unpackhi_pd(r[0], r[1]);
+  r[0] = t;
+}
+
+#else
+
+#define TILE 1
+typedef double row_t;
+#define LOAD(p)     (*(p))
+#define STORE(p, v) (*(p) = (v))
+#define STREAM(p, v) STORE(p, v)
+
+static inline void transpose_tile(row_t r[1]) { (void) r; }
+
+#endif
+
+/* B tile = (A tile)^T */
+static inline void tile_transpose(const double* A, size_t lda, double* B, size_t ldb,
+                                  int stream) {
+  row_t r[TILE];
+  for (int k = 0; k < TILE; ++k) r[k] = LOAD(A + k * lda);
+  transpose_tile(r);
+  if (stream) {
+    for (int k = 0; k < TILE; ++k) STREAM(B + k * ldb, r[k]);
+  } else {
+    for (int k = 0; k < TILE; ++k) STORE(B + k * ldb, r[k]);
+  }
+}
+
+/* X tile <-> (Y tile)^T, both in registers before either is stored */
+static inline void tile_swap(double* X, double* Y, size_t lda) {
+  row_t x[TILE], y[TILE];
+  for (int k = 0; k < TILE; ++k) {
+    x[k] = LOAD(X + k * lda);
+    y[k] = LOAD(Y + k * lda);
+  }
+  transpose_tile(x);
+  transpose_tile(y);
+  for (int k = 0; k < TILE; ++k) {
+    STORE(X + k * lda, y[k]);
+    STORE(Y + k * lda, x[k]);
+  }
+}
+
+void SIMD_NAME(layout_tile)(const double* A, size_t lda, double* B, size_t ldb,
+                            int m, int n, int stream) {
+  int mt = m - m % TILE, nt = n - n % TILE;
+  stream = stream && TILE > 1 && ldb % TILE == 0
+        && (uintptr_t) B % (TILE * sizeof(double)) == 0;
+  for (int j = 0; j < nt; j += TILE) {
+    for (int i = 0; i < mt; i += TILE) {
+      tile_transpose(A + i * lda + j, lda, B + j * ldb + i, ldb, stream);
+    }
+  }
+  for (int i = 0; i < m; ++i) {
+    for (int j = (i < mt) ? nt : 0; j < n; ++j) B[j * ldb + i] = A[i * lda + j];
+  }
+}
+
+void SIMD_NAME(layout_tile_swap)(double* X, double* Y, size_t lda, int r, int c) {
+  int rt = r - r % TILE, ct = c - c % TILE;
+  for (int i = 0; i < rt; i += TILE) {
+    for (int j = 0; j < ct; j += TILE) tile_swap(X + i * lda + j, Y + j * lda + i, lda);
+  }
+  for (int i = 0; i < r; ++i) {
+    for (int j = (i < rt) ? ct : 0; j < c; ++j) {
+      double t = X[i * lda + j];
+      X[i * lda + j] = Y[j * lda + i];
+      Y[j * lda + i] = t;
+    }
+  }
+}
+
+void SIMD_NAME(layout_tile_inplace)(double* A, size_t lda, int n) {
+  int nt = n - n % TILE;
+  for (int i = 0; i < nt; i += TILE) {
+    tile_transpose(A + i * lda + i, lda, A + i * lda + i, lda, 0);
+    for (int j = i + TILE; j < nt; j += TILE) tile_swap(A + i * lda + j, A + j * lda + i, lda);
+  }
+  for (int i = 0; i < n; ++i) {
+    for (int j = (i < nt) ? nt : i + 1; j < n; ++j) {
+      double t = A[i * lda + j];
+      A[i * lda + j] = A[j * lda + i];
+      A[j * lda + i] = t;
+    }
+  }
+}
@@ -0,0 +1,19 @@
+// layout_tile.h
+//
+// Leaf kernels of layout.c, one copy per ISA (layout_tile.c): transpose of
+// an m x n block into B (with non-temporal stores if stream), swap of the
+// r x c block X with the transpose of the c x r block Y (same leading
+// dimension), in-place transpose of a square block.
+
+#ifndef LAYOUT_TILE_H
+#define LAYOUT_TILE_H
+
+#include <stddef.h>
+#include "dispatch.h"
+
+SIMD_DECLARE(void, layout_tile, (const double* A, size_t lda, double* B, size_t ldb,
+                                 int m, int n, int stream));
+SIMD_DECLARE(void, layout_tile_swap, (double* X, double* Y, size_t lda, int r, int c));
+SIMD_DECLARE(void, layout_tile_inplace, (double* A, size_t lda, int n));
+
+#endif /* LAYOUT_TILE_H */
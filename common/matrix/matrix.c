@@ -0,0 +1,101 @@
+// matrix.c
+//
+// See matrix.h. GEMV hands the storage to the kernel of its layout in
+// matrix_kernel.c, in the variant picked at the first call.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "layout.h"
+#include "matrix.h"
+#include "matrix_kernel.h"
+
+typedef void (*gemv_fn)(int, int, double, const double*, size_t, const double*, double,
+                        double*);
+
+static gemv_fn rows_kernel(void) {
+  static gemv_fn f = NULL;
+  if (f == NULL) f = SIMD_SELECT(matrix_gemv_rows);
+  return f;
+}
+
+static gemv_fn cols_kernel(void) {
+  static gemv_fn f = NULL;
+  if (f == NULL) f = SIMD_SELECT(matrix_gemv_cols);
+  return f;
+}
+
+const char* matrix_isa(void) {
+  return simd_isa_name(simd_detect());
+}
+
+/* ========================================================================== */
+/* Storage and views                                                          */
+/* ========================================================================== */
+
+matrix matrix_create(int rows, int cols, matrix_layout layout) {
+  matrix A = {NULL, 0, 0, 0, layout, 0};
+  if (rows <= 0 || cols <= 0) return A;
+
+  size_t ld = (layout == MATRIX_ROW_MAJOR) ? cols : rows;
+  ld = (ld + 7) & ~(size_t) 7;
+  size_t count = ld * ((layout == MATRIX_ROW_MAJOR) ? rows : cols);
+  void* p = NULL;
+  if (posix_memalign(&p, 64, count * sizeof(double)) != 0) return A;
+  memset(p, 0, count * sizeof(double));
+
+  A.data = (double*) p;
+  A.rows = rows;
+  A.cols = cols;
+  A.ld = ld;
+  A.owner = 1;
+  return A;
+}
+
+void matrix_destroy(matrix* A) {
+  if (A->owner) free(A->data);
+  A->data = NULL;
+  A->rows = A->cols = 0;
+  A->ld = 0;
+  A->owner = 0;
+}
+
+matrix matrix_wrap(double* data, int rows, int cols, size_t ld, matrix_layout layout) {
+  matrix A = {data, rows, cols, ld, layout, 0};
+  return A;
+}
+
+matrix matrix_view(const matrix* A, int i0, int j0, int rows, int cols) {
+  matrix V = {matrix_at(A, i0, j0), rows, cols, A->ld, A->layout, 0};
+  return V;
+}
+
+matrix matrix_transpose_view(const matrix* A) {
+  matrix_layout flipped = (A->layout == MATRIX_ROW_MAJOR) ? MATRIX_COL_MAJOR : MATRIX_ROW_MAJOR;
+  matrix T = {A->data, A->cols, A->rows, A->ld, flipped, 0};
+  return T;
+}
+
+/* A row-major m x n matrix is the column-major storage of an n x m one:
+   same layouts copy line by line, different layouts are one transpose. */
+void matrix_convert(const matrix* A, matrix* B) {
+  int lines = (A->layout == MATRIX_ROW_MAJOR) ? A->rows : A->cols;
+  int length = (A->layout == MATRIX_ROW_MAJOR) ? A->cols : A->rows;
+  if (A->layout == B->layout) {
+    for (int k = 0; k < lines; ++k) {
+      memcpy(B->data + k * B->ld, A->data + k * A->ld, length * sizeof(double));
+    }
+  } else {
+    layout_transpose(A->data, A->ld, B->data, B->ld, lines, length);
+  }
+}
+
+/* ========================================================================== */
+/* GEMV                                                                       */
+/* ========================================================================== */
+
+void matrix_gemv(double alpha, const matrix* A, const double* x, double beta, double* y) {
+  gemv_fn kernel = (A->layout == MATRIX_ROW_MAJOR) ? rows_kernel() : cols_kernel();
+  if (A->rows <= 0) return;
+  kernel(A->rows, A->cols, alpha, A->data, A->ld, x, beta, y);
+}
@@ -0,0 +1,95 @@
+// matrix.h
+//
+// Dense matrix of doubles in one aligned allocation, with its layout
+// explicit, instead of double** (one allocation per row, one more load per
+// access) or a bare pointer whose order lives in comments:
+//
+//   matrix A = matrix_create(m, n, MATRIX_ROW_MAJOR);
+//   *matrix_at(&A, i, j) = 1.;
+//   matrix_gemv(1., &A, x, 0., y);                 // y = A x
+//   matrix B = matrix_view(&A, i0, j0, rows, cols); // shares A's storage
+//   matrix_destroy(&A);
+//
+// ld is the leading dimension: elements between the starts of two rows
+// (row-major) or two columns (column-major). matrix_create rounds it up to
+// a multiple of 8, so with the 64-byte aligned allocation every row (or
+// column) starts on a cache line. A view is a block of another matrix with
+// the same ld, a strided window that owns nothing; matrix_wrap describes
+// storage allocated elsewhere. matrix_transpose_view is A^T for free: the
+// same storage read in the other layout.
+//
+// matrix_gemv picks a kernel per layout, compiled per ISA (matrix_kernel.c,
+// common/simd dispatch, SIMD_ISA=scalar|sse4|avx2|avx512 to force one):
+//
+//   row-major     y_i = dot(row i, x), 4 rows at a time: every load of x
+//                 serves 4 rows and the 4 sums are independent chains.
+//   column-major  y += x_j * column j, 4 columns at a time on a panel of
+//                 y that stays in L1: y is loaded and stored once per 4
+//                 columns instead of once per column.
+//
+// Both read A once, with unit stride, so GEMV runs at the bandwidth of
+// memory (2 flops per 8 bytes of A). matrix_gemv_parallel splits the rows
+// over the OpenMP threads and lives in its own object: only the programs
+// that call it need OpenMP. matrix_convert copies between layouts with the
+// transposes of common/layout, so programs linking libmatrix.a also link
+// liblayout.a.
+
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum { MATRIX_ROW_MAJOR, MATRIX_COL_MAJOR } matrix_layout;
+
+typedef struct {
+  double*       data;       /* element (0, 0) */
+  int           rows, cols;
+  size_t        ld;
+  matrix_layout layout;
+  int           owner;      /* 1: data from matrix_create, freed by matrix_destroy */
+} matrix;
+
+/* rows x cols, zeroed. On failure data is NULL (and rows = cols = 0). */
+matrix matrix_create(int rows, int cols, matrix_layout layout);
+
+/* Frees the storage if A owns it; A becomes empty either way. */
+void matrix_destroy(matrix* A);
+
+/* Existing storage, not owned: ld >= cols (row-major) or >= rows. */
+matrix matrix_wrap(double* data, int rows, int cols, size_t ld, matrix_layout layout);
+
+/* The rows x cols block of A starting at (i0, j0), sharing its storage. */
+matrix matrix_view(const matrix* A, int i0, int j0, int rows, int cols);
+
+/* A^T sharing the storage of A (the layout flips). */
+matrix matrix_transpose_view(const matrix* A);
+
+static inline double* matrix_at(const matrix* A, int i, int j) {
+  return (A->layout == MATRIX_ROW_MAJOR) ? A->data + (size_t) i * A->ld + j
+                                         : A->data + (size_t) j * A->ld + i;
+}
+
+/* B = A, element by element, whatever the two layouts (same dimensions). */
+void matrix_convert(const matrix* A, matrix* B);
+
+/* y = alpha A x + beta y, x of A->cols elements, y of A->rows; y is not
+   read when beta is 0. */
+void matrix_gemv(double alpha, const matrix* A, const double* x, double beta, double* y);
+
+/* Same with the OpenMP threads of the caller's team size, each on a block
+   of rows (a multiple of 8, so column-major blocks stay aligned). */
+void matrix_gemv_parallel(double alpha, const matrix* A, const double* x, double beta,
+                          double* y);
+
+/* Name of the ISA the kernels run with. */
+const char* matrix_isa(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MATRIX_H */
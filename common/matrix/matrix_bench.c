@@ -0,0 +1,247 @@
+// matrix_bench.c
+//
+// Bandwidth of the GEMV kernels of matrix.h against the naive loops and
+// against STREAM triad, the ceiling of any kernel that streams its data
+// from memory once:
+//
+//   ./matrix_bench [n ...]        (default 1000 2048 4000)
+//
+// For every n x n matrix the best of MATRIX_REPEATS (default 10) runs is
+// reported in GB/s of useful traffic, 8 * (n^2 + 2 n) bytes (A and x read
+// once, y written once). The naive loops run on the same contiguous
+// row-major storage, in the two orders of loop_reoder_example.cpp: "naive
+// ij" one dot product per row, "naive ji" one column at a time, strided.
+// The kernels run on A row-major and on a column-major copy, serial and
+// with the OpenMP threads. Triad is measured at start on three arrays of
+// 64 MiB, serial and with the threads; %triad is the best serial kernel
+// against the serial triad. It can pass 100% out of the caches, and a bit
+// in memory too: triad also pays the write-allocate reads of a, which
+// STREAM does not count, while GEMV writes almost nothing. Every result is
+// checked against naive ij.
+
+#define _GNU_SOURCE
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "matrix.h"
+
+static double seconds(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + 1.e-9 * t.tv_nsec;
+}
+
+static double* alloc(size_t count) {
+  void* p = NULL;
+  if (posix_memalign(&p, 64, count * sizeof(double)) != 0) {
+    perror("posix_memalign");
+    exit(EXIT_FAILURE);
+  }
+  return (double*) p;
+}
+
+/* ========================================================================== */
+/* References                                                                 */
+/* ========================================================================== */
+
+#define TRIAD_COUNT (8 << 20)
+
+/* a = b + s c, 3 * 8 bytes per element as STREAM counts them */
+static double triad(int parallel, int repeats) {
+  double* a = alloc(TRIAD_COUNT);
+  double* b = alloc(TRIAD_COUNT);
+  double* c = alloc(TRIAD_COUNT);
+  int nthreads = parallel ? omp_get_max_threads() : 1;
+#pragma omp parallel for schedule(static) num_threads(nthreads)
+  for (long k = 0; k < TRIAD_COUNT; ++k) {
+    a[k] = 0.;
+    b[k] = 1.;
+    c[k] = 2.;
+  }
+  double best = 1.e30;
+  for (int r = 0; r < repeats; ++r) {
+    double t = seconds();
+#pragma omp parallel for schedule(static) num_threads(nthreads)
+    for (long k = 0; k < TRIAD_COUNT; ++k) a[k] = b[k] + 3. * c[k];
+    t = seconds() - t;
+    if (t < best) best = t;
+  }
+  free(a);
+  free(b);
+  free(c);
+  return 3. * TRIAD_COUNT * sizeof(double) / best * 1.e-9;
+}
+
+/* one dot product per row */
+static void naive_ij(const matrix* A, const double* x, double* y) {
+  for (int i = 0; i < A->rows; ++i) {
+    double s = 0.;
+    for (int j = 0; j < A->cols; ++j) s += A->data[i * A->ld + j] * x[j];
+    y[i] = s;
+  }
+}
+
+/* one column at a time: stride ld through the row-major storage */
+static void naive_ji(const matrix* A, const double* x, double* y) {
+  for (int i = 0; i < A->rows; ++i) y[i] = 0.;
+  for (int j = 0; j < A->cols; ++j) {
+    for (int i = 0; i < A->rows; ++i) y[i] += A->data[i * A->ld + j] * x[j];
+  }
+}
+
+/* ========================================================================== */
+/* Benchmark                                                                  */
+/* ========================================================================== */
+
+enum { NAIVE_IJ, NAIVE_JI, ROWS, COLS, PAR_ROWS, PAR_COLS, NMETHODS };
+
+static const char* const names[NMETHODS] = {
+  "naive ij", "naive ji", "rows", "cols", "par rows", "par cols",
+};
+
+static void run(int method, const matrix* R, const matrix* C, const double* x, double* y) {
+  switch (method) {
+  case NAIVE_IJ: naive_ij(R, x, y); break;
+  case NAIVE_JI: naive_ji(R, x, y); break;
+  case ROWS:     matrix_gemv(1., R, x, 0., y); break;
+  case COLS:     matrix_gemv(1., C, x, 0., y); break;
+  case PAR_ROWS: matrix_gemv_parallel(1., R, x, 0., y); break;
+  case PAR_COLS: matrix_gemv_parallel(1., C, x, 0., y); break;
+  }
+}
+
+static int check(const double* y, const double* ref, int n, const char* what) {
+  for (int i = 0; i < n; ++i) {
+    if (fabs(y[i] - ref[i]) > 1.e-12 * n * (fabs(ref[i]) + 1.)) {
+      fprintf(stderr, "%s: y[%d] = %.17g, expected %.17g\n", what, i, y[i], ref[i]);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* odd shapes, views, alpha and beta, against naive ij on the same data */
+static int self_test(void) {
+  static const int shapes[][2] = {{1, 1}, {1, 100}, {100, 1}, {37, 61}, {61, 37},
+                                  {257, 129}, {3000, 5}};
+  int ok = 1;
+  for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); ++s) {
+    int m = shapes[s][0], n = shapes[s][1];
+    matrix R = matrix_create(m + 3, n + 5, MATRIX_ROW_MAJOR);
+    matrix C = matrix_create(m + 3, n + 5, MATRIX_COL_MAJOR);
+    double* x = alloc(n);
+    double* y = alloc(m);
+    double* ref = alloc(m);
+    for (int i = 0; i < R.rows; ++i) {
+      for (int j = 0; j < R.cols; ++j) *matrix_at(&R, i, j) = (i * 7 + j * 3) % 11 - 5.;
+    }
+    matrix_convert(&R, &C);
+    for (int j = 0; j < n; ++j) x[j] = j % 5 - 2.;
+
+    /* views at (2, 3), strided inside the larger matrices */
+    matrix VR = matrix_view(&R, 2, 3, m, n);
+    matrix VC = matrix_view(&C, 2, 3, m, n);
+    naive_ij(&VR, x, ref);
+    for (int i = 0; i < m; ++i) ref[i] = 2. * ref[i] - 0.5 * i;
+    const matrix* views[2] = {&VR, &VC};
+    for (int v = 0; v < 2; ++v) {
+      for (int i = 0; i < m; ++i) y[i] = i;
+      matrix_gemv(2., views[v], x, -0.5, y);
+      ok &= check(y, ref, m, v ? "matrix_gemv cols" : "matrix_gemv rows");
+      for (int i = 0; i < m; ++i) y[i] = i;
+      matrix_gemv_parallel(2., views[v], x, -0.5, y);
+      ok &= check(y, ref, m, v ? "matrix_gemv_parallel cols" : "matrix_gemv_parallel rows");
+    }
+
+    /* A^T z with z = 1 through the transposed view: the column sums of A */
+    matrix T = matrix_transpose_view(&VR);
+    double* z = alloc(m);
+    for (int i = 0; i < m; ++i) z[i] = 1.;
+    matrix_gemv(1., &T, z, 0., x);
+    for (int j = 0; j < n && ok; ++j) {
+      double s = 0.;
+      for (int i = 0; i < m; ++i) s += *matrix_at(&VR, i, j);
+      ok &= check(x + j, &s, 1, "matrix_transpose_view");
+    }
+    free(z);
+    free(x);
+    free(y);
+    free(ref);
+    matrix_destroy(&R);
+    matrix_destroy(&C);
+  }
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  int default_sizes[] = {1000, 2048, 4000};
+  int nsizes = argc > 1 ? argc - 1 : (int) (sizeof(default_sizes) / sizeof(default_sizes[0]));
+  int repeats = getenv("MATRIX_REPEATS") ? atoi(getenv("MATRIX_REPEATS")) : 10;
+  if (repeats < 1) repeats = 1;
+
+  printf("# ISA:\t\t%s\n# Threads:\t%d\n# Repeats:\t%d\n", matrix_isa(),
+         omp_get_max_threads(), repeats);
+  if (!self_test()) return EXIT_FAILURE;
+  printf("# Self test:\tpassed\n");
+  double triad_serial = triad(0, repeats);
+  double triad_threads = triad(1, repeats);
+  printf("# Triad:\t%.2f GB/s serial, %.2f GB/s with the threads\n\n", triad_serial,
+         triad_threads);
+
+  printf("%8s %10s", "n", "MiB");
+  for (int k = 0; k < NMETHODS; ++k) printf(" %9s", names[k]);
+  printf(" %7s   [GB/s]\n", "%triad");
+
+  for (int s = 0; s < nsizes; ++s) {
+    int n = argc > 1 ? atoi(argv[s + 1]) : default_sizes[s];
+    if (n <= 0) {
+      fprintf(stderr, "invalid size %s\n", argv[s + 1]);
+      return EXIT_FAILURE;
+    }
+    matrix R = matrix_create(n, n, MATRIX_ROW_MAJOR);
+    matrix C = matrix_create(n, n, MATRIX_COL_MAJOR);
+    double* x = alloc(n);
+    double* y = alloc(n);
+    double* ref = alloc(n);
+    if (R.data == NULL || C.data == NULL) {
+      fprintf(stderr, "matrix_create: out of memory for n = %d\n", n);
+      return EXIT_FAILURE;
+    }
+    srand(42);
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < n; ++j) *matrix_at(&R, i, j) = (double) rand() / RAND_MAX;
+    }
+    matrix_convert(&R, &C);
+    for (int j = 0; j < n; ++j) x[j] = (double) rand() / RAND_MAX;
+    naive_ij(&R, x, ref);
+
+    double bytes = 8. * ((double) n * n + 2. * n);
+    double best_serial = 0.;
+    printf("%8d %10.1f", n, (double) n * n * sizeof(double) / 1048576.);
+    for (int k = 0; k < NMETHODS; ++k) {
+      double best = 1.e30;
+      for (int r = 0; r < repeats; ++r) {
+        double t = seconds();
+        run(k, &R, &C, x, y);
+        t = seconds() - t;
+        if (t < best) best = t;
+        if (!check(y, ref, n, names[k])) return EXIT_FAILURE;
+      }
+      double gbs = bytes / best * 1.e-9;
+      if ((k == ROWS || k == COLS) && gbs > best_serial) best_serial = gbs;
+      printf(" %9.2f", gbs);
+      fflush(stdout);
+    }
+    printf(" %6.0f%%\n", 100. * best_serial / triad_serial);
+    free(x);
+    free(y);
+    free(ref);
+    matrix_destroy(&R);
+    matrix_destroy(&C);
+  }
+  return 0;
+}
@@ -0,0 +1,158 @@
+// matrix_kernel.c
+//
+// GEMV kernels of matrix.c, compiled once per ISA with the flags of
+// common/simd/simd.mk. W is the number of doubles in a register; the
+// loops run over whole registers and finish the last n % W (or m % W)
+// elements one by one. Loads are unaligned: views start anywhere, and on
+// the aligned rows of matrix_create they cost the same as aligned ones.
+
+#include "dispatch.h"
+#include "matrix_kernel.h"
+
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+#define W 8
+typedef __m512d vec_t;
+#define ZERO()       _mm512_setzero_pd()
+#define SET1(a)      _mm512_set1_pd(a)
+#define LOAD(p)      _mm512_loadu_pd(p)
+#define STORE(p, v)  _mm512_storeu_pd(p, v)
+#define FMA(a, b, c) _mm512_fmadd_pd(a, b, c)
+#define HSUM(v)      _mm512_reduce_add_pd(v)
+
+#elif defined(__AVX__)
+
+#include <immintrin.h>
+#define W 4
+typedef __m256d vec_t;
+#define ZERO()       _mm256_setzero_pd()
+#define SET1(a)      _mm256_set1_pd(a)
+#define LOAD(p)      _mm256_loadu_pd(p)
+#define STORE(p, v)  _mm256_storeu_pd(p, v)
+#ifdef __FMA__
+#define FMA(a, b, c) _mm256_fmadd_pd(a, b, c)
+#else
+#define FMA(a, b, c) _mm256_add_pd(_mm256_mul_pd(a, b), c)
+#endif
+
+static inline double HSUM(vec_t v) {
+  __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+#elif defined(__SSE4_1__)
+
+#include <immintrin.h>
+#define W 2
+typedef __m128d vec_t;
+#define ZERO()       _mm_setzero_pd()
+#define SET1(a)      _mm_set1_pd(a)
+#define LOAD(p)      _mm_loadu_pd(p)
+#define STORE(p, v)  _mm_storeu_pd(p, v)
+#define FMA(a, b, c) _mm_add_pd(_mm_mul_pd(a, b), c)
+
+static inline double HSUM(vec_t v) {
+  return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+#else
+
+#define W 1
+typedef double vec_t;
+#define ZERO()       0.
+#define SET1(a)      (a)
+#define LOAD(p)      (*(p))
+#define STORE(p, v)  (*(p) = (v))
+#define FMA(a, b, c) ((a) * (b) + (c))
+#define HSUM(v)      (v)
+
+#endif
+
+/* rows of y updated together by the column-major kernel: 16 KiB of y,
+   which stays in L1 while the 4 columns stream past it */
+#define MATRIX_PANEL 2048
+
+/* y_i = alpha s_i + beta y_i, without reading y_i when beta is 0 */
+static inline double update(double s, double alpha, double beta, const double* y) {
+  return (beta == 0.) ? alpha * s : alpha * s + beta * *y;
+}
+
+void SIMD_NAME(matrix_gemv_rows)(int m, int n, double alpha, const double* A, size_t lda,
+                                 const double* x, double beta, double* y) {
+  int nw = n - n % W;
+  int i = 0;
+  for (; i + 4 <= m; i += 4) {
+    const double* a0 = A + i * lda;
+    const double* a1 = a0 + lda;
+    const double* a2 = a1 + lda;
+    const double* a3 = a2 + lda;
+    vec_t s0 = ZERO(), s1 = ZERO(), s2 = ZERO(), s3 = ZERO();
+    for (int j = 0; j < nw; j += W) {
+      vec_t xj = LOAD(x + j);
+      s0 = FMA(LOAD(a0 + j), xj, s0);
+      s1 = FMA(LOAD(a1 + j), xj, s1);
+      s2 = FMA(LOAD(a2 + j), xj, s2);
+      s3 = FMA(LOAD(a3 + j), xj, s3);
+    }
+    double t0 = HSUM(s0), t1 = HSUM(s1), t2 = HSUM(s2), t3 = HSUM(s3);
+    for (int j = nw; j < n; ++j) {
+      t0 += a0[j] * x[j];
+      t1 += a1[j] * x[j];
+      t2 += a2[j] * x[j];
+      t3 += a3[j] * x[j];
+    }
+    y[i]     = update(t0, alpha, beta, y + i);
+    y[i + 1] = update(t1, alpha, beta, y + i + 1);
+    y[i + 2] = update(t2, alpha, beta, y + i + 2);
+    y[i + 3] = update(t3, alpha, beta, y + i + 3);
+  }
+  for (; i < m; ++i) {
+    const double* a = A + i * lda;
+    vec_t s = ZERO();
+    for (int j = 0; j < nw; j += W) s = FMA(LOAD(a + j), LOAD(x + j), s);
+    double t = HSUM(s);
+    for (int j = nw; j < n; ++j) t += a[j] * x[j];
+    y[i] = update(t, alpha, beta, y + i);
+  }
+}
+
+void SIMD_NAME(matrix_gemv_cols)(int m, int n, double alpha, const double* A, size_t lda,
+                                 const double* x, double beta, double* y) {
+  for (int i = 0; i < m; ++i) y[i] = (beta == 0.) ? 0. : beta * y[i];
+
+  for (int i0 = 0; i0 < m; i0 += MATRIX_PANEL) {
+    int mb = (m - i0 < MATRIX_PANEL) ? m - i0 : MATRIX_PANEL;
+    int mw = mb - mb % W;
+    double* yp = y + i0;
+    const double* Ap = A + i0;
+    int j = 0;
+    for (; j + 4 <= n; j += 4) {
+      const double* a0 = Ap + j * lda;
+      const double* a1 = a0 + lda;
+      const double* a2 = a1 + lda;
+      const double* a3 = a2 + lda;
+      double c0 = alpha * x[j], c1 = alpha * x[j + 1];
+      double c2 = alpha * x[j + 2], c3 = alpha * x[j + 3];
+      vec_t x0 = SET1(c0), x1 = SET1(c1), x2 = SET1(c2), x3 = SET1(c3);
+      for (int i = 0; i < mw; i += W) {
+        vec_t v = LOAD(yp + i);
+        v = FMA(LOAD(a0 + i), x0, v);
+        v = FMA(LOAD(a1 + i), x1, v);
+        v = FMA(LOAD(a2 + i), x2, v);
+        v = FMA(LOAD(a3 + i), x3, v);
+        STORE(yp + i, v);
+      }
+      for (int i = mw; i < mb; ++i) {
+        yp[i] += c0 * a0[i] + c1 * a1[i] + c2 * a2[i] + c3 * a3[i];
+      }
+    }
+    for (; j < n; ++j) {
+      const double* a = Ap + j * lda;
+      double c = alpha * x[j];
+      vec_t xc = SET1(c);
+      for (int i = 0; i < mw; i += W) STORE(yp + i, FMA(LOAD(a + i), xc, LOAD(yp + i)));
+      for (int i = mw; i < mb; ++i) yp[i] += c * a[i];
+    }
+  }
+}
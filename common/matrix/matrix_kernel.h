@@ -0,0 +1,18 @@
+// matrix_kernel.h
+//
+// GEMV kernels of matrix.c, one copy per ISA (matrix_kernel.c):
+// y = alpha A x + beta y for the m x n matrix A with leading dimension lda,
+// stored by rows or by columns.
+
+#ifndef MATRIX_KERNEL_H
+#define MATRIX_KERNEL_H
+
+#include <stddef.h>
+#include "dispatch.h"
+
+SIMD_DECLARE(void, matrix_gemv_rows, (int m, int n, double alpha, const double* A, size_t lda,
+                                      const double* x, double beta, double* y));
+SIMD_DECLARE(void, matrix_gemv_cols, (int m, int n, double alpha, const double* A, size_t lda,
+                                      const double* x, double beta, double* y));
+
+#endif /* MATRIX_KERNEL_H */
@@ -0,0 +1,29 @@
+// matrix_parallel.c
+//
+// matrix_gemv_parallel, see matrix.h: the rows of A are cut in one block
+// per thread, a multiple of 8 rows each, and every thread runs the serial
+// GEMV on the view of its block. Each thread writes its own part of y and
+// reads all of x, which every thread keeps in its caches.
+
+#include <omp.h>
+
+#include "matrix.h"
+
+void matrix_gemv_parallel(double alpha, const matrix* A, const double* x, double beta,
+                          double* y) {
+  /* empty call: picks the kernel before the threads race for it */
+  matrix empty = matrix_view(A, 0, 0, 0, A->cols);
+  matrix_gemv(alpha, &empty, x, beta, y);
+
+#pragma omp parallel
+  {
+    int nthreads = omp_get_num_threads(), t = omp_get_thread_num();
+    int chunk = ((A->rows + nthreads - 1) / nthreads + 7) & ~7;
+    int i0 = t * chunk;
+    int rows = (A->rows - i0 < chunk) ? A->rows - i0 : chunk;
+    if (rows > 0) {
+      matrix block = matrix_view(A, i0, 0, rows, A->cols);
+      matrix_gemv(alpha, &block, x, beta, y + i0);
+    }
+  }
+}
@@ -0,0 +1,431 @@
+// mpiprof.c
+//
+// MPI profiler through the PMPI interface: every wrapped MPI_X records its
+// calls, bytes and time and calls PMPI_X. Nothing in the application
+// changes, the library only has to come before the MPI library at link time
+// (make MPIPROF=1 in mini_app and powermethod) or be preloaded:
+//
+//   LD_PRELOAD=.../libmpiprof.so mpirun -n 4 ./main 128 100 0.01
+//
+// Recorded per rank:
+//   - calls, bytes (count * type size, of the local buffer) and time of
+//     every wrapped function, with the longest single call;
+//   - point-to-point traffic per peer (messages and bytes sent to every
+//     world rank; non-blocking sends count when posted). Collectives have
+//     no peer and only enter the totals;
+//   - the time between MPI_Init and MPI_Finalize, split into compute
+//     (outside MPI), point-to-point, wait (MPI_Wait*, MPI_Barrier) and
+//     collectives.
+//
+// At MPI_Finalize the ranks gather their counters on rank 0, which prints
+// the merged report to stderr: min / avg / max over the ranks of every
+// function, the time split of every rank and the load imbalance
+// (max / avg - 1 of the compute time; a rank that computes less waits
+// more). The files, named after MPIPROF (default: mpiprof), are
+//   mpiprof.txt          the merged report,
+//   mpiprof_matrix.csv   bytes sent by rank (row) to rank (column),
+//   mpiprof_messages.csv the same for the number of messages,
+//   mpiprof.<rank>.txt   one line per function of that rank, unless
+//                        MPIPROF_RANKS=0.
+//
+// The overhead is two MPI_Wtime and a few additions per call; the per-peer
+// counters need the world rank of the peer, cached per communicator. The
+// counters are not atomic: MPI calls from several threads at once
+// (MPI_THREAD_MULTIPLE) would race on them.
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_COMMS 32
+
+enum {
+  F_SEND, F_RECV, F_ISEND, F_IRECV, F_SENDRECV,
+  F_WAIT, F_WAITALL, F_BARRIER,
+  F_BCAST, F_REDUCE, F_ALLREDUCE, F_GATHER, F_ALLGATHER, F_ALLGATHERV,
+  F_SCATTER, F_ALLTOALL,
+  NFUNCS
+};
+
+enum { C_P2P, C_WAIT, C_COLL, NCATEGORIES };
+
+static const char* func_names[NFUNCS] = {
+  "MPI_Send", "MPI_Recv", "MPI_Isend", "MPI_Irecv", "MPI_Sendrecv",
+  "MPI_Wait", "MPI_Waitall", "MPI_Barrier",
+  "MPI_Bcast", "MPI_Reduce", "MPI_Allreduce", "MPI_Gather", "MPI_Allgather",
+  "MPI_Allgatherv", "MPI_Scatter", "MPI_Alltoall"
+};
+static const int func_category[NFUNCS] = {
+  C_P2P, C_P2P, C_P2P, C_P2P, C_P2P,
+  C_WAIT, C_WAIT, C_WAIT,
+  C_COLL, C_COLL, C_COLL, C_COLL, C_COLL, C_COLL, C_COLL, C_COLL
+};
+static const char* category_names[NCATEGORIES] = {"p2p", "wait", "collective"};
+
+typedef struct {
+  double calls, bytes, time, longest;
+} counter;
+
+typedef struct {
+  MPI_Comm comm;
+  int size;
+  int* world;                 /* world rank of every rank of comm */
+} comm_map;
+
+static counter counters[NFUNCS];
+static double* peer_bytes = NULL;     /* [world rank of the destination] */
+static double* peer_msgs = NULL;
+static int world_rank = 0, world_size = 1;
+static double time_init = 0.;
+static comm_map maps[MAX_COMMS];
+static int nmaps = 0;
+
+/* ========================================================================== */
+/* Bookkeeping                                                                */
+/* ========================================================================== */
+
+static void record(int f, double bytes, double seconds) {
+  counter* c = &counters[f];
+  c->calls += 1.;
+  c->bytes += bytes;
+  c->time += seconds;
+  if (seconds > c->longest) c->longest = seconds;
+}
+
+static double type_bytes(int count, MPI_Datatype type) {
+  int size = 0;
+  if (type != MPI_DATATYPE_NULL) PMPI_Type_size(type, &size);
+  return (double) count * size;
+}
+
+/* World rank of `rank` in comm, -1 for MPI_PROC_NULL, MPI_ANY_SOURCE and
+   ranks outside MPI_COMM_WORLD. */
+static int world_of(MPI_Comm comm, int rank) {
+  if (rank < 0) return -1;
+  if (comm == MPI_COMM_WORLD) return rank < world_size ? rank : -1;
+  for (int m = 0; m < nmaps; ++m) {
+    if (maps[m].comm == comm) return rank < maps[m].size ? maps[m].world[rank] : -1;
+  }
+  if (nmaps == MAX_COMMS) return -1;
+
+  int inter = 0;
+  PMPI_Comm_test_inter(comm, &inter);
+  if (inter) return -1;
+  comm_map* m = &maps[nmaps];
+  MPI_Group group, world_group;
+  PMPI_Comm_size(comm, &m->size);
+  PMPI_Comm_group(comm, &group);
+  PMPI_Comm_group(MPI_COMM_WORLD, &world_group);
+  int* local = (int*) malloc(m->size * sizeof(int));
+  m->world = (int*) malloc(m->size * sizeof(int));
+  if (local == NULL || m->world == NULL) {
+    free(local);
+    free(m->world);
+    return -1;
+  }
+  for (int r = 0; r < m->size; ++r) local[r] = r;
+  PMPI_Group_translate_ranks(group, m->size, local, world_group, m->world);
+  for (int r = 0; r < m->size; ++r) if (m->world[r] == MPI_UNDEFINED) m->world[r] = -1;
+  PMPI_Group_free(&group);
+  PMPI_Group_free(&world_group);
+  free(local);
+  m->comm = comm;
+  ++nmaps;
+  return rank < m->size ? m->world[rank] : -1;
+}
+
+static void record_peer(MPI_Comm comm, int dest, double bytes) {
+  int w = world_of(comm, dest);
+  if (w < 0 || peer_bytes == NULL) return;
+  peer_bytes[w] += bytes;
+  peer_msgs[w] += 1.;
+}
+
+/* ========================================================================== */
+/* Set-up                                                                     */
+/* ========================================================================== */
+
+static void start(void) {
+  PMPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+  PMPI_Comm_size(MPI_COMM_WORLD, &world_size);
+  peer_bytes = (double*) calloc(world_size, sizeof(double));
+  peer_msgs = (double*) calloc(world_size, sizeof(double));
+  time_init = PMPI_Wtime();
+}
+
+int MPI_Init(int* argc, char*** argv) {
+  int rc = PMPI_Init(argc, argv);
+  start();
+  return rc;
+}
+
+int MPI_Init_thread(int* argc, char*** argv, int required, int* provided) {
+  int rc = PMPI_Init_thread(argc, argv, required, provided);
+  start();
+  return rc;
+}
+
+int MPI_Comm_free(MPI_Comm* comm) {
+  for (int m = 0; m < nmaps; ++m) {
+    if (maps[m].comm != *comm) continue;
+    free(maps[m].world);
+    maps[m] = maps[--nmaps];
+    break;
+  }
+  return PMPI_Comm_free(comm);
+}
+
+/* ========================================================================== */
+/* Wrappers                                                                   */
+/* ========================================================================== */
+
+#define TIMED(f, bytes, call)                   \
+  do {                                          \
+    double t0_ = PMPI_Wtime();                  \
+    int rc_ = call;                             \
+    record(f, bytes, PMPI_Wtime() - t0_);       \
+    return rc_;                                 \
+  } while (0)
+
+int MPI_Send(const void* buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm) {
+  double bytes = type_bytes(count, type);
+  record_peer(comm, dest, bytes);
+  TIMED(F_SEND, bytes, PMPI_Send(buf, count, type, dest, tag, comm));
+}
+
+int MPI_Recv(void* buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm,
+             MPI_Status* status) {
+  TIMED(F_RECV, type_bytes(count, type), PMPI_Recv(buf, count, type, source, tag, comm, status));
+}
+
+int MPI_Isend(const void* buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm,
+              MPI_Request* request) {
+  double bytes = type_bytes(count, type);
+  record_peer(comm, dest, bytes);
+  TIMED(F_ISEND, bytes, PMPI_Isend(buf, count, type, dest, tag, comm, request));
+}
+
+int MPI_Irecv(void* buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm,
+              MPI_Request* request) {
+  TIMED(F_IRECV, type_bytes(count, type),
+        PMPI_Irecv(buf, count, type, source, tag, comm, request));
+}
+
+int MPI_Sendrecv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, int dest, int sendtag,
+                 void* recvbuf, int recvcount, MPI_Datatype recvtype, int source, int recvtag,
+                 MPI_Comm comm, MPI_Status* status) {
+  double bytes = type_bytes(sendcount, sendtype);
+  record_peer(comm, dest, bytes);
+  TIMED(F_SENDRECV, bytes,
+        PMPI_Sendrecv(sendbuf, sendcount, sendtype, dest, sendtag, recvbuf, recvcount,
+                      recvtype, source, recvtag, comm, status));
+}
+
+int MPI_Wait(MPI_Request* request, MPI_Status* status) {
+  TIMED(F_WAIT, 0., PMPI_Wait(request, status));
+}
+
+int MPI_Waitall(int count, MPI_Request requests[], MPI_Status statuses[]) {
+  TIMED(F_WAITALL, 0., PMPI_Waitall(count, requests, statuses));
+}
+
+int MPI_Barrier(MPI_Comm comm) {
+  TIMED(F_BARRIER, 0., PMPI_Barrier(comm));
+}
+
+int MPI_Bcast(void* buf, int count, MPI_Datatype type, int root, MPI_Comm comm) {
+  TIMED(F_BCAST, type_bytes(count, type), PMPI_Bcast(buf, count, type, root, comm));
+}
+
+int MPI_Reduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype type, MPI_Op op,
+               int root, MPI_Comm comm) {
+  TIMED(F_REDUCE, type_bytes(count, type),
+        PMPI_Reduce(sendbuf, recvbuf, count, type, op, root, comm));
+}
+
+int MPI_Allreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype type, MPI_Op op,
+                  MPI_Comm comm) {
+  TIMED(F_ALLREDUCE, type_bytes(count, type),
+        PMPI_Allreduce(sendbuf, recvbuf, count, type, op, comm));
+}
+
+int MPI_Gather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf,
+               int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+  TIMED(F_GATHER, type_bytes(sendcount, sendtype),
+        PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm));
+}
+
+int MPI_Allgather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf,
+                  int recvcount, MPI_Datatype recvtype, MPI_Comm comm) {
+  TIMED(F_ALLGATHER, type_bytes(sendcount, sendtype),
+        PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm));
+}
+
+int MPI_Allgatherv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf,
+                   const int recvcounts[], const int displs[], MPI_Datatype recvtype,
+                   MPI_Comm comm) {
+  TIMED(F_ALLGATHERV, type_bytes(sendcount, sendtype),
+        PMPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs,
+                        recvtype, comm));
+}
+
+int MPI_Scatter(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf,
+                int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+  TIMED(F_SCATTER, type_bytes(recvcount, recvtype),
+        PMPI_Scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm));
+}
+
+int MPI_Alltoall(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf,
+                 int recvcount, MPI_Datatype recvtype, MPI_Comm comm) {
+  TIMED(F_ALLTOALL, type_bytes(sendcount, sendtype),
+        PMPI_Alltoall(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm));
+}
+
+/* ========================================================================== */
+/* Report                                                                     */
+/* ========================================================================== */
+
+/* Per rank, in this order: elapsed, time per category, then calls, bytes,
+   time and longest call of every function. */
+#define NVALUES (1 + NCATEGORIES + 4 * NFUNCS)
+
+static void pack(double* v, double elapsed) {
+  memset(v, 0, NVALUES * sizeof(double));
+  v[0] = elapsed;
+  for (int f = 0; f < NFUNCS; ++f) {
+    v[1 + func_category[f]] += counters[f].time;
+    double* c = v + 1 + NCATEGORIES + 4 * f;
+    c[0] = counters[f].calls;
+    c[1] = counters[f].bytes;
+    c[2] = counters[f].time;
+    c[3] = counters[f].longest;
+  }
+}
+
+static void write_rank_file(const char* prefix, double elapsed) {
+  const char* env = getenv("MPIPROF_RANKS");
+  if (env != NULL && strcmp(env, "0") == 0) return;
+  char path[1024];
+  snprintf(path, sizeof(path), "%s.%d.txt", prefix, world_rank);
+  FILE* f = fopen(path, "w");
+  if (f == NULL) return;
+  fprintf(f, "# rank %d, elapsed %.6f s\n# %-16s %12s %16s %12s %12s\n", world_rank, elapsed,
+          "function", "calls", "bytes", "time [s]", "longest [s]");
+  for (int k = 0; k < NFUNCS; ++k) {
+    if (counters[k].calls == 0.) continue;
+    fprintf(f, "%-18s %12.0f %16.0f %12.6f %12.6f\n", func_names[k], counters[k].calls,
+            counters[k].bytes, counters[k].time, counters[k].longest);
+  }
+  fclose(f);
+}
+
+static void print_report(FILE* out, const double* all) {
+  const int n = world_size;
+  double elapsed = 0.;
+  for (int r = 0; r < n; ++r) if (all[r * NVALUES] > elapsed) elapsed = all[r * NVALUES];
+
+  fprintf(out, "# MPI profile: %d rank(s), %.6f s between MPI_Init and MPI_Finalize (max)\n",
+          n, elapsed);
+  fprintf(out, "# %-16s %12s %16s %12s %12s %12s %12s %7s\n", "function", "calls (sum)",
+          "bytes (sum)", "min [s]", "avg [s]", "max [s]", "longest [s]", "% MPI");
+  double mpi_total = 0.;
+  for (int r = 0; r < n; ++r) {
+    for (int c = 0; c < NCATEGORIES; ++c) mpi_total += all[r * NVALUES + 1 + c];
+  }
+  for (int f = 0; f < NFUNCS; ++f) {
+    double calls = 0., bytes = 0., sum = 0., lo = 0., hi = 0., longest = 0.;
+    for (int r = 0; r < n; ++r) {
+      const double* c = all + r * NVALUES + 1 + NCATEGORIES + 4 * f;
+      calls += c[0];
+      bytes += c[1];
+      sum += c[2];
+      if (r == 0 || c[2] < lo) lo = c[2];
+      if (c[2] > hi) hi = c[2];
+      if (c[3] > longest) longest = c[3];
+    }
+    if (calls == 0.) continue;
+    fprintf(out, "%-18s %12.0f %16.0f %12.6f %12.6f %12.6f %12.6f %7.1f\n", func_names[f], calls,
+            bytes, lo, sum / n, hi, longest, mpi_total > 0. ? 100. * sum / mpi_total : 0.);
+  }
+
+  fprintf(out, "# %6s %12s %12s", "rank", "elapsed [s]", "compute [s]");
+  for (int c = 0; c < NCATEGORIES; ++c) fprintf(out, " %12s", category_names[c]);
+  fprintf(out, " %7s\n", "% MPI");
+  double compute_sum = 0., compute_max = 0., mpi_sum = 0., mpi_max = 0.;
+  for (int r = 0; r < n; ++r) {
+    const double* v = all + r * NVALUES;
+    double mpi = v[1] + v[2] + v[3], compute = v[0] - mpi;
+    compute_sum += compute;
+    mpi_sum += mpi;
+    if (compute > compute_max) compute_max = compute;
+    if (mpi > mpi_max) mpi_max = mpi;
+    fprintf(out, "  %6d %12.6f %12.6f", r, v[0], compute);
+    for (int c = 0; c < NCATEGORIES; ++c) fprintf(out, " %12.6f", v[1 + c]);
+    fprintf(out, " %7.1f\n", v[0] > 0. ? 100. * mpi / v[0] : 0.);
+  }
+  double compute_avg = compute_sum / n, mpi_avg = mpi_sum / n;
+  fprintf(out, "# compute: avg %.6f s, max %.6f s, imbalance (max/avg - 1) %.1f %%\n",
+          compute_avg, compute_max, compute_avg > 0. ? 100. * (compute_max / compute_avg - 1.) : 0.);
+  fprintf(out, "# MPI:     avg %.6f s, max %.6f s, %.1f %% of the elapsed time on average\n",
+          mpi_avg, mpi_max, elapsed > 0. ? 100. * mpi_avg / elapsed : 0.);
+}
+
+static void write_matrix(const char* prefix, const char* suffix, const char* what,
+                         const double* m) {
+  char path[1024];
+  snprintf(path, sizeof(path), "%s_%s.csv", prefix, suffix);
+  FILE* f = fopen(path, "w");
+  if (f == NULL) return;
+  fprintf(f, "# %s sent point-to-point by rank (row) to rank (column)\n", what);
+  for (int r = 0; r < world_size; ++r) {
+    for (int c = 0; c < world_size; ++c) {
+      fprintf(f, "%s%.0f", c ? "," : "", m[(size_t) r * world_size + c]);
+    }
+    fprintf(f, "\n");
+  }
+  fclose(f);
+}
+
+int MPI_Finalize(void) {
+  double elapsed = PMPI_Wtime() - time_init;
+  const char* prefix = getenv("MPIPROF");
+  if (prefix == NULL || prefix[0] == '\0') prefix = "mpiprof";
+  write_rank_file(prefix, elapsed);
+
+  double mine[NVALUES];
+  pack(mine, elapsed);
+  double* all = NULL;
+  double* bytes = NULL;
+  double* msgs = NULL;
+  if (world_rank == 0) {
+    all = (double*) malloc((size_t) world_size * NVALUES * sizeof(double));
+    bytes = (double*) malloc((size_t) world_size * world_size * sizeof(double));
+    msgs = (double*) malloc((size_t) world_size * world_size * sizeof(double));
+  }
+  PMPI_Gather(mine, NVALUES, MPI_DOUBLE, all, NVALUES, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+  PMPI_Gather(peer_bytes, world_size, MPI_DOUBLE, bytes, world_size, MPI_DOUBLE, 0,
+              MPI_COMM_WORLD);
+  PMPI_Gather(peer_msgs, world_size, MPI_DOUBLE, msgs, world_size, MPI_DOUBLE, 0,
+              MPI_COMM_WORLD);
+
+  if (world_rank == 0 && all != NULL && bytes != NULL && msgs != NULL) {
+    char path[1024];
+    print_report(stderr, all);
+    snprintf(path, sizeof(path), "%s.txt", prefix);
+    FILE* f = fopen(path, "w");
+    if (f != NULL) {
+      print_report(f, all);
+      fclose(f);
+    }
+    write_matrix(prefix, "matrix", "bytes", bytes);
+    write_matrix(prefix, "messages", "messages", msgs);
+  }
+  free(all);
+  free(bytes);
+  free(msgs);
+  free(peer_bytes);
+  free(peer_msgs);
+  peer_bytes = peer_msgs = NULL;
+  return PMPI_Finalize();
+}
@@ -0,0 +1,291 @@
+// perfcount.c
+//
+// See perfcount.h. Generalised from the counters of the dgemm statistics
+// mode (project_1/src/3-Optimize-Matrix-Matrix-Mult).
+
+#define _GNU_SOURCE
+#include "perfcount.h"
+
+#include <glob.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#define LINE_BYTES 64.
+
+const char* const perf_group_names[PC_NEVENTS] = {
+  "cycles", "instructions", "branches", "branch_misses", "l1d_misses", "llc_misses",
+  "fp_scalar_double", "fp_128_double", "fp_256_double", "fp_512_double",
+  "dram_reads", "dram_writes",
+};
+
+/* ========================================================================== */
+/* Opening                                                                    */
+/* ========================================================================== */
+
+static int is_intel(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) return 0;
+  char vendor[13];
+  memcpy(vendor, &ebx, 4);
+  memcpy(vendor + 4, &edx, 4);
+  memcpy(vendor + 8, &ecx, 4);
+  vendor[12] = '\0';
+  return strcmp(vendor, "GenuineIntel") == 0;
+#else
+  return 0;
+#endif
+}
+
+/* Counter of this process and of the threads it creates afterwards
+   (pid 0, inherit), or of a whole CPU (pid -1: uncore). */
+static int open_event(uint32_t type, uint64_t config, int cpu) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  if (cpu < 0) {
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+  }
+  return (int) syscall(SYS_perf_event_open, &attr, cpu < 0 ? 0 : -1, cpu, -1, 0);
+}
+
+static int read_file(const char* path, char* buf, size_t size) {
+  FILE* f = fopen(path, "r");
+  if (f == NULL) return 0;
+  size_t n = fread(buf, 1, size - 1, f);
+  fclose(f);
+  buf[n] = '\0';
+  return n > 0;
+}
+
+/* "event=0x04,umask=0x03" of an uncore event in sysfs, as a raw config. */
+static int uncore_config(const char* dir, const char* name, uint64_t* config) {
+  char path[512], text[256];
+  snprintf(path, sizeof(path), "%s/events/%s", dir, name);
+  if (!read_file(path, text, sizeof(text))) return 0;
+  const char* e = strstr(text, "event=");
+  const char* u = strstr(text, "umask=");
+  if (e == NULL) return 0;
+  *config = strtoull(e + 6, NULL, 0) | ((u ? strtoull(u + 6, NULL, 0) : 0) << 8);
+  return 1;
+}
+
+/* CAS counts of every memory controller, on the CPU of each socket that
+   sysfs names for it. */
+static void open_imc(perf_group* g) {
+  glob_t dirs;
+  if (glob("/sys/bus/event_source/devices/uncore_imc_*", 0, NULL, &dirs) != 0) return;
+  for (size_t d = 0; d < dirs.gl_pathc && g->nimc < PC_MAX_IMC; ++d) {
+    char path[512], text[256];
+    uint64_t rd, wr;
+    snprintf(path, sizeof(path), "%s/type", dirs.gl_pathv[d]);
+    if (!read_file(path, text, sizeof(text))) continue;
+    uint32_t type = (uint32_t) strtoul(text, NULL, 10);
+    if (!uncore_config(dirs.gl_pathv[d], "cas_count_read", &rd)) continue;
+    if (!uncore_config(dirs.gl_pathv[d], "cas_count_write", &wr)) continue;
+    snprintf(path, sizeof(path), "%s/cpumask", dirs.gl_pathv[d]);
+    if (!read_file(path, text, sizeof(text))) continue;
+    for (char* s = text; *s && g->nimc < PC_MAX_IMC; ) {
+      char* end;
+      int cpu = (int) strtol(s, &end, 10);
+      if (end == s) break;
+      int fr = open_event(type, rd, cpu), fw = open_event(type, wr, cpu);
+      if (fr >= 0 && fw >= 0) {
+        g->imc_fd[g->nimc][0] = fr;
+        g->imc_fd[g->nimc][1] = fw;
+        ++g->nimc;
+      } else {
+        if (fr >= 0) close(fr);
+        if (fw >= 0) close(fw);
+      }
+      s = (*end == ',' || *end == '-') ? end + 1 : end;
+      if (*end == '\n' || *end == '\0') break;
+    }
+  }
+  globfree(&dirs);
+}
+
+int perf_group_open(perf_group* g) {
+  memset(g, 0, sizeof(*g));
+  for (int e = 0; e < PC_NEVENTS; ++e) g->fd[e] = -1;
+
+  g->fd[PC_CYCLES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+  g->fd[PC_INSTRUCTIONS] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1);
+  g->fd[PC_BRANCHES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS, -1);
+  g->fd[PC_BRANCH_MISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1);
+  g->fd[PC_L1D_MISSES] = open_event(PERF_TYPE_HW_CACHE,
+                                    PERF_COUNT_HW_CACHE_L1D
+                                    | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), -1);
+  g->fd[PC_LLC_MISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, -1);
+
+  /* FP_ARITH_INST_RETIRED (event 0xC7) since Broadwell; the umask selects
+     the width. No portable generic event exists for floating point. */
+  if (is_intel()) {
+    g->fd[PC_FP_SCALAR] = open_event(PERF_TYPE_RAW, 0x01c7, -1);
+    g->fd[PC_FP_128]    = open_event(PERF_TYPE_RAW, 0x04c7, -1);
+    g->fd[PC_FP_256]    = open_event(PERF_TYPE_RAW, 0x10c7, -1);
+    g->fd[PC_FP_512]    = open_event(PERF_TYPE_RAW, 0x40c7, -1);
+  }
+  open_imc(g);
+
+  perf_group_reset(g);
+  int opened = 0;
+  for (int e = 0; e < PC_DRAM_READS; ++e) opened += (g->fd[e] >= 0);
+  if (g->nimc > 0) opened += 2;
+  return opened;
+}
+
+/* ========================================================================== */
+/* Counting                                                                   */
+/* ========================================================================== */
+
+static void each_fd(perf_group* g, unsigned long request) {
+  for (int e = 0; e < PC_NEVENTS; ++e) {
+    if (g->fd[e] >= 0) ioctl(g->fd[e], request, 0);
+  }
+  for (int m = 0; m < g->nimc; ++m) {
+    ioctl(g->imc_fd[m][0], request, 0);
+    ioctl(g->imc_fd[m][1], request, 0);
+  }
+}
+
+/* value, time enabled, time running: scaled when the PMU multiplexed */
+static double read_scaled(int fd) {
+  uint64_t data[3];
+  if (read(fd, data, sizeof(data)) != (ssize_t) sizeof(data)) return -1.;
+  if (data[2] == 0) return 0.;
+  return (double) data[0] * ((double) data[1] / (double) data[2]);
+}
+
+void perf_group_reset(perf_group* g) {
+  for (int e = 0; e < PC_NEVENTS; ++e) g->value[e] = (g->fd[e] >= 0) ? 0. : -1.;
+  g->value[PC_DRAM_READS] = g->value[PC_DRAM_WRITES] = (g->nimc > 0) ? 0. : -1.;
+}
+
+void perf_group_start(perf_group* g) {
+  each_fd(g, PERF_EVENT_IOC_RESET);
+  each_fd(g, PERF_EVENT_IOC_ENABLE);
+}
+
+void perf_group_stop(perf_group* g) {
+  each_fd(g, PERF_EVENT_IOC_DISABLE);
+  for (int e = 0; e < PC_NEVENTS; ++e) {
+    if (g->fd[e] < 0 || g->value[e] < 0.) continue;
+    double v = read_scaled(g->fd[e]);
+    g->value[e] = (v < 0.) ? -1. : g->value[e] + v;
+  }
+  for (int m = 0; m < g->nimc; ++m) {
+    for (int k = 0; k < 2; ++k) {
+      double* total = &g->value[PC_DRAM_READS + k];
+      double v = read_scaled(g->imc_fd[m][k]);
+      if (*total >= 0.) *total = (v < 0.) ? -1. : *total + v;
+    }
+  }
+}
+
+void perf_group_close(perf_group* g) {
+  for (int e = 0; e < PC_NEVENTS; ++e) {
+    if (g->fd[e] >= 0) close(g->fd[e]);
+    g->fd[e] = -1;
+  }
+  for (int m = 0; m < g->nimc; ++m) {
+    close(g->imc_fd[m][0]);
+    close(g->imc_fd[m][1]);
+  }
+  g->nimc = 0;
+}
+
+/* ========================================================================== */
+/* Metrics                                                                    */
+/* ========================================================================== */
+
+perf_metrics perf_group_metrics(const perf_group* g, double seconds, double flops) {
+  const double* v = g->value;
+  perf_metrics m;
+  m.ipc = (v[PC_CYCLES] > 0. && v[PC_INSTRUCTIONS] >= 0.) ? v[PC_INSTRUCTIONS] / v[PC_CYCLES] : -1.;
+
+  /* lanes per instruction; an FMA is counted twice by FP_ARITH already */
+  static const double lanes[] = {1., 2., 4., 8.};
+  double counted = 0., packed = 0.;
+  for (int e = PC_FP_SCALAR; e <= PC_FP_512; ++e) {
+    if (v[e] < 0.) {
+      counted = -1.;
+      break;
+    }
+    counted += lanes[e - PC_FP_SCALAR] * v[e];
+    if (e > PC_FP_SCALAR) packed += lanes[e - PC_FP_SCALAR] * v[e];
+  }
+  m.vector_ratio = (counted > 0.) ? packed / counted : -1.;
+  m.fp_ops = (counted >= 0.) ? counted : (flops > 0. ? flops : -1.);
+  m.gflops = (m.fp_ops >= 0. && seconds > 0.) ? 1.e-9 * m.fp_ops / seconds : -1.;
+
+  m.dram_estimated = 0;
+  if (v[PC_DRAM_READS] >= 0. && v[PC_DRAM_WRITES] >= 0.) {
+    m.dram_bytes = LINE_BYTES * (v[PC_DRAM_READS] + v[PC_DRAM_WRITES]);
+  } else if (v[PC_LLC_MISSES] >= 0.) {
+    m.dram_bytes = LINE_BYTES * v[PC_LLC_MISSES];
+    m.dram_estimated = 1;
+  } else {
+    m.dram_bytes = -1.;
+  }
+  m.gbs = (m.dram_bytes >= 0. && seconds > 0.) ? 1.e-9 * m.dram_bytes / seconds : -1.;
+  m.bytes_per_flop = (m.dram_bytes >= 0. && m.fp_ops > 0.) ? m.dram_bytes / m.fp_ops : -1.;
+
+  m.branch_miss_rate = (v[PC_BRANCHES] > 0. && v[PC_BRANCH_MISSES] >= 0.)
+                     ? v[PC_BRANCH_MISSES] / v[PC_BRANCHES] : -1.;
+  m.llc_misses_per_kinst = (v[PC_INSTRUCTIONS] > 0. && v[PC_LLC_MISSES] >= 0.)
+                         ? 1000. * v[PC_LLC_MISSES] / v[PC_INSTRUCTIONS] : -1.;
+  return m;
+}
+
+static void print_metric(FILE* out, const char* sep, const char* name, double value,
+                         double scale, const char* format, const char* unit) {
+  fprintf(out, "%s%s ", sep, name);
+  if (value < 0.) fprintf(out, "n/a");
+  else {
+    fprintf(out, format, scale * value);
+    fprintf(out, "%s", unit);
+  }
+}
+
+void perf_group_print(FILE* out, const char* label, const perf_group* g,
+                      double seconds, double flops) {
+  int any = g->nimc > 0;
+  for (int e = 0; e < PC_NEVENTS; ++e) any |= (g->fd[e] >= 0);
+  fprintf(out, "# %s:", label);
+  if (!any) {
+    char paranoid[16] = "?";
+    FILE* f = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+    if (f != NULL) {
+      if (fscanf(f, "%15s", paranoid) != 1) strcpy(paranoid, "?");
+      fclose(f);
+    }
+    fprintf(out, " counters unavailable (perf_event_paranoid = %s)\n", paranoid);
+    return;
+  }
+  perf_metrics m = perf_group_metrics(g, seconds, flops);
+  print_metric(out, " ", "IPC", m.ipc, 1., "%.2f", "");
+  print_metric(out, " | ", "vector", m.vector_ratio, 100., "%.1f", "%");
+  print_metric(out, " | ", "Gflop/s", m.gflops, 1., "%.2f", "");
+  print_metric(out, " | ", m.dram_estimated ? "GB/s (LLC est.)" : "GB/s", m.gbs, 1., "%.2f", "");
+  print_metric(out, " | ", "B/flop", m.bytes_per_flop, 1., "%.3f", "");
+  print_metric(out, " | ", "branch miss", m.branch_miss_rate, 100., "%.2f", "%");
+  print_metric(out, " | ", "LLC miss/kinst", m.llc_misses_per_kinst, 1., "%.2f", "");
+  fprintf(out, "\n");
+}
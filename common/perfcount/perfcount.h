@@ -0,0 +1,95 @@
+// perfcount.h
+//
+// Hardware counters around the timed regions of the benchmarks, read with
+// perf_event_open, and the metrics derived from them:
+//
+//   perf_group g;
+//   perf_group_open(&g);               // once, before the OpenMP threads
+//   perf_group_start(&g);              // exist: inherit counts them too
+//   ... timed region ...
+//   perf_group_stop(&g);               // start/stop pairs accumulate
+//   perf_group_print(stdout, "triad", &g, seconds, flops);
+//   perf_group_close(&g);
+//
+// Every event is opened on its own, so one the CPU or the kernel does not
+// provide (perf_event_paranoid, virtual machines, FP_ARITH outside Intel)
+// only leaves its value at -1 and its metrics as n/a; with no counters at
+// all the benchmark runs and prints as before plus one "unavailable" line.
+// Values are scaled by time enabled / time running when the PMU multiplexes.
+//
+// DRAM traffic comes from the CAS counts of the uncore memory controllers
+// (uncore_imc_*) when they can be opened; they count the whole socket, all
+// processes, so they are meaningful on an otherwise idle node. Otherwise it
+// is estimated as LLC misses * 64 B, which misses the write-backs and the
+// prefetches.
+
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+  PC_CYCLES,
+  PC_INSTRUCTIONS,
+  PC_BRANCHES,
+  PC_BRANCH_MISSES,
+  PC_L1D_MISSES,
+  PC_LLC_MISSES,
+  PC_FP_SCALAR,       /* FP_ARITH_INST_RETIRED scalar double (Intel) */
+  PC_FP_128,          /* 128-bit packed double */
+  PC_FP_256,          /* 256-bit packed double */
+  PC_FP_512,          /* 512-bit packed double */
+  PC_DRAM_READS,      /* uncore IMC CAS reads, 64 B each */
+  PC_DRAM_WRITES,     /* uncore IMC CAS writes */
+  PC_NEVENTS
+};
+
+#define PC_MAX_IMC 32
+
+typedef struct {
+  int    fd[PC_NEVENTS];
+  int    imc_fd[PC_MAX_IMC][2];       /* per memory controller: reads, writes */
+  int    nimc;
+  double value[PC_NEVENTS];           /* accumulated; -1 if unavailable */
+} perf_group;
+
+extern const char* const perf_group_names[PC_NEVENTS];
+
+/* Returns the number of events that could be opened (0: none, the
+   benchmark runs without counters). */
+int  perf_group_open(perf_group* g);
+void perf_group_reset(perf_group* g);
+void perf_group_start(perf_group* g);
+void perf_group_stop(perf_group* g);
+void perf_group_close(perf_group* g);
+
+/* Derived metrics, -1 where an input is missing. flops is the count of
+   the algorithm (0 if unknown); the FP_ARITH count is used without it. */
+typedef struct {
+  double ipc;                 /* instructions per cycle */
+  double fp_ops;              /* double precision flops (FMA = 2) */
+  double vector_ratio;        /* share of fp_ops in packed instructions */
+  double gflops;
+  double dram_bytes;
+  int    dram_estimated;      /* 1: from LLC misses */
+  double gbs;
+  double bytes_per_flop;
+  double branch_miss_rate;
+  double llc_misses_per_kinst;
+} perf_metrics;
+
+perf_metrics perf_group_metrics(const perf_group* g, double seconds, double flops);
+
+/* One line "# label: IPC ... | vector ... | GB/s ... | B/flop ...". */
+void perf_group_print(FILE* out, const char* label, const perf_group* g,
+                      double seconds, double flops);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PERFCOUNT_H */
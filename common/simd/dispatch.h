@@ -0,0 +1,100 @@
+// dispatch.h
+//
+// Run-time choice among the variants of a kernel compiled for several
+// instruction sets, from C and C++. The kernel file is compiled once per
+// ISA (simd.mk) and names its functions with SIMD_NAME:
+//
+//   // kernel.cpp: defines dot_scalar, dot_sse4, dot_avx2, dot_avx512
+//   extern "C" double SIMD_NAME(dot)(const double* x, const double* y, int n) { ... }
+//
+//   // kernel.h, included by both sides
+//   SIMD_DECLARE(double, dot, (const double* x, const double* y, int n));
+//
+//   // caller, compiled without ISA flags
+//   static double (*dot)(const double*, const double*, int) = 0;
+//   if (!dot) dot = SIMD_SELECT(dot);
+//
+// simd_detect() asks the CPU (cpuid, through __builtin_cpu_supports, which
+// also checks that the OS saves the wide registers) for the best ISA, once
+// per translation unit. SIMD_ISA=scalar|sse4|avx2|avx512 in the environment
+// lowers the choice, to compare the variants on one machine; it never
+// raises it above what the CPU supports. Outside x86 only the scalar
+// variant exists.
+
+#ifndef SIMD_DISPATCH_H
+#define SIMD_DISPATCH_H
+
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  SIMD_SCALAR,
+  SIMD_SSE4,
+  SIMD_AVX2,          /* AVX2 + FMA */
+  SIMD_AVX512,        /* AVX-512F */
+  SIMD_NISA
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#else
+#define SIMD_X86 0
+#endif
+
+/* ISA of the translation unit being compiled, from the -m flags */
+#if defined(__AVX512F__)
+#define SIMD_ISA_NS avx512
+#elif defined(__AVX2__) && defined(__FMA__)
+#define SIMD_ISA_NS avx2
+#elif defined(__SSE4_1__)
+#define SIMD_ISA_NS sse4
+#else
+#define SIMD_ISA_NS scalar
+#endif
+
+#define SIMD_CONCAT_(a, b) a##_##b
+#define SIMD_CONCAT(a, b) SIMD_CONCAT_(a, b)
+#define SIMD_NAME(name) SIMD_CONCAT(name, SIMD_ISA_NS)
+
+#if SIMD_X86
+#define SIMD_DECLARE(ret, name, params) \
+  ret name##_scalar params; ret name##_sse4 params; \
+  ret name##_avx2 params; ret name##_avx512 params
+#define SIMD_SELECT(name) \
+  (simd_detect() == SIMD_AVX512 ? name##_avx512 : \
+   simd_detect() == SIMD_AVX2   ? name##_avx2   : \
+   simd_detect() == SIMD_SSE4   ? name##_sse4   : name##_scalar)
+#else
+#define SIMD_DECLARE(ret, name, params) ret name##_scalar params
+#define SIMD_SELECT(name) (name##_scalar)
+#endif
+
+static inline const char* simd_isa_name(int isa) {
+  switch (isa) {
+  case SIMD_SSE4:   return "sse4";
+  case SIMD_AVX2:   return "avx2";
+  case SIMD_AVX512: return "avx512";
+  default:          return "scalar";
+  }
+}
+
+static inline int simd_detect(void) {
+  static int isa = -1;
+  if (isa >= 0) return isa;
+
+  int best = SIMD_SCALAR;
+#if SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.1")) best = SIMD_SSE4;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) best = SIMD_AVX2;
+  if (best == SIMD_AVX2 && __builtin_cpu_supports("avx512f")) best = SIMD_AVX512;
+#endif
+  const char* cap = getenv("SIMD_ISA");
+  for (int i = 0; cap != NULL && i < best; ++i) {
+    if (strcmp(cap, simd_isa_name(i)) == 0) best = i;
+  }
+  isa = best;
+  return isa;
+}
+
+#endif /* SIMD_DISPATCH_H */
@@ -0,0 +1,424 @@
+// simd.hpp
+//
+// Portable SIMD vectors, header-only, instead of raw _mm256_* intrinsics
+// in every kernel:
+//
+//   typedef simd::native<double> V;           // widest vector of this build
+//   V acc(0.);
+//   for (int i = 0; i < n; i += V::width)      // load(p, k): first k lanes,
+//       acc = fma(V::load(x + i, n - i),       // the others are zero
+//                 V::load(y + i, n - i), acc);
+//   double dot = reduce_add(acc);
+//
+// vector<T, W> for T = float, double with W lanes: W = 1 everywhere, and
+// 16-byte (SSE4), 32-byte (AVX2 + FMA) and 64-byte (AVX-512F) vectors when
+// the translation unit is compiled for them. Each has load/store (whole or
+// masked to the first k lanes), + - * /, fma, min, max, the comparisons
+// < <= > >= giving a mask (& | and any(), select(m, a, b) for the masked
+// updates), and the reductions reduce_add and reduce_max.
+//
+// Kernels are written once against native<T>, compiled once per ISA with
+// the flags of simd.mk, and picked at run time with dispatch.h. Everything
+// here lives in an inline namespace named after the ISA of the translation
+// unit (simd::avx2::vector...), so the copies of these inline functions in
+// an AVX-512 object and in the scalar one are different symbols: the linker
+// cannot merge them and run AVX-512 code on a CPU without it. The same
+// holds for anything else a kernel file instantiates (std::min, std::vector):
+// keep the per-ISA files to loops over plain pointers.
+
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include "dispatch.h"
+
+#if defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+namespace simd {
+inline namespace SIMD_ISA_NS {
+
+template <class T, int W> struct vector;
+
+////////////////////////////////////////////////////////////////////////////////
+//  one lane: any T, any machine
+////////////////////////////////////////////////////////////////////////////////
+
+template <class T> struct vector<T, 1> {
+    static const int width = 1;
+    typedef T value_type;
+    struct mask { bool m; };
+
+    T v;
+
+    vector() {}
+    vector(T x) : v(x) {}
+
+    static vector load(const T* p) { return vector(*p); }
+    static vector load(const T* p, int k) { return vector(k > 0 ? *p : T(0)); }
+    void store(T* p) const { *p = v; }
+    void store(T* p, int k) const { if (k > 0) *p = v; }
+
+    friend vector operator+(vector a, vector b) { return a.v + b.v; }
+    friend vector operator-(vector a, vector b) { return a.v - b.v; }
+    friend vector operator*(vector a, vector b) { return a.v * b.v; }
+    friend vector operator/(vector a, vector b) { return a.v / b.v; }
+    friend vector fma(vector a, vector b, vector c) { return a.v * b.v + c.v; }
+    friend vector min(vector a, vector b) { return a.v < b.v ? a.v : b.v; }
+    friend vector max(vector a, vector b) { return a.v > b.v ? a.v : b.v; }
+
+    friend mask operator<(vector a, vector b)  { return mask{a.v < b.v}; }
+    friend mask operator<=(vector a, vector b) { return mask{a.v <= b.v}; }
+    friend mask operator>(vector a, vector b)  { return mask{a.v > b.v}; }
+    friend mask operator>=(vector a, vector b) { return mask{a.v >= b.v}; }
+    friend mask operator&(mask a, mask b) { return mask{a.m && b.m}; }
+    friend mask operator|(mask a, mask b) { return mask{a.m || b.m}; }
+    friend bool any(mask a) { return a.m; }
+    friend vector select(mask m, vector a, vector b) { return m.m ? a : b; }
+
+    friend T reduce_add(vector a) { return a.v; }
+    friend T reduce_max(vector a) { return a.v; }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//  SSE4: 2 doubles, 4 floats
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__SSE4_1__)
+
+// masked load and store of the first k lanes through a buffer: SSE has no
+// masked moves, and they only run for the tails
+template <class V, class T> V load_first(const T* p, int k) {
+    alignas(64) T buf[V::width] = {};
+    for (int i = 0; i < k && i < V::width; ++i) buf[i] = p[i];
+    return V::load(buf);
+}
+
+template <class V, class T> void store_first(V a, T* p, int k) {
+    alignas(64) T buf[V::width];
+    a.store(buf);
+    for (int i = 0; i < k && i < V::width; ++i) p[i] = buf[i];
+}
+
+template <> struct vector<double, 2> {
+    static const int width = 2;
+    typedef double value_type;
+    struct mask { __m128d m; };
+
+    __m128d v;
+
+    vector() {}
+    vector(double x) : v(_mm_set1_pd(x)) {}
+    vector(__m128d x) : v(x) {}
+
+    static vector load(const double* p) { return _mm_loadu_pd(p); }
+    static vector load(const double* p, int k) {
+        return k >= width ? load(p) : load_first<vector>(p, k);
+    }
+    void store(double* p) const { _mm_storeu_pd(p, v); }
+    void store(double* p, int k) const {
+        if (k >= width) store(p);
+        else store_first(*this, p, k);
+    }
+
+    friend vector operator+(vector a, vector b) { return _mm_add_pd(a.v, b.v); }
+    friend vector operator-(vector a, vector b) { return _mm_sub_pd(a.v, b.v); }
+    friend vector operator*(vector a, vector b) { return _mm_mul_pd(a.v, b.v); }
+    friend vector operator/(vector a, vector b) { return _mm_div_pd(a.v, b.v); }
+    friend vector fma(vector a, vector b, vector c) { return a * b + c; }
+    friend vector min(vector a, vector b) { return _mm_min_pd(a.v, b.v); }
+    friend vector max(vector a, vector b) { return _mm_max_pd(a.v, b.v); }
+
+    friend mask operator<(vector a, vector b)  { return mask{_mm_cmplt_pd(a.v, b.v)}; }
+    friend mask operator<=(vector a, vector b) { return mask{_mm_cmple_pd(a.v, b.v)}; }
+    friend mask operator>(vector a, vector b)  { return mask{_mm_cmpgt_pd(a.v, b.v)}; }
+    friend mask operator>=(vector a, vector b) { return mask{_mm_cmpge_pd(a.v, b.v)}; }
+    friend mask operator&(mask a, mask b) { return mask{_mm_and_pd(a.m, b.m)}; }
+    friend mask operator|(mask a, mask b) { return mask{_mm_or_pd(a.m, b.m)}; }
+    friend bool any(mask a) { return _mm_movemask_pd(a.m) != 0; }
+    friend vector select(mask m, vector a, vector b) { return _mm_blendv_pd(b.v, a.v, m.m); }
+
+    friend double reduce_add(vector a) {
+        return _mm_cvtsd_f64(_mm_add_sd(a.v, _mm_unpackhi_pd(a.v, a.v)));
+    }
+    friend double reduce_max(vector a) {
+        return _mm_cvtsd_f64(_mm_max_sd(a.v, _mm_unpackhi_pd(a.v, a.v)));
+    }
+};
+
+template <> struct vector<float, 4> {
+    static const int width = 4;
+    typedef float value_type;
+    struct mask { __m128 m; };
+
+    __m128 v;
+
+    vector() {}
+    vector(float x) : v(_mm_set1_ps(x)) {}
+    vector(__m128 x) : v(x) {}
+
+    static vector load(const float* p) { return _mm_loadu_ps(p); }
+    static vector load(const float* p, int k) {
+        return k >= width ? load(p) : load_first<vector>(p, k);
+    }
+    void store(float* p) const { _mm_storeu_ps(p, v); }
+    void store(float* p, int k) const {
+        if (k >= width) store(p);
+        else store_first(*this, p, k);
+    }
+
+    friend vector operator+(vector a, vector b) { return _mm_add_ps(a.v, b.v); }
+    friend vector operator-(vector a, vector b) { return _mm_sub_ps(a.v, b.v); }
+    friend vector operator*(vector a, vector b) { return _mm_mul_ps(a.v, b.v); }
+    friend vector operator/(vector a, vector b) { return _mm_div_ps(a.v, b.v); }
+    friend vector fma(vector a, vector b, vector c) { return a * b + c; }
+    friend vector min(vector a, vector b) { return _mm_min_ps(a.v, b.v); }
+    friend vector max(vector a, vector b) { return _mm_max_ps(a.v, b.v); }
+
+    friend mask operator<(vector a, vector b)  { return mask{_mm_cmplt_ps(a.v, b.v)}; }
+    friend mask operator<=(vector a, vector b) { return mask{_mm_cmple_ps(a.v, b.v)}; }
+    friend mask operator>(vector a, vector b)  { return mask{_mm_cmpgt_ps(a.v, b.v)}; }
+    friend mask operator>=(vector a, vector b) { return mask{_mm_cmpge_ps(a.v, b.v)}; }
+    friend mask operator&(mask a, mask b) { return mask{_mm_and_ps(a.m, b.m)}; }
+    friend mask operator|(mask a, mask b) { return mask{_mm_or_ps(a.m, b.m)}; }
+    friend bool any(mask a) { return _mm_movemask_ps(a.m) != 0; }
+    friend vector select(mask m, vector a, vector b) { return _mm_blendv_ps(b.v, a.v, m.m); }
+
+    friend float reduce_add(vector a) {
+        __m128 s = _mm_add_ps(a.v, _mm_movehl_ps(a.v, a.v));
+        return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+    }
+    friend float reduce_max(vector a) {
+        __m128 s = _mm_max_ps(a.v, _mm_movehl_ps(a.v, a.v));
+        return _mm_cvtss_f32(_mm_max_ss(s, _mm_shuffle_ps(s, s, 1)));
+    }
+};
+
+#endif // __SSE4_1__
+
+////////////////////////////////////////////////////////////////////////////////
+//  AVX2 + FMA: 4 doubles, 8 floats
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+template <> struct vector<double, 4> {
+    static const int width = 4;
+    typedef double value_type;
+    struct mask { __m256d m; };
+
+    __m256d v;
+
+    vector() {}
+    vector(double x) : v(_mm256_set1_pd(x)) {}
+    vector(__m256d x) : v(x) {}
+
+    // lanes below k, for vmaskmov
+    static __m256i first(int k) {
+        return _mm256_cmpgt_epi64(_mm256_set1_epi64x(k), _mm256_setr_epi64x(0, 1, 2, 3));
+    }
+    static vector load(const double* p) { return _mm256_loadu_pd(p); }
+    static vector load(const double* p, int k) {
+        return k >= width ? load(p) : vector(_mm256_maskload_pd(p, first(k)));
+    }
+    void store(double* p) const { _mm256_storeu_pd(p, v); }
+    void store(double* p, int k) const {
+        if (k >= width) store(p);
+        else _mm256_maskstore_pd(p, first(k), v);
+    }
+
+    friend vector operator+(vector a, vector b) { return _mm256_add_pd(a.v, b.v); }
+    friend vector operator-(vector a, vector b) { return _mm256_sub_pd(a.v, b.v); }
+    friend vector operator*(vector a, vector b) { return _mm256_mul_pd(a.v, b.v); }
+    friend vector operator/(vector a, vector b) { return _mm256_div_pd(a.v, b.v); }
+    friend vector fma(vector a, vector b, vector c) { return _mm256_fmadd_pd(a.v, b.v, c.v); }
+    friend vector min(vector a, vector b) { return _mm256_min_pd(a.v, b.v); }
+    friend vector max(vector a, vector b) { return _mm256_max_pd(a.v, b.v); }
+
+    friend mask operator<(vector a, vector b)  { return mask{_mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ)}; }
+    friend mask operator<=(vector a, vector b) { return mask{_mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ)}; }
+    friend mask operator>(vector a, vector b)  { return mask{_mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ)}; }
+    friend mask operator>=(vector a, vector b) { return mask{_mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ)}; }
+    friend mask operator&(mask a, mask b) { return mask{_mm256_and_pd(a.m, b.m)}; }
+    friend mask operator|(mask a, mask b) { return mask{_mm256_or_pd(a.m, b.m)}; }
+    friend bool any(mask a) { return _mm256_movemask_pd(a.m) != 0; }
+    friend vector select(mask m, vector a, vector b) { return _mm256_blendv_pd(b.v, a.v, m.m); }
+
+    friend double reduce_add(vector a) {
+        typedef vector<double, 2> half;
+        return reduce_add(half(_mm256_castpd256_pd128(a.v)) + half(_mm256_extractf128_pd(a.v, 1)));
+    }
+    friend double reduce_max(vector a) {
+        typedef vector<double, 2> half;
+        return reduce_max(max(half(_mm256_castpd256_pd128(a.v)), half(_mm256_extractf128_pd(a.v, 1))));
+    }
+};
+
+template <> struct vector<float, 8> {
+    static const int width = 8;
+    typedef float value_type;
+    struct mask { __m256 m; };
+
+    __m256 v;
+
+    vector() {}
+    vector(float x) : v(_mm256_set1_ps(x)) {}
+    vector(__m256 x) : v(x) {}
+
+    static __m256i first(int k) {
+        return _mm256_cmpgt_epi32(_mm256_set1_epi32(k), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    }
+    static vector load(const float* p) { return _mm256_loadu_ps(p); }
+    static vector load(const float* p, int k) {
+        return k >= width ? load(p) : vector(_mm256_maskload_ps(p, first(k)));
+    }
+    void store(float* p) const { _mm256_storeu_ps(p, v); }
+    void store(float* p, int k) const {
+        if (k >= width) store(p);
+        else _mm256_maskstore_ps(p, first(k), v);
+    }
+
+    friend vector operator+(vector a, vector b) { return _mm256_add_ps(a.v, b.v); }
+    friend vector operator-(vector a, vector b) { return _mm256_sub_ps(a.v, b.v); }
+    friend vector operator*(vector a, vector b) { return _mm256_mul_ps(a.v, b.v); }
+    friend vector operator/(vector a, vector b) { return _mm256_div_ps(a.v, b.v); }
+    friend vector fma(vector a, vector b, vector c) { return _mm256_fmadd_ps(a.v, b.v, c.v); }
+    friend vector min(vector a, vector b) { return _mm256_min_ps(a.v, b.v); }
+    friend vector max(vector a, vector b) { return _mm256_max_ps(a.v, b.v); }
+
+    friend mask operator<(vector a, vector b)  { return mask{_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+    friend mask operator<=(vector a, vector b) { return mask{_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+    friend mask operator>(vector a, vector b)  { return mask{_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+    friend mask operator>=(vector a, vector b) { return mask{_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+    friend mask operator&(mask a, mask b) { return mask{_mm256_and_ps(a.m, b.m)}; }
+    friend mask operator|(mask a, mask b) { return mask{_mm256_or_ps(a.m, b.m)}; }
+    friend bool any(mask a) { return _mm256_movemask_ps(a.m) != 0; }
+    friend vector select(mask m, vector a, vector b) { return _mm256_blendv_ps(b.v, a.v, m.m); }
+
+    friend float reduce_add(vector a) {
+        typedef vector<float, 4> half;
+        return reduce_add(half(_mm256_castps256_ps128(a.v)) + half(_mm256_extractf128_ps(a.v, 1)));
+    }
+    friend float reduce_max(vector a) {
+        typedef vector<float, 4> half;
+        return reduce_max(max(half(_mm256_castps256_ps128(a.v)), half(_mm256_extractf128_ps(a.v, 1))));
+    }
+};
+
+#endif // __AVX2__ && __FMA__
+
+////////////////////////////////////////////////////////////////////////////////
+//  AVX-512F: 8 doubles, 16 floats, with mask registers
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__AVX512F__)
+
+template <> struct vector<double, 8> {
+    static const int width = 8;
+    typedef double value_type;
+    struct mask { __mmask8 m; };
+
+    __m512d v;
+
+    vector() {}
+    vector(double x) : v(_mm512_set1_pd(x)) {}
+    vector(__m512d x) : v(x) {}
+
+    static __mmask8 first(int k) { return (__mmask8) ((1u << (k > 0 ? k : 0)) - 1); }
+    static vector load(const double* p) { return _mm512_loadu_pd(p); }
+    static vector load(const double* p, int k) {
+        return k >= width ? load(p) : vector(_mm512_maskz_loadu_pd(first(k), p));
+    }
+    void store(double* p) const { _mm512_storeu_pd(p, v); }
+    void store(double* p, int k) const {
+        if (k >= width) store(p);
+        else _mm512_mask_storeu_pd(p, first(k), v);
+    }
+
+    friend vector operator+(vector a, vector b) { return _mm512_add_pd(a.v, b.v); }
+    friend vector operator-(vector a, vector b) { return _mm512_sub_pd(a.v, b.v); }
+    friend vector operator*(vector a, vector b) { return _mm512_mul_pd(a.v, b.v); }
+    friend vector operator/(vector a, vector b) { return _mm512_div_pd(a.v, b.v); }
+    friend vector fma(vector a, vector b, vector c) { return _mm512_fmadd_pd(a.v, b.v, c.v); }
+    friend vector min(vector a, vector b) { return _mm512_min_pd(a.v, b.v); }
+    friend vector max(vector a, vector b) { return _mm512_max_pd(a.v, b.v); }
+
+    friend mask operator<(vector a, vector b)  { return mask{_mm512_cmp_pd_mask(a.v, b.v, _CMP_LT_OQ)}; }
+    friend mask operator<=(vector a, vector b) { return mask{_mm512_cmp_pd_mask(a.v, b.v, _CMP_LE_OQ)}; }
+    friend mask operator>(vector a, vector b)  { return mask{_mm512_cmp_pd_mask(a.v, b.v, _CMP_GT_OQ)}; }
+    friend mask operator>=(vector a, vector b) { return mask{_mm512_cmp_pd_mask(a.v, b.v, _CMP_GE_OQ)}; }
+    friend mask operator&(mask a, mask b) { return mask{(__mmask8) (a.m & b.m)}; }
+    friend mask operator|(mask a, mask b) { return mask{(__mmask8) (a.m | b.m)}; }
+    friend bool any(mask a) { return a.m != 0; }
+    friend vector select(mask m, vector a, vector b) { return _mm512_mask_blend_pd(m.m, b.v, a.v); }
+
+    friend double reduce_add(vector a) { return _mm512_reduce_add_pd(a.v); }
+    friend double reduce_max(vector a) { return _mm512_reduce_max_pd(a.v); }
+};
+
+template <> struct vector<float, 16> {
+    static const int width = 16;
+    typedef float value_type;
+    struct mask { __mmask16 m; };
+
+    __m512 v;
+
+    vector() {}
+    vector(float x) : v(_mm512_set1_ps(x)) {}
+    vector(__m512 x) : v(x) {}
+
+    static __mmask16 first(int k) { return (__mmask16) ((1u << (k > 0 ? k : 0)) - 1); }
+    static vector load(const float* p) { return _mm512_loadu_ps(p); }
+    static vector load(const float* p, int k) {
+        return k >= width ? load(p) : vector(_mm512_maskz_loadu_ps(first(k), p));
+    }
+    void store(float* p) const { _mm512_storeu_ps(p, v); }
+    void store(float* p, int k) const {
+        if (k >= width) store(p);
+        else _mm512_mask_storeu_ps(p, first(k), v);
+    }
+
+    friend vector operator+(vector a, vector b) { return _mm512_add_ps(a.v, b.v); }
+    friend vector operator-(vector a, vector b) { return _mm512_sub_ps(a.v, b.v); }
+    friend vector operator*(vector a, vector b) { return _mm512_mul_ps(a.v, b.v); }
+    friend vector operator/(vector a, vector b) { return _mm512_div_ps(a.v, b.v); }
+    friend vector fma(vector a, vector b, vector c) { return _mm512_fmadd_ps(a.v, b.v, c.v); }
+    friend vector min(vector a, vector b) { return _mm512_min_ps(a.v, b.v); }
+    friend vector max(vector a, vector b) { return _mm512_max_ps(a.v, b.v); }
+
+    friend mask operator<(vector a, vector b)  { return mask{_mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ)}; }
+    friend mask operator<=(vector a, vector b) { return mask{_mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ)}; }
+    friend mask operator>(vector a, vector b)  { return mask{_mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ)}; }
+    friend mask operator>=(vector a, vector b) { return mask{_mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ)}; }
+    friend mask operator&(mask a, mask b) { return mask{(__mmask16) (a.m & b.m)}; }
+    friend mask operator|(mask a, mask b) { return mask{(__mmask16) (a.m | b.m)}; }
+    friend bool any(mask a) { return a.m != 0; }
+    friend vector select(mask m, vector a, vector b) { return _mm512_mask_blend_ps(m.m, b.v, a.v); }
+
+    friend float reduce_add(vector a) { return _mm512_reduce_add_ps(a.v); }
+    friend float reduce_max(vector a) { return _mm512_reduce_max_ps(a.v); }
+};
+
+#endif // __AVX512F__
+
+////////////////////////////////////////////////////////////////////////////////
+//  widest vector of this translation unit
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__AVX512F__)
+static const int native_bytes = 64;
+#elif defined(__AVX2__) && defined(__FMA__)
+static const int native_bytes = 32;
+#elif defined(__SSE4_1__)
+static const int native_bytes = 16;
+#else
+static const int native_bytes = 0;
+#endif
+
+template <class T>
+using native = vector<T, native_bytes ? native_bytes / (int) sizeof(T) : 1>;
+
+} // inline namespace SIMD_ISA_NS
+} // namespace simd
+
+#endif // SIMD_HPP
@@ -0,0 +1,18 @@
+# Varianti per ISA dei kernel scritti con simd.hpp: ogni file kernel si
+# compila una volta per ISA e dispatch.h sceglie a run-time quella migliore
+# supportata dalla CPU. Uso nel Makefile del progetto:
+#
+#   SIMD = ../../../common/simd
+#   include $(SIMD)/simd.mk
+#   kernel_%.o: kernel.cpp
+#   	$(CXX) $(CXXFLAGS) -I$(SIMD) $(SIMD_FLAGS_$*) -c $< -o $@
+#
+# e si linkano $(SIMD_ISAS:%=kernel_%.o). Niente -march=native nei CXXFLAGS:
+# l'eseguibile deve girare su tutti i nodi, le ISA le sceglie il dispatch.
+# sse4 e' SSE4.1 e basta: -msse4.2 accende anche POPCNT, che dispatch.h non
+# verifica
+SIMD_ISAS         = scalar sse4 avx2 avx512
+SIMD_FLAGS_scalar =
+SIMD_FLAGS_sse4   = -msse4.1
+SIMD_FLAGS_avx2   = -mavx2 -mfma
+SIMD_FLAGS_avx512 = -mavx512f -mavx2 -mfma
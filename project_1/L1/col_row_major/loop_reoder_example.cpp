@@ -4,43 +4,65 @@ HPC Class: Loop reordering and contiguous data access.
 Author: Aryan Eftekhari <aryan.eftekhari@gmail.com>
 
 Compile Instructions:
-- Compile: g++ -o main.exe loop_reoder_example.cpp
+- Compile: make (builds common/matrix and common/layout first)
 - Allocate (SLURM): salloc -N 1 --time=00:05:00 --reservation=hpc-monday
 - Execute: ./main.exe
 
 TODO:
 1. What is "vector<double>"? It is very useful. See: https://en.cppreference.com/w/cpp/container/vector 
 2. Run the code. Why is there a difference in runtime?
-3. Try compiling with the "-O3" flag, i.e., g++ -o main.exe loop_reoder_example.cpp -O3. How does that change the runtime?
+3. Try compiling with the "-O3" flag, i.e., make clean; make CXXFLAGS=-O3. How does that change the runtime?
+4. The matrix is one contiguous allocation (common/matrix/matrix.h), stored
+   by rows. matrix_gemv runs the optimized kernel of its layout; compare it
+   with the two loops, on A and on a column-major copy of A.
 */
 
+#include <algorithm>
 #include <iostream>
+#include <numeric>
 #include <vector>
 #include <chrono>
 #include <random>
 
+#include "matrix.h"
+
 using namespace std;
 using namespace std::chrono;
 
 // Function for matrix-vector multiplication (row-major access)
-void matrix_vector_multiply_row(vector<double>& y, double** A, const vector<double>& x, size_t n) {
+void matrix_vector_multiply_row(vector<double>& y, const matrix& A, const vector<double>& x, size_t n) {
+    fill(y.begin(), y.end(), 0);  // Initialize result vector
     for (size_t i = 0; i < n; ++i) {
         for (size_t j = 0; j < n; ++j) {
-            y[i] = A[i][j] * x[j];
+            y[i] += *matrix_at(&A, i, j) * x[j];
         }
     }
 }
 
 // Function for matrix-vector multiplication (column-major access)
-void matrix_vector_multiply_col(vector<double>& y, double** A, const vector<double>& x, size_t n) {
+void matrix_vector_multiply_col(vector<double>& y, const matrix& A, const vector<double>& x, size_t n) {
     fill(y.begin(), y.end(), 0);  // Initialize result vector
     for (size_t j = 0; j < n; ++j) {
         for (size_t i = 0; i < n; ++i) {
-            y[i] = A[i][j] * x[j];
+            y[i] += *matrix_at(&A, i, j) * x[j];
         }
     }
 }
 
+// Time K products y = A x with multiply, print the average and the sum of y
+template <typename F>
+void time_runs(const char* name, F multiply, vector<double>& y, size_t K) {
+    auto start_time = high_resolution_clock::now();
+    for (size_t i = 0; i < K; ++i) {
+        multiply();
+    }
+    auto end_time = high_resolution_clock::now();
+    auto duration = duration_cast<microseconds>(end_time - start_time);
+    double sum = accumulate(y.begin(), y.end(), 0.0);
+    cout << "Average runtime for " << name << " over " << K << " runs: "
+         << static_cast<double>(duration.count()) / 1000. / K << " ms, sum: " << sum << endl;
+}
+
 int main() {
     // Matrix size and number of iterations
     size_t n = 2000;
@@ -52,18 +74,19 @@ int main() {
     uniform_real_distribution<> dis(0.0, 1.0);
 
     // Allocate and initialize a symmetric matrix with random numbers
-    double** A = new double*[n];
-    for (size_t i = 0; i < n; ++i) {
-        A[i] = new double[n];
-    }
+    matrix A = matrix_create(n, n, MATRIX_ROW_MAJOR);
     for (size_t i = 0; i < n; ++i) {
         for (size_t j = i; j < n; ++j) {
             double val = dis(gen);
-            A[i][j] = val;
-            A[j][i] = val;  // Symmetric assignment
+            *matrix_at(&A, i, j) = val;
+            *matrix_at(&A, j, i) = val;  // Symmetric assignment
         }
     }
 
+    // Same matrix stored by columns
+    matrix A_col = matrix_create(n, n, MATRIX_COL_MAJOR);
+    matrix_convert(&A, &A_col);
+
     // Initialize vector x with random numbers
     vector<double> x(n);
     for (size_t i = 0; i < n; ++i) {
@@ -73,33 +96,17 @@ int main() {
     // Initialize vector y
     vector<double> y(n);
 
-    // Test column-major matrix-vector multiplication
-    auto start_time = high_resolution_clock::now();
-    for (size_t i = 0; i < K; ++i) {
-        matrix_vector_multiply_col(y, A, x, n);
-    }
-    auto end_time = high_resolution_clock::now();
-    auto duration = duration_cast<milliseconds>(end_time - start_time);
-    double sum_col = accumulate(y.begin(), y.end(), 0.0);
-    cout << "Average runtime for matrix_vector_multiply_col over " << K << " runs: "
-         << static_cast<double>(duration.count()) / K << " ms, sum: " << sum_col << endl;
+    // Loops over the row-major storage: column-wise access, then row-wise
+    time_runs("matrix_vector_multiply_col", [&] { matrix_vector_multiply_col(y, A, x, n); }, y, K);
+    time_runs("matrix_vector_multiply_row", [&] { matrix_vector_multiply_row(y, A, x, n); }, y, K);
 
-    // Test row-major matrix-vector multiplication
-    start_time = high_resolution_clock::now();
-    for (size_t i = 0; i < K; ++i) {
-        matrix_vector_multiply_row(y, A, x, n);
-    }
-    end_time = high_resolution_clock::now();
-    duration = duration_cast<milliseconds>(end_time - start_time);
-    double sum_row = accumulate(y.begin(), y.end(), 0.0);
-    cout << "Average runtime for matrix_vector_multiply_row over " << K << " runs: "
-         << static_cast<double>(duration.count()) / K << " ms, sum: " << sum_row << endl;
+    // Optimized kernels, one per layout
+    time_runs("matrix_gemv (row-major)", [&] { matrix_gemv(1., &A, x.data(), 0., y.data()); }, y, K);
+    time_runs("matrix_gemv (column-major)", [&] { matrix_gemv(1., &A_col, x.data(), 0., y.data()); }, y, K);
 
     // Cleanup
-    for (size_t i = 0; i < n; ++i) {
-        delete[] A[i];
-    }
-    delete[] A;
+    matrix_destroy(&A);
+    matrix_destroy(&A_col);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,415 @@
+// memhier.c
+//
+// Memory hierarchy characterisation, the companion of stream.c: STREAM
+// measures one array size, i.e. DRAM only. Here the working set is swept
+// from 4 KiB to max_MiB (4 points per octave) and for every size we measure
+//
+//   - read, write and triad bandwidth, with one thread and with all OpenMP
+//     threads (the working set is the total over all threads, every thread
+//     repeatedly sweeps its own contiguous slice);
+//   - load-to-use latency, by chasing pointers through a random cyclic
+//     permutation of the cache lines of the working set, so that every load
+//     depends on the previous one and the prefetchers cannot guess the next
+//     line.
+//
+// The cache levels are then found from the latency curve: a level ends
+// where the latency jumps (ratio >= KNEE_RATIO between neighbouring sizes;
+// as many jumps as sysfs reports cache levels, the highest ones), and each
+// level gets the latency and median bandwidths of its plateau. The sizes
+// reported by sysfs are printed next to them for comparison. max_MiB should
+// be well above the last level cache, or the last level found is not DRAM.
+//
+// The results go to stdout and to a JSON file with the raw sweep, the
+// levels and one bandwidth ceiling per level and thread count, for the
+// multi-ceiling roofline in ../04.
+//
+//   ./memhier [max_MiB [out.json]]     default: 2048 MiB, memhier.json
+//
+// Latencies include TLB misses at the larger sizes (4 KiB pages), like any
+// real random access would. Every bandwidth measurement runs on fresh pages
+// first touched with the split of its kernel and thread count, so on a NUMA
+// node each thread's slice is local at every working set size, not only at
+// max_MiB.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <omp.h>
+#include <sys/mman.h>
+
+#define LINE             64
+#define MIN_BYTES        (4L << 10)
+#define POINTS_PER_OCTAVE 4
+#define MAX_POINTS       128
+#define TRIALS           3
+#define MIN_SECONDS      0.01
+#define KNEE_RATIO       1.2
+#define MAX_LEVELS       8
+#define MAX_CHASE        (1L << 20)
+#define READ_PARTIALS    64   /* 8 AVX-512 registers: add latency x 2 ports */
+
+enum { READ, WRITE, TRIAD, NKERNELS };
+static const char* kernel_names[NKERNELS] = {"read", "write", "triad"};
+
+typedef struct {
+  size_t bytes;
+  double latency_ns;
+  double gbs[NKERNELS][2];   /* [kernel][0: one thread, 1: all threads] */
+} point;
+
+typedef struct {
+  char   name[16];
+  size_t capacity;           /* largest working set of the plateau */
+  int    first, last;        /* points of the plateau */
+  double latency_ns;
+  double gbs[NKERNELS][2];
+} level;
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return 1.*t.tv_sec + 1.e-9*t.tv_nsec;
+}
+
+static void die(const char* message) {
+  fprintf(stderr, "%s\n", message);
+  exit(EXIT_FAILURE);
+}
+
+/* ========================================================================== */
+/* Bandwidth                                                                  */
+/* ========================================================================== */
+
+static volatile double sink;
+
+/* reps passes of kernel k over a working set of `bytes` in buf, split over
+   `threads` threads; returns the elapsed time. */
+static double run_kernel(int k, double* buf, size_t bytes, long reps, int threads) {
+  size_t n = bytes / sizeof(double);
+  if (k == TRIAD) n /= 3;
+  double* a = buf;
+  double* b = buf + n;
+  double* c = buf + 2*n;
+
+  double t = -now();
+  #pragma omp parallel num_threads(threads)
+  {
+    int id = omp_get_thread_num(), nt = omp_get_num_threads();
+    size_t lo = n * id / nt, hi = n * (id + 1) / nt;
+    /* independent partial sums, or one add chain limits the cached sizes;
+       combined once after all the passes, not per pass */
+    double part[READ_PARTIALS] = {0.};
+    for (long r = 0; r < reps; ++r) {
+      if (k == READ) {
+        size_t i = lo;
+        for (; i + READ_PARTIALS <= hi; i += READ_PARTIALS) {
+          #pragma omp simd
+          for (int l = 0; l < READ_PARTIALS; ++l) part[l] += a[i + l];
+        }
+        for (; i < hi; ++i) part[0] += a[i];
+      } else if (k == WRITE) {
+        const double v = (double) r;
+        #pragma omp simd
+        for (size_t i = lo; i < hi; ++i) a[i] = v;
+      } else {
+        const double q = 1.e-9 * r;
+        #pragma omp simd
+        for (size_t i = lo; i < hi; ++i) a[i] = b[i] + q * c[i];
+      }
+      /* keep the passes from being merged */
+      __asm__ __volatile__("" ::: "memory");
+    }
+    double s = 0.;
+    for (int l = 0; l < READ_PARTIALS; ++l) s += part[l];
+    if (s != 0.) sink = s;
+  }
+  return t + now();
+}
+
+/* Fresh pages for a run of kernel k, each written first by the thread
+   that will use it in run_kernel. All three triad arrays are written: a
+   page that is only read stays mapped to the shared zero page and would
+   be read from the caches. */
+static double* place(int k, size_t bytes, int threads) {
+  void* m = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (m == MAP_FAILED) die("Failed to map a working set.");
+  double* buf = (double*) m;
+  size_t n = bytes / sizeof(double);
+  if (k == TRIAD) n /= 3;
+  int arrays = (k == TRIAD) ? 3 : 1;
+
+  #pragma omp parallel num_threads(threads)
+  {
+    int id = omp_get_thread_num(), nt = omp_get_num_threads();
+    size_t lo = n * id / nt, hi = n * (id + 1) / nt;
+    for (int a = 0; a < arrays; ++a) {
+      for (size_t i = lo; i < hi; ++i) buf[a * n + i] = 1.;
+    }
+  }
+  return buf;
+}
+
+/* Best of TRIALS, each long enough for the timer, on pages placed for this
+   kernel and thread count; bytes moved are counted as in STREAM (no
+   write-allocate). */
+static double bandwidth(int k, size_t bytes, int threads) {
+  double* buf = place(k, bytes, threads);
+  size_t moved = (k == TRIAD) ? bytes / (3 * sizeof(double)) * 3 * sizeof(double)
+                              : bytes / sizeof(double) * sizeof(double);
+  long reps = 1;
+  double t = run_kernel(k, buf, bytes, reps, threads);   /* also warms up */
+  while (t < MIN_SECONDS) {
+    reps = (t > 0.) ? (long) (reps * 1.5 * MIN_SECONDS / t) + 1 : reps * 16;
+    t = run_kernel(k, buf, bytes, reps, threads);
+  }
+  double best = t;
+  for (int trial = 1; trial < TRIALS; ++trial) {
+    t = run_kernel(k, buf, bytes, reps, threads);
+    if (t < best) best = t;
+  }
+  munmap(buf, bytes);
+  return 1.e-9 * moved * reps / best;
+}
+
+/* ========================================================================== */
+/* Latency                                                                    */
+/* ========================================================================== */
+
+/* One pointer per cache line, linked in a single random cycle (Sattolo). */
+static void build_chase(char* buf, size_t lines, size_t* order) {
+  for (size_t i = 0; i < lines; ++i) order[i] = i;
+  for (size_t i = lines - 1; i > 0; --i) {
+    size_t j = (size_t) (drand48() * i);   /* j < i: one cycle */
+    size_t tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+  }
+  for (size_t i = 0; i < lines; ++i) {
+    *(void**) (buf + order[i] * LINE) = buf + order[(i + 1) % lines] * LINE;
+  }
+}
+
+static double chase(void* start, long steps) {
+  void* p = start;
+  double t = -now();
+  for (long s = 0; s < steps; s += 8) {
+    p = *(void**) p; p = *(void**) p; p = *(void**) p; p = *(void**) p;
+    p = *(void**) p; p = *(void**) p; p = *(void**) p; p = *(void**) p;
+  }
+  t += now();
+  sink = (double) (uintptr_t) p;
+  return t;
+}
+
+/* buf is released after every size: build_chase writes every line it
+   uses, and the bandwidth runs map their own pages meanwhile. */
+static double latency_ns(char* buf, size_t bytes, size_t* order) {
+  size_t lines = bytes / LINE;
+  if (lines < 2) return 0.;
+  build_chase(buf, lines, order);
+
+  /* a random sample of the cycle is enough once it is much larger than
+     the caches; a full cycle of 1 GiB would take seconds */
+  long steps = 8 * ((long) lines / 8 + 1);
+  if (steps > MAX_CHASE) steps = MAX_CHASE;
+  chase(buf, steps);                        /* warm-up */
+  double t;
+  while ((t = chase(buf, steps)) < MIN_SECONDS) steps *= 2;
+  double best = t;
+  for (int trial = 1; trial < TRIALS; ++trial) {
+    t = chase(buf, steps);
+    if (t < best) best = t;
+  }
+  madvise(buf, bytes, MADV_DONTNEED);
+  return 1.e9 * best / steps;
+}
+
+/* ========================================================================== */
+/* Levels                                                                     */
+/* ========================================================================== */
+
+static int compare_double(const void* a, const void* b) {
+  double x = *(const double*) a, y = *(const double*) b;
+  return (x > y) - (x < y);
+}
+
+/* Splits the sweep at the latency jumps. A jump spread over neighbouring
+   points (a level filling up gradually) counts once, with the ratio of the
+   latencies after and before it as its height; only the max_knees highest
+   are kept, which drops the smaller steps of TLB misses inside DRAM. */
+static int find_levels(const point* p, int np, int max_knees, level* lv) {
+  int start[MAX_POINTS], end[MAX_POINTS], nk = 0;
+  if (max_knees > MAX_LEVELS - 1) max_knees = MAX_LEVELS - 1;
+  double height[MAX_POINTS];
+  for (int i = 1; i < np; ++i) {
+    if (p[i].latency_ns < KNEE_RATIO * p[i-1].latency_ns) continue;
+    start[nk] = i;
+    while (i + 1 < np && p[i+1].latency_ns >= KNEE_RATIO * p[i].latency_ns) ++i;
+    end[nk] = i;
+    height[nk] = p[i].latency_ns / p[start[nk] - 1].latency_ns;
+    ++nk;
+  }
+  while (nk > max_knees) {
+    int lowest = 0;
+    for (int k = 1; k < nk; ++k) if (height[k] < height[lowest]) lowest = k;
+    for (int k = lowest; k + 1 < nk; ++k) {
+      start[k] = start[k+1]; end[k] = end[k+1]; height[k] = height[k+1];
+    }
+    --nk;
+  }
+
+  int nl = nk + 1;
+  for (int l = 0; l < nl; ++l) {
+    lv[l].first = l ? end[l-1] : 0;
+    lv[l].last = (l < nk) ? start[l] - 1 : np - 1;
+    lv[l].capacity = p[lv[l].last].bytes;
+    if (l == nl - 1 && nl > 1) snprintf(lv[l].name, sizeof(lv[l].name), "DRAM");
+    else snprintf(lv[l].name, sizeof(lv[l].name), "L%d", l + 1);
+
+    /* latency: the flat part (smallest); bandwidth: median of the plateau */
+    double values[MAX_POINTS];
+    int count = lv[l].last - lv[l].first + 1;
+    lv[l].latency_ns = p[lv[l].first].latency_ns;
+    for (int i = lv[l].first; i <= lv[l].last; ++i) {
+      if (p[i].latency_ns < lv[l].latency_ns) lv[l].latency_ns = p[i].latency_ns;
+    }
+    for (int k = 0; k < NKERNELS; ++k) {
+      for (int t = 0; t < 2; ++t) {
+        for (int i = 0; i < count; ++i) values[i] = p[lv[l].first + i].gbs[k][t];
+        qsort(values, count, sizeof(double), compare_double);
+        lv[l].gbs[k][t] = (count % 2) ? values[count/2]
+                                      : 0.5 * (values[count/2 - 1] + values[count/2]);
+      }
+    }
+  }
+  return nl;
+}
+
+/* Data and unified caches of CPU 0 from sysfs, for comparison; returns
+   the number of levels (0 if sysfs has none). */
+static int print_sysfs_caches(void) {
+  int levels = 0;
+  printf("# sysfs caches:");
+  for (int index = 0; index < 8; ++index) {
+    char path[128], type[32] = "", size[32] = "";
+    int lvl = 0;
+    FILE* f;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+    if ((f = fopen(path, "r")) == NULL) break;
+    if (fscanf(f, "%d", &lvl) != 1) lvl = 0;
+    fclose(f);
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", index);
+    if ((f = fopen(path, "r")) != NULL) { if (fscanf(f, "%31s", type) != 1) type[0] = '\0'; fclose(f); }
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+    if ((f = fopen(path, "r")) != NULL) { if (fscanf(f, "%31s", size) != 1) size[0] = '\0'; fclose(f); }
+    if (strcmp(type, "Instruction") != 0) printf("  L%d %s", lvl, size);
+    if (lvl > levels) levels = lvl;
+  }
+  printf("\n");
+  return levels;
+}
+
+/* ========================================================================== */
+/* Output                                                                     */
+/* ========================================================================== */
+
+static void write_json(const char* path, int threads, const point* p, int np,
+                       const level* lv, int nl) {
+  FILE* f = fopen(path, "w");
+  if (f == NULL) die("Failed to open the output file.");
+
+  fprintf(f, "{\n  \"threads\": %d,\n  \"sweep\": [", threads);
+  for (int i = 0; i < np; ++i) {
+    fprintf(f, "%s\n    {\"bytes\": %zu, \"latency_ns\": %.4g", i ? "," : "",
+            p[i].bytes, p[i].latency_ns);
+    for (int k = 0; k < NKERNELS; ++k) {
+      fprintf(f, ", \"%s_gbs\": [%.4g, %.4g]", kernel_names[k], p[i].gbs[k][0], p[i].gbs[k][1]);
+    }
+    fprintf(f, "}");
+  }
+
+  fprintf(f, "\n  ],\n  \"levels\": [");
+  for (int l = 0; l < nl; ++l) {
+    fprintf(f, "%s\n    {\"name\": \"%s\", \"capacity_bytes\": %zu, \"latency_ns\": %.4g",
+            l ? "," : "", lv[l].name, lv[l].capacity, lv[l].latency_ns);
+    for (int k = 0; k < NKERNELS; ++k) {
+      fprintf(f, ", \"%s_gbs\": [%.4g, %.4g]", kernel_names[k], lv[l].gbs[k][0], lv[l].gbs[k][1]);
+    }
+    fprintf(f, "}");
+  }
+
+  /* Roofline ceilings: triad bandwidth of each level, as STREAM reports */
+  fprintf(f, "\n  ],\n  \"ceilings\": [");
+  for (int l = 0, first = 1; l < nl; ++l) {
+    for (int t = 0; t < (threads > 1 ? 2 : 1); ++t, first = 0) {
+      fprintf(f, "%s\n    {\"name\": \"%s\", \"threads\": %d, \"bandwidth_gbs\": %.4g}",
+              first ? "" : ",", lv[l].name, t ? threads : 1, lv[l].gbs[TRIAD][t]);
+    }
+  }
+  fprintf(f, "\n  ]\n}\n");
+  fclose(f);
+}
+
+int main(int argc, char** argv) {
+  size_t max_bytes = (size_t) (argc > 1 ? atol(argv[1]) : 2048) << 20;
+  const char* path = argc > 2 ? argv[2] : "memhier.json";
+  if (max_bytes < (size_t) MIN_BYTES) die("Invalid maximum size.");
+  int threads = omp_get_max_threads();
+
+  /* only the latency runs use buf, from the master thread; pages are
+     touched by build_chase, up to the size being measured */
+  void* m = mmap(NULL, max_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (m == MAP_FAILED) die("Failed to allocate the working set.");
+  double* buf = (double*) m;
+  size_t* order = (size_t*) malloc(max_bytes / LINE * sizeof(size_t));
+  if (order == NULL) die("Failed to allocate the permutation.");
+
+  point p[MAX_POINTS];
+  int np = 0;
+  for (int step = 0; np < MAX_POINTS; ++step) {
+    double scale = 1.;
+    for (int s = 0; s < step % POINTS_PER_OCTAVE; ++s) scale *= 1.189207115002721; /* 2^(1/4) */
+    size_t bytes = (size_t) (MIN_BYTES * scale) << (step / POINTS_PER_OCTAVE);
+    bytes = bytes / LINE * LINE;
+    if (bytes > max_bytes) break;
+    p[np++].bytes = bytes;
+  }
+
+  printf("# Threads: %d, working sets %zu KiB - %zu MiB\n", threads,
+         p[0].bytes >> 10, p[np-1].bytes >> 20);
+  int caches = print_sysfs_caches();
+  printf("#%13s %12s", "Size (KiB)", "Latency (ns)");
+  for (int k = 0; k < NKERNELS; ++k) printf(" %8s 1T %6s %dT", kernel_names[k], kernel_names[k], threads);
+  printf("   [GB/s]\n");
+
+  for (int i = 0; i < np; ++i) {
+    p[i].latency_ns = latency_ns((char*) buf, p[i].bytes, order);
+    for (int k = 0; k < NKERNELS; ++k) {
+      p[i].gbs[k][0] = bandwidth(k, p[i].bytes, 1);
+      p[i].gbs[k][1] = bandwidth(k, p[i].bytes, threads);
+    }
+    printf("%14.1f %12.2f", p[i].bytes / 1024., p[i].latency_ns);
+    for (int k = 0; k < NKERNELS; ++k) printf(" %11.2f %9.2f", p[i].gbs[k][0], p[i].gbs[k][1]);
+    printf("\n");
+    fflush(stdout);
+  }
+
+  level lv[MAX_LEVELS];
+  int nl = find_levels(p, np, caches > 0 ? caches : 3, lv);
+  printf("\n# Level   Capacity (KiB)  Latency (ns)");
+  for (int k = 0; k < NKERNELS; ++k) printf(" %8s 1T %6s %dT", kernel_names[k], kernel_names[k], threads);
+  printf("\n");
+  for (int l = 0; l < nl; ++l) {
+    printf("  %-6s %16.0f %13.2f", lv[l].name, lv[l].capacity / 1024., lv[l].latency_ns);
+    for (int k = 0; k < NKERNELS; ++k) printf(" %11.2f %9.2f", lv[l].gbs[k][0], lv[l].gbs[k][1]);
+    printf("\n");
+  }
+
+  write_json(path, threads, p, np, lv, nl);
+  printf("# Written to %s\n", path);
+
+  free(order);
+  munmap(buf, max_bytes);
+  return 0;
+}
@@ -18,3 +18,7 @@ lscpu | grep "Model name"
 make clean
 make
 srun ./stream_c_1
+
+# naive vs tuned (non-temporal stores), then tuned with ordinary stores
+srun ./stream_c_tuned
+STREAM_NT=0 srun ./stream_c_tuned
@@ -0,0 +1,21 @@
+#!/bin/bash
+#SBATCH -A es_math                         # Account (es_math or ls_math)
+#SBATCH --job-name=slurm_stream_numa       # Job name    (default: sbatch)
+#SBATCH --output=slurm_stream_numa-%j.out  # Output file (default: slurm-%j.out)
+#SBATCH --error=slurm_stream_numa-%j.err   # Error file  (default: slurm-%j.out)
+#SBATCH --ntasks=1                         # Number of tasks
+#SBATCH --exclusive                        # Whole node: every socket
+#SBATCH --time=00:10:00                    # Wall clock time limit
+
+# load some modules & list loaded modules
+module list
+module load gcc
+
+# print CPU and NUMA info
+lscpu | grep -E "Model name|NUMA"
+
+# compile & run: bandwidth matrix (threads on node i, memory on node j) and
+# triad scaling per socket, in stream_numa.json
+make clean
+make stream_numa
+srun --cpus-per-task=$(nproc --all) ./stream_numa 512
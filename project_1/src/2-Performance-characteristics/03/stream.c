@@ -46,6 +46,14 @@
 # include <float.h>
 # include <limits.h>
 # include <sys/time.h>
+# include <stdlib.h>
+#ifdef TUNED
+# include <immintrin.h>
+#endif
+#ifdef PERFCOUNT
+# include <string.h>
+# include "perfcount.h"
+#endif
 
 /*-----------------------------------------------------------------------
  * INSTRUCTIONS:
@@ -146,10 +154,17 @@
  *     to the compile line.
  *     Note that this changes the minimum array sizes required --- see (1) above.
  *
- *     The preprocessor directive "TUNED" does not do much -- it simply causes the 
- *       code to call separate functions to execute each kernel.  Trivial versions
- *       of these functions are provided, but they are *not* tuned -- they just 
- *       provide predefined interfaces to be replaced with tuned code.
+ *     The preprocessor directive "TUNED" causes the code to run, after each
+ *       of the four standard loops, a tuned version of the same kernel
+ *       (tuned_STREAM_*, at the end of this file) and to report both rates
+ *       side by side. The tuned kernels use explicit SIMD (AVX-512, AVX or
+ *       SSE2, whichever the compiler targets) on 64-byte aligned arrays, give
+ *       each thread one contiguous, vector-aligned chunk, and by default
+ *       write with non-temporal (streaming) stores, which skip the
+ *       write-allocate read of the destination. STREAM_NT=0 in the
+ *       environment selects ordinary stores instead, to measure the
+ *       write-allocate cost on its own. With STREAM_TYPE other than double
+ *       or float the tuned kernels are the plain loops.
  *
  *
  *	4) Optional: Mail the results to mccalpin@cs.virginia.edu
@@ -176,23 +191,63 @@
 #define STREAM_TYPE double
 #endif
 
-static STREAM_TYPE	a[STREAM_ARRAY_SIZE+OFFSET],
-			b[STREAM_ARRAY_SIZE+OFFSET],
-			c[STREAM_ARRAY_SIZE+OFFSET];
+/*  Arrays start on a cache line (and AVX-512 register) boundary */
+#ifndef STREAM_ALIGN
+#   define STREAM_ALIGN	64
+#endif
 
-static double	avgtime[4] = {0}, maxtime[4] = {0},
-		mintime[4] = {FLT_MAX,FLT_MAX,FLT_MAX,FLT_MAX};
+static STREAM_TYPE	a[STREAM_ARRAY_SIZE+OFFSET] __attribute__((aligned(STREAM_ALIGN))),
+			b[STREAM_ARRAY_SIZE+OFFSET] __attribute__((aligned(STREAM_ALIGN))),
+			c[STREAM_ARRAY_SIZE+OFFSET] __attribute__((aligned(STREAM_ALIGN)));
 
-static char	*label[4] = {"Copy:      ", "Scale:     ",
-    "Add:       ", "Triad:     "};
+/*  With TUNED, kernels 4-7 are the tuned versions of 0-3 */
+#ifdef TUNED
+#   define NKERNELS	8
+#   define NPASSES	2
+#else
+#   define NKERNELS	4
+#   define NPASSES	1
+#endif
 
-static double	bytes[4] = {
+static double	avgtime[8] = {0}, maxtime[8] = {0},
+		mintime[8] = {FLT_MAX,FLT_MAX,FLT_MAX,FLT_MAX,
+			      FLT_MAX,FLT_MAX,FLT_MAX,FLT_MAX};
+
+static char	*label[8] = {"Copy:      ", "Scale:     ",
+    "Add:       ", "Triad:     ",
+    "Copy (t):  ", "Scale (t): ", "Add (t):   ", "Triad (t): "};
+
+static double	bytes[8] = {
+    2 * sizeof(STREAM_TYPE) * STREAM_ARRAY_SIZE,
+    2 * sizeof(STREAM_TYPE) * STREAM_ARRAY_SIZE,
+    3 * sizeof(STREAM_TYPE) * STREAM_ARRAY_SIZE,
+    3 * sizeof(STREAM_TYPE) * STREAM_ARRAY_SIZE,
     2 * sizeof(STREAM_TYPE) * STREAM_ARRAY_SIZE,
     2 * sizeof(STREAM_TYPE) * STREAM_ARRAY_SIZE,
     3 * sizeof(STREAM_TYPE) * STREAM_ARRAY_SIZE,
     3 * sizeof(STREAM_TYPE) * STREAM_ARRAY_SIZE
     };
 
+#ifdef TUNED
+/*  Words stored per word counted, for the write-allocate estimate */
+static double	stores[4] = {1.0/2.0, 1.0/2.0, 1.0/3.0, 1.0/3.0};
+#endif
+
+#ifdef PERFCOUNT
+/*  Hardware counters of every kernel over all NTIMES passes, and the
+ *  flops of one pass for the derived metrics */
+static perf_group	counters[8];
+static double	flops[8] = {
+    0, STREAM_ARRAY_SIZE, STREAM_ARRAY_SIZE, 2.0 * STREAM_ARRAY_SIZE,
+    0, STREAM_ARRAY_SIZE, STREAM_ARRAY_SIZE, 2.0 * STREAM_ARRAY_SIZE
+    };
+#   define COUNT_START(j)	perf_group_start(&counters[j])
+#   define COUNT_STOP(j)	perf_group_stop(&counters[j])
+#else
+#   define COUNT_START(j)
+#   define COUNT_STOP(j)
+#endif
+
 extern double mysecond();
 extern void checkSTREAMresults();
 #ifdef TUNED
@@ -200,6 +255,7 @@ extern void tuned_STREAM_Copy();
 extern void tuned_STREAM_Scale(STREAM_TYPE scalar);
 extern void tuned_STREAM_Add();
 extern void tuned_STREAM_Triad(STREAM_TYPE scalar);
+extern int tuned_STREAM_Init();
 #endif
 #ifdef _OPENMP
 extern int omp_get_num_threads();
@@ -212,10 +268,15 @@ main()
     int			k;
     ssize_t		j;
     STREAM_TYPE		scalar;
-    double		t, times[4][NTIMES];
+    double		t, times[8][NTIMES];
 
     /* --- SETUP --- determine precision and check timing --- */
 
+#ifdef PERFCOUNT
+    /* before the first parallel region: inherit then counts the threads */
+    for (j=0; j<NKERNELS; j++) perf_group_open(&counters[j]);
+#endif
+
     printf(HLINE);
     printf("STREAM version $Revision: 5.10 $\n");
     printf(HLINE);
@@ -301,57 +362,83 @@ main()
     printf("precision of your system timer.\n");
     printf(HLINE);
     
+#ifdef TUNED
+    printf("Tuned kernels: %s\n", tuned_STREAM_Init() ?
+	"non-temporal stores (no write-allocate)" :
+	"ordinary stores (STREAM_NT=0, with write-allocate)");
+    printf(HLINE);
+#endif
+
     /*	--- MAIN LOOP --- repeat test cases NTIMES times --- */
 
     scalar = 3.0;
     for (k=0; k<NTIMES; k++)
 	{
 	times[0][k] = mysecond();
-#ifdef TUNED
-        tuned_STREAM_Copy();
-#else
+	COUNT_START(0);
 #pragma omp parallel for
 	for (j=0; j<STREAM_ARRAY_SIZE; j++)
 	    c[j] = a[j];
-#endif
+	COUNT_STOP(0);
 	times[0][k] = mysecond() - times[0][k];
 	
 	times[1][k] = mysecond();
-#ifdef TUNED
-        tuned_STREAM_Scale(scalar);
-#else
+	COUNT_START(1);
 #pragma omp parallel for
 	for (j=0; j<STREAM_ARRAY_SIZE; j++)
 	    b[j] = scalar*c[j];
-#endif
+	COUNT_STOP(1);
 	times[1][k] = mysecond() - times[1][k];
 	
 	times[2][k] = mysecond();
-#ifdef TUNED
-        tuned_STREAM_Add();
-#else
+	COUNT_START(2);
 #pragma omp parallel for
 	for (j=0; j<STREAM_ARRAY_SIZE; j++)
 	    c[j] = a[j]+b[j];
-#endif
+	COUNT_STOP(2);
 	times[2][k] = mysecond() - times[2][k];
 	
 	times[3][k] = mysecond();
-#ifdef TUNED
-        tuned_STREAM_Triad(scalar);
-#else
+	COUNT_START(3);
 #pragma omp parallel for
 	for (j=0; j<STREAM_ARRAY_SIZE; j++)
 	    a[j] = b[j]+scalar*c[j];
-#endif
+	COUNT_STOP(3);
 	times[3][k] = mysecond() - times[3][k];
+
+#ifdef TUNED
+	/* same sequence again with the tuned kernels */
+	times[4][k] = mysecond();
+	COUNT_START(4);
+        tuned_STREAM_Copy();
+	COUNT_STOP(4);
+	times[4][k] = mysecond() - times[4][k];
+
+	times[5][k] = mysecond();
+	COUNT_START(5);
+        tuned_STREAM_Scale(scalar);
+	COUNT_STOP(5);
+	times[5][k] = mysecond() - times[5][k];
+
+	times[6][k] = mysecond();
+	COUNT_START(6);
+        tuned_STREAM_Add();
+	COUNT_STOP(6);
+	times[6][k] = mysecond() - times[6][k];
+
+	times[7][k] = mysecond();
+	COUNT_START(7);
+        tuned_STREAM_Triad(scalar);
+	COUNT_STOP(7);
+	times[7][k] = mysecond() - times[7][k];
+#endif
 	}
 
     /*	--- SUMMARY --- */
 
     for (k=1; k<NTIMES; k++) /* note -- skip first iteration */
 	{
-	for (j=0; j<4; j++)
+	for (j=0; j<NKERNELS; j++)
 	    {
 	    avgtime[j] = avgtime[j] + times[j][k];
 	    mintime[j] = MIN(mintime[j], times[j][k]);
@@ -360,7 +447,7 @@ main()
 	}
     
     printf("Function    Best Rate MB/s  Avg time     Min time     Max time\n");
-    for (j=0; j<4; j++) {
+    for (j=0; j<NKERNELS; j++) {
 		avgtime[j] = avgtime[j]/(double)(NTIMES-1);
 
 		printf("%s%12.1f  %11.6f  %11.6f  %11.6f\n", label[j],
@@ -371,6 +458,32 @@ main()
     }
     printf(HLINE);
 
+#ifdef TUNED
+    /* Naive and tuned side by side. "Naive + WA" adds the write-allocate
+       read of the destination, which ordinary stores also move. */
+    printf("Function    Naive MB/s  Naive + WA MB/s   Tuned MB/s  Tuned/Naive\n");
+    for (j=0; j<4; j++) {
+		double naive = 1.0E-06 * bytes[j]/mintime[j];
+		double tuned = 1.0E-06 * bytes[j+4]/mintime[j+4];
+		printf("%s%10.1f  %15.1f  %11.1f  %11.2f\n", label[j],
+	       naive, naive * (1.0 + stores[j]), tuned, tuned/naive);
+    }
+    printf(HLINE);
+#endif
+
+#ifdef PERFCOUNT
+    /* Counters of all passes, the first one included */
+    for (j=0; j<NKERNELS; j++) {
+		char name[16];
+		double seconds = 0.0;
+		for (k=0; k<NTIMES; k++) seconds += times[j][k];
+		snprintf(name, sizeof(name), "%.*s", (int) strcspn(label[j], ":"), label[j]);
+		perf_group_print(stdout, name, &counters[j], seconds, NTIMES * flops[j]);
+		perf_group_close(&counters[j]);
+    }
+    printf(HLINE);
+#endif
+
     /* --- Check Results --- */
     checkSTREAMresults();
     printf(HLINE);
@@ -447,7 +560,7 @@ void checkSTREAMresults ()
 	aj = 2.0E0 * aj;
     /* now execute timing loop */
 	scalar = 3.0;
-	for (k=0; k<NTIMES; k++)
+	for (k=0; k<NTIMES*NPASSES; k++)
         {
             cj = aj;
             bj = scalar*cj;
@@ -549,37 +662,165 @@ void checkSTREAMresults ()
 }
 
 #ifdef TUNED
-/* stubs for "tuned" versions of the kernels */
+/* Tuned versions of the kernels.
+ *
+ * Every thread works on one contiguous chunk, a multiple of the vector
+ * length, so all its loads and stores are aligned (the arrays are
+ * STREAM_ALIGN-aligned). Stores are non-temporal unless STREAM_NT=0: they
+ * go to the write-combining buffers and straight to memory, without first
+ * reading the destination line into the cache. The sfence at the end makes
+ * each thread's stores globally visible before the timer is read.
+ */
+#define XCAT(x,y)	CAT(x,y)
+#define CAT(x,y)	x##y
+#define IS_double	1
+#define IS_float	2
+#define STREAM_KIND	XCAT(IS_, STREAM_TYPE)
+
+#if STREAM_KIND == IS_double && defined(__AVX512F__)
+#   define VLEN		8
+#   define VTYPE	__m512d
+#   define VLOAD	_mm512_load_pd
+#   define VSTORE	_mm512_store_pd
+#   define VSTREAM	_mm512_stream_pd
+#   define VSET1	_mm512_set1_pd
+#   define VADD		_mm512_add_pd
+#   define VMUL		_mm512_mul_pd
+#elif STREAM_KIND == IS_double && defined(__AVX__)
+#   define VLEN		4
+#   define VTYPE	__m256d
+#   define VLOAD	_mm256_load_pd
+#   define VSTORE	_mm256_store_pd
+#   define VSTREAM	_mm256_stream_pd
+#   define VSET1	_mm256_set1_pd
+#   define VADD		_mm256_add_pd
+#   define VMUL		_mm256_mul_pd
+#elif STREAM_KIND == IS_double && defined(__SSE2__)
+#   define VLEN		2
+#   define VTYPE	__m128d
+#   define VLOAD	_mm_load_pd
+#   define VSTORE	_mm_store_pd
+#   define VSTREAM	_mm_stream_pd
+#   define VSET1	_mm_set1_pd
+#   define VADD		_mm_add_pd
+#   define VMUL		_mm_mul_pd
+#elif STREAM_KIND == IS_float && defined(__AVX512F__)
+#   define VLEN		16
+#   define VTYPE	__m512
+#   define VLOAD	_mm512_load_ps
+#   define VSTORE	_mm512_store_ps
+#   define VSTREAM	_mm512_stream_ps
+#   define VSET1	_mm512_set1_ps
+#   define VADD		_mm512_add_ps
+#   define VMUL		_mm512_mul_ps
+#elif STREAM_KIND == IS_float && defined(__AVX__)
+#   define VLEN		8
+#   define VTYPE	__m256
+#   define VLOAD	_mm256_load_ps
+#   define VSTORE	_mm256_store_ps
+#   define VSTREAM	_mm256_stream_ps
+#   define VSET1	_mm256_set1_ps
+#   define VADD		_mm256_add_ps
+#   define VMUL		_mm256_mul_ps
+#elif STREAM_KIND == IS_float && defined(__SSE__)
+#   define VLEN		4
+#   define VTYPE	__m128
+#   define VLOAD	_mm_load_ps
+#   define VSTORE	_mm_store_ps
+#   define VSTREAM	_mm_stream_ps
+#   define VSET1	_mm_set1_ps
+#   define VADD		_mm_add_ps
+#   define VMUL		_mm_mul_ps
+#endif
+
+#ifdef _OPENMP
+extern int omp_get_thread_num();
+#endif
+
+static int stream_nt = 1;
+
+int tuned_STREAM_Init()
+{
+	char *env = getenv("STREAM_NT");
+	stream_nt = (env == NULL || atoi(env) != 0);
+	return stream_nt;
+}
+
+/* This thread's chunk [*lo, *hi), starting on a vector boundary */
+static void thread_range(ssize_t *lo, ssize_t *hi)
+{
+	ssize_t n = STREAM_ARRAY_SIZE, chunk;
+	int t = 0, nt = 1;
+#ifdef _OPENMP
+	t = omp_get_thread_num();
+	nt = omp_get_num_threads();
+#endif
+#ifdef VLEN
+	chunk = ((n + nt - 1) / nt + VLEN - 1) / VLEN * VLEN;
+#else
+	chunk = (n + nt - 1) / nt;
+#endif
+	*lo = MIN(n, (ssize_t) t * chunk);
+	*hi = MIN(n, *lo + chunk);
+}
+
+#ifdef VLEN
+/* One kernel: dst[j] = EXPR(j) over this thread's chunk, vector body with
+   streaming or ordinary stores, scalar tail. */
+#define TUNED_LOOP(dst, VEXPR, SEXPR)					\
+    {									\
+	ssize_t j, lo, hi;						\
+	thread_range(&lo, &hi);						\
+	j = lo;								\
+	if (stream_nt) {						\
+	    for (; j + VLEN <= hi; j += VLEN)				\
+		VSTREAM(&dst[j], VEXPR);				\
+	} else {							\
+	    for (; j + VLEN <= hi; j += VLEN)				\
+		VSTORE(&dst[j], VEXPR);					\
+	}								\
+	for (; j < hi; j++)						\
+	    dst[j] = SEXPR;						\
+	_mm_sfence();							\
+    }
+#else
+#define TUNED_LOOP(dst, VEXPR, SEXPR)					\
+    {									\
+	ssize_t j, lo, hi;						\
+	thread_range(&lo, &hi);						\
+	for (j = lo; j < hi; j++)					\
+	    dst[j] = SEXPR;						\
+    }
+#endif
+
 void tuned_STREAM_Copy()
 {
-	ssize_t j;
-#pragma omp parallel for
-        for (j=0; j<STREAM_ARRAY_SIZE; j++)
-            c[j] = a[j];
+#pragma omp parallel
+	TUNED_LOOP(c, VLOAD(&a[j]), a[j])
 }
 
 void tuned_STREAM_Scale(STREAM_TYPE scalar)
 {
-	ssize_t j;
-#pragma omp parallel for
-	for (j=0; j<STREAM_ARRAY_SIZE; j++)
-	    b[j] = scalar*c[j];
+#ifdef VLEN
+	VTYPE s = VSET1(scalar);
+#endif
+#pragma omp parallel
+	TUNED_LOOP(b, VMUL(s, VLOAD(&c[j])), scalar*c[j])
 }
 
 void tuned_STREAM_Add()
 {
-	ssize_t j;
-#pragma omp parallel for
-	for (j=0; j<STREAM_ARRAY_SIZE; j++)
-	    c[j] = a[j]+b[j];
+#pragma omp parallel
+	TUNED_LOOP(c, VADD(VLOAD(&a[j]), VLOAD(&b[j])), a[j]+b[j])
 }
 
 void tuned_STREAM_Triad(STREAM_TYPE scalar)
 {
-	ssize_t j;
-#pragma omp parallel for
-	for (j=0; j<STREAM_ARRAY_SIZE; j++)
-	    a[j] = b[j]+scalar*c[j];
+#ifdef VLEN
+	VTYPE s = VSET1(scalar);
+#endif
+#pragma omp parallel
+	TUNED_LOOP(a, VADD(VLOAD(&b[j]), VMUL(s, VLOAD(&c[j]))), b[j]+scalar*c[j])
 }
-/* end of stubs for the "tuned" versions of the kernels */
+/* end of the tuned versions of the kernels */
 #endif
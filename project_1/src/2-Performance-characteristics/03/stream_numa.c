@@ -0,0 +1,309 @@
+// stream_numa.c
+//
+// NUMA placement matrix for the STREAM kernels. On a multi-socket node
+// stream.c with OMP_NUM_THREADS gives one aggregate number, with the
+// threads wherever the OS puts them and every page on the node of the
+// thread that touched it first. Here placement is explicit:
+//
+//   - matrix: for every pair (i, j) the threads are pinned to the CPUs of
+//     node i and the three arrays are bound to the memory of node j
+//     (mbind, MPOL_BIND), then Copy, Scale, Add and Triad are timed. The
+//     diagonal is local access, the rest pays the inter-socket link;
+//   - scaling: Triad with local memory on every node, for 1, 2, ... up to
+//     all the CPUs of the node, i.e. where one socket saturates.
+//
+// The placement uses the raw set_mempolicy family of system calls
+// (linux/mempolicy.h), no libnuma needed; the CPUs of a node are those
+// of sysfs that are also in the affinity mask the job started with, so
+// `srun --cpus-per-task` restricts them as expected. The node of the first
+// page of every array is checked with get_mempolicy.
+//
+//   ./stream_numa [MiB_per_array [threads_per_node [out.json]]]
+//
+// default: 256 MiB per array (well above the last level cache, as the
+// STREAM rules ask), all the CPUs of each node, stream_numa.json. Bytes are
+// counted as in STREAM (no write-allocate), best of NTIMES.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <omp.h>
+
+#define NTIMES     10
+#define MAX_NODES  64
+#define MASK_WORDS (MAX_NODES / (8 * sizeof(unsigned long)))
+
+enum { COPY, SCALE, ADD, TRIAD, NKERNELS };
+static const char* kernel_names[NKERNELS] = {"Copy", "Scale", "Add", "Triad"};
+static const int kernel_arrays[NKERNELS] = {2, 2, 3, 3};
+
+typedef struct {
+  int id;
+  int ncpus;
+  int* cpus;
+} node;
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return 1.*t.tv_sec + 1.e-9*t.tv_nsec;
+}
+
+static void die(const char* message) {
+  fprintf(stderr, "%s\n", message);
+  exit(EXIT_FAILURE);
+}
+
+/* ========================================================================== */
+/* Topology                                                                   */
+/* ========================================================================== */
+
+/* Parses a sysfs list ("0-3,8,10-11") into out[]; returns the count. */
+static int parse_list(const char* path, int* out, int max) {
+  FILE* f = fopen(path, "r");
+  if (f == NULL) return 0;
+  int n = 0, lo, hi;
+  char sep;
+  while (fscanf(f, "%d", &lo) == 1) {
+    hi = lo;
+    if (fscanf(f, "%c", &sep) == 1 && sep == '-') {
+      if (fscanf(f, "%d", &hi) != 1) hi = lo;
+      if (fscanf(f, "%c", &sep) != 1) sep = '\n';
+    }
+    for (int v = lo; v <= hi && n < max; ++v) out[n++] = v;
+    if (sep != ',') break;
+  }
+  fclose(f);
+  return n;
+}
+
+/* Nodes with at least one CPU we may run on; returns the count. */
+static int cpu_nodes(node* nodes, const cpu_set_t* allowed) {
+  int ids[MAX_NODES], count = 0;
+  int n = parse_list("/sys/devices/system/node/online", ids, MAX_NODES);
+  if (n == 0) { ids[0] = 0; n = 1; }   /* no sysfs: one node */
+  for (int k = 0; k < n; ++k) {
+    char path[128];
+    int cpus[CPU_SETSIZE];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", ids[k]);
+    int nc = parse_list(path, cpus, CPU_SETSIZE), kept = 0;
+    if (n == 1 && nc == 0) {
+      for (int c = 0; c < CPU_SETSIZE; ++c) if (CPU_ISSET(c, allowed)) cpus[nc++] = c;
+    }
+    for (int c = 0; c < nc; ++c) if (CPU_ISSET(cpus[c], allowed)) cpus[kept++] = cpus[c];
+    if (kept == 0) continue;
+    nodes[count].id = ids[k];
+    nodes[count].ncpus = kept;
+    nodes[count].cpus = malloc(kept * sizeof(int));
+    memcpy(nodes[count].cpus, cpus, kept * sizeof(int));
+    ++count;
+  }
+  return count;
+}
+
+/* Nodes with memory; returns the count. */
+static int memory_nodes(int* ids) {
+  int n = parse_list("/sys/devices/system/node/has_memory", ids, MAX_NODES);
+  if (n == 0) n = parse_list("/sys/devices/system/node/online", ids, MAX_NODES);
+  if (n == 0) { ids[0] = 0; n = 1; }
+  return n;
+}
+
+/* Pins the calling thread to the t-th CPU of the node (round robin). */
+static void pin(const node* nd, int t) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(nd->cpus[t % nd->ncpus], &set);
+  sched_setaffinity(0, sizeof(set), &set);
+}
+
+/* ========================================================================== */
+/* Memory                                                                     */
+/* ========================================================================== */
+
+static double* alloc_on(size_t bytes, int mem_node) {
+  void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) die("Failed to map the arrays.");
+  unsigned long mask[MASK_WORDS] = {0};
+  mask[mem_node / (8 * sizeof(unsigned long))] = 1UL << (mem_node % (8 * sizeof(unsigned long)));
+  if (syscall(SYS_mbind, p, bytes, MPOL_BIND, mask, MAX_NODES + 1, 0) != 0) {
+    perror("mbind");
+    die("Failed to bind the arrays to the memory node.");
+  }
+  return (double*) p;
+}
+
+/* Node of the page holding p, or -1 if the kernel does not say. */
+static int node_of(const void* p) {
+  int nd = -1;
+  if (syscall(SYS_get_mempolicy, &nd, NULL, 0, p, MPOL_F_NODE | MPOL_F_ADDR) != 0) return -1;
+  return nd;
+}
+
+/* ========================================================================== */
+/* Kernels                                                                    */
+/* ========================================================================== */
+
+/* One pass of kernel k by `threads` threads pinned to nd, static split as
+   in stream.c; returns the elapsed time. */
+static double run_kernel(int k, double* a, double* b, double* c, size_t n,
+                         const node* nd, int threads) {
+  const double scalar = 3.;
+  double t = 0.;
+  #pragma omp parallel num_threads(threads)
+  {
+    int id = omp_get_thread_num();
+    size_t lo = n * id / threads, hi = n * (id + 1) / threads;
+    pin(nd, id);
+    #pragma omp barrier
+    #pragma omp master
+    t = -now();
+    switch (k) {
+      case COPY:
+        #pragma omp simd
+        for (size_t i = lo; i < hi; ++i) c[i] = a[i];
+        break;
+      case SCALE:
+        #pragma omp simd
+        for (size_t i = lo; i < hi; ++i) b[i] = scalar * c[i];
+        break;
+      case ADD:
+        #pragma omp simd
+        for (size_t i = lo; i < hi; ++i) c[i] = a[i] + b[i];
+        break;
+      default:
+        #pragma omp simd
+        for (size_t i = lo; i < hi; ++i) a[i] = b[i] + scalar * c[i];
+    }
+  }
+  return t + now();
+}
+
+/* Best GB/s of NTIMES passes (the first is not counted, as in STREAM). */
+static double bandwidth(int k, double* a, double* b, double* c, size_t n,
+                        const node* nd, int threads) {
+  double best = 0.;
+  for (int r = 0; r < NTIMES; ++r) {
+    double t = run_kernel(k, a, b, c, n, nd, threads);
+    if (r > 0 && t > 0. && (best == 0. || t < best)) best = t;
+  }
+  return 1.e-9 * kernel_arrays[k] * sizeof(double) * n / best;
+}
+
+/* ========================================================================== */
+/* Main                                                                       */
+/* ========================================================================== */
+
+int main(int argc, char** argv) {
+  size_t bytes = (size_t) (argc > 1 ? atol(argv[1]) : 256) << 20;
+  int per_node = argc > 2 ? atoi(argv[2]) : 0;
+  const char* path = argc > 3 ? argv[3] : "stream_numa.json";
+  if (bytes < 4096) die("Invalid array size.");
+  const size_t n = bytes / sizeof(double);
+
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) die("Failed to read the affinity mask.");
+  node cpu[MAX_NODES];
+  int mem[MAX_NODES];
+  const int ncpu = cpu_nodes(cpu, &allowed), nmem = memory_nodes(mem);
+  if (ncpu == 0) die("No usable CPU.");
+
+  printf("# Array size: %zu MiB (x3), NTIMES: %d\n", bytes >> 20, NTIMES);
+  for (int i = 0; i < ncpu; ++i) {
+    printf("# Node %d: %d CPU(s)", cpu[i].id, cpu[i].ncpus);
+    if (per_node > 0) printf(", %d thread(s) used", per_node);
+    printf("\n");
+  }
+
+  /* bw[k][i][j]: kernel k, threads on cpu[i], memory on mem[j] */
+  static double bw[NKERNELS][MAX_NODES][MAX_NODES];
+  static double scaling[MAX_NODES][CPU_SETSIZE + 1];   /* [node][threads], 1-based */
+
+  for (int j = 0; j < nmem; ++j) {
+    double* a = alloc_on(bytes, mem[j]);
+    double* b = alloc_on(bytes, mem[j]);
+    double* c = alloc_on(bytes, mem[j]);
+    for (size_t i = 0; i < n; ++i) { a[i] = 1.; b[i] = 2.; c[i] = 0.; }
+    int placed[3] = {node_of(a), node_of(b), node_of(c)};
+    for (int q = 0; q < 3; ++q) {
+      if (placed[q] >= 0 && placed[q] != mem[j]) {
+        fprintf(stderr, "# warning: array on node %d instead of %d\n", placed[q], mem[j]);
+      }
+    }
+
+    for (int i = 0; i < ncpu; ++i) {
+      int threads = (per_node > 0) ? per_node : cpu[i].ncpus;
+      for (int k = 0; k < NKERNELS; ++k) bw[k][i][j] = bandwidth(k, a, b, c, n, &cpu[i], threads);
+      if (cpu[i].id != mem[j]) continue;
+
+      /* local memory: how the node scales */
+      for (int t = 1; t <= cpu[i].ncpus; ++t) {
+        scaling[i][t] = bandwidth(TRIAD, a, b, c, n, &cpu[i], t);
+      }
+    }
+    munmap(a, bytes);
+    munmap(b, bytes);
+    munmap(c, bytes);
+  }
+
+  for (int k = 0; k < NKERNELS; ++k) {
+    printf("\n# %s (GB/s): threads on node (rows), memory on node (columns)\n%-8s", kernel_names[k], "");
+    for (int j = 0; j < nmem; ++j) printf("  mem %-4d", mem[j]);
+    printf("\n");
+    for (int i = 0; i < ncpu; ++i) {
+      printf("cpu %-4d", cpu[i].id);
+      for (int j = 0; j < nmem; ++j) printf(" %9.2f", bw[k][i][j]);
+      printf("\n");
+    }
+  }
+
+  printf("\n# Triad scaling with local memory (GB/s)\n%-8s", "threads");
+  for (int i = 0; i < ncpu; ++i) printf("  node %-3d", cpu[i].id);
+  printf("\n");
+  int max_cpus = 0;
+  for (int i = 0; i < ncpu; ++i) if (cpu[i].ncpus > max_cpus) max_cpus = cpu[i].ncpus;
+  for (int t = 1; t <= max_cpus; ++t) {
+    printf("%-8d", t);
+    for (int i = 0; i < ncpu; ++i) {
+      if (t <= cpu[i].ncpus && scaling[i][t] > 0.) printf(" %9.2f", scaling[i][t]);
+      else printf(" %9s", "-");
+    }
+    printf("\n");
+  }
+
+  FILE* f = fopen(path, "w");
+  if (f == NULL) die("Failed to open the output file.");
+  fprintf(f, "{\n  \"array_bytes\": %zu,\n  \"cpu_nodes\": [", bytes);
+  for (int i = 0; i < ncpu; ++i) fprintf(f, "%s%d", i ? ", " : "", cpu[i].id);
+  fprintf(f, "],\n  \"memory_nodes\": [");
+  for (int j = 0; j < nmem; ++j) fprintf(f, "%s%d", j ? ", " : "", mem[j]);
+  fprintf(f, "],\n  \"matrix_gbs\": {");
+  for (int k = 0; k < NKERNELS; ++k) {
+    fprintf(f, "%s\n    \"%s\": [", k ? "," : "", kernel_names[k]);
+    for (int i = 0; i < ncpu; ++i) {
+      fprintf(f, "%s[", i ? ", " : "");
+      for (int j = 0; j < nmem; ++j) fprintf(f, "%s%.4g", j ? ", " : "", bw[k][i][j]);
+      fprintf(f, "]");
+    }
+    fprintf(f, "]");
+  }
+  fprintf(f, "\n  },\n  \"triad_scaling_gbs\": {");
+  for (int i = 0; i < ncpu; ++i) {
+    fprintf(f, "%s\n    \"%d\": [", i ? "," : "", cpu[i].id);
+    for (int t = 1; t <= cpu[i].ncpus; ++t) fprintf(f, "%s%.4g", t > 1 ? ", " : "", scaling[i][t]);
+    fprintf(f, "]");
+  }
+  fprintf(f, "\n  }\n}\n");
+  fclose(f);
+  printf("# Written to %s\n", path);
+
+  for (int i = 0; i < ncpu; ++i) free(cpu[i].cpus);
+  return 0;
+}
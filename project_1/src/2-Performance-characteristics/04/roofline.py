@@ -1,3 +1,30 @@
+"""Roofline plots.
+
+Without arguments this is the hand-computed roofline of one Rosa core.
+Given the JSON written by roofline_probe (make; ./roofline_probe), it
+draws every measured ceiling instead: one horizontal line per peak
+(scalar, SSE, AVX2, AVX-512) and one slanted line per bandwidth (L1, L2,
+L3, DRAM), for one thread or for all threads.
+
+    python3 roofline.py [roofline.json] [--threads N] [--memhier memhier.json]
+                        [--points kernels.csv] [--point NAME:I:P ...]
+                        [-o roofline.pdf]
+
+--memhier adds the per-level triad ceilings of ../03/memhier.
+
+Kernel points are (operational intensity in flop/byte, Gflop/s), given with
+--point or in a CSV file with lines "name,intensity,gflops" ('#' starts a
+comment). The intensity is measured or counted for the kernel at hand:
+  - dgemm variants: Gflop/s from `benchmark-... stats`; intensity as
+    flops / (LLC misses * 64 B) from the same run's counters;
+  - mini_app stencil: about 8 flops per 5 reads and 1 write of 8 B per grid
+    point, i.e. 8 / 48 flop/byte when the neighbours do not stay in cache;
+  - dot product: 2 flops per 16 B, 0.125 flop/byte.
+"""
+import argparse
+import csv
+import json
+
 import matplotlib.pyplot as plt
 import numpy as np
 
@@ -18,11 +45,78 @@ def plot_roofline(Pmax, bmax, Imin, Imax, N=1000, ax=None, **plt_kwargs):
     return ax
 
 
+def plot_ceilings(probe, threads, Imin, Imax, ax, memhier=None):
+    """Measured roof (best peak, DRAM) plus every other ceiling."""
+    peaks = [p for p in probe["peaks"] if p["threads"] == threads]
+    bws = [b for b in probe["bandwidths"] if b["threads"] == threads]
+    Pmax = max(p["gflops"] for p in peaks)
+    dram = [b["gbs"] for b in bws if b["name"] == "DRAM"]
+    bmax = dram[0] if dram else min(b["gbs"] for b in bws)
+
+    plot_roofline(Pmax=Pmax, bmax=bmax, Imin=Imin, Imax=Imax, ax=ax, color="k",
+                  linewidth=2, label=f"{probe['cpu']} ({threads} thread(s))")
+
+    I = np.logspace(np.log2(Imin), np.log2(Imax), 200, base=2)
+    for p in peaks:
+        ax.plot(I, np.full_like(I, p["gflops"]), "--", linewidth=0.8)
+        ax.annotate(f"{p['name']} {p['gflops']:.1f}", (Imax, p["gflops"]),
+                    ha="right", va="bottom", fontsize=7)
+    ceilings = [(b["name"], b["gbs"], "-.") for b in bws]
+    if memhier is not None:
+        ceilings += [(f"{c['name']} (memhier)", c["bandwidth_gbs"], ":")
+                     for c in memhier["ceilings"] if c["threads"] == threads]
+    for name, gbs, style in ceilings:
+        ax.plot(I, np.minimum(gbs * I, Pmax), style, linewidth=0.8)
+        Ilabel = Pmax / gbs / 4
+        if Imin < Ilabel < Imax:
+            ax.annotate(f"{name} {gbs:.1f} GB/s", (Ilabel, gbs * Ilabel),
+                        rotation=30, fontsize=7, va="bottom")
+    return ax
+
+
+def read_points(path):
+    points = []
+    with open(path) as f:
+        for row in csv.reader(line for line in f if not line.lstrip().startswith("#")):
+            if len(row) >= 3:
+                points.append((row[0].strip(), float(row[1]), float(row[2])))
+    return points
+
+
 if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("probe", nargs="?", help="JSON of roofline_probe")
+    parser.add_argument("--threads", type=int, help="thread count of the ceilings (default: all)")
+    parser.add_argument("--memhier", help="JSON of ../03/memhier")
+    parser.add_argument("--points", help="CSV of name,intensity,gflops")
+    parser.add_argument("--point", action="append", default=[], help="NAME:I:P")
+    parser.add_argument("-o", "--output", default="roofline.pdf")
+    args = parser.parse_args()
+
+    Imin, Imax = 1.e-2, 1.e+3
     fig, ax = plt.subplots()
-    # Rosa single core: Peak = 36.8 GFlops/s, Bandwidth = 12.3 GB/s
-    ax = plot_roofline(Pmax=36.8, bmax=12.3, Imin=1.e-2, Imax=1.e+3, ax=ax,
-                       label="Intel Xeon E5-2650 v3 (single core)")
-    ax.legend()
-    plt.savefig("roofline.pdf")
+    if args.probe is None:
+        # Rosa single core: Peak = 36.8 GFlops/s, Bandwidth = 12.3 GB/s
+        ax = plot_roofline(Pmax=36.8, bmax=12.3, Imin=Imin, Imax=Imax, ax=ax,
+                           label="Intel Xeon E5-2650 v3 (single core)")
+    else:
+        with open(args.probe) as f:
+            probe = json.load(f)
+        memhier = None
+        if args.memhier:
+            with open(args.memhier) as f:
+                memhier = json.load(f)
+        threads = args.threads or probe["threads"]
+        ax = plot_ceilings(probe, threads, Imin, Imax, ax, memhier)
+
+    points = read_points(args.points) if args.points else []
+    for p in args.point:
+        name, I, P = p.rsplit(":", 2)
+        points.append((name, float(I), float(P)))
+    for name, I, P in points:
+        ax.plot(I, P, "o", markersize=4)
+        ax.annotate(name, (I, P), textcoords="offset points", xytext=(4, 4), fontsize=7)
+
+    ax.legend(fontsize=7, loc="lower right")
+    plt.savefig(args.output)
     plt.show()
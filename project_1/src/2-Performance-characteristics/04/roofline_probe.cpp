@@ -0,0 +1,313 @@
+// roofline_probe.cpp
+//
+// Measures the ceilings of the roofline model on the machine it runs on and
+// writes them as JSON for roofline.py:
+//
+//   - peak double precision Gflop/s with FMA-saturating loops (independent
+//     accumulator chains, no memory traffic) for every instruction set the
+//     build targets: scalar, SSE (128 bit), AVX2 (256 bit), AVX-512 (512
+//     bit), on one core and on all OpenMP threads;
+//   - triad bandwidth (a = b + s*c, STREAM counting) with working sets that
+//     sit in L1, L2, L3 and DRAM, again on one core and on all threads. The
+//     cache sizes come from sysfs; the private levels are sized per thread.
+//
+// Build with -march=native (see Makefile): the vector kernels that the
+// compiler cannot target are skipped.
+//
+//   ./roofline_probe [out.json]        default: roofline.json
+//   python3 roofline.py roofline.json
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int chains = 12;            // > FMA latency (4) x FMA ports (2)
+constexpr double min_seconds = 0.05;
+
+void die(const char* message) {
+    std::fprintf(stderr, "%s\n", message);
+    std::exit(EXIT_FAILURE);
+}
+
+/* ========================================================================== */
+/* Peak                                                                       */
+/* ========================================================================== */
+
+/* One register type: width doubles, fmadd, and a horizontal sum for the
+   result that keeps the loop alive. */
+struct scalar_fma {
+    using reg = __m128d;
+    static constexpr int width = 1;
+    static constexpr const char* name = "scalar";
+    static reg set1(double x) { return _mm_set_sd(x); }
+    static reg fmadd(reg a, reg b, reg c) {
+#ifdef __FMA__
+        return _mm_fmadd_sd(a, b, c);
+#else
+        return _mm_add_sd(_mm_mul_sd(a, b), c);
+#endif
+    }
+    static double sum(reg a) { return _mm_cvtsd_f64(a); }
+};
+
+struct sse_fma {
+    using reg = __m128d;
+    static constexpr int width = 2;
+    static constexpr const char* name = "sse";
+    static reg set1(double x) { return _mm_set1_pd(x); }
+    static reg fmadd(reg a, reg b, reg c) {
+#ifdef __FMA__
+        return _mm_fmadd_pd(a, b, c);
+#else
+        return _mm_add_pd(_mm_mul_pd(a, b), c);
+#endif
+    }
+    static double sum(reg a) { return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a))); }
+};
+
+#if defined(__AVX2__) && defined(__FMA__)
+struct avx2_fma {
+    using reg = __m256d;
+    static constexpr int width = 4;
+    static constexpr const char* name = "avx2";
+    static reg set1(double x) { return _mm256_set1_pd(x); }
+    static reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+    static double sum(reg a) {
+        return sse_fma::sum(_mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1)));
+    }
+};
+#endif
+
+#ifdef __AVX512F__
+struct avx512_fma {
+    using reg = __m512d;
+    static constexpr int width = 8;
+    static constexpr const char* name = "avx512";
+    static reg set1(double x) { return _mm512_set1_pd(x); }
+    static reg fmadd(reg a, reg b, reg c) { return _mm512_fmadd_pd(a, b, c); }
+    static double sum(reg a) {
+        alignas(64) double v[8];
+        _mm512_store_pd(v, a);
+        return v[0] + v[1] + v[2] + v[3] + v[4] + v[5] + v[6] + v[7];
+    }
+};
+#endif
+
+template <class V>
+__attribute__((noinline)) double fma_loop(long iterations, double seed) {
+    typename V::reg acc[chains];
+    const typename V::reg x = V::set1(1. - 1.e-12 * seed), y = V::set1(1.e-12 * seed);
+    for (int c = 0; c < chains; ++c) acc[c] = V::set1(c);
+    for (long it = 0; it < iterations; ++it) {
+        for (int c = 0; c < chains; ++c) acc[c] = V::fmadd(acc[c], x, y);
+    }
+    double s = 0.;
+    for (int c = 0; c < chains; ++c) s += V::sum(acc[c]);
+    return s;
+}
+
+volatile double sink;
+
+/* Gflop/s of `threads` threads running the loop at the same time, best of
+   three runs after calibration. */
+template <class V>
+double peak(int threads) {
+    long iterations = 1 << 16;
+    double best = 0.;
+    for (int run = 0; run < 4; ) {
+        double s = 0.;
+        double t = omp_get_wtime();
+        #pragma omp parallel num_threads(threads) reduction(+:s)
+        s += fma_loop<V>(iterations, 1. + omp_get_thread_num());
+        t = omp_get_wtime() - t;
+        sink = s;
+        if (t < min_seconds) {
+            iterations *= 2;
+            continue;
+        }
+        if (run++ > 0) best = std::max(best, 2.e-9 * V::width * chains * iterations * threads / t);
+    }
+    return best;
+}
+
+/* ========================================================================== */
+/* Bandwidth                                                                  */
+/* ========================================================================== */
+
+struct cache_level {
+    int level;
+    long bytes;
+    bool shared;   // shared by more than one CPU
+};
+
+long parse_size(const std::string& s) {
+    long v = std::atol(s.c_str());
+    if (s.find('K') != std::string::npos) v <<= 10;
+    if (s.find('M') != std::string::npos) v <<= 20;
+    return v;
+}
+
+/* Data and unified caches of CPU 0. */
+std::vector<cache_level> sysfs_caches() {
+    std::vector<cache_level> caches;
+    for (int index = 0; index < 8; ++index) {
+        const std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+        std::ifstream level(dir + "level"), type(dir + "type"), size(dir + "size"),
+                      shared(dir + "shared_cpu_list");
+        if (!level) break;
+        cache_level c;
+        std::string t, s, cpus;
+        level >> c.level;
+        type >> t;
+        size >> s;
+        shared >> cpus;
+        if (t == "Instruction") continue;
+        c.bytes = parse_size(s);
+        c.shared = cpus.find_first_of(",-") != std::string::npos;
+        caches.push_back(c);
+    }
+    return caches;
+}
+
+/* Triad over `total` bytes split over `threads` threads, each on its own
+   first-touched arrays; GB/s, best of three after calibration. */
+double triad(long total, int threads) {
+    const long n = std::max(64L, total / threads / (3 * (long) sizeof(double))) / 8 * 8;
+    double best = 0.;
+    long reps = 1;
+    int run = 0;
+    double s = 0.;
+    #pragma omp parallel num_threads(threads) reduction(+:s)
+    {
+        double* a = static_cast<double*>(std::aligned_alloc(64, 3 * n * sizeof(double)));
+        if (a == nullptr) die("Failed to allocate the triad arrays.");
+        double* b = a + n;
+        double* c = b + n;
+        for (long i = 0; i < n; ++i) { a[i] = 0.; b[i] = 1.; c[i] = 2.; }
+
+        while (run < 4) {
+            #pragma omp barrier
+            double t = omp_get_wtime();
+            for (long r = 0; r < reps; ++r) {
+                const double q = 1.e-9 * r;
+                #pragma omp simd
+                for (long i = 0; i < n; ++i) a[i] = b[i] + q * c[i];
+                __asm__ __volatile__("" ::: "memory");
+            }
+            #pragma omp barrier
+            #pragma omp single
+            {
+                t = omp_get_wtime() - t;
+                if (t < min_seconds) {
+                    reps = reps * 2;
+                } else {
+                    if (run > 0) best = std::max(best, 1.e-9 * 3 * sizeof(double) * n * threads * reps / t);
+                    ++run;
+                }
+            }
+            // run and reps are read after the implicit barrier of single
+        }
+        s += a[n / 2];
+        std::free(a);
+    }
+    sink = s;
+    return best;
+}
+
+std::string cpu_model() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.rfind("model name", 0) == 0) return line.substr(line.find(':') + 2);
+    }
+    return "unknown";
+}
+
+struct peak_result {
+    std::string name;
+    int width, threads;
+    double gflops;
+};
+
+struct bw_result {
+    std::string name;
+    long bytes;
+    int threads;
+    double gbs;
+};
+
+template <class V>
+void measure_peak(std::vector<peak_result>& peaks, int threads) {
+    for (int t : {1, threads}) {
+        peaks.push_back({V::name, V::width, t, peak<V>(t)});
+        std::printf("Peak   %-8s %2d x double %4d thread(s) %10.2f Gflop/s\n",
+                    V::name, V::width, t, peaks.back().gflops);
+        std::fflush(stdout);
+        if (threads == 1) break;
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string path = argc > 1 ? argv[1] : "roofline.json";
+    const int threads = omp_get_max_threads();
+
+    std::vector<peak_result> peaks;
+    measure_peak<scalar_fma>(peaks, threads);
+    measure_peak<sse_fma>(peaks, threads);
+#if defined(__AVX2__) && defined(__FMA__)
+    measure_peak<avx2_fma>(peaks, threads);
+#endif
+#ifdef __AVX512F__
+    measure_peak<avx512_fma>(peaks, threads);
+#endif
+
+    // Half of each cache (the other half for code, stack, the other arrays'
+    // conflicts); DRAM well beyond the last level
+    std::vector<bw_result> bws;
+    std::vector<cache_level> caches = sysfs_caches();
+    long llc = 0;
+    for (const cache_level& c : caches) llc = std::max(llc, c.bytes);
+    for (int t : {1, threads}) {
+        for (const cache_level& c : caches) {
+            long total = c.bytes / 2 * (c.shared ? 1 : t);
+            bws.push_back({"L" + std::to_string(c.level), total, t, triad(total, t)});
+        }
+        long dram = std::min(std::max(4 * llc, 256L << 20), 2048L << 20);
+        bws.push_back({"DRAM", dram, t, triad(dram, t)});
+        if (threads == 1) break;
+    }
+    for (const bw_result& b : bws) {
+        std::printf("Triad  %-8s %10ld KiB %4d thread(s) %10.2f GB/s\n",
+                    b.name.c_str(), b.bytes >> 10, b.threads, b.gbs);
+    }
+
+    std::FILE* f = std::fopen(path.c_str(), "w");
+    if (f == nullptr) {
+        std::perror(path.c_str());
+        return EXIT_FAILURE;
+    }
+    std::fprintf(f, "{\n  \"cpu\": \"%s\",\n  \"threads\": %d,\n  \"peaks\": [", cpu_model().c_str(), threads);
+    for (std::size_t i = 0; i < peaks.size(); ++i) {
+        std::fprintf(f, "%s\n    {\"name\": \"%s\", \"width\": %d, \"threads\": %d, \"gflops\": %.4g}",
+                     i ? "," : "", peaks[i].name.c_str(), peaks[i].width, peaks[i].threads, peaks[i].gflops);
+    }
+    std::fprintf(f, "\n  ],\n  \"bandwidths\": [");
+    for (std::size_t i = 0; i < bws.size(); ++i) {
+        std::fprintf(f, "%s\n    {\"name\": \"%s\", \"bytes\": %ld, \"threads\": %d, \"gbs\": %.4g}",
+                     i ? "," : "", bws[i].name.c_str(), bws[i].bytes, bws[i].threads, bws[i].gbs);
+    }
+    std::fprintf(f, "\n  ]\n}\n");
+    std::fclose(f);
+    std::printf("Written to %s\n", path.c_str());
+    return 0;
+}
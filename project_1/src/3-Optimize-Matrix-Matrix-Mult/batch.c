@@ -0,0 +1,287 @@
+// batch.c
+//
+// Batched small dgemm, see batch.h. The kernels are written once as
+// always-inline bodies taking the sizes as arguments; the wrappers below
+// call them with constants, which gives one fully specialised copy per size
+// (the C counterpart of a template on the size).
+
+#include <string.h> // For: memset
+
+#include "batch.h"
+
+#define INLINE static inline __attribute__((always_inline))
+
+/* Below this many multiply-adds per call the batch stays on one thread. */
+#define MIN_PARALLEL_WORK (1L << 18)
+
+#define MAX_ROWS 32
+
+/* ========================================================================== */
+/* Kernels                                                                    */
+/* ========================================================================== */
+
+/* One column-major matrix, M <= MAX_ROWS: a column of C is accumulated in
+   registers, one column of A at a time. */
+INLINE void small_body(const int M, const int N, const int K, double alpha,
+                       const double* restrict A, int lda,
+                       const double* restrict B, int ldb,
+                       double beta, double* restrict C, int ldc) {
+  for (int j = 0; j < N; ++j) {
+    double acc[MAX_ROWS];
+    for (int i = 0; i < M; ++i) acc[i] = 0.;
+    for (int p = 0; p < K; ++p) {
+      const double b = B[p + j*ldb];
+      #pragma omp simd
+      for (int i = 0; i < M; ++i) acc[i] += A[i + p*lda] * b;
+    }
+    double* c = C + j*ldc;
+    if (beta == 0.) {
+      for (int i = 0; i < M; ++i) c[i] = alpha * acc[i];
+    } else {
+      for (int i = 0; i < M; ++i) c[i] = alpha * acc[i] + beta * c[i];
+    }
+  }
+}
+
+/* Register tile of the interleaved kernel: IB rows x JB columns of C, for
+   all lanes. With AVX-512 the 4 x 4 accumulators take 16 of the 32 vector
+   registers; AVX2 needs two registers per lane group, hence two columns. */
+#define IB 4
+#ifdef __AVX512F__
+#define JB 4
+#else
+#define JB 2
+#endif
+
+/* R x NJ block of C (R <= IB, NJ <= JB) of one group of BATCH_LANES
+   interleaved matrices; A, B and C point at its first row and column.
+   Every load of A serves NJ columns and every load of B R rows. */
+INLINE void interleaved_tile(const int R, const int NJ, const int M, const int K,
+                             double alpha, const double* restrict A,
+                             const double* restrict B, double beta,
+                             double* restrict C) {
+  const int W = BATCH_LANES;
+  double acc[IB][JB][BATCH_LANES];
+  for (int r = 0; r < R; ++r) {
+    for (int c = 0; c < NJ; ++c) {
+      for (int l = 0; l < W; ++l) acc[r][c][l] = 0.;
+    }
+  }
+  for (int p = 0; p < K; ++p) {
+    for (int c = 0; c < NJ; ++c) {
+      const double* b = B + (p + c*K) * W;
+      for (int r = 0; r < R; ++r) {
+        const double* a = A + (r + p*M) * W;
+        #pragma omp simd
+        for (int l = 0; l < W; ++l) acc[r][c][l] += a[l] * b[l];
+      }
+    }
+  }
+  for (int c = 0; c < NJ; ++c) {
+    for (int r = 0; r < R; ++r) {
+      double* cc = C + (r + c*M) * W;
+      if (beta == 0.) {
+        #pragma omp simd
+        for (int l = 0; l < W; ++l) cc[l] = alpha * acc[r][c][l];
+      } else {
+        #pragma omp simd
+        for (int l = 0; l < W; ++l) cc[l] = alpha * acc[r][c][l] + beta * cc[l];
+      }
+    }
+  }
+}
+
+/* One group of BATCH_LANES interleaved matrices: every operation is on the
+   same element of all lanes. The row blocks are the outer loop, so the IB
+   rows of A (IB * K * BATCH_LANES doubles, 8 KiB at size 32) stay in L1
+   while all the columns of B go past them; C is computed in IB x JB
+   register tiles. */
+INLINE void interleaved_body(const int M, const int N, const int K,
+                             double alpha, const double* restrict A,
+                             const double* restrict B, double beta,
+                             double* restrict C) {
+  const int W = BATCH_LANES;
+  for (int i0 = 0; i0 < M; i0 += IB) {
+    const int rows = (M - i0 < IB) ? M - i0 : IB;
+    const double* a = A + i0 * W;
+    int j0 = 0;
+    for (; j0 + JB <= N; j0 += JB) {
+      const double* b = B + j0 * K * W;
+      double* c = C + (i0 + j0*M) * W;
+      if (rows == IB) interleaved_tile(IB, JB, M, K, alpha, a, b, beta, c);
+      else            interleaved_tile(rows, JB, M, K, alpha, a, b, beta, c);
+    }
+    if (j0 < N) {
+      interleaved_tile(rows, N - j0, M, K, alpha, a, B + j0 * K * W, beta,
+                       C + (i0 + j0*M) * W);
+    }
+  }
+}
+
+typedef void (*small_kernel)(double alpha, const double* A, int lda,
+                             const double* B, int ldb,
+                             double beta, double* C, int ldc);
+typedef void (*interleaved_kernel)(double alpha, const double* A,
+                                   const double* B, double beta, double* C);
+
+#define SPECIALISE(S)                                                       \
+  static void small_##S(double alpha, const double* A, int lda,             \
+                        const double* B, int ldb,                           \
+                        double beta, double* C, int ldc) {                  \
+    small_body(S, S, S, alpha, A, lda, B, ldb, beta, C, ldc);               \
+  }                                                                         \
+  static void interleaved_##S(double alpha, const double* A,                \
+                              const double* B, double beta, double* C) {    \
+    interleaved_body(S, S, S, alpha, A, B, beta, C);                        \
+  }
+
+SPECIALISE(4)
+SPECIALISE(6)
+SPECIALISE(8)
+SPECIALISE(12)
+SPECIALISE(16)
+SPECIALISE(20)
+SPECIALISE(24)
+SPECIALISE(32)
+
+static const struct {
+  int                size;
+  small_kernel       small;
+  interleaved_kernel interleaved;
+} specialised[] = {
+  { 4, small_4,  interleaved_4},
+  { 6, small_6,  interleaved_6},
+  { 8, small_8,  interleaved_8},
+  {12, small_12, interleaved_12},
+  {16, small_16, interleaved_16},
+  {20, small_20, interleaved_20},
+  {24, small_24, interleaved_24},
+  {32, small_32, interleaved_32},
+};
+
+static int find_specialised(int m, int n, int k) {
+  if (m != n || n != k) return -1;
+  for (int s = 0; s < (int) (sizeof(specialised) / sizeof(specialised[0])); ++s) {
+    if (specialised[s].size == m) return s;
+  }
+  return -1;
+}
+
+/* Any shape: row blocks of at most MAX_ROWS through the runtime-size body. */
+static void generic_small(int m, int n, int k, double alpha,
+                          const double* A, int lda, const double* B, int ldb,
+                          double beta, double* C, int ldc) {
+  for (int i0 = 0; i0 < m; i0 += MAX_ROWS) {
+    int rows = (m - i0 < MAX_ROWS) ? m - i0 : MAX_ROWS;
+    small_body(rows, n, k, alpha, A + i0, lda, B, ldb, beta, C + i0, ldc);
+  }
+}
+
+static void generic_interleaved(int m, int n, int k, double alpha,
+                                const double* A, const double* B,
+                                double beta, double* C) {
+  interleaved_body(m, n, k, alpha, A, B, beta, C);
+}
+
+/* ========================================================================== */
+/* Batched API                                                                */
+/* ========================================================================== */
+
+void dgemm_batch(int m, int n, int k, double alpha,
+                 const double* const* A, int lda,
+                 const double* const* B, int ldb,
+                 double beta, double* const* C, int ldc, int batch) {
+  if (m <= 0 || n <= 0 || batch <= 0) return;
+  const int s = find_specialised(m, n, k);
+  const long work = (long) batch * m * n * (k > 0 ? k : 1);
+
+  #pragma omp parallel for schedule(static) if (work >= MIN_PARALLEL_WORK)
+  for (int b = 0; b < batch; ++b) {
+    if (s >= 0) specialised[s].small(alpha, A[b], lda, B[b], ldb, beta, C[b], ldc);
+    else        generic_small(m, n, k, alpha, A[b], lda, B[b], ldb, beta, C[b], ldc);
+  }
+}
+
+void dgemm_batch_strided(int m, int n, int k, double alpha,
+                         const double* A, int lda, long strideA,
+                         const double* B, int ldb, long strideB,
+                         double beta, double* C, int ldc, long strideC,
+                         int batch) {
+  if (m <= 0 || n <= 0 || batch <= 0) return;
+  const int s = find_specialised(m, n, k);
+  const long work = (long) batch * m * n * (k > 0 ? k : 1);
+
+  #pragma omp parallel for schedule(static) if (work >= MIN_PARALLEL_WORK)
+  for (int b = 0; b < batch; ++b) {
+    const double* a = A + b * strideA;
+    const double* bb = B + b * strideB;
+    double* c = C + b * strideC;
+    if (s >= 0) specialised[s].small(alpha, a, lda, bb, ldb, beta, c, ldc);
+    else        generic_small(m, n, k, alpha, a, lda, bb, ldb, beta, c, ldc);
+  }
+}
+
+/* ========================================================================== */
+/* Interleaved layout                                                         */
+/* ========================================================================== */
+
+long batch_interleaved_size(int rows, int cols, int batch) {
+  long groups = (batch + BATCH_LANES - 1) / BATCH_LANES;
+  return groups * rows * cols * BATCH_LANES;
+}
+
+void batch_interleave(int rows, int cols, const double* X, int ldx,
+                      long strideX, int batch, double* Xi) {
+  const int W = BATCH_LANES;
+  const int groups = (batch + W - 1) / W;
+  const long group_size = (long) rows * cols * W;
+
+  #pragma omp parallel for schedule(static) if ((long) batch * rows * cols >= MIN_PARALLEL_WORK)
+  for (int g = 0; g < groups; ++g) {
+    double* xi = Xi + g * group_size;
+    const int lanes = (batch - g*W < W) ? batch - g*W : W;
+    if (lanes < W) memset(xi, 0, group_size * sizeof(double));
+    for (int l = 0; l < lanes; ++l) {
+      const double* x = X + (long) (g*W + l) * strideX;
+      for (int j = 0; j < cols; ++j) {
+        for (int i = 0; i < rows; ++i) xi[(i + j*rows) * W + l] = x[i + j*ldx];
+      }
+    }
+  }
+}
+
+void batch_deinterleave(int rows, int cols, const double* Xi, double* X,
+                        int ldx, long strideX, int batch) {
+  const int W = BATCH_LANES;
+  const int groups = (batch + W - 1) / W;
+  const long group_size = (long) rows * cols * W;
+
+  #pragma omp parallel for schedule(static) if ((long) batch * rows * cols >= MIN_PARALLEL_WORK)
+  for (int g = 0; g < groups; ++g) {
+    const double* xi = Xi + g * group_size;
+    const int lanes = (batch - g*W < W) ? batch - g*W : W;
+    for (int l = 0; l < lanes; ++l) {
+      double* x = X + (long) (g*W + l) * strideX;
+      for (int j = 0; j < cols; ++j) {
+        for (int i = 0; i < rows; ++i) x[i + j*ldx] = xi[(i + j*rows) * W + l];
+      }
+    }
+  }
+}
+
+void dgemm_batch_interleaved(int m, int n, int k, double alpha,
+                             const double* Ai, const double* Bi,
+                             double beta, double* Ci, int batch) {
+  if (m <= 0 || n <= 0 || batch <= 0) return;
+  const int W = BATCH_LANES;
+  const int groups = (batch + W - 1) / W;
+  const long sa = (long) m * k * W, sb = (long) k * n * W, sc = (long) m * n * W;
+  const int s = find_specialised(m, n, k);
+  const long work = (long) batch * m * n * (k > 0 ? k : 1);
+
+  #pragma omp parallel for schedule(static) if (work >= MIN_PARALLEL_WORK)
+  for (int g = 0; g < groups; ++g) {
+    if (s >= 0) specialised[s].interleaved(alpha, Ai + g*sa, Bi + g*sb, beta, Ci + g*sc);
+    else        generic_interleaved(m, n, k, alpha, Ai + g*sa, Bi + g*sb, beta, Ci + g*sc);
+  }
+}
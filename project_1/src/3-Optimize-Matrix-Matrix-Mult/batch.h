@@ -0,0 +1,60 @@
+// batch.h
+//
+// Batched dgemm for many small matrices (a few to a few tens of rows), where
+// one call per matrix is dominated by call and packing overhead. Square
+// sizes 4, 6, 8, 12, 16, 20, 24 and 32 have kernels with the sizes fixed at
+// compile time, so the compiler fully unrolls and vectorises them; other
+// shapes go through a generic loop nest. The batch is split over OpenMP
+// threads.
+//
+// All operations are
+//
+//   C[b] := alpha * A[b] * B[b] + beta * C[b],   b = 0, ..., batch-1
+//
+// with m x k A[b], k x n B[b] and m x n C[b], column-major, no transposes.
+// C[b] is not read when beta = 0.
+
+#ifndef BATCH_H
+#define BATCH_H
+
+/* Matrices per group in the interleaved layout: one AVX-512 register of
+   doubles, two AVX2 registers. */
+#define BATCH_LANES 8
+
+/* Uniform batch given as arrays of pointers. */
+void dgemm_batch(int m, int n, int k, double alpha,
+                 const double* const* A, int lda,
+                 const double* const* B, int ldb,
+                 double beta, double* const* C, int ldc, int batch);
+
+/* Uniform batch with A[b] = A + b * strideA, and so on. */
+void dgemm_batch_strided(int m, int n, int k, double alpha,
+                         const double* A, int lda, long strideA,
+                         const double* B, int ldb, long strideB,
+                         double beta, double* C, int ldc, long strideC,
+                         int batch);
+
+/* Interleaved layout: the batch is cut in groups of BATCH_LANES matrices and
+ * element (i, j) of the matrices of one group is stored contiguously,
+ *
+ *   X_group[(i + j*rows) * BATCH_LANES + lane],
+ *
+ * so one SIMD instruction works on the same element of 8 matrices. Groups
+ * follow each other (rows * cols * BATCH_LANES doubles each); the last
+ * group is padded with zero matrices. This is the layout to keep the data
+ * in when the same small products are repeated, e.g. per element.
+ */
+long batch_interleaved_size(int rows, int cols, int batch);
+
+/* Copies a strided batch into / out of the interleaved layout. */
+void batch_interleave(int rows, int cols, const double* X, int ldx,
+                      long strideX, int batch, double* Xi);
+void batch_deinterleave(int rows, int cols, const double* Xi, double* X,
+                        int ldx, long strideX, int batch);
+
+/* dgemm on a batch in the interleaved layout. */
+void dgemm_batch_interleaved(int m, int n, int k, double alpha,
+                             const double* Ai, const double* Bi,
+                             double beta, double* Ci, int batch);
+
+#endif // BATCH_H
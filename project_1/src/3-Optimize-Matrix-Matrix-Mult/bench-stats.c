@@ -0,0 +1,110 @@
+// bench-stats.c
+//
+// Peak measurement and summary statistics for the statistics mode of benchmark.c, see bench-stats.h.
+
+#define _GNU_SOURCE
+#include <math.h>   // For: sqrt
+#include <stdint.h>
+#include <stdlib.h> // For: qsort
+#include <string.h> // For: memset
+#include <time.h>   // For: clock_gettime
+
+#include "bench-stats.h"
+
+/* ========================================================================== */
+/* Peak                                                                       */
+/* ========================================================================== */
+
+#if defined(__AVX512F__)
+#define PEAK_WIDTH 8
+#elif defined(__AVX__)
+#define PEAK_WIDTH 4
+#else
+#define PEAK_WIDTH 2
+#endif
+
+/* Enough independent chains to cover FMA latency x FMA units (4 x 2 on
+   current x86) with some margin, few enough to stay in registers. */
+#define PEAK_CHAINS 12
+
+typedef double peak_vec __attribute__((vector_size(8 * PEAK_WIDTH)));
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return 1.*t.tv_sec + 1.e-9*t.tv_nsec;
+}
+
+__attribute__((noinline))
+static double fma_loop(long iterations, double seed) {
+  peak_vec acc[PEAK_CHAINS], x, y;
+  for (int l = 0; l < PEAK_WIDTH; ++l) {
+    x[l] = 1. - 1.e-9 * seed;
+    y[l] = 1.e-9 * seed;
+  }
+  for (int c = 0; c < PEAK_CHAINS; ++c) acc[c] = x * (double) c;
+
+  for (long it = 0; it < iterations; ++it) {
+    for (int c = 0; c < PEAK_CHAINS; ++c) acc[c] = acc[c] * x + y;
+  }
+
+  double sum = 0.;
+  for (int c = 0; c < PEAK_CHAINS; ++c) {
+    for (int l = 0; l < PEAK_WIDTH; ++l) sum += acc[c][l];
+  }
+  return sum;
+}
+
+int bench_simd_width(void) {
+  return PEAK_WIDTH;
+}
+
+/* Best of a few runs of at least 50 ms each, after a warm-up that lets the
+   clock reach its turbo frequency. */
+double bench_peak_gflops(void) {
+  volatile double sink = 0.;
+  sink += fma_loop(1L << 22, 1.);
+
+  long iterations = 1L << 20;
+  double seconds = 0.;
+  while ((seconds = -now(), sink += fma_loop(iterations, 2.), seconds += now()) < 0.05) {
+    iterations *= 2;
+  }
+
+  double best = 0.;
+  for (int r = 0; r < 5; ++r) {
+    seconds = -now();
+    sink += fma_loop(iterations, 3. + r);
+    seconds += now();
+    double gflops = 2.e-9 * PEAK_WIDTH * PEAK_CHAINS * iterations / seconds;
+    if (gflops > best) best = gflops;
+  }
+  (void) sink;
+  return best;
+}
+
+/* ========================================================================== */
+/* Statistics                                                                 */
+/* ========================================================================== */
+
+static int compare_double(const void* a, const void* b) {
+  double x = *(const double*) a, y = *(const double*) b;
+  return (x > y) - (x < y);
+}
+
+bench_summary bench_summarize(double* samples, int n) {
+  bench_summary s;
+  memset(&s, 0, sizeof(s));
+  if (n <= 0) return s;
+
+  qsort(samples, n, sizeof(double), compare_double);
+  s.min = samples[0];
+  s.max = samples[n - 1];
+  s.median = (n % 2) ? samples[n/2] : 0.5 * (samples[n/2 - 1] + samples[n/2]);
+
+  for (int i = 0; i < n; ++i) s.mean += samples[i];
+  s.mean /= n;
+  for (int i = 0; i < n; ++i) s.stddev += (samples[i] - s.mean) * (samples[i] - s.mean);
+  s.stddev = (n > 1) ? sqrt(s.stddev / (n - 1)) : 0.;
+  return s;
+}
@@ -0,0 +1,31 @@
+// bench-stats.h
+//
+// Support for the statistics mode of benchmark.c (./benchmark-... stats):
+// peak Gflop/s of this machine measured with a register-only FMA loop,
+// and summary statistics over repeated timings. The hardware counters are
+// those of common/perfcount.
+
+#ifndef BENCH_STATS_H
+#define BENCH_STATS_H
+
+#include <stdio.h>
+
+/* Peak double precision Gflop/s of one core: independent FMA chains on the
+   widest vector type enabled at compile time (-march=native). */
+double bench_peak_gflops(void);
+
+/* Vector width in doubles used by bench_peak_gflops. */
+int bench_simd_width(void);
+
+typedef struct {
+  double median;
+  double min;
+  double max;
+  double mean;
+  double stddev;
+} bench_summary;
+
+/* Summary of n samples; the samples are sorted in place. */
+bench_summary bench_summarize(double* samples, int n);
+
+#endif // BENCH_STATS_H
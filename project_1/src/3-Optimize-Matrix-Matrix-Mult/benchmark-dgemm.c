@@ -0,0 +1,326 @@
+#include <stdlib.h> // For: exit, drand48, malloc, free, NULL, EXIT_FAILURE
+#include <stdio.h>  // For: perror
+#include <string.h> // For: memcpy, strcmp
+
+#include <float.h>  // For: DBL_EPSILON
+#include <math.h>   // For: fabs, NAN
+
+#include <time.h> // For struct timespec, clock_gettime, CLOCK_MONOTONIC
+
+#include "dgemm-packed.h"
+#include "batch.h"
+
+// On icsmaster
+// 2.3 GHz * 8 vector width * 2 flops for FMA = 36.8 GF/s
+#define MAX_SPEED 36.8
+
+/* Benchmark and check of the BLAS-style hpc_dgemm on rectangular and
+   transposed shapes. The reference is a plain loop nest, so this program
+   does not need MKL or any other BLAS. */
+
+typedef struct {
+  int    M, N, K;
+  char   transA, transB;
+  double alpha, beta;
+  int    pad; // extra rows in every leading dimension
+} shape;
+
+double wall_time() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return 1.*t.tv_sec + 1.e-9*t.tv_nsec;
+}
+
+void die(const char* message) {
+  perror (message);
+  exit (EXIT_FAILURE);
+}
+
+void fill(double* p, int n) {
+  for (int i = 0; i < n; ++i) {
+    p[i] = 2. * drand48() - 1.; // Uniformly distributed over [-1, 1]
+  }
+}
+
+static int is_trans(char trans) {
+  return trans == 'T' || trans == 't' || trans == 'C' || trans == 'c';
+}
+
+/* Element (i, p) of op(X) for a column-major X with leading dimension ld. */
+static double op(const double* X, int ld, char trans, int i, int p) {
+  return is_trans(trans) ? X[p + (long) i * ld] : X[i + (long) p * ld];
+}
+
+/* C := alpha * op(A) * op(B) + beta * C by definition, and the
+   componentwise error bound
+   bound := 3 * e_mach * (K + 2) * (|alpha| |op(A)| |op(B)| + |beta| |C|). */
+void reference_dgemm(const shape* s, const double* A, int lda,
+                     const double* B, int ldb, double* C, double* bound,
+                     int ldc) {
+  for (int j = 0; j < s->N; ++j) {
+    for (int i = 0; i < s->M; ++i) {
+      double cij = 0., aij = 0.;
+      for (int p = 0; p < s->K; ++p) {
+        double prod = op(A, lda, s->transA, i, p) * op(B, ldb, s->transB, p, j);
+        cij += prod;
+        aij += fabs(prod);
+      }
+      double c0 = (s->beta == 0.) ? 0. : C[i + (long) j * ldc];
+      C[i + (long) j * ldc] = s->alpha * cij + s->beta * c0;
+      bound[i + (long) j * ldc] = 3. * DBL_EPSILON * (s->K + 2)
+                                * (fabs(s->alpha) * aij + fabs(s->beta * c0));
+    }
+  }
+}
+
+/* ========================================================================== */
+/* Batched small matrices: ./benchmark-dgemm batch [count]                    */
+/* ========================================================================== */
+
+enum batch_mode { PER_CALL, POINTERS, STRIDED, INTERLEAVED, NMODES };
+
+/* The same batch in the three forms of batch.h: contiguous matrices (also
+   the strided form), pointers to them, and interleaved copies. */
+typedef struct {
+  const double *A, *B;
+  double *C;
+  const double **Ap, **Bp;
+  double **Cp;
+  const double *Ai, *Bi;
+  double *Ci;
+} batch_data;
+
+/* One pass over the batch with the given method. */
+void run_batch(enum batch_mode mode, int s, int count, double alpha, double beta,
+               const batch_data* d) {
+  long ss = (long) s * s;
+  const double *A = d->A, *B = d->B, *Ai = d->Ai, *Bi = d->Bi;
+  double *C = d->C, *Ci = d->Ci;
+  switch (mode) {
+  case PER_CALL:
+    for (int b = 0; b < count; ++b) {
+      hpc_dgemm('N', 'N', s, s, s, alpha, A + b*ss, s, B + b*ss, s,
+                beta, C + b*ss, s);
+    }
+    break;
+  case POINTERS:
+    dgemm_batch(s, s, s, alpha, d->Ap, s, d->Bp, s, beta, d->Cp, s, count);
+    break;
+  case STRIDED:
+    dgemm_batch_strided(s, s, s, alpha, A, s, ss, B, s, ss, beta, C, s, ss, count);
+    break;
+  case INTERLEAVED:
+    dgemm_batch_interleaved(s, s, s, alpha, Ai, Bi, beta, Ci, count);
+    break;
+  default:
+    break;
+  }
+}
+
+/* Gflop/s of one method, timed as in benchmark.c. */
+double time_batch(enum batch_mode mode, int s, int count, double alpha, double beta,
+                  const batch_data* d) {
+  double Gflops_s, seconds = -1.0;
+  double timeout = 0.1;
+  for (int n_iterations = 1; seconds < timeout; n_iterations *= 2) {
+    run_batch(mode, s, count, alpha, beta, d);
+
+    seconds = -wall_time();
+    for (int it = 0; it < n_iterations; ++it) {
+      run_batch(mode, s, count, alpha, beta, d);
+    }
+    seconds += wall_time();
+
+    Gflops_s = 2.e-9 * n_iterations * count * s * s * s / seconds;
+  }
+  return Gflops_s;
+}
+
+/* For every small size: one hpc_dgemm call per matrix, dgemm_batch on
+   pointer arrays, dgemm_batch_strided and dgemm_batch_interleaved (data kept
+   interleaved, conversion not timed), each checked against the loop nest. By default the batch holds about 32
+   MiB of matrices. */
+int batch_benchmark(int fixed_count) {
+  printf("# Description:\tbatched small dgemm (%d matrices per group).\n\n",
+         BATCH_LANES);
+
+  int sizes[] = {4, 5, 6, 8, 12, 16, 20, 24, 32};
+  int nsizes = sizeof(sizes)/sizeof(sizes[0]);
+  const double alpha = 1.5, beta = 0.5;
+
+  for (int is = 0; is < nsizes; ++is) {
+    int s = sizes[is];
+    long ss = (long) s * s;
+    int count = fixed_count > 0 ? fixed_count : (int) ((4L << 20) / (3 * ss));
+
+    long size_i = batch_interleaved_size(s, s, count);
+    double* buf = (double*) malloc((4 * ss * count + 3 * size_i) * sizeof(double));
+    double** ptrs = (double**) malloc(3 * count * sizeof(double*));
+    if (buf == NULL || ptrs == NULL) die("Failed to allocate batch.\n");
+    double* A = buf;
+    double* B = A + ss * count;
+    double* C = B + ss * count;
+    double* Cref = C + ss * count;
+    double* Ai = Cref + ss * count;
+    double* Bi = Ai + size_i;
+    double* Ci = Bi + size_i;
+    fill(A, ss * count);
+    fill(B, ss * count);
+    fill(C, ss * count);
+    batch_interleave(s, s, A, s, ss, count, Ai);
+    batch_interleave(s, s, B, s, ss, count, Bi);
+    batch_interleave(s, s, C, s, ss, count, Ci);
+    for (int b = 0; b < count; ++b) {
+      ptrs[b] = A + b*ss;
+      ptrs[count + b] = B + b*ss;
+      ptrs[2*count + b] = C + b*ss;
+    }
+    batch_data d = {A, B, C, (const double**) ptrs, (const double**) ptrs + count,
+                    ptrs + 2*count, Ai, Bi, Ci};
+
+    double rate[NMODES];
+    for (int mode = PER_CALL; mode < NMODES; ++mode) {
+      rate[mode] = time_batch(mode, s, count, alpha, beta, &d);
+    }
+    printf("Size: %4d\tBatch: %8d\tPer call Gflop/s: %8.2f\tPointers: %8.2f"
+           "\tStrided: %8.2f\tInterleaved: %8.2f\n",
+           s, count, rate[PER_CALL], rate[POINTERS], rate[STRIDED], rate[INTERLEAVED]);
+
+    /* One more pass of each method from the same C, against the
+       reference */
+    shape sh = {s, s, s, 'N', 'N', alpha, beta, 0};
+    double bound[32 * 32];
+    for (int mode = PER_CALL; mode < NMODES; ++mode) {
+      fill(C, ss * count);
+      memcpy(Cref, C, ss * count * sizeof(double));
+      batch_interleave(s, s, C, s, ss, count, Ci);
+      run_batch(mode, s, count, alpha, beta, &d);
+      if (mode == INTERLEAVED) batch_deinterleave(s, s, Ci, C, s, ss, count);
+
+      for (int b = 0; b < count; b += (count > 1000 ? count / 1000 : 1)) {
+        reference_dgemm(&sh, A + b*ss, s, B + b*ss, s, Cref + b*ss, bound, s);
+        for (long ij = 0; ij < ss; ++ij) {
+          if (!(fabs(C[b*ss + ij] - Cref[b*ss + ij]) <= bound[ij]))
+            die("Error in batched multiply exceeds componentwise error bounds.\n");
+        }
+      }
+    }
+
+    free(ptrs);
+    free(buf);
+  }
+  return 0;
+}
+
+/* The benchmarking program */
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "batch") == 0) {
+    return batch_benchmark(argc > 2 ? atoi(argv[2]) : 0);
+  }
+
+  printf("# Description:\thpc_dgemm on rectangular and transposed shapes.\n\n");
+
+  /* Square products with every transpose combination, then the shapes our
+     codes actually produce: tall and wide blocks, rank-k updates, inner
+     products, matrix-vector and odd sizes with padded leading dimensions. */
+  shape shapes[] = {
+    { 800,  800,  800, 'N', 'N',  1.0, 1.0, 0},
+    { 800,  800,  800, 'T', 'N',  1.0, 1.0, 0},
+    { 800,  800,  800, 'N', 'T',  1.0, 1.0, 0},
+    { 800,  800,  800, 'T', 'T',  1.0, 1.0, 0},
+    {4000,  200,  500, 'N', 'N',  1.0, 1.0, 0},
+    { 200, 4000,  500, 'N', 'N',  1.0, 1.0, 0},
+    {1000, 1000,   64, 'N', 'T', -1.0, 1.0, 0},
+    {  64,   64, 4000, 'T', 'N',  1.0, 0.0, 0},
+    {   1, 1000, 1000, 'N', 'N',  1.0, 0.0, 0},
+    {1000,    1, 1000, 'T', 'N',  2.0, 0.5, 0},
+    { 777,  333,  555, 'T', 'T',  0.5, -2.0, 3},
+    {  31, 1001,  257, 'N', 'T',  1.0, 0.0, 17},
+    { 513,  511,  509, 'N', 'N',  1.0, 1.0, 1},
+  };
+  int nshapes = sizeof(shapes)/sizeof(shapes[0]);
+
+  /* Invalid arguments are rejected, not computed. */
+  if (hpc_dgemm('X', 'N', 1, 1, 1, 1., NULL, 1, NULL, 1, 0., NULL, 1) != -1 ||
+      hpc_dgemm('N', 'N', 4, 1, 1, 1., NULL, 3, NULL, 1, 0., NULL, 4) != -8)
+    die("hpc_dgemm does not check its arguments.\n");
+
+  double avg_perf = 0.;
+
+  for (int is = 0; is < nshapes; ++is) {
+    const shape* s = &shapes[is];
+
+    int rowsA = is_trans(s->transA) ? s->K : s->M;
+    int colsA = is_trans(s->transA) ? s->M : s->K;
+    int rowsB = is_trans(s->transB) ? s->N : s->K;
+    int colsB = is_trans(s->transB) ? s->K : s->N;
+    int lda = rowsA + s->pad, ldb = rowsB + s->pad, ldc = s->M + s->pad;
+
+    long sizeA = (long) lda * colsA, sizeB = (long) ldb * colsB;
+    long sizeC = (long) ldc * s->N;
+    double* buf = (double*) malloc((sizeA + sizeB + 3 * sizeC) * sizeof(double));
+    if (buf == NULL) die("Failed to allocate problem.\n");
+    double* A = buf;
+    double* B = A + sizeA;
+    double* C = B + sizeB;
+    double* Cref = C + sizeC;
+    double* bound = Cref + sizeC;
+    fill(A, sizeA);
+    fill(B, sizeB);
+    fill(C, sizeC);
+
+    /* Measure performance (in Gflops/s), as in benchmark.c. */
+    double Gflops_s, seconds = -1.0;
+    double timeout = 0.1;
+    for (int n_iterations = 1; seconds < timeout; n_iterations *= 2) {
+      hpc_dgemm(s->transA, s->transB, s->M, s->N, s->K, s->alpha, A, lda,
+                B, ldb, s->beta, C, ldc);
+
+      seconds = -wall_time();
+      for (int it = 0; it < n_iterations; ++it) {
+        hpc_dgemm(s->transA, s->transB, s->M, s->N, s->K, s->alpha, A, lda,
+                  B, ldb, s->beta, C, ldc);
+      }
+      seconds += wall_time();
+
+      Gflops_s = 2.e-9 * n_iterations * s->M * s->N * s->K / seconds;
+    }
+    printf("Shape: %5d x %5d x %5d\top: %c%c\tGflop/s: %8.2f\tPercentage:%8.2lf\n",
+           s->M, s->N, s->K, s->transA, s->transB,
+           Gflops_s, Gflops_s*100/MAX_SPEED);
+    avg_perf += Gflops_s*100/MAX_SPEED;
+
+    /* Check one call against the reference. With beta = 0, C must not be
+       read: start from NaN and make sure none survives. */
+    fill(C, sizeC);
+    if (s->beta == 0.) {
+      for (long i = 0; i < sizeC; ++i) C[i] = NAN;
+    }
+    memcpy(Cref, C, sizeC * sizeof(double));
+
+    hpc_dgemm(s->transA, s->transB, s->M, s->N, s->K, s->alpha, A, lda,
+              B, ldb, s->beta, C, ldc);
+    reference_dgemm(s, A, lda, B, ldb, Cref, bound, ldc);
+
+    for (int j = 0; j < s->N; ++j) {
+      for (int i = 0; i < s->M; ++i) {
+        long ij = i + (long) j * ldc;
+        if (!(fabs(C[ij] - Cref[ij]) <= bound[ij]))
+          die("Error in matrix multiply exceeds componentwise error bounds.\n");
+      }
+      /* The padding rows of C belong to the caller. */
+      for (int i = s->M; i < ldc; ++i) {
+        long ij = i + (long) j * ldc;
+        if (!(C[ij] == Cref[ij]) && !(isnan(C[ij]) && isnan(Cref[ij])))
+          die("hpc_dgemm wrote outside of C.\n");
+      }
+    }
+
+    free(buf);
+  }
+
+  avg_perf /= nshapes;
+  printf("# Average percentage of peak performance = %g\n", avg_perf);
+
+  return 0;
+}
@@ -0,0 +1,171 @@
+// benchmark-gemm.cpp
+//
+// Benchmark of the templated gemm (gemm.hpp) in the four precisions, in the
+// format of benchmark.c. The percentage is of the peak of each type: single
+// precision has twice the SIMD lanes of double precision, and a complex
+// multiply-add is four real FMAs counted as 8 flops, so complex types share
+// the peak of their real type.
+//
+//   ./benchmark-gemm [n ...]
+
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include <time.h> // For struct timespec, clock_gettime, CLOCK_MONOTONIC
+
+#include "gemm.hpp"
+
+// On icsmaster
+// 2.3 GHz * 8 vector width * 2 flops for FMA = 36.8 GF/s (double)
+#define MAX_SPEED 36.8
+
+/* Sizes up to this are checked against the loop nest. */
+#define MAX_CHECKED 512
+
+static double wall_time() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return 1. * t.tv_sec + 1.e-9 * t.tv_nsec;
+}
+
+static void die(const char* message) {
+    std::fprintf(stderr, "%s", message);
+    std::exit(EXIT_FAILURE);
+}
+
+template <class T> struct type_info;
+template <> struct type_info<float> {
+    using real = float;
+    using wide = double;
+    static constexpr const char* name = "float (sgemm)";
+    static constexpr double flops = 2.;
+};
+template <> struct type_info<double> {
+    using real = double;
+    using wide = double;
+    static constexpr const char* name = "double (dgemm)";
+    static constexpr double flops = 2.;
+};
+template <> struct type_info<std::complex<float>> {
+    using real = float;
+    using wide = std::complex<double>;
+    static constexpr const char* name = "complex<float> (cgemm)";
+    static constexpr double flops = 8.;
+};
+template <> struct type_info<std::complex<double>> {
+    using real = double;
+    using wide = std::complex<double>;
+    static constexpr const char* name = "complex<double> (zgemm)";
+    static constexpr double flops = 8.;
+};
+
+/* Uniformly distributed over [-1, 1], in each part for complex types. */
+template <class T>
+static void fill(std::vector<T>& x) {
+    for (auto& v : x) {
+        if constexpr (type_info<T>::flops == 8.) {
+            v = T(2. * drand48() - 1., 2. * drand48() - 1.);
+        } else {
+            v = T(2. * drand48() - 1.);
+        }
+    }
+}
+
+/* Gflop/s of gemm on n x n matrices, over at least 1/10 second. */
+template <class T>
+static double time_gemm(int n, const T* A, const T* B, T* C) {
+    double Gflops_s = 0., seconds = -1.0;
+    for (int n_iterations = 1; seconds < 0.1; n_iterations *= 2) {
+        gemm::gemm(n, n, n, T(1), A, n, B, n, C, n);
+
+        seconds = -wall_time();
+        for (int it = 0; it < n_iterations; ++it) {
+            gemm::gemm(n, n, n, T(1), A, n, B, n, C, n);
+        }
+        seconds += wall_time();
+
+        Gflops_s = type_info<T>::flops * 1.e-9 * n_iterations * n * n * n / seconds;
+    }
+    return Gflops_s;
+}
+
+/* Componentwise bound |C - A*B| <= 4 * e_mach * n * |A| * |B|, with A*B and
+   |A| * |B| computed by the loop nest in double precision: 3 n e_mach as in
+   benchmark.c, plus the rounding of the reference itself for the double
+   precision types. */
+template <class T>
+static bool check(int n, const T* A, const T* B, const T* C) {
+    using W = typename type_info<T>::wide;
+    const double eps = std::numeric_limits<typename type_info<T>::real>::epsilon();
+    std::vector<W> ref(std::size_t(n) * n, W(0));
+    std::vector<double> abs(std::size_t(n) * n, 0.);
+    for (int j = 0; j < n; ++j) {
+        for (int k = 0; k < n; ++k) {
+            const W b = W(B[k + j * n]);
+            const double bb = std::abs(b);
+            for (int i = 0; i < n; ++i) {
+                ref[i + j * n] += W(A[i + k * n]) * b;
+                abs[i + j * n] += std::abs(W(A[i + k * n])) * bb;
+            }
+        }
+    }
+    for (std::size_t i = 0; i < ref.size(); ++i) {
+        if (!(std::abs(W(C[i]) - ref[i]) <= 4. * eps * n * abs[i])) return false;
+    }
+    return true;
+}
+
+template <class T>
+static double run(const std::vector<int>& sizes) {
+    const gemm::params p = gemm::default_params<T>();
+    const double peak = MAX_SPEED * 8 / sizeof(typename type_info<T>::real);
+    std::printf("# Type:\t%s\n", type_info<T>::name);
+    std::printf("# Kernel:\t%s, MC %d KC %d NC %d, peak %.1f Gflop/s\n",
+                gemm::kernel_name<T>(), p.mc, p.kc, p.nc, peak);
+
+    double avg_perf = 0.;
+    for (int n : sizes) {
+        std::vector<T> A(std::size_t(n) * n), B(A.size()), C(A.size());
+        fill(A);
+        fill(B);
+        fill(C);
+
+        double Gflops_s = time_gemm(n, A.data(), B.data(), C.data());
+        std::printf("Size: %8d\tGflop/s: %8.2f\tPercentage:%8.2lf\n",
+                    n, Gflops_s, Gflops_s * 100 / peak);
+        avg_perf += Gflops_s * 100 / peak;
+
+        if (n <= MAX_CHECKED) {
+            std::fill(C.begin(), C.end(), T(0));
+            gemm::gemm(n, n, n, T(1), A.data(), n, B.data(), n, C.data(), n);
+            if (!check(n, A.data(), B.data(), C.data()))
+                die("Error in matrix multiply exceeds componentwise error bounds.\n");
+        }
+    }
+    avg_perf /= sizes.size();
+    std::printf("# Average percentage of peak performance = %g\n\n", avg_perf);
+    return avg_perf;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> sizes = {31, 32, 96, 97, 127, 128, 129, 255, 256, 257,
+                              511, 512, 767, 768, 1000};
+    if (argc > 1) {
+        sizes.clear();
+        for (int i = 1; i < argc; ++i) {
+            sizes.push_back(std::atoi(argv[i]));
+            if (sizes.back() <= 0) die("Invalid matrix size.\n");
+        }
+    }
+
+    std::printf("# Description:\tTemplated packed gemm\n\n");
+    run<float>(sizes);
+    run<double>(sizes);
+    run<std::complex<float>>(sizes);
+    run<std::complex<double>>(sizes);
+    return 0;
+}
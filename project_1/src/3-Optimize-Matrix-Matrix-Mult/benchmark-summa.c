@@ -0,0 +1,239 @@
+#include <stdlib.h> // For: exit, malloc, free, atoi, NULL, EXIT_FAILURE
+#include <stdio.h>  // For: printf, fprintf
+#include <string.h> // For: memset, strcmp
+
+#include <float.h>  // For: DBL_EPSILON
+#include <math.h>   // For: fabs
+
+#include <mpi.h>
+
+#include "summa.h"
+
+// On icsmaster
+// 2.3 GHz * 8 vector width * 2 flops for FMA = 36.8 GF/s
+#define MAX_SPEED 36.8
+
+/* Sizes up to this are gathered on rank 0 and checked against a serial
+   loop nest. */
+#define MAX_CHECK 1000
+
+/* Parameters of the local dgemm, tuned on first use (dgemm-packed.c). */
+extern const char* dgemm_tuning(void);
+
+/* Distributed benchmark of summa_dgemm / cannon_dgemm, modelled on
+ * benchmark.c:
+ *
+ *   mpirun -n P ./benchmark-summa [summa|cannon] [nb] [n ...]
+ *
+ * reports the aggregate Gflop/s, Gflop/s per node and per rank, and the
+ * per-rank percentage of MAX_SPEED.
+ */
+
+void die(const char* message) {
+  fprintf(stderr, "%s", message);
+  MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+}
+
+/* Entry (i, j) of matrix `which`, uniformly distributed over [-1, 1] and
+   independent of the process grid, so every rank fills its own blocks. */
+double entry(int which, int i, int j) {
+  unsigned long x = (unsigned long) i * 73856093u
+                  ^ (unsigned long) j * 19349663u
+                  ^ (unsigned long) which * 83492791u;
+  x = x * 6364136223846793005ul + 1442695040888963407ul;
+  x ^= x >> 29;
+  x *= 0xbf58476d1ce4e5b9ul;
+  x ^= x >> 32;
+  return 2. * (x >> 11) * (1. / 9007199254740992.) - 1.;
+}
+
+void fill_local(const proc_grid* g, int n, int nb, int which, double* X) {
+  int mloc = numroc(n, nb, g->myrow, g->nprow);
+  int nloc = numroc(n, nb, g->mycol, g->npcol);
+  for (int lj = 0; lj < nloc; ++lj) {
+    int gj = local_to_global(lj, nb, g->mycol, g->npcol);
+    for (int li = 0; li < mloc; ++li) {
+      int gi = local_to_global(li, nb, g->myrow, g->nprow);
+      X[li + (long) lj * mloc] = entry(which, gi, gj);
+    }
+  }
+}
+
+/* Collects the distributed C on rank 0 of the grid into the n x n Cg. */
+void gather(const proc_grid* g, int n, int nb, const double* C, double* Cg) {
+  int rank, size;
+  MPI_Comm_rank(g->comm, &rank);
+  MPI_Comm_size(g->comm, &size);
+
+  int mloc = numroc(n, nb, g->myrow, g->nprow);
+  int nloc = numroc(n, nb, g->mycol, g->npcol);
+  if (rank != 0) {
+    MPI_Send(C, mloc * nloc, MPI_DOUBLE, 0, 0, g->comm);
+    return;
+  }
+
+  int mmax = numroc(n, nb, 0, g->nprow), nmax = numroc(n, nb, 0, g->npcol);
+  double* buf = (double*) malloc(((long) mmax * nmax + 1) * sizeof(double));
+  if (buf == NULL) die("Failed to allocate gather buffer.\n");
+
+  for (int r = 0; r < size; ++r) {
+    int coords[2];
+    MPI_Cart_coords(g->comm, r, 2, coords);
+    int ml = numroc(n, nb, coords[0], g->nprow);
+    int nl = numroc(n, nb, coords[1], g->npcol);
+    const double* src = C;
+    if (r != 0) {
+      MPI_Recv(buf, ml * nl, MPI_DOUBLE, r, 0, g->comm, MPI_STATUS_IGNORE);
+      src = buf;
+    }
+    for (int lj = 0; lj < nl; ++lj) {
+      int gj = local_to_global(lj, nb, coords[1], g->npcol);
+      for (int li = 0; li < ml; ++li) {
+        int gi = local_to_global(li, nb, coords[0], g->nprow);
+        Cg[gi + (long) gj * n] = src[li + (long) lj * ml];
+      }
+    }
+  }
+  free(buf);
+}
+
+/* Componentwise check of Cg = A * B: |Cg - A*B| <= 3 * e_mach * n * |A||B|. */
+int check(int n, const double* Cg) {
+  double* a = (double*) malloc(2 * (long) n * n * sizeof(double));
+  if (a == NULL) die("Failed to allocate reference.\n");
+  double* b = a + (long) n * n;
+  for (int j = 0; j < n; ++j) {
+    for (int i = 0; i < n; ++i) {
+      a[i + (long) j * n] = entry(0, i, j);
+      b[i + (long) j * n] = entry(1, i, j);
+    }
+  }
+
+  int ok = 1;
+  for (int j = 0; j < n && ok; ++j) {
+    for (int i = 0; i < n; ++i) {
+      double cij = 0., bound = 0.;
+      for (int k = 0; k < n; ++k) {
+        cij += a[i + (long) k * n] * b[k + (long) j * n];
+        bound += fabs(a[i + (long) k * n] * b[k + (long) j * n]);
+      }
+      if (fabs(Cg[i + (long) j * n] - cij) > 3. * DBL_EPSILON * n * bound) {
+        ok = 0;
+        break;
+      }
+    }
+  }
+  free(a);
+  return ok;
+}
+
+/* The benchmarking program */
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+
+  int cannon = (argc > 1 && strcmp(argv[1], "cannon") == 0);
+  int nb = (argc > 2) ? atoi(argv[2]) : 128;
+
+  int default_sizes[] = {500, 1000, 2000, 4000};
+  int nsizes = (argc > 3) ? argc - 3 : (int) (sizeof(default_sizes)/sizeof(default_sizes[0]));
+
+  proc_grid grid;
+  if (nb <= 0 || grid_init(&grid, MPI_COMM_WORLD, 0, 0) != 0)
+    die("Usage: mpirun -n P ./benchmark-summa [summa|cannon] [nb] [n ...]\n");
+  if (cannon && grid.nprow != grid.npcol)
+    die("Cannon's algorithm needs a square number of ranks.\n");
+
+  int rank, size;
+  MPI_Comm_rank(grid.comm, &rank);
+  MPI_Comm_size(grid.comm, &size);
+
+  // ranks sharing a node: one tunes the local dgemm, the others read the file
+  MPI_Comm node;
+  int node_rank, nnodes, is_root;
+  MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node);
+  MPI_Comm_rank(node, &node_rank);
+  is_root = (node_rank == 0);
+  MPI_Allreduce(&is_root, &nnodes, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  if (is_root) dgemm_tuning();
+  MPI_Barrier(MPI_COMM_WORLD);
+  const char* tuning = dgemm_tuning();
+
+  if (rank == 0) {
+    printf("# Description:\t%s dgemm, %d x %d grid, %d nodes, block %d.\n",
+           cannon ? "Cannon" : "SUMMA", grid.nprow, grid.npcol, nnodes, nb);
+    printf("# Local dgemm:\t%s\n\n", tuning);
+  }
+
+  for (int isize = 0; isize < nsizes; ++isize) {
+    int n = (argc > 3) ? atoi(argv[3 + isize]) : default_sizes[isize];
+    if (n <= 0) continue;
+
+    /* Create and fill the local blocks of A, B, C */
+    int mloc = numroc(n, nb, grid.myrow, grid.nprow);
+    int nloc = numroc(n, nb, grid.mycol, grid.npcol);
+    long local = (long) mloc * nloc;
+    double* buf = (double*) malloc((3 * local + 1) * sizeof(double));
+    if (buf == NULL) die("Failed to allocate problem.\n");
+    double* A = buf;
+    double* B = A + local;
+    double* C = B + local;
+    fill_local(&grid, n, nb, 0, A);
+    fill_local(&grid, n, nb, 1, B);
+    memset(C, 0, local * sizeof(double));
+
+    /* Time a "sufficiently long" sequence of calls, as in benchmark.c. Rank
+       0 decides when it is long enough, so all ranks do the same calls. */
+    double Gflops_s, seconds = -1.0;
+    double timeout = 0.1;
+    for (int n_iterations = 1; seconds < timeout; n_iterations *= 2) {
+      /* Warm-up */
+      if (cannon) cannon_dgemm(&grid, n, nb, A, B, C);
+      else        summa_dgemm(&grid, n, nb, A, B, C);
+
+      MPI_Barrier(grid.comm);
+      seconds = -MPI_Wtime();
+      for (int it = 0; it < n_iterations; ++it) {
+        if (cannon) cannon_dgemm(&grid, n, nb, A, B, C);
+        else        summa_dgemm(&grid, n, nb, A, B, C);
+      }
+      MPI_Barrier(grid.comm);
+      seconds += MPI_Wtime();
+      MPI_Bcast(&seconds, 1, MPI_DOUBLE, 0, grid.comm);
+
+      Gflops_s = 2.e-9 * n_iterations * n * (double) n * n / seconds;
+    }
+
+    if (rank == 0) {
+      printf("Size: %8d\tGflop/s: %8.2f\tPer node: %8.2f\tPer rank: %8.2f"
+             "\tPercentage:%8.2lf\n",
+             n, Gflops_s, Gflops_s / nnodes, Gflops_s / size,
+             Gflops_s / size * 100 / MAX_SPEED);
+    }
+
+    /* C := A * B once more and compare with the serial product. */
+    if (n <= MAX_CHECK) {
+      memset(C, 0, local * sizeof(double));
+      if (cannon) cannon_dgemm(&grid, n, nb, A, B, C);
+      else        summa_dgemm(&grid, n, nb, A, B, C);
+
+      double* Cg = NULL;
+      if (rank == 0) {
+        Cg = (double*) malloc((long) n * n * sizeof(double));
+        if (Cg == NULL) die("Failed to allocate gather buffer.\n");
+      }
+      gather(&grid, n, nb, C, Cg);
+      if (rank == 0) {
+        if (!check(n, Cg))
+          die("Error in matrix multiply exceeds componentwise error bounds.\n");
+        free(Cg);
+      }
+    }
+
+    free(buf);
+  }
+
+  MPI_Comm_free(&node);
+  grid_free(&grid);
+  MPI_Finalize();
+  return 0;
+}
@@ -1,9 +1,9 @@
-#include <stdlib.h> // For: exit, drand48, malloc, free, NULL, EXIT_FAILURE
+#include <stdlib.h> // For: exit, drand48, malloc, free, atoi, NULL, EXIT_FAILURE
 #include <stdio.h>  // For: perror
-#include <string.h> // For: memset
+#include <string.h> // For: memset, strcmp
 
 #include <float.h>  // For: DBL_EPSILON
-#include <math.h>   // For: fabs
+#include <math.h>   // For: fabs, fmax
 
 #ifdef GETTIMEOFDAY
 #include <sys/time.h> // For struct timeval, gettimeofday
@@ -11,10 +11,27 @@
 #include <time.h> // For struct timespec, clock_gettime, CLOCK_MONOTONIC
 #endif
 
+#include "bench-stats.h"
+#include "perfcount.h"
+
 // On icsmaster
 // 2.3 GHz * 8 vector width * 2 flops for FMA = 36.8 GF/s
 #define MAX_SPEED 36.8
 
+#ifdef NO_BLAS
+/* Without a BLAS library, reference_dgemm is the plain loop nest
+   C := C + ALPHA * A * B: slow, but independent of the code under test. */
+void reference_dgemm(int N, double ALPHA, double* A, double* B, double* C) {
+  for (int j = 0; j < N; ++j) {
+    for (int k = 0; k < N; ++k) {
+      double bkj = ALPHA * B[k + j*N];
+      for (int i = 0; i < N; ++i) {
+        C[i + j*N] += A[i + k*N] * bkj;
+      }
+    }
+  }
+}
+#else
 /* Reference_dgemm wraps a call to the BLAS-3 routine DGEMM, via the standard
    FORTRAN interface - hence the reference semantics. */ 
 #define DGEMM dgemm_
@@ -31,11 +48,25 @@ void reference_dgemm(int N, double ALPHA, double* A, double* B, double* C) {
   int LDC = N;
   DGEMM(&TRANSA, &TRANSB, &M, &N, &K, &ALPHA, A, &LDA, B, &LDB, &BETA, C, &LDC);
 }   
+#endif
 
 /* Your function must have the following signature: */
 extern const char* dgemm_desc;
 extern void square_dgemm(int, double*, double*, double*);
 
+/* Optional: implementations with run-time tuned parameters describe them
+   here. Weak, so the versions that do not define it still link. */
+extern const char* dgemm_tuning(void) __attribute__((weak));
+
+/* Optional: fast (Strassen-like) algorithms only satisfy a normwise bound
+   |C - A*B| <= factor(n) * e_mach * max|A| * max|B|; they provide factor. */
+extern double dgemm_error_factor(int) __attribute__((weak));
+
+/* OpenMP run-time calls for the thread sweep; weak, so that they are NULL
+   in the benchmarks that do not link OpenMP. */
+extern void omp_set_num_threads(int) __attribute__((weak));
+extern int  omp_get_max_threads(void) __attribute__((weak));
+
 double wall_time() {
 #ifdef GETTIMEOFDAY
   struct timeval t;
@@ -65,13 +96,291 @@ void absolute_value(double *p, int n) {
   }
 }
 
+/* Measure performance (in Gflops/s) of square_dgemm on n x n matrices.
+   Time a "sufficiently long" sequence of calls to reduce noise */
+double time_dgemm(int n, double* A, double* B, double* C) {
+  double Gflops_s, seconds = -1.0;
+  double timeout = 0.1; // "sufficiently long" := at least 1/10 second.
+  for (int n_iterations = 1; seconds < timeout; n_iterations *= 2) {
+    /* Warm-up */
+    square_dgemm(n, A, B, C);
+
+    /* Benchmark n_iterations runs of square_dgemm */
+    seconds = -wall_time();
+    for (int it = 0; it < n_iterations; ++it) {
+      square_dgemm(n, A, B, C);
+    }
+    seconds += wall_time();
+
+    /*  Compute Gflop/s rate */
+    Gflops_s = 2.e-9 * n_iterations * n * n * n / seconds;
+  }
+  return Gflops_s;
+}
+
+/* Thread sweep: ./benchmark-... sweep [n ...]
+   For every size, runs 1, 2, 4, ... and the maximum number of OpenMP
+   threads and reports Gflop/s, Gflop/s per thread and parallel efficiency
+   (speed-up over one thread divided by the number of threads). */
+int next_thread_count(int t, int max_threads) {
+  if (t >= max_threads) return max_threads + 1;
+  return (2*t < max_threads) ? 2*t : max_threads;
+}
+
+int thread_sweep(int nsizes, char** sizes) {
+  if (omp_set_num_threads == NULL || omp_get_max_threads == NULL) {
+    fprintf(stderr, "This benchmark is not built with OpenMP.\n");
+    return 1;
+  }
+
+  int default_sizes[] = {500, 1000, 2000};
+  int ndefault = sizeof(default_sizes)/sizeof(default_sizes[0]);
+  if (nsizes == 0) nsizes = ndefault;
+
+  int nmax = 0;
+  for (int is = 0; is < nsizes; ++is) {
+    int n = sizes ? atoi(sizes[is]) : default_sizes[is];
+    if (n > nmax) nmax = n;
+  }
+  if (nmax <= 0) die("Invalid matrix size.\n");
+
+  double* buf = (double*) malloc(3 * (size_t) nmax * nmax * sizeof(double));
+  if (buf == NULL) die("Failed to allocate largest problem size.\n");
+
+  int max_threads = omp_get_max_threads();
+
+  for (int is = 0; is < nsizes; ++is) {
+    int n = sizes ? atoi(sizes[is]) : default_sizes[is];
+    if (n <= 0) continue;
+    double* A = buf + 0;
+    double* B = A + (size_t) nmax*nmax;
+    double* C = B + (size_t) nmax*nmax;
+    fill(A, n*n);
+    fill(B, n*n);
+    fill(C, n*n);
+
+    double serial = 0.;
+    for (int t = 1; t <= max_threads; t = next_thread_count(t, max_threads)) {
+      omp_set_num_threads(t);
+      double Gflops_s = time_dgemm(n, A, B, C);
+      if (t == 1) serial = Gflops_s;
+      printf("Threads: %4d\tSize: %8d\tGflop/s: %8.2f\tPer thread: %8.2f"
+             "\tEfficiency:%8.2lf\n",
+             t, n, Gflops_s, Gflops_s / t, Gflops_s * 100 / (serial * t));
+    }
+    omp_set_num_threads(max_threads);
+  }
+
+  free(buf);
+  return 0;
+}
+
+/* Statistics mode: ./benchmark-... stats [out.json | out.csv] [n ...]
+   Every size is timed BENCH_REPEATS times (default 10), each sample long
+   enough (>= 20 ms) to be above the timer resolution, and summarised by
+   median, min and standard deviation. The peak is measured on this machine
+   (bench_peak_gflops times the number of OpenMP threads) unless BENCH_PEAK
+   gives it in Gflop/s. Hardware counters are per call, averaged over the
+   samples, with the metrics derived from them (IPC, share of vector flops,
+   DRAM bytes per flop). The file, if given, gets the same data as JSON or CSV, for
+   comparisons between builds and over time. */
+static int ends_with(const char* s, const char* suffix) {
+  size_t ls = strlen(s), lx = strlen(suffix);
+  return ls >= lx && strcmp(s + ls - lx, suffix) == 0;
+}
+
+static void json_string(FILE* f, const char* s) {
+  fputc('"', f);
+  for (; s && *s; ++s) {
+    if (*s == '"' || *s == '\\') fputc('\\', f);
+    if ((unsigned char) *s >= 0x20) fputc(*s, f);
+  }
+  fputc('"', f);
+}
+
+static void print_number(FILE* f, double x, int json) {
+  if (x >= 0.) fprintf(f, "%.6g", x);
+  else if (json) fprintf(f, "null");
+}
+
+int stats_mode(int nargs, char** args) {
+  const char* path = NULL;
+  if (nargs > 0 && (ends_with(args[0], ".json") || ends_with(args[0], ".csv"))) {
+    path = args[0];
+    ++args;
+    --nargs;
+  }
+  int json = path && ends_with(path, ".json");
+
+  int repeats = getenv("BENCH_REPEATS") ? atoi(getenv("BENCH_REPEATS")) : 10;
+  if (repeats < 1) repeats = 1;
+
+  int default_sizes[] = {64, 128, 256, 512, 1024};
+  int nsizes = nargs > 0 ? nargs : (int) (sizeof(default_sizes)/sizeof(default_sizes[0]));
+  int nmax = 0;
+  for (int is = 0; is < nsizes; ++is) {
+    int n = nargs > 0 ? atoi(args[is]) : default_sizes[is];
+    if (n <= 0) die("Invalid matrix size.\n");
+    if (n > nmax) nmax = n;
+  }
+
+  int threads = omp_get_max_threads ? omp_get_max_threads() : 1;
+  double peak = getenv("BENCH_PEAK") ? atof(getenv("BENCH_PEAK"))
+                                     : bench_peak_gflops() * threads;
+  printf("# Peak:\t%.2f Gflop/s (%d thread(s), %d doubles per vector%s)\n",
+         peak, threads, bench_simd_width(), getenv("BENCH_PEAK") ? ", BENCH_PEAK" : "");
+
+  perf_group counters;
+  int ncounters = perf_group_open(&counters);
+  printf("# Counters:\t%d of %d available\n", ncounters, PC_NEVENTS);
+  printf("# Repeats:\t%d\n\n", repeats);
+
+  FILE* out = NULL;
+  if (path) {
+    out = fopen(path, "w");
+    if (out == NULL) die("Failed to open the output file");
+    if (json) {
+      fprintf(out, "{\n  \"description\": ");
+      json_string(out, dgemm_desc);
+      fprintf(out, ",\n  \"parameters\": ");
+      if (dgemm_tuning != NULL) json_string(out, dgemm_tuning());
+      else fprintf(out, "null");
+      fprintf(out, ",\n  \"threads\": %d,\n  \"peak_gflops\": %.6g,\n"
+                   "  \"repeats\": %d,\n  \"results\": [", threads, peak, repeats);
+    } else {
+      fprintf(out, "description,threads,peak_gflops,n,repeats,iterations,"
+                   "time_median,time_min,time_stddev,gflops_median,gflops_best,"
+                   "percent_peak");
+      for (int e = 0; e < PC_NEVENTS; ++e) fprintf(out, ",%s", perf_group_names[e]);
+      fprintf(out, ",fp_ops,ipc,flops_per_cycle,vector_ratio,dram_bytes,bytes_per_flop,"
+                   "branch_miss_rate\n");
+    }
+  }
+
+  double* buf = (double*) malloc(3 * (size_t) nmax * nmax * sizeof(double));
+  double* samples = (double*) malloc(repeats * sizeof(double));
+  if (buf == NULL || samples == NULL) die("Failed to allocate largest problem size.\n");
+
+  for (int is = 0; is < nsizes; ++is) {
+    int n = nargs > 0 ? atoi(args[is]) : default_sizes[is];
+    double* A = buf + 0;
+    double* B = A + (size_t) nmax*nmax;
+    double* C = B + (size_t) nmax*nmax;
+    fill(A, n*n);
+    fill(B, n*n);
+    fill(C, n*n);
+
+    /* Warm-up, and calls per sample */
+    double seconds = -wall_time();
+    square_dgemm(n, A, B, C);
+    seconds += wall_time();
+    int iterations = (seconds > 0.02) ? 1 : (int) (0.02 / (seconds > 1.e-7 ? seconds : 1.e-7)) + 1;
+
+    perf_group_reset(&counters);
+    perf_group_start(&counters);
+    for (int r = 0; r < repeats; ++r) {
+      samples[r] = -wall_time();
+      for (int it = 0; it < iterations; ++it) square_dgemm(n, A, B, C);
+      samples[r] = (samples[r] + wall_time()) / iterations;
+    }
+    perf_group_stop(&counters);
+
+    double calls = (double) repeats * iterations;
+    for (int e = 0; e < PC_NEVENTS; ++e) {
+      if (counters.value[e] >= 0.) counters.value[e] /= calls;
+    }
+    double flops = 2. * n * n * (double) n;
+    perf_metrics m = perf_group_metrics(&counters, 0., flops);
+    double fp_ops = (counters.value[PC_FP_SCALAR] >= 0.) ? m.fp_ops : -1.;
+    double ipc = m.ipc;
+    double cycles = counters.value[PC_CYCLES];
+    double flops_per_cycle = cycles > 0. ? flops / cycles : -1.;
+
+    bench_summary s = bench_summarize(samples, repeats);
+    double gflops_median = 1.e-9 * flops / s.median;
+    double gflops_best = 1.e-9 * flops / s.min;
+
+    printf("Size: %8d\tGflop/s: %8.2f\tBest: %8.2f\tStddev:%7.2lf%%\tPercentage:%8.2lf",
+           n, gflops_median, gflops_best, 100. * s.stddev / s.mean,
+           gflops_median * 100 / peak);
+    if (ipc >= 0.) printf("\tIPC: %5.2f", ipc);
+    if (flops_per_cycle >= 0.) printf("\tFlop/cycle: %6.2f", flops_per_cycle);
+    if (m.vector_ratio >= 0.) printf("\tVector: %5.1f%%", 100. * m.vector_ratio);
+    if (m.bytes_per_flop >= 0.) printf("\tB/flop: %6.3f", m.bytes_per_flop);
+    printf("\n");
+
+    if (out && json) {
+      fprintf(out, "%s\n    {\"n\": %d, \"iterations\": %d, \"time_median\": %.6g, "
+                   "\"time_min\": %.6g, \"time_stddev\": %.6g, \"gflops_median\": %.6g, "
+                   "\"gflops_best\": %.6g, \"percent_peak\": %.6g,\n     \"counters\": {",
+              is ? "," : "", n, iterations, s.median, s.min, s.stddev,
+              gflops_median, gflops_best, gflops_median * 100 / peak);
+      for (int e = 0; e < PC_NEVENTS; ++e) {
+        fprintf(out, "%s\"%s\": ", e ? ", " : "", perf_group_names[e]);
+        print_number(out, counters.value[e], 1);
+      }
+      fprintf(out, "},\n     \"fp_ops\": ");
+      print_number(out, fp_ops, 1);
+      fprintf(out, ", \"ipc\": ");
+      print_number(out, ipc, 1);
+      fprintf(out, ", \"flops_per_cycle\": ");
+      print_number(out, flops_per_cycle, 1);
+      fprintf(out, ",\n     \"vector_ratio\": ");
+      print_number(out, m.vector_ratio, 1);
+      fprintf(out, ", \"dram_bytes\": ");
+      print_number(out, m.dram_bytes, 1);
+      fprintf(out, ", \"dram_estimated\": %s", m.dram_estimated ? "true" : "false");
+      fprintf(out, ", \"bytes_per_flop\": ");
+      print_number(out, m.bytes_per_flop, 1);
+      fprintf(out, ", \"branch_miss_rate\": ");
+      print_number(out, m.branch_miss_rate, 1);
+      fprintf(out, "}");
+    } else if (out) {
+      fprintf(out, "\"%s\",%d,%.6g,%d,%d,%d,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g",
+              dgemm_desc, threads, peak, n, repeats, iterations, s.median, s.min,
+              s.stddev, gflops_median, gflops_best, gflops_median * 100 / peak);
+      for (int e = 0; e < PC_NEVENTS; ++e) {
+        fputc(',', out);
+        print_number(out, counters.value[e], 0);
+      }
+      double derived[] = {fp_ops, ipc, flops_per_cycle, m.vector_ratio, m.dram_bytes,
+                          m.bytes_per_flop, m.branch_miss_rate};
+      for (int d = 0; d < 7; ++d) {
+        fputc(',', out);
+        print_number(out, derived[d], 0);
+      }
+      fputc('\n', out);
+    }
+  }
+
+  if (out) {
+    if (json) fprintf(out, "\n  ]\n}\n");
+    fclose(out);
+  }
+  perf_group_close(&counters);
+  free(samples);
+  free(buf);
+  return 0;
+}
+
 /* The benchmarking program */
 int main(int argc, char **argv) {
-  printf("# Description:\t%s\n\n", dgemm_desc);
+  printf("# Description:\t%s\n", dgemm_desc);
+  if (dgemm_tuning != NULL) {
+    printf("# Parameters:\t%s\n", dgemm_tuning());
+  }
+  printf("\n");
+
+  if (argc > 1 && strcmp(argv[1], "sweep") == 0) {
+    return thread_sweep(argc - 2, argc > 2 ? argv + 2 : NULL);
+  }
+  if (argc > 1 && strcmp(argv[1], "stats") == 0) {
+    return stats_mode(argc - 2, argv + 2);
+  }
 
   /* Test sizes should highlight performance dips at multiples of certain
-     powers-of-two */
-  int test_sizes[] = {  31,   32,   96,   97,
+     powers-of-two. Sizes given on the command line replace them. */
+  int default_sizes[] = {  31,   32,   96,   97,
                        127,  128,  129,  191, 192,
                        229, 255, 256, 257,
                        319, 320, 321,
@@ -85,50 +394,46 @@ int main(int argc, char **argv) {
                       1100,
                       1200};
 
-  int nsizes = sizeof(test_sizes)/sizeof(test_sizes[0]);
+  int* test_sizes = default_sizes;
+  int nsizes = sizeof(default_sizes)/sizeof(default_sizes[0]);
+  if (argc > 1) {
+    nsizes = argc - 1;
+    test_sizes = (int*) malloc(nsizes * sizeof(int));
+    if (test_sizes == NULL) die("Failed to allocate size list.\n");
+    for (int i = 0; i < nsizes; ++i) {
+      test_sizes[i] = atoi(argv[i + 1]);
+      if (test_sizes[i] <= 0) die("Invalid matrix size.\n");
+    }
+  }
 
-  /* Assume last size is also the largest size */
-  int nmax = test_sizes[nsizes-1];
+  /* Largest size, for the allocation below */
+  int nmax = 0;
+  for (int i = 0; i < nsizes; ++i) {
+    if (test_sizes[i] > nmax) nmax = test_sizes[i];
+  }
 
   /* Allocate memory for all problems */
   double* buf = NULL;
-  buf = (double*) malloc(3 * nmax * nmax * sizeof(double));
+  buf = (double*) malloc(3 * (size_t) nmax * nmax * sizeof(double));
   if (buf == NULL) die("Failed to allocate largest problem size.\n");
 
   /* Average percentage of peak performance*/
   double avg_perf = 0.; 
 
   /* For each test size */
-  for (int isize = 0; isize < sizeof(test_sizes)/sizeof(test_sizes[0]);
-       ++isize) {
+  for (int isize = 0; isize < nsizes; ++isize) {
 
     /* Create and fill 3 random matrices A, B, C */
     int n = test_sizes[isize];
     double* A = buf + 0;
-    double* B = A + nmax*nmax;
-    double* C = B + nmax*nmax;
+    double* B = A + (size_t) nmax*nmax;
+    double* C = B + (size_t) nmax*nmax;
     fill(A, n*n);
     fill(B, n*n);
     fill(C, n*n);
 
     /* Measure performance (in Gflops/s). */
-    /* Time a "sufficiently long" sequence of calls to reduce noise */
-    double Gflops_s, seconds = -1.0;
-    double timeout = 0.1; // "sufficiently long" := at least 1/10 second.
-    for (int n_iterations = 1; seconds < timeout; n_iterations *= 2) {
-      /* Warm-up */
-      square_dgemm(n, A, B, C);
-
-      /* Benchmark n_iterations runs of square_dgemm */
-      seconds = -wall_time();
-      for (int it = 0; it < n_iterations; ++it) {
-        square_dgemm(n, A, B, C);
-      }
-      seconds += wall_time();
-
-      /*  Compute Gflop/s rate */
-      Gflops_s = 2.e-9 * n_iterations * n * n * n / seconds;
-    }
+    double Gflops_s = time_dgemm(n, A, B, C);
     /* Report size, GFlop rate and percentage of peak performance */
     printf("Size: %8d\tGflop/s: %8.2f\tPercentage:%8.2lf\n",
            n, Gflops_s, Gflops_s*100/MAX_SPEED);
@@ -146,6 +451,21 @@ int main(int argc, char **argv) {
        C := C - A * B, computed with reference_dgemm */
     reference_dgemm(n, -1., A, B, C);
 
+    if (dgemm_error_factor != NULL) {
+      /* |C| <= 3 * e_mach * factor(n) * max|A| * max|B|, normwise */
+      double amax = 0., bmax = 0.;
+      for (int i = 0; i < n * n; ++i) {
+        amax = fmax(amax, fabs(A[i]));
+        bmax = fmax(bmax, fabs(B[i]));
+      }
+      double bound = 3. * DBL_EPSILON * dgemm_error_factor(n) * amax * bmax;
+      for (int i = 0; i < n * n; ++i) {
+        if (!(fabs(C[i]) <= bound))
+          die("Error in matrix multiply exceeds normwise error bounds.\n");
+      }
+      continue;
+    }
+
     /* A := |A|, B := |B|, C := |C| */
     absolute_value (A, n * n);
     absolute_value (B, n * n);
@@ -167,6 +487,7 @@ int main(int argc, char **argv) {
   printf("# Average percentage of peak performance = %g\n", avg_perf);
 
   free(buf);
+  if (test_sizes != default_sizes) free(test_sizes);
 
   return 0;
 }
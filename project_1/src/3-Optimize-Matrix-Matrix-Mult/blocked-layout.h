@@ -0,0 +1,102 @@
+// blocked-layout.h
+//
+// Internal layouts for the blocked dgemm when n is a critical stride.
+//
+// With column-major n x n operands, element (i, k) and (i, k+1) are n
+// doubles apart. When n * 8 bytes is a multiple of a large power of two
+// (512 B or more), the columns touched by one block all map to the same
+// few cache sets (4 KiB of L1 is one way: 64 sets of 64 B) and evict each
+// other: the dips at 256, 512, 768, ... in benchmark.c. The blocked loops
+// then work on block-major copies instead: every bs x bs tile of A and B
+// is contiguous, so a tile occupies consecutive lines whatever n is. The
+// copies are O(n^2) and every tile is reused n / bs times, once per block
+// of the other operand, so their cost is amortised over the K loop.
+//
+// The copies also pay off at sizes that are not critical strides (the
+// tile rows of A make the k loop unit-stride), so they are used for every
+// problem that does not fit in L1 anyway; only small matrices that are not
+// critical strides keep the direct loops, where the copy would dominate.
+//
+// Tiles are zero-padded to full bs x bs at the edges; tile (ib, kb) of A is
+// stored row by row (the k loop of do_block is then contiguous), tile
+// (kb, jb) of B column by column.
+
+#ifndef BLOCKED_LAYOUT_H
+#define BLOCKED_LAYOUT_H
+
+#include <stdlib.h> // For: posix_memalign
+#include <string.h> // For: memset
+
+/* Leading dimensions (in bytes) that are multiples of this are copied. */
+#define CRITICAL_STRIDE 512
+
+/* Three n x n operands up to this many bytes stay in L1 as they are. */
+#define DIRECT_BYTES (32 * 1024)
+
+#ifdef _OPENMP
+#define LAYOUT_PARALLEL_FOR _Pragma("omp parallel for schedule(static)")
+#else
+#define LAYOUT_PARALLEL_FOR
+#endif
+
+static inline int is_critical_stride(int ld) {
+  return ((size_t) ld * sizeof(double)) % CRITICAL_STRIDE == 0;
+}
+
+static inline int use_block_major(int n) {
+  return is_critical_stride(n) || 3 * (size_t) n * n * sizeof(double) > DIRECT_BYTES;
+}
+
+/* Number of tiles per dimension and doubles of a block-major copy. */
+static inline int layout_tiles(int n, int bs) {
+  return (n + bs - 1) / bs;
+}
+
+static inline double* layout_alloc(int n, int bs) {
+  size_t nt = layout_tiles(n, bs);
+  void* p = NULL;
+  if (posix_memalign(&p, 64, nt * nt * bs * bs * sizeof(double))) return NULL;
+  return (double*) p;
+}
+
+/* Tile (ib, kb) of A at At + (ib*nt + kb) * bs*bs, element (i, k) of the
+   tile at [i*bs + k]. */
+static inline void pack_tiles_A(int n, int bs, const double* A, double* At) {
+  const int nt = layout_tiles(n, bs);
+  LAYOUT_PARALLEL_FOR
+  for (int ib = 0; ib < nt; ++ib) {
+    for (int kb = 0; kb < nt; ++kb) {
+      double* t = At + ((size_t) ib*nt + kb) * bs*bs;
+      int rows = (n - ib*bs < bs) ? n - ib*bs : bs;
+      int cols = (n - kb*bs < bs) ? n - kb*bs : bs;
+      if (rows < bs || cols < bs) memset(t, 0, (size_t) bs*bs * sizeof(double));
+      for (int k = 0; k < cols; ++k) {
+        const double* a = A + ib*bs + (size_t) (kb*bs + k) * n;
+        for (int i = 0; i < rows; ++i) t[i*bs + k] = a[i];
+      }
+    }
+  }
+}
+
+/* Tile (kb, jb) of B at Bt + (jb*nt + kb) * bs*bs, element (k, j) of the
+   tile at [k + j*bs]. */
+static inline void pack_tiles_B(int n, int bs, const double* B, double* Bt) {
+  const int nt = layout_tiles(n, bs);
+  LAYOUT_PARALLEL_FOR
+  for (int jb = 0; jb < nt; ++jb) {
+    for (int kb = 0; kb < nt; ++kb) {
+      double* t = Bt + ((size_t) jb*nt + kb) * bs*bs;
+      int rows = (n - kb*bs < bs) ? n - kb*bs : bs;
+      int cols = (n - jb*bs < bs) ? n - jb*bs : bs;
+      if (rows < bs || cols < bs) memset(t, 0, (size_t) bs*bs * sizeof(double));
+      for (int j = 0; j < cols; ++j) {
+        const double* b = B + kb*bs + (size_t) (jb*bs + j) * n;
+        for (int k = 0; k < rows; ++k) t[k + j*bs] = b[k];
+      }
+    }
+  }
+}
+
+#undef LAYOUT_PARALLEL_FOR
+
+#endif // BLOCKED_LAYOUT_H
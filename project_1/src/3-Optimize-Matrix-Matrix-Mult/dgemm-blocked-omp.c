@@ -1,6 +1,9 @@
 // dgemm-blocked-omp.c
 
 #include <stddef.h>
+#include <stdlib.h> // For: free
+
+#include "blocked-layout.h"
 
 const char* dgemm_desc = "Blocked dgemm + OpenMP";
 
@@ -33,9 +36,67 @@ static inline void do_block(int n, int si, int sj, int sk, int bs,
   }
 }
 
+// Stesso blocco sulle copie a blocchi (blocked-layout.h): At e Bt puntano
+// ai tile di A e B, il loop su k percorre il tile intero (padding a zero)
+static inline void do_tile(int n, int si, int sj, int bs,
+                           const double* At,
+                           const double* Bt,
+                           double* C) {
+
+  int i_max = si + bs; if (i_max > n) i_max = n;
+  int j_max = sj + bs; if (j_max > n) j_max = n;
+
+  for (int j = sj; j < j_max; ++j) {
+    const double* b = Bt + (size_t)(j - sj) * bs;
+    for (int i = si; i < i_max; ++i) {
+      const double* a = At + (size_t)(i - si) * bs;
+      double cij = C[i + (size_t)j*n];
+
+      #pragma omp simd reduction(+:cij)
+      for (int k = 0; k < bs; ++k) {
+        cij += a[k] * b[k];
+      }
+
+      C[i + (size_t)j*n] = cij;
+    }
+  }
+}
+
+static void square_dgemm_tiled(int n, int bs, double* At, double* Bt,
+                               const double* A, const double* B, double* C) {
+  const int nt = layout_tiles(n, bs);
+  const size_t tile = (size_t) bs * bs;
+  pack_tiles_A(n, bs, A, At);   // copie in parallelo
+  pack_tiles_B(n, bs, B, Bt);
+
+  #pragma omp parallel for collapse(2) schedule(static)
+  for (int ib = 0; ib < nt; ++ib) {
+    for (int jb = 0; jb < nt; ++jb) {
+      for (int kb = 0; kb < nt; ++kb) {
+        do_tile(n, ib*bs, jb*bs, bs,
+                At + ((size_t) ib*nt + kb) * tile, Bt + ((size_t) jb*nt + kb) * tile, C);
+      }
+    }
+  }
+}
+
 void square_dgemm(int n, double* A, double* B, double* C) {
   const int bs = BLOCK_SIZE;
 
+  // Stride critico (n*8 byte multiplo di 512) o fuori da L1: copie a blocchi
+  if (use_block_major(n)) {
+    double* At = layout_alloc(n, bs);
+    double* Bt = layout_alloc(n, bs);
+    if (At != NULL && Bt != NULL) {
+      square_dgemm_tiled(n, bs, At, Bt, A, B, C);
+      free(At);
+      free(Bt);
+      return;
+    }
+    free(At);
+    free(Bt);
+  }
+
   // Parallelizza i loop di blocco (coprono quasi tutto il lavoro)
   // collapse(2) = spartisce (i,j) tra i thread
   #pragma omp parallel for collapse(2) schedule(static)
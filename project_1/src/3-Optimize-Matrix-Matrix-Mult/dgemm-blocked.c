@@ -1,3 +1,7 @@
+#include <stdlib.h> // For: free
+
+#include "blocked-layout.h"
+
 const char* dgemm_desc = "Blocked dgemm.";
 
 #ifndef BLOCK_SIZE
@@ -29,9 +33,64 @@ static inline void do_block(int n, int si, int sj, int sk, int block_size,
   }
 }
 
+/* Same block on the block-major copies (see blocked-layout.h): At and Bt
+ * point to the tiles of A and B, the k loop runs over the padded tile.
+ */
+static inline void do_tile(int n, int si, int sj, int block_size,
+                           const double* At, const double* Bt, double* C) {
+  int i_max = si + block_size;
+  int j_max = sj + block_size;
+
+  i_max = (i_max > n) ? n : i_max;
+  j_max = (j_max > n) ? n : j_max;
+
+  for (int i = si; i < i_max; ++i) {
+    const double* a = At + (i - si) * block_size;
+    for (int j = sj; j < j_max; ++j) {
+      const double* b = Bt + (j - sj) * block_size;
+      double cij = C[i + j*n];
+      for (int k = 0; k < block_size; ++k) {
+        cij += a[k] * b[k];
+      }
+      C[i + j*n] = cij;
+    }
+  }
+}
+
+static void square_dgemm_tiled(int n, int block_size, double* At, double* Bt,
+                               double* A, double* B, double* C) {
+  const int nt = layout_tiles(n, block_size);
+  const size_t tile = (size_t) block_size * block_size;
+  pack_tiles_A(n, block_size, A, At);
+  pack_tiles_B(n, block_size, B, Bt);
+
+  for (int ib = 0; ib < nt; ++ib) {
+    for (int jb = 0; jb < nt; ++jb) {
+      for (int kb = 0; kb < nt; ++kb) {
+        do_tile(n, ib*block_size, jb*block_size, block_size,
+                At + (ib*nt + kb) * tile, Bt + (jb*nt + kb) * tile, C);
+      }
+    }
+  }
+}
+
 void square_dgemm(int n, double* A, double* B, double* C) {
   int block_size = BLOCK_SIZE;
 
+  /* Critical stride or out of L1: work on block-major copies */
+  if (use_block_major(n)) {
+    double* At = layout_alloc(n, block_size);
+    double* Bt = layout_alloc(n, block_size);
+    if (At != NULL && Bt != NULL) {
+      square_dgemm_tiled(n, block_size, At, Bt, A, B, C);
+      free(At);
+      free(Bt);
+      return;
+    }
+    free(At);
+    free(Bt);
+  }
+
   for (int i = 0; i < n; i += block_size) {
     for (int j = 0; j < n; j += block_size) {
       for (int k = 0; k < n; k += block_size) {
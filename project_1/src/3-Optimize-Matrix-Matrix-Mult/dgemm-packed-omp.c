@@ -0,0 +1,35 @@
+// dgemm-packed-omp.c
+
+#include "packed-gemm.h"
+#include "gemm-tune.h"
+
+const char* dgemm_desc = "Packed dgemm + OpenMP (shared B panels, per-socket groups).";
+
+/* Blocking parameters and microkernel, tuned for this host on first use.
+   They describe one core's caches, which is what every thread works in. */
+static const gemm_params* params(void) {
+  static int initialized = 0;
+  static gemm_params tuned;
+  if (!initialized) {
+    tuned = gemm_tuned_params();
+    initialized = 1;
+  }
+  return &tuned;
+}
+
+/* Parameters in use, printed by the benchmark next to its results. */
+const char* dgemm_tuning(void) {
+  params();
+  return gemm_tuning_summary();
+}
+
+/* This routine performs a dgemm operation
+ *
+ *  C := C + A * B
+ *
+ * where A, B, and C are n-by-n matrices stored in column-major format, with
+ * all OpenMP threads.
+ */
+void square_dgemm(int n, double* A, double* B, double* C) {
+  packed_dgemm_omp(params(), 0, n, n, n, 1., A, 1, n, B, 1, n, C, n);
+}
@@ -0,0 +1,81 @@
+// dgemm-packed.c
+
+#include "dgemm-packed.h"
+#include "packed-gemm.h"
+#include "gemm-tune.h"
+
+const char* dgemm_desc = "Packed dgemm (MC/KC/NC blocking + FMA microkernel).";
+
+/* Blocking parameters and microkernel, tuned for this host on first use. */
+static const gemm_params* params(void) {
+  static int initialized = 0;
+  static gemm_params tuned;
+  if (!initialized) {
+    tuned = gemm_tuned_params();
+    initialized = 1;
+  }
+  return &tuned;
+}
+
+/* Parameters in use, printed by the benchmark next to its results. */
+const char* dgemm_tuning(void) {
+  params();
+  return gemm_tuning_summary();
+}
+
+/* This routine performs a dgemm operation
+ *
+ *  C := C + A * B
+ *
+ * where A, B, and C are n-by-n matrices stored in column-major format, by
+ * handing them to the packed driver with unit row stride.
+ */
+void square_dgemm(int n, double* A, double* B, double* C) {
+  packed_dgemm(params(), n, n, n, 1., A, 1, n, B, 1, n, C, n);
+}
+
+static int is_trans(char trans) {
+  return trans == 'T' || trans == 't' || trans == 'C' || trans == 'c';
+}
+
+static int is_valid_trans(char trans) {
+  return trans == 'N' || trans == 'n' || is_trans(trans);
+}
+
+int hpc_dgemm(char transA, char transB, int M, int N, int K,
+              double alpha, const double* A, int lda,
+              const double* B, int ldb,
+              double beta, double* C, int ldc) {
+  int rowsA = is_trans(transA) ? K : M;
+  int rowsB = is_trans(transB) ? N : K;
+
+  /* Same argument order and checks as the reference xerbla. */
+  if (!is_valid_trans(transA))        return -1;
+  if (!is_valid_trans(transB))        return -2;
+  if (M < 0)                          return -3;
+  if (N < 0)                          return -4;
+  if (K < 0)                          return -5;
+  if (lda < (rowsA > 1 ? rowsA : 1))  return -8;
+  if (ldb < (rowsB > 1 ? rowsB : 1))  return -10;
+  if (ldc < (M > 1 ? M : 1))          return -13;
+
+  if (M == 0 || N == 0 || ((alpha == 0. || K == 0) && beta == 1.)) return 0;
+
+  /* C := beta * C; beta = 0 overwrites, so NaNs in C do not survive. */
+  if (beta != 1.) {
+    for (int j = 0; j < N; ++j) {
+      double* c = C + (long) j * ldc;
+      if (beta == 0.) {
+        for (int i = 0; i < M; ++i) c[i] = 0.;
+      } else {
+        for (int i = 0; i < M; ++i) c[i] *= beta;
+      }
+    }
+  }
+
+  /* C := C + alpha * op(A) * op(B); the transposes become strides. */
+  int rsa = is_trans(transA) ? lda : 1, csa = is_trans(transA) ? 1 : lda;
+  int rsb = is_trans(transB) ? ldb : 1, csb = is_trans(transB) ? 1 : ldb;
+  packed_dgemm(params(), M, N, K, alpha, A, rsa, csa, B, rsb, csb, C, ldc);
+  return 0;
+}
@@ -0,0 +1,25 @@
+// dgemm-packed.h
+//
+// BLAS-style interface to the packed dgemm, for callers that need more than
+// the square C := C + A * B of square_dgemm.
+
+#ifndef DGEMM_PACKED_H
+#define DGEMM_PACKED_H
+
+/* This routine performs the BLAS-3 dgemm operation
+ *
+ *  C := alpha * op(A) * op(B) + beta * C
+ *
+ * where op(X) is X for trans = 'N' and X^T for 'T' or 'C', op(A) is M-by-K,
+ * op(B) K-by-N and C M-by-N, all column-major with leading dimensions lda,
+ * ldb and ldc. As in the reference BLAS, C is not read when beta = 0 and A
+ * and B are not read when alpha = 0 or K = 0.
+ *
+ * Returns 0, or -i if the i-th argument is invalid (nothing is computed).
+ */
+int hpc_dgemm(char transA, char transB, int M, int N, int K,
+              double alpha, const double* A, int lda,
+              const double* B, int ldb,
+              double beta, double* C, int ldc);
+
+#endif // DGEMM_PACKED_H
@@ -0,0 +1,34 @@
+// dgemm-strassen.c
+
+#include <stdio.h> // For: snprintf
+
+#include "strassen.h"
+#include "gemm-tune.h"
+
+const char* dgemm_desc = "Strassen-Winograd dgemm over the packed kernel (+ OpenMP tasks).";
+
+/* Parameters in use, printed by the benchmark next to its results. */
+const char* dgemm_tuning(void) {
+  static char summary[1024];
+  int cutoff = strassen_cutoff();
+  snprintf(summary, sizeof(summary), "Strassen cutoff %d; %s",
+           cutoff, gemm_tuning_summary());
+  return summary;
+}
+
+/* Normwise error factor, used by the benchmark instead of the componentwise
+   bound of the conventional algorithm. */
+double dgemm_error_factor(int n) {
+  return strassen_error_factor(n);
+}
+
+/* This routine performs a dgemm operation
+ *
+ *  C := C + A * B
+ *
+ * where A, B, and C are n-by-n matrices stored in column-major format.
+ * Gflop/s reported for it are "effective", i.e. based on 2 n^3 flops.
+ */
+void square_dgemm(int n, double* A, double* B, double* C) {
+  strassen_dgemm(n, A, n, B, n, C, n);
+}
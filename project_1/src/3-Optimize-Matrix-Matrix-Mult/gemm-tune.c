@@ -0,0 +1,288 @@
+// gemm-tune.c
+//
+// Cache probing, parameter search and the per-host tuning file, see
+// gemm-tune.h.
+
+#include <stdio.h>  // For: FILE, fopen, fgets, fprintf, snprintf
+#include <stdlib.h> // For: getenv, malloc, free
+#include <string.h> // For: strcmp, strncmp, strlen, memset
+#include <time.h>   // For: clock_gettime, CLOCK_MONOTONIC
+#include <unistd.h> // For: sysconf, gethostname
+
+#include "gemm-tune.h"
+
+/* Calibration size: large enough that packing and the C tiles behave as
+   in the benchmark sizes, small enough to keep the search under a second
+   with the fast kernels. Not a power of two on purpose. */
+#define CALIBRATION_SIZE 480
+#define CALIBRATION_REPS 3
+
+static char summary[768] = "not tuned";
+
+/* ========================================================================== */
+/* Cache sizes                                                                */
+/* ========================================================================== */
+
+/* Reads the size of the data or unified cache of the given level of cpu0
+   from sysfs, 0 if not found. */
+static long sysfs_cache_size(int level) {
+  for (int index = 0; index < 8; ++index) {
+    char path[128], buf[64];
+    int  lvl = 0;
+    FILE* f;
+
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+    if ((f = fopen(path, "r")) == NULL) break;
+    if (fscanf(f, "%d", &lvl) != 1) lvl = 0;
+    fclose(f);
+    if (lvl != level) continue;
+
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu0/cache/index%d/type", index);
+    if ((f = fopen(path, "r")) == NULL) continue;
+    if (fgets(buf, sizeof(buf), f) == NULL) buf[0] = '\0';
+    fclose(f);
+    if (strncmp(buf, "Instruction", 11) == 0) continue;
+
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+    if ((f = fopen(path, "r")) == NULL) continue;
+    long size = 0;
+    char unit = 'K';
+    if (fscanf(f, "%ld%c", &size, &unit) < 1) size = 0;
+    fclose(f);
+    if (unit == 'K') size *= 1024;
+    if (unit == 'M') size *= 1024 * 1024;
+    return size;
+  }
+  return 0;
+}
+
+cache_sizes gemm_probe_caches(void) {
+  cache_sizes caches = {0, 0, 0};
+
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+  caches.l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+  caches.l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  caches.l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+
+  if (caches.l1 <= 0) caches.l1 = sysfs_cache_size(1);
+  if (caches.l2 <= 0) caches.l2 = sysfs_cache_size(2);
+  if (caches.l3 <= 0) caches.l3 = sysfs_cache_size(3);
+
+  if (caches.l1 <= 0) caches.l1 = 32 * 1024;
+  if (caches.l2 <= 0) caches.l2 = 256 * 1024;
+  if (caches.l3 <= 0) caches.l3 = caches.l2;
+
+  return caches;
+}
+
+/* ========================================================================== */
+/* Cache model                                                                */
+/* ========================================================================== */
+
+static int clamp(int x, int lo, int hi) {
+  return (x < lo) ? lo : (x > hi) ? hi : x;
+}
+
+/* The KC x NR micro-panel of B should fill about half of L1 (the rest holds
+   the streamed A micro-panel and C), the MC x KC block of A about half of
+   L2 and the KC x NC panel of B about half of L3. */
+static gemm_params model_params(const cache_sizes* caches, int kernel,
+                                int kc) {
+  const gemm_kernel_info* ki = &gemm_kernels[kernel];
+  gemm_params params;
+
+  params.kernel = kernel;
+  params.kc = kc;
+  params.mc = clamp((int) (caches->l2 / 2 / (8 * kc)), ki->mr, 1024);
+  params.mc = params.mc / ki->mr * ki->mr;
+  params.nc = clamp((int) (caches->l3 / 2 / (8 * kc)), ki->nr, 4096);
+  params.nc = params.nc / ki->nr * ki->nr;
+  gemm_fix_params(&params);
+  return params;
+}
+
+static int model_kc(const cache_sizes* caches, int kernel) {
+  int kc = (int) (caches->l1 / 2 / (8 * gemm_kernels[kernel].nr));
+  return clamp(kc / 8 * 8, 64, 512);
+}
+
+gemm_params gemm_model_params(const cache_sizes* caches, int kernel) {
+  return model_params(caches, kernel, model_kc(caches, kernel));
+}
+
+/* ========================================================================== */
+/* Search                                                                     */
+/* ========================================================================== */
+
+static double seconds_now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return 1.*t.tv_sec + 1.e-9*t.tv_nsec;
+}
+
+/* Best-of-reps rate of one n x n multiply with the given parameters. */
+static double time_params(const gemm_params* params, int n,
+                          const double* A, const double* B, double* C) {
+  double best = 0.;
+  for (int rep = 0; rep < CALIBRATION_REPS; ++rep) {
+    double t = seconds_now();
+    packed_dgemm(params, n, n, n, 1., A, 1, n, B, 1, n, C, n);
+    t = seconds_now() - t;
+    double gflops = 2.e-9 * n * n * n / t;
+    if (gflops > best) best = gflops;
+  }
+  return best;
+}
+
+gemm_params gemm_search(const cache_sizes* caches, int n, double* gflops) {
+  gemm_params best = gemm_model_params(caches, 0);
+  double best_gflops = 0.;
+
+  double* buf = (double*) malloc(3 * (size_t) n * n * sizeof(double));
+  if (buf == NULL) {
+    if (gflops) *gflops = 0.;
+    return best;
+  }
+  double* A = buf;
+  double* B = A + (size_t) n * n;
+  double* C = B + (size_t) n * n;
+
+  /* Deterministic data, so the caller's drand48 sequence is untouched. */
+  for (size_t i = 0; i < (size_t) n * n; ++i) {
+    A[i] = (double) (i % 17) / 17. - 0.5;
+    B[i] = (double) (i % 13) / 13. - 0.5;
+  }
+  memset(C, 0, (size_t) n * n * sizeof(double));
+
+  /* Per kernel, the cache model first, then KC around it (with MC and NC
+     following the model), then MC around the best KC. */
+  static const int kc_scale[] = {2, 3, 6}; // in quarters of the model value
+  static const int mc_scale[] = {2, 3, 6, 8};
+
+  for (int kernel = 0; kernel < gemm_nkernels; ++kernel) {
+    int kc0 = model_kc(caches, kernel);
+    gemm_params local = model_params(caches, kernel, kc0);
+    double local_gflops = time_params(&local, n, A, B, C);
+
+    for (int s = 0; s < 3; ++s) {
+      int kc = clamp(kc0 * kc_scale[s] / 4 / 8 * 8, 32, 1024);
+      gemm_params p = model_params(caches, kernel, kc);
+      double g = time_params(&p, n, A, B, C);
+      if (g > local_gflops) { local = p; local_gflops = g; }
+    }
+
+    int mc0 = local.mc;
+    for (int s = 0; s < 4; ++s) {
+      gemm_params p = local;
+      p.mc = mc0 * mc_scale[s] / 4;
+      gemm_fix_params(&p);
+      if (p.mc == mc0) continue;
+      double g = time_params(&p, n, A, B, C);
+      if (g > local_gflops) { local = p; local_gflops = g; }
+    }
+
+    if (local_gflops > best_gflops) { best = local; best_gflops = local_gflops; }
+  }
+
+  free(buf);
+  if (gflops) *gflops = best_gflops;
+  return best;
+}
+
+/* ========================================================================== */
+/* Tuning file                                                                */
+/* ========================================================================== */
+
+/* Home directories are often shared between the nodes of a cluster, hence
+   the host name in the file name. */
+static void tune_file_name(char* path, size_t size) {
+  const char* env = getenv("GEMM_TUNE_FILE");
+  if (env != NULL && env[0] != '\0') {
+    snprintf(path, size, "%s", env);
+    return;
+  }
+
+  char host[64] = "localhost";
+  gethostname(host, sizeof(host));
+  host[sizeof(host) - 1] = '\0';
+
+  const char* home = getenv("HOME");
+  snprintf(path, size, "%s/.packed-gemm-%s", home ? home : ".", host);
+}
+
+/* Returns 1 if the file exists and names a kernel of this build. */
+static int read_params(const char* path, gemm_params* params) {
+  FILE* f = fopen(path, "r");
+  if (f == NULL) return 0;
+
+  char line[128], name[64] = "";
+  gemm_params p = {0, 0, 0, -1};
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (line[0] == '#') continue;
+    if (sscanf(line, "kernel = %63[^\n]", name) == 1) continue;
+    if (sscanf(line, "mc = %d", &p.mc) == 1) continue;
+    if (sscanf(line, "kc = %d", &p.kc) == 1) continue;
+    if (sscanf(line, "nc = %d", &p.nc) == 1) continue;
+  }
+  fclose(f);
+
+  for (int kernel = 0; kernel < gemm_nkernels; ++kernel) {
+    if (strcmp(name, gemm_kernels[kernel].name) == 0) p.kernel = kernel;
+  }
+  if (p.kernel < 0 || p.mc <= 0 || p.kc <= 0 || p.nc <= 0) return 0;
+
+  gemm_fix_params(&p);
+  *params = p;
+  return 1;
+}
+
+static int write_params(const char* path, const gemm_params* params,
+                        const cache_sizes* caches, double gflops) {
+  FILE* f = fopen(path, "w");
+  if (f == NULL) return 0;
+
+  fprintf(f, "# packed_dgemm parameters, found on a %dx%d calibration run\n",
+          CALIBRATION_SIZE, CALIBRATION_SIZE);
+  fprintf(f, "# L1 %ld KiB, L2 %ld KiB, L3 %ld KiB, %.2f Gflop/s\n",
+          caches->l1 / 1024, caches->l2 / 1024, caches->l3 / 1024, gflops);
+  fprintf(f, "kernel = %s\n", gemm_kernels[params->kernel].name);
+  fprintf(f, "mc = %d\n", params->mc);
+  fprintf(f, "kc = %d\n", params->kc);
+  fprintf(f, "nc = %d\n", params->nc);
+  return fclose(f) == 0;
+}
+
+gemm_params gemm_tuned_params(void) {
+  char path[512];
+  tune_file_name(path, sizeof(path));
+
+  cache_sizes caches = gemm_probe_caches();
+  gemm_params params;
+  const char* source;
+  double gflops = 0.;
+
+  const char* retune = getenv("GEMM_RETUNE");
+  if ((retune == NULL || retune[0] == '\0' || retune[0] == '0') &&
+      read_params(path, &params)) {
+    source = "read from";
+  } else {
+    params = gemm_search(&caches, CALIBRATION_SIZE, &gflops);
+    source = write_params(path, &params, &caches, gflops)
+             ? "tuned, saved to" : "tuned, could not write";
+  }
+
+  snprintf(summary, sizeof(summary),
+           "kernel %s, MC %d, KC %d, NC %d (L1 %ld KiB, L2 %ld KiB, "
+           "L3 %ld KiB; %s %s)",
+           gemm_kernels[params.kernel].name, params.mc, params.kc, params.nc,
+           caches.l1 / 1024, caches.l2 / 1024, caches.l3 / 1024, source, path);
+  return params;
+}
+
+const char* gemm_tuning_summary(void) {
+  return summary;
+}
@@ -0,0 +1,40 @@
+// gemm-tune.h
+//
+// Run-time choice of the packed_dgemm parameters (see packed-gemm.h). The
+// cache sizes of the machine are probed, a short search over MC/KC/NC and
+// the microkernels of this build is timed on a calibration problem, and the
+// winner is stored in a per-host file so the search runs once per machine.
+
+#ifndef GEMM_TUNE_H
+#define GEMM_TUNE_H
+
+#include "packed-gemm.h"
+
+/* Data cache sizes in bytes; per core for L1 and L2, per socket for L3. */
+typedef struct {
+  long l1;
+  long l2;
+  long l3;
+} cache_sizes;
+
+/* Queries sysconf, then sysfs, and falls back to conservative defaults. */
+cache_sizes gemm_probe_caches(void);
+
+/* Parameters derived from the cache sizes alone (no timing). */
+gemm_params gemm_model_params(const cache_sizes* caches, int kernel);
+
+/* Times candidate parameters around the cache model on an n x n multiply
+   and returns the fastest; gflops receives its rate if not NULL. */
+gemm_params gemm_search(const cache_sizes* caches, int n, double* gflops);
+
+/* Parameters for this host: read from the tuning file if it exists and
+   matches this build, otherwise searched for and written to it.
+   The file is $GEMM_TUNE_FILE, or $HOME/.packed-gemm-<hostname>; setting
+   GEMM_RETUNE forces a new search. */
+gemm_params gemm_tuned_params(void);
+
+/* One-line description of the parameters returned by the last call to
+   gemm_tuned_params, including where they came from. */
+const char* gemm_tuning_summary(void);
+
+#endif // GEMM_TUNE_H
@@ -0,0 +1,390 @@
+// gemm.cpp
+//
+// Templated packed matrix multiply, see gemm.hpp.
+
+#include "gemm.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+extern "C" {
+#include "gemm-tune.h"
+}
+
+namespace gemm {
+
+namespace {
+
+constexpr int alignment = 64;
+
+/* ========================================================================== */
+/* Types                                                                      */
+/* ========================================================================== */
+
+/* Real scalar type of T and number of real components (1 or 2). Packed
+   panels are arrays of real values; component c of a complex is its real
+   (c = 0) or imaginary (c = 1) part. */
+template <class T>
+struct traits {
+    using real = T;
+    static constexpr int comps = 1;
+    static real part(const T& x, int) { return x; }
+};
+
+template <class R>
+struct traits<std::complex<R>> {
+    using real = R;
+    static constexpr int comps = 2;
+    static real part(const std::complex<R>& x, int c) { return c ? x.imag() : x.real(); }
+};
+
+/* ========================================================================== */
+/* SIMD registers                                                             */
+/* ========================================================================== */
+
+/* One SIMD register of R: width lanes, aligned load from packed panels,
+   unaligned load/store for C, broadcast and fused multiply-adds. */
+template <class R>
+struct scalar_vec {
+    using real = R;
+    using reg = R;
+    static constexpr int width = 1;
+    static reg zero() { return R(0); }
+    static reg load(const R* p) { return *p; }
+    static reg loadu(const R* p) { return *p; }
+    static void storeu(R* p, reg x) { *p = x; }
+    static reg set1(R x) { return x; }
+    static reg fmadd(reg a, reg b, reg c) { return a * b + c; }
+    static reg fnmadd(reg a, reg b, reg c) { return c - a * b; }
+};
+
+#define SIMD_VEC(NAME, R, REG, W, SUFFIX, PREFIX)                                   \
+    struct NAME {                                                                   \
+        using real = R;                                                             \
+        using reg = REG;                                                            \
+        static constexpr int width = W;                                             \
+        static reg zero() { return PREFIX##_setzero_##SUFFIX(); }                   \
+        static reg load(const R* p) { return PREFIX##_load_##SUFFIX(p); }           \
+        static reg loadu(const R* p) { return PREFIX##_loadu_##SUFFIX(p); }         \
+        static void storeu(R* p, reg x) { PREFIX##_storeu_##SUFFIX(p, x); }         \
+        static reg set1(R x) { return PREFIX##_set1_##SUFFIX(x); }                  \
+        static reg fmadd(reg a, reg b, reg c) { return PREFIX##_fmadd_##SUFFIX(a, b, c); }   \
+        static reg fnmadd(reg a, reg b, reg c) { return PREFIX##_fnmadd_##SUFFIX(a, b, c); } \
+    };
+
+#if defined(__AVX512F__)
+SIMD_VEC(avx512_d, double, __m512d, 8, pd, _mm512)
+SIMD_VEC(avx512_s, float, __m512, 16, ps, _mm512)
+#endif
+#if defined(__AVX2__) && defined(__FMA__)
+SIMD_VEC(avx2_d, double, __m256d, 4, pd, _mm256)
+SIMD_VEC(avx2_s, float, __m256, 8, ps, _mm256)
+#endif
+
+#undef SIMD_VEC
+
+/* ========================================================================== */
+/* Microkernels                                                               */
+/* ========================================================================== */
+
+/* C[0:MR, 0:NR] += alpha * Ap * Bp for real types: Ap holds MR values per
+   step of the inner dimension, Bp NR values. */
+template <class V, int MR, int NR>
+void real_kernel(int kc, const typename V::real* Ap, const typename V::real* Bp,
+                 typename V::real* C, int ldc, typename V::real alpha) {
+    constexpr int W = V::width, R = MR / W;
+    static_assert(MR % W == 0, "MR must be a multiple of the SIMD width");
+
+    typename V::reg acc[R][NR];
+    for (int j = 0; j < NR; ++j)
+        for (int r = 0; r < R; ++r) acc[r][j] = V::zero();
+
+    for (int p = 0; p < kc; ++p) {
+        typename V::reg a[R];
+        for (int r = 0; r < R; ++r) a[r] = V::load(Ap + p * MR + r * W);
+        for (int j = 0; j < NR; ++j) {
+            typename V::reg b = V::set1(Bp[p * NR + j]);
+            for (int r = 0; r < R; ++r) acc[r][j] = V::fmadd(a[r], b, acc[r][j]);
+        }
+    }
+
+    typename V::reg va = V::set1(alpha);
+    for (int j = 0; j < NR; ++j) {
+        for (int r = 0; r < R; ++r) {
+            typename V::real* c = C + j * ldc + r * W;
+            V::storeu(c, V::fmadd(va, acc[r][j], V::loadu(c)));
+        }
+    }
+}
+
+/* Complex tile with split parts: per step Ap holds MR real parts then MR
+   imaginary parts, Bp holds NR (real, imaginary) pairs. Real and imaginary
+   parts of the tile are accumulated in separate registers. */
+template <class V, int MR, int NR>
+void complex_kernel(int kc, const typename V::real* Ap, const typename V::real* Bp,
+                    std::complex<typename V::real>* C, int ldc,
+                    std::complex<typename V::real> alpha) {
+    using R = typename V::real;
+    constexpr int W = V::width, NV = MR / W;
+    static_assert(MR % W == 0, "MR must be a multiple of the SIMD width");
+
+    typename V::reg re[NV][NR], im[NV][NR];
+    for (int j = 0; j < NR; ++j)
+        for (int r = 0; r < NV; ++r) re[r][j] = im[r][j] = V::zero();
+
+    for (int p = 0; p < kc; ++p) {
+        typename V::reg ar[NV], ai[NV];
+        for (int r = 0; r < NV; ++r) {
+            ar[r] = V::load(Ap + 2 * p * MR + r * W);
+            ai[r] = V::load(Ap + 2 * p * MR + MR + r * W);
+        }
+        for (int j = 0; j < NR; ++j) {
+            typename V::reg br = V::set1(Bp[2 * (p * NR + j)]);
+            typename V::reg bi = V::set1(Bp[2 * (p * NR + j) + 1]);
+            for (int r = 0; r < NV; ++r) {
+                re[r][j] = V::fmadd(ar[r], br, re[r][j]);
+                re[r][j] = V::fnmadd(ai[r], bi, re[r][j]);
+                im[r][j] = V::fmadd(ar[r], bi, im[r][j]);
+                im[r][j] = V::fmadd(ai[r], br, im[r][j]);
+            }
+        }
+    }
+
+    // O(MR * NR) per tile against O(MR * NR * kc) above: done in scalar
+    alignas(alignment) R tre[MR], tim[MR];
+    for (int j = 0; j < NR; ++j) {
+        for (int r = 0; r < NV; ++r) {
+            V::storeu(tre + r * W, re[r][j]);
+            V::storeu(tim + r * W, im[r][j]);
+        }
+        for (int i = 0; i < MR; ++i) C[i + j * ldc] += alpha * std::complex<R>(tre[i], tim[i]);
+    }
+}
+
+/* Microkernel, register tile and name for T. The largest SIMD width
+   enabled at compile time wins. */
+template <class T>
+struct kernel;
+
+#if defined(__AVX512F__)
+template <> struct kernel<double> {
+    static constexpr int mr = 24, nr = 8;
+    static constexpr const char* name = "avx512 24x8";
+    static constexpr auto run = real_kernel<avx512_d, mr, nr>;
+};
+template <> struct kernel<float> {
+    static constexpr int mr = 48, nr = 8;
+    static constexpr const char* name = "avx512 48x8";
+    static constexpr auto run = real_kernel<avx512_s, mr, nr>;
+};
+template <> struct kernel<std::complex<double>> {
+    static constexpr int mr = 16, nr = 6;
+    static constexpr const char* name = "avx512 split 16x6";
+    static constexpr auto run = complex_kernel<avx512_d, mr, nr>;
+};
+template <> struct kernel<std::complex<float>> {
+    static constexpr int mr = 32, nr = 6;
+    static constexpr const char* name = "avx512 split 32x6";
+    static constexpr auto run = complex_kernel<avx512_s, mr, nr>;
+};
+#elif defined(__AVX2__) && defined(__FMA__)
+template <> struct kernel<double> {
+    static constexpr int mr = 8, nr = 6;
+    static constexpr const char* name = "avx2 8x6";
+    static constexpr auto run = real_kernel<avx2_d, mr, nr>;
+};
+template <> struct kernel<float> {
+    static constexpr int mr = 16, nr = 6;
+    static constexpr const char* name = "avx2 16x6";
+    static constexpr auto run = real_kernel<avx2_s, mr, nr>;
+};
+template <> struct kernel<std::complex<double>> {
+    static constexpr int mr = 8, nr = 2;
+    static constexpr const char* name = "avx2 split 8x2";
+    static constexpr auto run = complex_kernel<avx2_d, mr, nr>;
+};
+template <> struct kernel<std::complex<float>> {
+    static constexpr int mr = 16, nr = 2;
+    static constexpr const char* name = "avx2 split 16x2";
+    static constexpr auto run = complex_kernel<avx2_s, mr, nr>;
+};
+#else
+template <> struct kernel<double> {
+    static constexpr int mr = 4, nr = 4;
+    static constexpr const char* name = "scalar 4x4";
+    static constexpr auto run = real_kernel<scalar_vec<double>, mr, nr>;
+};
+template <> struct kernel<float> {
+    static constexpr int mr = 4, nr = 4;
+    static constexpr const char* name = "scalar 4x4";
+    static constexpr auto run = real_kernel<scalar_vec<float>, mr, nr>;
+};
+template <> struct kernel<std::complex<double>> {
+    static constexpr int mr = 2, nr = 2;
+    static constexpr const char* name = "scalar split 2x2";
+    static constexpr auto run = complex_kernel<scalar_vec<double>, mr, nr>;
+};
+template <> struct kernel<std::complex<float>> {
+    static constexpr int mr = 2, nr = 2;
+    static constexpr const char* name = "scalar split 2x2";
+    static constexpr auto run = complex_kernel<scalar_vec<float>, mr, nr>;
+};
+#endif
+
+/* ========================================================================== */
+/* Packing                                                                    */
+/* ========================================================================== */
+
+/* mc x kc block of A into MR-row micro-panels, zero-padded; per step of the
+   inner dimension the comps parts follow each other (MR values each). */
+template <class T, int MR>
+void pack_A(int mc, int kc, const T* A, int rsa, int csa, typename traits<T>::real* Ap) {
+    constexpr int CP = traits<T>::comps;
+    for (int i0 = 0; i0 < mc; i0 += MR) {
+        const int mr = std::min(MR, mc - i0);
+        const T* a = A + i0 * rsa;
+        for (int p = 0; p < kc; ++p) {
+            for (int c = 0; c < CP; ++c) {
+                auto* dst = Ap + (p * CP + c) * MR;
+                for (int i = 0; i < mr; ++i) dst[i] = traits<T>::part(a[i * rsa + p * csa], c);
+                for (int i = mr; i < MR; ++i) dst[i] = 0;
+            }
+        }
+        Ap += MR * kc * CP;
+    }
+}
+
+/* kc x nc panel of B into NR-column micro-panels, zero-padded; the parts of
+   one element are adjacent. */
+template <class T, int NR>
+void pack_B(int kc, int nc, const T* B, int rsb, int csb, typename traits<T>::real* Bp) {
+    constexpr int CP = traits<T>::comps;
+    for (int j0 = 0; j0 < nc; j0 += NR) {
+        const int nr = std::min(NR, nc - j0);
+        const T* b = B + j0 * csb;
+        for (int p = 0; p < kc; ++p) {
+            auto* dst = Bp + p * NR * CP;
+            for (int j = 0; j < nr; ++j)
+                for (int c = 0; c < CP; ++c) dst[j * CP + c] = traits<T>::part(b[p * rsb + j * csb], c);
+            for (int j = nr * CP; j < NR * CP; ++j) dst[j] = 0;
+        }
+        Bp += NR * kc * CP;
+    }
+}
+
+/* Packing buffers, one pair per thread and type, grown on demand. */
+template <class R>
+R* grow(int which, std::size_t needed) {
+    thread_local R* buffer[2] = {nullptr, nullptr};
+    thread_local std::size_t size[2] = {0, 0};
+    if (needed > size[which]) {
+        std::free(buffer[which]);
+        void* p = nullptr;
+        if (posix_memalign(&p, alignment, needed * sizeof(R))) std::abort();
+        buffer[which] = static_cast<R*>(p);
+        size[which] = needed;
+    }
+    return buffer[which];
+}
+
+int round_up(int x, int multiple) {
+    return (std::max(x, 1) + multiple - 1) / multiple * multiple;
+}
+
+} // namespace
+
+/* ========================================================================== */
+/* Driver                                                                     */
+/* ========================================================================== */
+
+template <class T>
+const char* kernel_name() {
+    return kernel<T>::name;
+}
+
+/* Same cache model as gemm-tune.c, with the element size of T: the KC x NR
+   micro-panel of B in half of L1, the MC x KC block of A in half of L2, the
+   KC x NC panel of B in half of L3. */
+template <class T>
+params default_params() {
+    using K = kernel<T>;
+    const long bytes = sizeof(T);
+    cache_sizes caches = gemm_probe_caches();
+
+    params p;
+    p.kc = std::max(32, std::min(512, int(caches.l1 / 2 / (bytes * K::nr)) / 8 * 8));
+    p.mc = std::max(K::mr, std::min(1024, int(caches.l2 / 2 / (bytes * p.kc))) / K::mr * K::mr);
+    p.nc = std::max(K::nr, std::min(4096, int(caches.l3 / 2 / (bytes * p.kc))) / K::nr * K::nr);
+    return p;
+}
+
+template <class T>
+void gemm(const params& prm, int m, int n, int k, T alpha,
+          const T* A, int rsa, int csa,
+          const T* B, int rsb, int csb,
+          T* C, int ldc) {
+    using K = kernel<T>;
+    using R = typename traits<T>::real;
+    constexpr int MR = K::mr, NR = K::nr, CP = traits<T>::comps;
+
+    if (m <= 0 || n <= 0 || k <= 0 || alpha == T(0)) return;
+
+    const int MC = round_up(prm.mc, MR), NC = round_up(prm.nc, NR), KC = std::max(prm.kc, 1);
+    const int mc_max = std::min(MC, round_up(m, MR));
+    const int nc_max = std::min(NC, round_up(n, NR));
+    const int kc_max = std::min(KC, k);
+
+    R* Ap = grow<R>(0, std::size_t(mc_max) * kc_max * CP);
+    R* Bp = grow<R>(1, std::size_t(kc_max) * nc_max * CP);
+    alignas(alignment) T tile[MR * NR];
+
+    for (int jc = 0; jc < n; jc += NC) {
+        const int nc = std::min(NC, n - jc);
+        for (int pc = 0; pc < k; pc += KC) {
+            const int kc = std::min(KC, k - pc);
+            pack_B<T, NR>(kc, nc, B + pc * rsb + jc * csb, rsb, csb, Bp);
+            for (int ic = 0; ic < m; ic += MC) {
+                const int mc = std::min(MC, m - ic);
+                pack_A<T, MR>(mc, kc, A + ic * rsa + pc * csa, rsa, csa, Ap);
+
+                for (int j0 = 0; j0 < nc; j0 += NR) {
+                    const int nr = std::min(NR, nc - j0);
+                    const R* b = Bp + j0 * kc * CP;
+                    for (int i0 = 0; i0 < mc; i0 += MR) {
+                        const int mr = std::min(MR, mc - i0);
+                        const R* a = Ap + i0 * kc * CP;
+                        T* c = C + (ic + i0) + (jc + j0) * ldc;
+                        if (mr == MR && nr == NR) {
+                            K::run(kc, a, b, c, ldc, alpha);
+                        } else {
+                            std::fill(tile, tile + MR * NR, T(0));
+                            K::run(kc, a, b, tile, MR, alpha);
+                            for (int j = 0; j < nr; ++j)
+                                for (int i = 0; i < mr; ++i) c[i + j * ldc] += tile[i + j * MR];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+#define GEMM_INSTANTIATE(T)                                                   \
+    template params default_params<T>();                                      \
+    template const char* kernel_name<T>();                                    \
+    template void gemm<T>(const params&, int, int, int, T,                    \
+                          const T*, int, int, const T*, int, int, T*, int);
+
+GEMM_INSTANTIATE(float)
+GEMM_INSTANTIATE(double)
+GEMM_INSTANTIATE(std::complex<float>)
+GEMM_INSTANTIATE(std::complex<double>)
+
+#undef GEMM_INSTANTIATE
+
+} // namespace gemm
@@ -0,0 +1,67 @@
+// gemm.hpp
+//
+// Templated packed matrix multiply for float, double, std::complex<float>
+// and std::complex<double> (sgemm, dgemm, cgemm, zgemm). Same scheme as
+// packed-gemm.c: MC/KC/NC cache blocks copied into micro-panels, and an
+// MR x NR register tile updated by a microkernel. Packing, blocking and the
+// loop nest are shared by all types; only the microkernels are specific.
+// Complex operands are packed with real and imaginary parts split, so the
+// complex kernels run on plain real SIMD registers.
+
+#ifndef GEMM_HPP
+#define GEMM_HPP
+
+#include <complex>
+
+namespace gemm {
+
+/* Cache blocking parameters; mc and nc are rounded to the register tile. */
+struct params {
+    int mc;
+    int kc;
+    int nc;
+};
+
+/* Parameters from the cache sizes of this machine and the size of T. */
+template <class T>
+params default_params();
+
+/* Name and register tile of the microkernel used for T. */
+template <class T>
+const char* kernel_name();
+
+/* C := C + alpha * A * B with A m x k, B k x n and C m x n, C column-major.
+ * Element (i, p) of A is A[i*rsa + p*csa], element (p, j) of B is
+ * B[p*rsb + j*csb], as in packed_dgemm.
+ */
+template <class T>
+void gemm(const params& p, int m, int n, int k, T alpha,
+          const T* A, int rsa, int csa,
+          const T* B, int rsb, int csb,
+          T* C, int ldc);
+
+/* Column-major, no transposes, default parameters. */
+template <class T>
+void gemm(int m, int n, int k, T alpha, const T* A, int lda, const T* B, int ldb,
+          T* C, int ldc) {
+    static const params p = default_params<T>();
+    gemm(p, m, n, k, alpha, A, 1, lda, B, 1, ldb, C, ldc);
+}
+
+#define GEMM_DECLARE(T)                                                       \
+    extern template params default_params<T>();                               \
+    extern template const char* kernel_name<T>();                             \
+    extern template void gemm<T>(const params&, int, int, int, T,             \
+                                 const T*, int, int, const T*, int, int,      \
+                                 T*, int);
+
+GEMM_DECLARE(float)
+GEMM_DECLARE(double)
+GEMM_DECLARE(std::complex<float>)
+GEMM_DECLARE(std::complex<double>)
+
+#undef GEMM_DECLARE
+
+} // namespace gemm
+
+#endif // GEMM_HPP
@@ -0,0 +1,171 @@
+// packed-gemm-omp.c
+//
+// Threaded packed matrix multiply, see packed_dgemm_omp in packed-gemm.h.
+// Same loop nest as packed_dgemm, parallel in the BLIS way:
+//
+//   groups (sockets): split the columns of C, each group packs its own B
+//                     panel into memory local to the socket (first touch)
+//   threads of a group: pack the shared KC x NC panel of B together, then
+//                     split the ic loop and, if there are fewer MC blocks
+//                     than threads, the jr loop as well
+//
+// The packed A block is private to a thread. When the jr loop is split the
+// threads sharing an ic block each pack it; that is O(MC*KC) extra copies
+// against O(MC*KC*NC / jr_ways) flops, and saves a barrier per block.
+
+#include <stdio.h>  // For: FILE, fopen, fscanf, snprintf
+#include <stdlib.h> // For: posix_memalign, free, getenv, atoi, abort
+#include <unistd.h> // For: sysconf
+
+#include <omp.h>
+
+#include "packed-gemm.h"
+
+#define ALIGNMENT 64
+#define MAX_SOCKETS 64
+
+static int ceil_div(int a, int b) {
+  return (a + b - 1) / b;
+}
+
+static int min(int a, int b) {
+  return (a < b) ? a : b;
+}
+
+static double* aligned_buffer(size_t count) {
+  void* p = NULL;
+  if (posix_memalign(&p, ALIGNMENT, count * sizeof(double))) abort();
+  return (double*) p;
+}
+
+/* Number of distinct physical packages among the online CPUs, from sysfs;
+   $GEMM_GROUPS overrides it. */
+static int default_groups(void) {
+  const char* env = getenv("GEMM_GROUPS");
+  if (env != NULL && atoi(env) > 0) return atoi(env);
+
+  static int sockets = 0;
+  if (sockets > 0) return sockets;
+
+  int seen[MAX_SOCKETS] = {0};
+  long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+  for (long cpu = 0; cpu < ncpus; ++cpu) {
+    char path[128];
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%ld/topology/physical_package_id", cpu);
+    FILE* f = fopen(path, "r");
+    if (f == NULL) continue;
+    int id = 0;
+    if (fscanf(f, "%d", &id) == 1 && id >= 0 && id < MAX_SOCKETS) seen[id] = 1;
+    fclose(f);
+  }
+  for (int id = 0; id < MAX_SOCKETS; ++id) sockets += seen[id];
+  if (sockets == 0) sockets = 1;
+  return sockets;
+}
+
+/* One group of nthreads threads computing columns [n0, n1) of C. */
+static void run_group(const gemm_params* p, int nthreads, int n0, int n1,
+                      int m, int k, double alpha,
+                      const double* A, int rsa, int csa,
+                      const double* B, int rsb, int csb,
+                      double* C, int ldc) {
+  const gemm_kernel_info* ki = &gemm_kernels[p->kernel];
+  const int MR = ki->mr, NR = ki->nr;
+  const int MC = p->mc, KC = p->kc, NC = p->nc;
+
+  int nc_max = min(NC, ceil_div(n1 - n0, NR) * NR);
+  int mc_max = min(MC, ceil_div(m, MR) * MR);
+  int kc_max = min(KC, k);
+
+  // allocated by the group's first thread, first touched by the group
+  double* Bp = aligned_buffer((size_t) kc_max * nc_max);
+
+  #pragma omp parallel num_threads(nthreads) proc_bind(close)
+  {
+    const int tid = omp_get_thread_num(), nt = omp_get_num_threads();
+
+    // ic_ways x jr_ways = nt, as many ic ways as there are MC blocks
+    const int nb_ic = ceil_div(m, MC);
+    int ic_ways = nt;
+    while (ic_ways > 1 && (nt % ic_ways != 0 || ic_ways > nb_ic)) --ic_ways;
+    const int jr_ways = nt / ic_ways;
+    const int ic_id = tid / jr_ways, jr_id = tid % jr_ways;
+
+    double* Ap = aligned_buffer((size_t) mc_max * kc_max);
+
+    for (int jc = n0; jc < n1; jc += NC) {
+      int nc = min(n1 - jc, NC);
+      int npanels = ceil_div(nc, NR);
+
+      for (int pc = 0; pc < k; pc += KC) {
+        int kc = min(k - pc, KC);
+
+        // every thread packs its share of the NR micro-panels of B
+        int q0 = npanels * tid / nt, q1 = npanels * (tid + 1) / nt;
+        if (q1 > q0) {
+          gemm_pack_B(kc, min(nc, q1 * NR) - q0 * NR,
+                      B + pc*rsb + (jc + q0*NR)*csb, rsb, csb, NR,
+                      Bp + (size_t) q0 * NR * kc);
+        }
+        #pragma omp barrier
+
+        int r0 = npanels * jr_id / jr_ways * NR;
+        int r1 = min(nc, npanels * (jr_id + 1) / jr_ways * NR);
+        if (r1 > r0) {
+          for (int ic = ic_id * MC; ic < m; ic += ic_ways * MC) {
+            int mc = min(m - ic, MC);
+            gemm_pack_A(mc, kc, A + ic*rsa + pc*csa, rsa, csa, MR, Ap);
+            gemm_macro_kernel(ki, mc, r1 - r0, kc, alpha, Ap,
+                              Bp + (size_t) r0 * kc,
+                              C + ic + (jc + r0)*ldc, ldc);
+          }
+        }
+        // Bp is overwritten by the next pack
+        #pragma omp barrier
+      }
+    }
+
+    free(Ap);
+  }
+
+  free(Bp);
+}
+
+void packed_dgemm_omp(const gemm_params* params, int groups,
+                      int m, int n, int k, double alpha,
+                      const double* A, int rsa, int csa,
+                      const double* B, int rsb, int csb,
+                      double* C, int ldc) {
+  if (m <= 0 || n <= 0 || k <= 0 || alpha == 0.) return;
+
+  gemm_params p = *params;
+  gemm_fix_params(&p);
+  const int NR = gemm_kernels[p.kernel].nr;
+
+  const int nthreads = omp_get_max_threads();
+  if (groups <= 0) groups = default_groups();
+  if (groups > nthreads) groups = nthreads;
+
+  // columns per group in whole micro-panels; small n may need fewer groups
+  const int cols = ceil_div(ceil_div(n, groups), NR) * NR;
+  groups = ceil_div(n, cols);
+
+  if (groups == 1) {
+    run_group(&p, nthreads, 0, n, m, k, alpha, A, rsa, csa, B, rsb, csb, C, ldc);
+    return;
+  }
+
+  const int levels = omp_get_max_active_levels();
+  omp_set_max_active_levels(2);
+
+  #pragma omp parallel num_threads(groups) proc_bind(spread)
+  {
+    const int g = omp_get_thread_num();
+    const int size = nthreads / groups + (g < nthreads % groups);
+    const int n0 = g * cols, n1 = min(n, n0 + cols);
+    run_group(&p, size, n0, n1, m, k, alpha, A, rsa, csa, B, rsb, csb, C, ldc);
+  }
+
+  omp_set_max_active_levels(levels);
+}
@@ -0,0 +1,318 @@
+// packed-gemm.c
+//
+// Packed matrix multiply with MC/KC/NC cache blocking and MR x NR register
+// tiles, see packed-gemm.h. Loop order (outermost first), as in BLIS:
+//
+//   jc: NC columns of B and C        -> B panel packed once, lives in L3
+//   pc: KC of the inner dimension
+//   ic: MC rows of A and C           -> A block packed once, lives in L2
+//   jr: NR columns of the B panel    -> B micro-panel lives in L1
+//   ir: MR rows of the A block       -> microkernel, C tile in registers
+
+#include <stdlib.h> // For: posix_memalign, free
+#include <string.h> // For: memset
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include "packed-gemm.h"
+
+#define ALIGNMENT 64
+
+/* ========================================================================== */
+/* Microkernels                                                               */
+/* ========================================================================== */
+
+/* The register tile is held in fixed-size arrays indexed by loop counters
+   with compile-time bounds. The wrappers below call the bodies with constant
+   MR and NR, so the compiler unrolls everything and keeps the tile in
+   registers. */
+
+#define INLINE static inline __attribute__((always_inline))
+
+INLINE void kernel_scalar(int MR, int NR, int kc, const double* restrict a,
+                          const double* restrict b, double* restrict c,
+                          int ldc, double alpha) {
+  double acc[4][4] = {{0.}};
+  for (int p = 0; p < kc; ++p) {
+    for (int j = 0; j < NR; ++j) {
+      for (int i = 0; i < MR; ++i) {
+        acc[j][i] += a[p*MR + i] * b[p*NR + j];
+      }
+    }
+  }
+  for (int j = 0; j < NR; ++j) {
+    for (int i = 0; i < MR; ++i) {
+      c[i + j*ldc] += alpha * acc[j][i];
+    }
+  }
+}
+
+static void kernel_scalar_4x4(int kc, const double* a, const double* b,
+                              double* c, int ldc, double alpha) {
+  kernel_scalar(4, 4, kc, a, b, c, ldc, alpha);
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+INLINE void kernel_avx2(int MR, int NR, int kc, const double* restrict a,
+                        const double* restrict b, double* restrict c,
+                        int ldc, double alpha) {
+  __m256d acc[3][8];
+  for (int j = 0; j < NR; ++j) {
+    for (int r = 0; r < MR/4; ++r) acc[r][j] = _mm256_setzero_pd();
+  }
+  for (int p = 0; p < kc; ++p) {
+    __m256d av[3];
+    for (int r = 0; r < MR/4; ++r) av[r] = _mm256_load_pd(a + p*MR + 4*r);
+    for (int j = 0; j < NR; ++j) {
+      __m256d bj = _mm256_broadcast_sd(b + p*NR + j);
+      for (int r = 0; r < MR/4; ++r) {
+        acc[r][j] = _mm256_fmadd_pd(av[r], bj, acc[r][j]);
+      }
+    }
+  }
+  __m256d valpha = _mm256_set1_pd(alpha);
+  for (int j = 0; j < NR; ++j) {
+    for (int r = 0; r < MR/4; ++r) {
+      double* cij = c + j*ldc + 4*r;
+      _mm256_storeu_pd(cij, _mm256_fmadd_pd(valpha, acc[r][j],
+                                            _mm256_loadu_pd(cij)));
+    }
+  }
+}
+
+static void kernel_avx2_8x6(int kc, const double* a, const double* b,
+                            double* c, int ldc, double alpha) {
+  kernel_avx2(8, 6, kc, a, b, c, ldc, alpha);
+}
+
+static void kernel_avx2_12x4(int kc, const double* a, const double* b,
+                             double* c, int ldc, double alpha) {
+  kernel_avx2(12, 4, kc, a, b, c, ldc, alpha);
+}
+#endif
+
+#if defined(__AVX512F__)
+INLINE void kernel_avx512(int MR, int NR, int kc, const double* restrict a,
+                          const double* restrict b, double* restrict c,
+                          int ldc, double alpha) {
+  __m512d acc[3][12];
+  for (int j = 0; j < NR; ++j) {
+    for (int r = 0; r < MR/8; ++r) acc[r][j] = _mm512_setzero_pd();
+  }
+  for (int p = 0; p < kc; ++p) {
+    __m512d av[3];
+    for (int r = 0; r < MR/8; ++r) av[r] = _mm512_load_pd(a + p*MR + 8*r);
+    for (int j = 0; j < NR; ++j) {
+      __m512d bj = _mm512_set1_pd(b[p*NR + j]);
+      for (int r = 0; r < MR/8; ++r) {
+        acc[r][j] = _mm512_fmadd_pd(av[r], bj, acc[r][j]);
+      }
+    }
+  }
+  __m512d valpha = _mm512_set1_pd(alpha);
+  for (int j = 0; j < NR; ++j) {
+    for (int r = 0; r < MR/8; ++r) {
+      double* cij = c + j*ldc + 8*r;
+      _mm512_storeu_pd(cij, _mm512_fmadd_pd(valpha, acc[r][j],
+                                            _mm512_loadu_pd(cij)));
+    }
+  }
+}
+
+static void kernel_avx512_24x8(int kc, const double* a, const double* b,
+                               double* c, int ldc, double alpha) {
+  kernel_avx512(24, 8, kc, a, b, c, ldc, alpha);
+}
+
+static void kernel_avx512_16x12(int kc, const double* a, const double* b,
+                                double* c, int ldc, double alpha) {
+  kernel_avx512(16, 12, kc, a, b, c, ldc, alpha);
+}
+#endif
+
+const gemm_kernel_info gemm_kernels[] = {
+#if defined(__AVX512F__)
+  {"avx512 24x8",  24,  8, kernel_avx512_24x8},
+  {"avx512 16x12", 16, 12, kernel_avx512_16x12},
+#endif
+#if defined(__AVX2__) && defined(__FMA__)
+  {"avx2 8x6",      8,  6, kernel_avx2_8x6},
+  {"avx2 12x4",    12,  4, kernel_avx2_12x4},
+#endif
+  {"scalar 4x4",    4,  4, kernel_scalar_4x4},
+};
+
+const int gemm_nkernels = sizeof(gemm_kernels) / sizeof(gemm_kernels[0]);
+
+/* ========================================================================== */
+/* Parameters                                                                 */
+/* ========================================================================== */
+
+static int round_up(int x, int multiple) {
+  return (x + multiple - 1) / multiple * multiple;
+}
+
+void gemm_fix_params(gemm_params* params) {
+  if (params->kernel < 0 || params->kernel >= gemm_nkernels) params->kernel = 0;
+  const gemm_kernel_info* ki = &gemm_kernels[params->kernel];
+  params->mc = round_up(params->mc > 0 ? params->mc : 1, ki->mr);
+  params->nc = round_up(params->nc > 0 ? params->nc : 1, ki->nr);
+  if (params->kc < 1) params->kc = 1;
+}
+
+/* The A block (MC x KC) should take about half of L2 and the B micro-panel
+   (KC x NR) a fraction of L1: with 8-byte doubles KC = 256 gives 12-16 KiB
+   B micro-panels, MC ~ 128 gives a 256 KiB A block. */
+gemm_params gemm_default_params(void) {
+  gemm_params params = {128, 256, 4096, 0};
+  gemm_fix_params(&params);
+  return params;
+}
+
+/* ========================================================================== */
+/* Packing                                                                    */
+/* ========================================================================== */
+
+/* Packs the mc x kc block of A starting at A into micro-panels of MR rows.
+   The last micro-panel is padded with zeros, so the kernel can always run
+   on a full register tile. */
+void gemm_pack_A(int mc, int kc, const double* A, int rsa, int csa,
+                 int MR, double* restrict Ap) {
+  for (int i0 = 0; i0 < mc; i0 += MR) {
+    int mr = (mc - i0 < MR) ? mc - i0 : MR;
+    const double* a = A + i0*rsa;
+    if (rsa == 1 && mr == MR) {
+      for (int p = 0; p < kc; ++p) {
+        memcpy(Ap + p*MR, a + p*csa, MR * sizeof(double));
+      }
+    } else if (csa == 1) {
+      // transposed A: read rows of A contiguously
+      for (int i = 0; i < mr; ++i) {
+        for (int p = 0; p < kc; ++p) Ap[p*MR + i] = a[i*rsa + p];
+      }
+      for (int i = mr; i < MR; ++i) {
+        for (int p = 0; p < kc; ++p) Ap[p*MR + i] = 0.;
+      }
+    } else {
+      for (int p = 0; p < kc; ++p) {
+        for (int i = 0; i < mr; ++i) Ap[p*MR + i] = a[i*rsa + p*csa];
+        for (int i = mr; i < MR; ++i) Ap[p*MR + i] = 0.;
+      }
+    }
+    Ap += MR * kc;
+  }
+}
+
+/* Packs the kc x nc panel of B starting at B into micro-panels of NR
+   columns stored row after row, padded with zeros like gemm_pack_A. */
+void gemm_pack_B(int kc, int nc, const double* B, int rsb, int csb,
+                 int NR, double* restrict Bp) {
+  for (int j0 = 0; j0 < nc; j0 += NR) {
+    int nr = (nc - j0 < NR) ? nc - j0 : NR;
+    const double* b = B + j0*csb;
+    if (rsb == 1) {
+      // column-major B: read columns of B contiguously
+      for (int j = 0; j < nr; ++j) {
+        for (int p = 0; p < kc; ++p) Bp[p*NR + j] = b[p + j*csb];
+      }
+      for (int j = nr; j < NR; ++j) {
+        for (int p = 0; p < kc; ++p) Bp[p*NR + j] = 0.;
+      }
+    } else {
+      for (int p = 0; p < kc; ++p) {
+        for (int j = 0; j < nr; ++j) Bp[p*NR + j] = b[p*rsb + j*csb];
+        for (int j = nr; j < NR; ++j) Bp[p*NR + j] = 0.;
+      }
+    }
+    Bp += NR * kc;
+  }
+}
+
+/* ========================================================================== */
+/* Driver                                                                     */
+/* ========================================================================== */
+
+/* Packing buffers are kept between calls so that small multiplies do not pay
+   for malloc/free and fresh page faults every time. One set per thread, so
+   that packed_dgemm can be called from several threads at once (e.g. the
+   OpenMP tasks of strassen.c). */
+static __thread double* buffer_A = NULL;
+static __thread double* buffer_B = NULL;
+static __thread size_t size_A = 0;
+static __thread size_t size_B = 0;
+
+static double* grow(double** buffer, size_t* size, size_t needed) {
+  if (needed > *size) {
+    free(*buffer);
+    if (posix_memalign((void**) buffer, ALIGNMENT, needed * sizeof(double))) {
+      *buffer = NULL;
+      *size = 0;
+      return NULL;
+    }
+    *size = needed;
+  }
+  return *buffer;
+}
+
+/* Runs the register tiles of one packed mc x nc block of C. Edge tiles are
+   computed into a scratch tile and added to C afterwards. */
+void gemm_macro_kernel(const gemm_kernel_info* ki, int mc, int nc, int kc,
+                       double alpha, const double* Ap, const double* Bp,
+                       double* C, int ldc) {
+  const int MR = ki->mr, NR = ki->nr;
+  double tile[24 * 12] __attribute__((aligned(ALIGNMENT)));
+
+  for (int j0 = 0; j0 < nc; j0 += NR) {
+    int nr = (nc - j0 < NR) ? nc - j0 : NR;
+    const double* b = Bp + j0 * kc;
+    for (int i0 = 0; i0 < mc; i0 += MR) {
+      int mr = (mc - i0 < MR) ? mc - i0 : MR;
+      const double* a = Ap + i0 * kc;
+      double* c = C + i0 + j0 * ldc;
+      if (mr == MR && nr == NR) {
+        ki->kernel(kc, a, b, c, ldc, alpha);
+      } else {
+        memset(tile, 0, MR * NR * sizeof(double));
+        ki->kernel(kc, a, b, tile, MR, alpha);
+        for (int j = 0; j < nr; ++j) {
+          for (int i = 0; i < mr; ++i) c[i + j*ldc] += tile[i + j*MR];
+        }
+      }
+    }
+  }
+}
+
+void packed_dgemm(const gemm_params* params, int m, int n, int k, double alpha,
+                  const double* A, int rsa, int csa,
+                  const double* B, int rsb, int csb,
+                  double* C, int ldc) {
+  if (m <= 0 || n <= 0 || k <= 0 || alpha == 0.) return;
+
+  gemm_params p = *params;
+  gemm_fix_params(&p);
+  const gemm_kernel_info* ki = &gemm_kernels[p.kernel];
+
+  const int MC = p.mc, KC = p.kc, NC = p.nc;
+  int nc_max = (n < NC) ? round_up(n, ki->nr) : NC;
+  int mc_max = (m < MC) ? round_up(m, ki->mr) : MC;
+  int kc_max = (k < KC) ? k : KC;
+
+  double* Ap = grow(&buffer_A, &size_A, (size_t) mc_max * kc_max);
+  double* Bp = grow(&buffer_B, &size_B, (size_t) kc_max * nc_max);
+  if (Ap == NULL || Bp == NULL) abort();
+
+  for (int jc = 0; jc < n; jc += NC) {
+    int nc = (n - jc < NC) ? n - jc : NC;
+    for (int pc = 0; pc < k; pc += KC) {
+      int kc = (k - pc < KC) ? k - pc : KC;
+      gemm_pack_B(kc, nc, B + pc*rsb + jc*csb, rsb, csb, ki->nr, Bp);
+      for (int ic = 0; ic < m; ic += MC) {
+        int mc = (m - ic < MC) ? m - ic : MC;
+        gemm_pack_A(mc, kc, A + ic*rsa + pc*csa, rsa, csa, ki->mr, Ap);
+        gemm_macro_kernel(ki, mc, nc, kc, alpha, Ap, Bp, C + ic + jc*ldc, ldc);
+      }
+    }
+  }
+}
@@ -0,0 +1,89 @@
+// packed-gemm.h
+//
+// BLIS-style packed matrix multiply. The operands are cut into cache blocks
+// (NC columns of B, KC of the inner dimension, MC rows of A), each block is
+// copied into contiguous micro-panels, and an MR x NR register tile of C is
+// updated at a time by a microkernel written with FMA intrinsics.
+
+#ifndef PACKED_GEMM_H
+#define PACKED_GEMM_H
+
+/* A microkernel computes one MR x NR register tile
+ *
+ *   C[0:MR, 0:NR] := C[0:MR, 0:NR] + alpha * Ap * Bp
+ *
+ * where Ap is an MR x kc micro-panel of A stored column after column and Bp
+ * a kc x NR micro-panel of B stored row after row. C is column-major.
+ */
+typedef void (*gemm_ukernel)(int kc, const double* Ap, const double* Bp,
+                             double* C, int ldc, double alpha);
+
+typedef struct {
+  const char*  name;
+  int          mr;
+  int          nr;
+  gemm_ukernel kernel;
+} gemm_kernel_info;
+
+/* Microkernels compiled into this build, best one first. Which ones exist
+   depends on the instruction set enabled at compile time (-march=native). */
+extern const gemm_kernel_info gemm_kernels[];
+extern const int gemm_nkernels;
+
+/* Cache blocking parameters and microkernel used by packed_dgemm. */
+typedef struct {
+  int mc;     // rows of A per packed block (multiple of the kernel's MR)
+  int kc;     // depth of the packed blocks
+  int nc;     // columns of B per packed panel (multiple of the kernel's NR)
+  int kernel; // index into gemm_kernels
+} gemm_params;
+
+/* Reasonable parameters for the best kernel of this build. */
+gemm_params gemm_default_params(void);
+
+/* Rounds mc and nc to multiples of the kernel's register tile. */
+void gemm_fix_params(gemm_params* params);
+
+/* C := C + alpha * A * B, with A m x k, B k x n and C m x n column-major.
+ *
+ * Element (i, p) of A is A[i*rsa + p*csa]: rsa = 1, csa = lda for a
+ * column-major operand, rsa = lda, csa = 1 for a transposed one. The same
+ * holds for B with rsb and csb. The packing absorbs the strides, so the
+ * microkernel always sees unit-stride panels.
+ */
+void packed_dgemm(const gemm_params* params, int m, int n, int k, double alpha,
+                  const double* A, int rsa, int csa,
+                  const double* B, int rsb, int csb,
+                  double* C, int ldc);
+
+/* Threaded C := C + alpha * A * B with the same arguments as packed_dgemm
+ * (packed-gemm-omp.c, needs OpenMP). The team is split into groups, one per
+ * socket by default, that work on separate column ranges of C with their
+ * own packed B panel; inside a group the threads pack the shared B panel
+ * together and split the MC and NR loops. groups <= 0 picks the number of
+ * sockets (or $GEMM_GROUPS).
+ */
+void packed_dgemm_omp(const gemm_params* params, int groups,
+                      int m, int n, int k, double alpha,
+                      const double* A, int rsa, int csa,
+                      const double* B, int rsb, int csb,
+                      double* C, int ldc);
+
+/* Building blocks of packed_dgemm, shared with the threaded driver. */
+
+/* Packs the mc x kc block at A into MR-row micro-panels (zero-padded). */
+void gemm_pack_A(int mc, int kc, const double* A, int rsa, int csa,
+                 int MR, double* Ap);
+
+/* Packs the kc x nc panel at B into NR-column micro-panels (zero-padded).
+   Micro-panel j of the result starts at Bp + j*NR*kc, so disjoint ranges of
+   micro-panels can be packed independently. */
+void gemm_pack_B(int kc, int nc, const double* B, int rsb, int csb,
+                 int NR, double* Bp);
+
+/* C[0:mc, 0:nc] += alpha * Ap * Bp for packed Ap (mc x kc) and Bp (kc x nc). */
+void gemm_macro_kernel(const gemm_kernel_info* ki, int mc, int nc, int kc,
+                       double alpha, const double* Ap, const double* Bp,
+                       double* C, int ldc);
+
+#endif // PACKED_GEMM_H
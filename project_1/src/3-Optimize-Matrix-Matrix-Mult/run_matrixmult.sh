@@ -21,6 +21,17 @@ srun ./benchmark-blas | tee timing_blas_dgemm.data
 echo
 echo "==== benchmark-blocked ===================="
 srun ./benchmark-blocked | tee timing_blocked_dgemm.data
+echo
+echo "==== benchmark-packed ====================="
+srun ./benchmark-packed | tee timing_packed_dgemm.data
+
+
+echo
+echo "==== statistics (JSON) ===================="
+for b in naive blas blocked packed; do
+  srun ./benchmark-$b stats stats_$b.json
+done
+OMP_NUM_THREADS=$SLURM_CPUS_PER_TASK srun ./benchmark-blocked-omp stats stats_blocked_omp.json
 
 echo
 echo "==== plot results ========================="
@@ -0,0 +1,307 @@
+// strassen.c
+//
+// Strassen-Winograd recursion, see strassen.h. With quadrants X11, X12,
+// X21, X22 of A, B and C, each level computes
+//
+//   S1 = A21 + A22   S2 = S1 - A11   S3 = A11 - A21   S4 = A12 - S2
+//   T1 = B12 - B11   T2 = B22 - T1   T3 = B22 - B12   T4 = T2 - B21
+//
+//   M1 = A11 B11   M2 = A12 B21   M3 = S4 B22   M4 = A22 T4
+//   M5 = S1 T1     M6 = S2 T2     M7 = S3 T3
+//
+//   C11 += M1 + M2              C12 += M1 + M3 + M5 + M6
+//   C21 += M1 - M4 + M6 + M7    C22 += M1 + M5 + M6 + M7
+//
+// Serial levels use two sum buffers and one product buffer, reusing them
+// product after product. Task levels compute all sums first and give every
+// product its own buffer and its own workspace for the levels below.
+
+#include <math.h>   // For: pow, log2
+#include <stdio.h>  // For: snprintf
+#include <stdlib.h> // For: posix_memalign, free, getenv, atoi, abort
+#include <string.h> // For: memset
+#include <time.h>   // For: clock_gettime, CLOCK_MONOTONIC
+
+#include <omp.h>
+
+#include "strassen.h"
+#include "packed-gemm.h"
+#include "gemm-tune.h"
+
+#define ALIGNMENT 64
+
+/* Sizes timed by the cutoff search; above the largest one the recursion
+   is assumed to pay off. */
+static const int probe_sizes[] = {256, 384, 512, 768, 1024, 1536, 2048};
+
+static gemm_params params;
+static int cutoff = 0;
+
+/* Which quadrants of C every product goes to, with its sign. */
+static const int coef[7][4] = {
+  // C11 C21 C12 C22
+  {  1,  1,  1,  1 }, // M1
+  {  1,  0,  0,  0 }, // M2
+  {  0,  0,  1,  0 }, // M3
+  {  0, -1,  0,  0 }, // M4
+  {  0,  0,  1,  1 }, // M5
+  {  0,  1,  1,  1 }, // M6
+  {  0,  1,  0,  1 }, // M7
+};
+
+/* ========================================================================== */
+/* Helpers                                                                    */
+/* ========================================================================== */
+
+/* Z := X + s * Y for h x h blocks. */
+static void add(int h, const double* X, int ldx, double s, const double* Y,
+                int ldy, double* Z, int ldz) {
+  for (int j = 0; j < h; ++j) {
+    const double* x = X + (long) j * ldx;
+    const double* y = Y + (long) j * ldy;
+    double* z = Z + (long) j * ldz;
+    #pragma omp simd
+    for (int i = 0; i < h; ++i) z[i] = x[i] + s * y[i];
+  }
+}
+
+/* Z := Z + s * X for h x h blocks. */
+static void accumulate(int h, double s, const double* X, int ldx,
+                       double* Z, int ldz) {
+  add(h, Z, ldz, s, X, ldx, Z, ldz);
+}
+
+/* Doubles of workspace needed below size n with the given task levels. */
+static size_t workspace(int n, int task_levels) {
+  if (n <= cutoff) return 0;
+  int h = (n & ~1) / 2;
+  size_t hh = (size_t) h * h;
+  if (task_levels > 0) return 15 * hh + 7 * workspace(h, task_levels - 1);
+  return 3 * hh + workspace(h, 0);
+}
+
+/* C += A * B for the last row, last column and rank-1 term of an odd n;
+   the (n-1) x (n-1) core is done by the caller. */
+static void peel(int n, const double* A, int lda, const double* B, int ldb,
+                 double* C, int ldc) {
+  const int m = n - 1;
+  // C(0:m, m) += A(0:m, :) B(:, m)
+  packed_dgemm(&params, m, 1, n, 1., A, 1, lda, B + (long) m * ldb, 1, ldb,
+               C + (long) m * ldc, ldc);
+  // C(m, :) += A(m, :) B
+  packed_dgemm(&params, 1, n, n, 1., A + m, 1, lda, B, 1, ldb, C + m, ldc);
+  // C(0:m, 0:m) += A(0:m, m) B(m, 0:m)
+  packed_dgemm(&params, m, m, 1, 1., A + (long) m * lda, 1, lda, B + m, 1, ldb,
+               C, ldc);
+}
+
+/* ========================================================================== */
+/* Recursion                                                                  */
+/* ========================================================================== */
+
+static void strassen(int n, const double* A, int lda, const double* B, int ldb,
+                     double* C, int ldc, double* work, int task_levels) {
+  if (n <= cutoff) {
+    packed_dgemm(&params, n, n, n, 1., A, 1, lda, B, 1, ldb, C, ldc);
+    return;
+  }
+  if (n & 1) {
+    strassen(n - 1, A, lda, B, ldb, C, ldc, work, task_levels);
+    peel(n, A, lda, B, ldb, C, ldc);
+    return;
+  }
+
+  const int h = n / 2;
+  const size_t hh = (size_t) h * h;
+  const double *A11 = A, *A21 = A + h, *A12 = A + (long) h * lda, *A22 = A12 + h;
+  const double *B11 = B, *B21 = B + h, *B12 = B + (long) h * ldb, *B22 = B12 + h;
+  double* Cq[4] = {C, C + h, C + (long) h * ldc, C + (long) h * ldc + h};
+
+  if (task_levels == 0) {
+    double* X = work;
+    double* Y = X + hh;
+    double* M = Y + hh;
+    double* below = M + hh;
+
+    // one product into M, then into the quadrants of C
+    #define PRODUCT(i, P, ldp, Q, ldq)                                  \
+      memset(M, 0, hh * sizeof(double));                                \
+      strassen(h, P, ldp, Q, ldq, M, h, below, 0);                      \
+      for (int q = 0; q < 4; ++q) {                                     \
+        if (coef[i][q]) accumulate(h, coef[i][q], M, h, Cq[q], ldc);    \
+      }
+
+    PRODUCT(0, A11, lda, B11, ldb);
+    PRODUCT(1, A12, lda, B21, ldb);
+    add(h, A21, lda,  1., A22, lda, X, h);  // S1
+    add(h, B12, ldb, -1., B11, ldb, Y, h);  // T1
+    PRODUCT(4, X, h, Y, h);
+    add(h, X, h, -1., A11, lda, X, h);      // S2
+    add(h, B22, ldb, -1., Y, h, Y, h);      // T2
+    PRODUCT(5, X, h, Y, h);
+    add(h, A12, lda, -1., X, h, X, h);      // S4
+    PRODUCT(2, X, h, B22, ldb);
+    add(h, Y, h, -1., B21, ldb, Y, h);      // T4
+    PRODUCT(3, A22, lda, Y, h);
+    add(h, A11, lda, -1., A21, lda, X, h);  // S3
+    add(h, B22, ldb, -1., B12, ldb, Y, h);  // T3
+    PRODUCT(6, X, h, Y, h);
+
+    #undef PRODUCT
+    return;
+  }
+
+  double* S = work;             // S1..S4
+  double* T = S + 4 * hh;       // T1..T4
+  double* M = T + 4 * hh;       // M1..M7
+  double* below = M + 7 * hh;
+  const size_t below_size = workspace(h, task_levels - 1);
+
+  add(h, A21, lda,  1., A22, lda, S, h);
+  add(h, S, h, -1., A11, lda, S + hh, h);
+  add(h, A11, lda, -1., A21, lda, S + 2*hh, h);
+  add(h, A12, lda, -1., S + hh, h, S + 3*hh, h);
+  add(h, B12, ldb, -1., B11, ldb, T, h);
+  add(h, B22, ldb, -1., T, h, T + hh, h);
+  add(h, B22, ldb, -1., B12, ldb, T + 2*hh, h);
+  add(h, T + hh, h, -1., B21, ldb, T + 3*hh, h);
+
+  const double* left[7]  = {A11, A12, S + 3*hh, A22, S, S + hh, S + 2*hh};
+  const int     ldl[7]   = {lda, lda, h, lda, h, h, h};
+  const double* right[7] = {B11, B21, B22, T + 3*hh, T, T + hh, T + 2*hh};
+  const int     ldr[7]   = {ldb, ldb, ldb, h, h, h, h};
+
+  for (int i = 0; i < 7; ++i) {
+    #pragma omp task firstprivate(i)
+    {
+      memset(M + i*hh, 0, hh * sizeof(double));
+      strassen(h, left[i], ldl[i], right[i], ldr[i], M + i*hh, h,
+               below + i * below_size, task_levels - 1);
+    }
+  }
+  #pragma omp taskwait
+
+  // the four quadrants of C are independent
+  for (int q = 0; q < 4; ++q) {
+    #pragma omp task firstprivate(q)
+    for (int i = 0; i < 7; ++i) {
+      if (coef[i][q]) accumulate(h, coef[i][q], M + i*hh, h, Cq[q], ldc);
+    }
+  }
+  #pragma omp taskwait
+}
+
+/* ========================================================================== */
+/* Workspace, cutoff and entry point                                          */
+/* ========================================================================== */
+
+static double* pool = NULL;
+static size_t pool_size = 0;
+
+static double* reserve(size_t needed) {
+  if (needed > pool_size) {
+    free(pool);
+    if (posix_memalign((void**) &pool, ALIGNMENT, needed * sizeof(double))) abort();
+    pool_size = needed;
+  }
+  return pool;
+}
+
+static double seconds_now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return 1.*t.tv_sec + 1.e-9*t.tv_nsec;
+}
+
+/* Best of two runs, serial: packed kernel (levels = 0) or one level of
+   Strassen-Winograd above it (levels = 1). */
+static double time_probe(int n, int levels, const double* A, const double* B,
+                         double* C) {
+  int saved = cutoff;
+  cutoff = levels ? n - 1 : n;
+  double* work = reserve(workspace(n, 0));
+  double best = 1e30;
+  for (int rep = 0; rep < 2; ++rep) {
+    double t = seconds_now();
+    strassen(n, A, n, B, n, C, n, work, 0);
+    t = seconds_now() - t;
+    if (t < best) best = t;
+  }
+  cutoff = saved;
+  return best;
+}
+
+static void init(void) {
+  if (cutoff > 0) return;
+  params = gemm_tuned_params();
+
+  const char* env = getenv("STRASSEN_CUTOFF");
+  if (env != NULL && atoi(env) > 0) {
+    cutoff = atoi(env);
+    return;
+  }
+
+  int nprobes = sizeof(probe_sizes) / sizeof(probe_sizes[0]);
+  int nmax = probe_sizes[nprobes - 1];
+  double* buf = NULL;
+  if (posix_memalign((void**) &buf, ALIGNMENT, 3 * (size_t) nmax * nmax * sizeof(double))) abort();
+  for (size_t i = 0; i < 3 * (size_t) nmax * nmax; ++i) buf[i] = (double) (i % 7) - 3.;
+
+  // largest probed size at which one level does not pay off yet
+  cutoff = nmax;
+  int last_loss = probe_sizes[0] / 2;
+  for (int p = 0; p < nprobes; ++p) {
+    int n = probe_sizes[p];
+    double* A = buf;
+    double* B = A + (size_t) n * n;
+    double* C = B + (size_t) n * n;
+    if (time_probe(n, 1, A, B, C) < 0.97 * time_probe(n, 0, A, B, C)) {
+      cutoff = last_loss;
+      break;
+    }
+    last_loss = n;
+  }
+  free(buf);
+}
+
+int strassen_cutoff(void) {
+  init();
+  return cutoff;
+}
+
+double strassen_error_factor(int n) {
+  init();
+  int levels = 0;
+  double n0 = n;
+  while (n0 > cutoff) {
+    n0 = floor(n0 / 2);
+    ++levels;
+  }
+  double f = pow(18., levels) * (n0 * n0 + 6. * n0) - 6. * n;
+  return (f > (double) n * n) ? f : (double) n * n;
+}
+
+void strassen_dgemm(int n, const double* A, int lda, const double* B, int ldb,
+                    double* C, int ldc) {
+  init();
+  if (n <= 0) return;
+
+  const int threads = omp_get_max_threads();
+  if (n <= cutoff) {
+    if (threads > 1) packed_dgemm_omp(&params, 0, n, n, n, 1., A, 1, lda, B, 1, ldb, C, ldc);
+    else             packed_dgemm(&params, n, n, n, 1., A, 1, lda, B, 1, ldb, C, ldc);
+    return;
+  }
+
+  const int task_levels = (threads > 7) ? 2 : (threads > 1) ? 1 : 0;
+  double* work = reserve(workspace(n, task_levels));
+
+  if (task_levels == 0) {
+    strassen(n, A, lda, B, ldb, C, ldc, work, 0);
+    return;
+  }
+
+  #pragma omp parallel
+  #pragma omp single
+  strassen(n, A, lda, B, ldb, C, ldc, work, task_levels);
+}
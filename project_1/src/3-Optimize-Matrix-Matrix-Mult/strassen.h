@@ -0,0 +1,38 @@
+// strassen.h
+//
+// Strassen-Winograd multiply on top of the packed dgemm: 7 half-size
+// products and 15 additions per level instead of 8 products, recursively,
+// until the size drops to a cutoff where the packed kernel is faster.
+
+#ifndef STRASSEN_H
+#define STRASSEN_H
+
+/* C := C + A * B for n x n column-major matrices with leading dimensions
+ * lda, ldb and ldc.
+ *
+ * Odd sizes are peeled: the even (n-1) x (n-1) core recurses and the last
+ * row, column and rank-1 term are added with the packed kernel. With more
+ * than one OpenMP thread the 7 products of the top level (top two levels
+ * with more than 7 threads) run as OpenMP tasks. All temporaries come from
+ * one workspace that is allocated on the first call and grown when needed:
+ * about n^2 doubles serial, 5.5 n^2 with one task level, 13 n^2 with two.
+ */
+void strassen_dgemm(int n, const double* A, int lda, const double* B, int ldb,
+                    double* C, int ldc);
+
+/* Sizes n <= cutoff go to the packed kernel. Tuned on first use by timing
+   one Strassen level against the packed kernel at a few sizes; the
+   environment variable STRASSEN_CUTOFF overrides it. */
+int strassen_cutoff(void);
+
+/* The error of Strassen-Winograd is only bounded normwise (Higham, Accuracy
+ * and Stability of Numerical Algorithms, sec. 23.2.2):
+ *
+ *   max|C - fl(C)| <= [ (n/n0)^log2(18) (n0^2 + 6 n0) - 6n ] u max|A| max|B|
+ *
+ * with n0 the size at which the recursion stops. Returns the factor in
+ * brackets for the current cutoff.
+ */
+double strassen_error_factor(int n);
+
+#endif // STRASSEN_H
@@ -0,0 +1,204 @@
+// summa.c
+//
+// SUMMA and Cannon matrix multiply on a block-cyclic 2D process grid, see
+// summa.h. The local products go through hpc_dgemm (dgemm-packed.c), since
+// the panels are rectangular.
+
+#include <stdlib.h> // For: malloc, free, abort
+#include <string.h> // For: memcpy
+
+#include "summa.h"
+#include "dgemm-packed.h"
+
+static int min(int a, int b) {
+  return (a < b) ? a : b;
+}
+
+static double* alloc_doubles(long count) {
+  double* p = (double*) malloc((count > 0 ? count : 1) * sizeof(double));
+  if (p == NULL) abort();
+  return p;
+}
+
+int grid_init(proc_grid* grid, MPI_Comm comm, int nprow, int npcol) {
+  int size;
+  MPI_Comm_size(comm, &size);
+
+  int dims[2] = {nprow, npcol};
+  if (nprow < 0 || npcol < 0) return 1;
+  if (nprow > 0 && npcol > 0 && nprow * npcol != size) return 1;
+  if (MPI_Dims_create(size, 2, dims) != MPI_SUCCESS) return 1;
+
+  // periodic in both directions for the shifts of Cannon's algorithm
+  int periods[2] = {1, 1};
+  MPI_Cart_create(comm, 2, dims, periods, 0, &grid->comm);
+
+  int rank, coords[2];
+  MPI_Comm_rank(grid->comm, &rank);
+  MPI_Cart_coords(grid->comm, rank, 2, coords);
+  grid->nprow = dims[0];
+  grid->npcol = dims[1];
+  grid->myrow = coords[0];
+  grid->mycol = coords[1];
+
+  int keep_cols[2] = {0, 1}, keep_rows[2] = {1, 0};
+  MPI_Cart_sub(grid->comm, keep_cols, &grid->row_comm);
+  MPI_Cart_sub(grid->comm, keep_rows, &grid->col_comm);
+  return 0;
+}
+
+void grid_free(proc_grid* grid) {
+  MPI_Comm_free(&grid->row_comm);
+  MPI_Comm_free(&grid->col_comm);
+  MPI_Comm_free(&grid->comm);
+}
+
+int numroc(int n, int nb, int iproc, int nprocs) {
+  int nblocks = n / nb;
+  int num = (nblocks / nprocs) * nb;
+  int extra = nblocks % nprocs;
+  if (iproc < extra) num += nb;
+  else if (iproc == extra) num += n % nb;
+  return num;
+}
+
+int local_to_global(int l, int nb, int iproc, int nprocs) {
+  return ((l / nb) * nprocs + iproc) * nb + l % nb;
+}
+
+int global_to_local(int g, int nb, int nprocs) {
+  return (g / (nb * nprocs)) * nb + g % nb;
+}
+
+/* ========================================================================== */
+/* SUMMA                                                                      */
+/* ========================================================================== */
+
+typedef struct {
+  const proc_grid* grid;
+  int n, nb, mloc, nloc;
+  const double* A;
+  const double* B;
+} summa_args;
+
+/* Copies block column kb of A and block row kb of B into the panel buffers
+   on their owners and starts the broadcasts along the grid rows/columns. */
+static void post_panels(const summa_args* s, int kb, double* Ap, double* Bp,
+                        MPI_Request* requests) {
+  const proc_grid* g = s->grid;
+  const int nb = s->nb, w = min(nb, s->n - kb * nb);
+  const int owner_col = kb % g->npcol, owner_row = kb % g->nprow;
+
+  if (g->mycol == owner_col) {
+    // the local columns of one block are contiguous
+    int lk = (kb / g->npcol) * nb;
+    memcpy(Ap, s->A + (long) lk * s->mloc, (long) s->mloc * w * sizeof(double));
+  }
+  if (g->myrow == owner_row) {
+    int lk = (kb / g->nprow) * nb;
+    for (int j = 0; j < s->nloc; ++j) {
+      for (int p = 0; p < w; ++p) {
+        Bp[p + (long) j * w] = s->B[lk + p + (long) j * s->mloc];
+      }
+    }
+  }
+
+  MPI_Ibcast(Ap, s->mloc * w, MPI_DOUBLE, owner_col, g->row_comm, &requests[0]);
+  MPI_Ibcast(Bp, w * s->nloc, MPI_DOUBLE, owner_row, g->col_comm, &requests[1]);
+}
+
+void summa_dgemm(const proc_grid* grid, int n, int nb,
+                 const double* A, const double* B, double* C) {
+  summa_args s = {grid, n, nb,
+                  numroc(n, nb, grid->myrow, grid->nprow),
+                  numroc(n, nb, grid->mycol, grid->npcol), A, B};
+  const int nblocks = (n + nb - 1) / nb;
+
+  // two sets of panels: the one being multiplied and the one in flight
+  double* Ap[2] = {alloc_doubles((long) s.mloc * nb), alloc_doubles((long) s.mloc * nb)};
+  double* Bp[2] = {alloc_doubles((long) nb * s.nloc), alloc_doubles((long) nb * s.nloc)};
+  MPI_Request requests[2][2];
+
+  post_panels(&s, 0, Ap[0], Bp[0], requests[0]);
+  for (int kb = 0; kb < nblocks; ++kb) {
+    const int cur = kb % 2, next = 1 - cur;
+    const int w = min(nb, n - kb * nb);
+
+    if (kb + 1 < nblocks) post_panels(&s, kb + 1, Ap[next], Bp[next], requests[next]);
+    MPI_Waitall(2, requests[cur], MPI_STATUSES_IGNORE);
+
+    if (s.mloc > 0 && s.nloc > 0) {
+      hpc_dgemm('N', 'N', s.mloc, s.nloc, w, 1., Ap[cur], s.mloc,
+                Bp[cur], w, 1., C, s.mloc);
+    }
+  }
+
+  for (int b = 0; b < 2; ++b) {
+    free(Ap[b]);
+    free(Bp[b]);
+  }
+}
+
+/* ========================================================================== */
+/* Cannon                                                                     */
+/* ========================================================================== */
+
+int cannon_dgemm(const proc_grid* grid, int n, int nb,
+                 const double* A, const double* B, double* C) {
+  if (grid->nprow != grid->npcol) return 1;
+
+  const int P = grid->nprow, i = grid->myrow, j = grid->mycol;
+  const int mloc = numroc(n, nb, i, P), nloc = numroc(n, nb, j, P);
+  const int kmax = numroc(n, nb, 0, P);
+
+  /* With a block-cyclic layout on a square grid, the local arrays behave
+     like the blocks of the textbook algorithm: the product of the local A
+     of (i, l) and the local B of (l, j) is exactly the l-th contribution to
+     the local C of (i, j). */
+  double* Ab[2] = {alloc_doubles((long) mloc * kmax), alloc_doubles((long) mloc * kmax)};
+  double* Bb[2] = {alloc_doubles((long) kmax * nloc), alloc_doubles((long) kmax * nloc)};
+
+  // initial skew: (i, j) starts with A of (i, i+j) and B of (i+j, j)
+  int src, dst;
+  int l = (i + j) % P, kl = numroc(n, nb, l, P);
+  MPI_Cart_shift(grid->comm, 1, -i, &src, &dst);
+  MPI_Sendrecv(A, mloc * nloc, MPI_DOUBLE, dst, 0,
+               Ab[0], mloc * kl, MPI_DOUBLE, src, 0, grid->comm, MPI_STATUS_IGNORE);
+  MPI_Cart_shift(grid->comm, 0, -j, &src, &dst);
+  MPI_Sendrecv(B, mloc * nloc, MPI_DOUBLE, dst, 1,
+               Bb[0], kl * nloc, MPI_DOUBLE, src, 1, grid->comm, MPI_STATUS_IGNORE);
+
+  // at every step A moves one column left and B one row up
+  int right, left, below, above;
+  MPI_Cart_shift(grid->comm, 1, -1, &right, &left);
+  MPI_Cart_shift(grid->comm, 0, -1, &below, &above);
+
+  for (int step = 0; step < P; ++step) {
+    const int cur = step % 2, next = 1 - cur;
+    MPI_Request requests[4];
+    int nreq = 0;
+
+    if (step + 1 < P) {
+      int kn = numroc(n, nb, (l + 1) % P, P);
+      MPI_Irecv(Ab[next], mloc * kn, MPI_DOUBLE, right, 2, grid->comm, &requests[nreq++]);
+      MPI_Irecv(Bb[next], kn * nloc, MPI_DOUBLE, below, 3, grid->comm, &requests[nreq++]);
+      MPI_Isend(Ab[cur], mloc * kl, MPI_DOUBLE, left, 2, grid->comm, &requests[nreq++]);
+      MPI_Isend(Bb[cur], kl * nloc, MPI_DOUBLE, above, 3, grid->comm, &requests[nreq++]);
+    }
+
+    if (mloc > 0 && nloc > 0) {
+      hpc_dgemm('N', 'N', mloc, nloc, kl, 1., Ab[cur], mloc,
+                Bb[cur], kl > 0 ? kl : 1, 1., C, mloc);
+    }
+    MPI_Waitall(nreq, requests, MPI_STATUSES_IGNORE);
+
+    l = (l + 1) % P;
+    kl = numroc(n, nb, l, P);
+  }
+
+  for (int b = 0; b < 2; ++b) {
+    free(Ab[b]);
+    free(Bb[b]);
+  }
+  return 0;
+}
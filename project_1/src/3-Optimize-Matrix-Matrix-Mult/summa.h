@@ -0,0 +1,51 @@
+// summa.h
+//
+// Distributed dense matrix multiply on a 2D process grid. Matrices are
+// n x n and stored 2D block-cyclic with square nb x nb blocks, as in
+// ScaLAPACK: global block (I, J) lives on process (I mod nprow, J mod npcol),
+// and every process keeps its blocks in one column-major local array with
+// leading dimension equal to its number of local rows.
+
+#ifndef SUMMA_H
+#define SUMMA_H
+
+#include <mpi.h>
+
+typedef struct {
+  MPI_Comm comm;     // 2D Cartesian communicator, periodic
+  MPI_Comm row_comm; // processes of my grid row, ranked by column
+  MPI_Comm col_comm; // processes of my grid column, ranked by row
+  int nprow, npcol;  // grid shape
+  int myrow, mycol;  // my coordinates
+} proc_grid;
+
+/* Creates an nprow x npcol grid over comm with MPI_Cart_create; zeros let
+   MPI_Dims_create choose. Returns 0, or 1 if the shape does not match the
+   size of comm. */
+int grid_init(proc_grid* grid, MPI_Comm comm, int nprow, int npcol);
+void grid_free(proc_grid* grid);
+
+/* Number of rows (or columns) of an n-long dimension split in blocks of nb
+   that process iproc out of nprocs owns (ScaLAPACK's NUMROC). */
+int numroc(int n, int nb, int iproc, int nprocs);
+
+/* Global index of local index l on process iproc, and back. */
+int local_to_global(int l, int nb, int iproc, int nprocs);
+int global_to_local(int g, int nb, int nprocs);
+
+/* C := C + A * B with SUMMA: for every block column of A and block row of
+   B, the owners broadcast their panel along the grid rows and columns and
+   everybody updates its local C. The broadcast of the next panels is
+   posted before the local multiply of the current ones, so communication
+   overlaps with computation. Works on any grid shape. */
+void summa_dgemm(const proc_grid* grid, int n, int nb,
+                 const double* A, const double* B, double* C);
+
+/* C := C + A * B with Cannon's algorithm: after an initial skew the local
+   arrays of A and B circulate along the grid rows and columns, and the
+   shift of the next step overlaps with the current local multiply. Needs a
+   square grid. Returns 0, or 1 if the grid is not square. */
+int cannon_dgemm(const proc_grid* grid, int n, int nb,
+                 const double* A, const double* B, double* C);
+
+#endif // SUMMA_H
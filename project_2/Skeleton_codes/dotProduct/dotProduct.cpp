@@ -1,5 +1,7 @@
 #include <omp.h>
 #include "walltime.h"
+#include "perfcount.h"
+#include "dotProduct_simd.h"
 #include <iostream>
 #include <math.h>
 #include <stdio.h>
@@ -36,16 +38,27 @@ int main() {
     b[i] = i / 10.0;
   }
 
+  // Hardware counters of every version, opened before the first
+  // parallel region so that the OpenMP threads are counted too
+  perf_group counters_serial, counters_red, counters_critical, counters_simd;
+  perf_group_open(&counters_serial);
+  perf_group_open(&counters_red);
+  perf_group_open(&counters_critical);
+  perf_group_open(&counters_simd);
+  const double flops = 2.0 * N * NUM_ITERATIONS;
+
   long double alpha = 0;
   // serial execution
   // Note that we do extra iterations to reduce relative timing overhead
   time_start = wall_time();
+  perf_group_start(&counters_serial);
   for (int iterations = 0; iterations < NUM_ITERATIONS; iterations++) {
     alpha = 0.0;
     for (int i = 0; i < N; i++) {
       alpha += a[i] * b[i];
     }
   }
+  perf_group_stop(&counters_serial);
   time_serial = wall_time() - time_start;
   cout << "Serial execution time = " << time_serial << " sec" << endl;
 
@@ -56,6 +69,7 @@ int main() {
 
   // Parallel dot product using reduction pragma
   time_start = wall_time();
+  perf_group_start(&counters_red);
   for (int iterations = 0; iterations < NUM_ITERATIONS; iterations++) {
     long double alpha_tmp = 0.0;
 #pragma omp parallel for reduction(+ : alpha_tmp)
@@ -64,10 +78,12 @@ int main() {
     }
     alpha_reduction = alpha_tmp;
   }
+  perf_group_stop(&counters_red);
   time_red = wall_time() - time_start;
 
   // Parallel dot product using critical pragma
   time_start = wall_time();
+  perf_group_start(&counters_critical);
   for (int iterations = 0; iterations < NUM_ITERATIONS; iterations++) {
     long double alpha_tmp = 0.0;
 #pragma omp parallel
@@ -82,8 +98,22 @@ int main() {
     }
     alpha_critical = alpha_tmp;
   }
+  perf_group_stop(&counters_critical);
   time_critical = wall_time() - time_start;
 
+  // Parallel dot product with explicit vectors (common/simd), in the
+  // variant for the widest vectors this CPU has
+  double (*dot_simd)(const double *, const double *, int) = SIMD_SELECT(dot_simd);
+  double alpha_simd = 0.0;
+  double time_simd = 0.0;
+  time_start = wall_time();
+  perf_group_start(&counters_simd);
+  for (int iterations = 0; iterations < NUM_ITERATIONS; iterations++) {
+    alpha_simd = dot_simd(a, b, N);
+  }
+  perf_group_stop(&counters_simd);
+  time_simd = wall_time() - time_start;
+
   long double denom = fabsl(alpha) > 0.0L ? fabsl(alpha) : 1.0L;
   if ((fabsl(alpha_reduction - alpha) / denom) > EPSILON) {
     cout << "parallel reduction: " << alpha_reduction
@@ -97,11 +127,28 @@ int main() {
     cerr << "Critical-based alpha not implemented correctly!\n";
     exit(1);
   }
+  if ((fabsl(alpha_simd - alpha) / denom) > EPSILON) {
+    cout << "parallel simd: " << alpha_simd << ", serial: " << alpha << "\n";
+    cerr << "SIMD alpha not implemented correctly!\n";
+    exit(1);
+  }
 
   cout << "Parallel reduction dot product = " << alpha_reduction
        << ", time = " << time_red << " sec" << endl;
   cout << "Parallel critical dot product = " << alpha_critical
        << ", time = " << time_critical << " sec" << endl;
+  cout << "Parallel SIMD (" << simd_isa_name(simd_detect())
+       << ") dot product = " << alpha_simd << ", time = " << time_simd << " sec" << endl;
+
+  // IPC, share of vector flops and bytes per flop of each version
+  perf_group_print(stdout, "serial", &counters_serial, time_serial, flops);
+  perf_group_print(stdout, "reduction", &counters_red, time_red, flops);
+  perf_group_print(stdout, "critical", &counters_critical, time_critical, flops);
+  perf_group_print(stdout, "simd", &counters_simd, time_simd, flops);
+  perf_group_close(&counters_serial);
+  perf_group_close(&counters_red);
+  perf_group_close(&counters_critical);
+  perf_group_close(&counters_simd);
 
   // De-allocate memory
   delete[] a;
@@ -0,0 +1,28 @@
+#include <omp.h>
+#include "simd.hpp"
+#include "dotProduct_simd.h"
+
+// Every thread sums its contiguous chunk into four vector accumulators
+// (independent FMA chains), then the partial sums meet in the reduction.
+typedef simd::native<double> V;
+
+extern "C" double SIMD_NAME(dot_simd)(const double *a, const double *b, int n) {
+  double alpha = 0.0;
+#pragma omp parallel reduction(+ : alpha)
+  {
+    long nt = omp_get_num_threads(), t = omp_get_thread_num();
+    int begin = int(n * t / nt), end = int(n * (t + 1) / nt);
+    V acc0(0.0), acc1(0.0), acc2(0.0), acc3(0.0);
+    int i = begin;
+    for (; i + 4 * V::width <= end; i += 4 * V::width) {
+      acc0 = fma(V::load(a + i), V::load(b + i), acc0);
+      acc1 = fma(V::load(a + i + V::width), V::load(b + i + V::width), acc1);
+      acc2 = fma(V::load(a + i + 2 * V::width), V::load(b + i + 2 * V::width), acc2);
+      acc3 = fma(V::load(a + i + 3 * V::width), V::load(b + i + 3 * V::width), acc3);
+    }
+    for (; i < end; i += V::width)
+      acc0 = fma(V::load(a + i, end - i), V::load(b + i, end - i), acc0);
+    alpha += reduce_add((acc0 + acc1) + (acc2 + acc3));
+  }
+  return alpha;
+}
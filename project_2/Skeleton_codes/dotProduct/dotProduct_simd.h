@@ -0,0 +1,12 @@
+#ifndef DOTPRODUCT_SIMD_H
+#define DOTPRODUCT_SIMD_H
+
+#include "dispatch.h"
+
+// Parallel dot product written with common/simd, one copy per ISA
+// (dotProduct_simd.cpp); pick it with SIMD_SELECT(dot_simd).
+extern "C" {
+SIMD_DECLARE(double, dot_simd, (const double *a, const double *b, int n));
+}
+
+#endif
@@ -3,6 +3,7 @@
 #include <random>
 #include <vector>
 #include "walltime.h"
+#include "perfcount.h"
 
 #define VEC_SIZE 1000000000
 #define BINS 16
@@ -35,8 +36,16 @@ int main() {
     dist_mergeOut[i] = 0;
   }
 
+  // hardware counters of the three versions, opened before the first
+  // parallel region so that the worker threads are counted too
+  perf_group counters_critical, counters_mergeOut, counters_atomic;
+  perf_group_open(&counters_critical);
+  perf_group_open(&counters_mergeOut);
+  perf_group_open(&counters_atomic);
+
   // with private histograms for each thread ===================
   time_start_critical = walltime();
+  perf_group_start(&counters_critical);
   #pragma omp parallel 
   {
     long dist_private[BINS];
@@ -56,10 +65,12 @@ int main() {
       }
     }
   }
+  perf_group_stop(&counters_critical);
   time_end_critical = walltime();
 
   // with private histograms and merge outside ================
   time_start_mergeOut = walltime();
+  perf_group_start(&counters_mergeOut);
 
   int num_threads = omp_get_max_threads();
   std::vector<std::vector<long>> all_private_dists(num_threads, std::vector<long>(BINS, 0));
@@ -85,17 +96,19 @@ int main() {
       dist_mergeOut[i] += all_private_dists[t][i];
     }
   }
-
+  perf_group_stop(&counters_mergeOut);
   time_end_mergeOut = walltime();
 
   // with atomic updates ========================================
   time_start_atomic = walltime();
+  perf_group_start(&counters_atomic);
 
   #pragma omp parallel for
   for (long i = 0; i < VEC_SIZE; ++i) {
     #pragma omp atomic
     dist_atomic[vec[i]]++;
   }
+  perf_group_stop(&counters_atomic);
   time_end_atomic = walltime();
 
 
@@ -109,6 +122,15 @@ int main() {
   std::cout << "Time Merge Out: " << time_end_mergeOut - time_start_mergeOut << " sec" << std::endl;
   std::cout << "Time Atomic: " << time_end_atomic - time_start_atomic << " sec" << std::endl;
 
+  // IPC, DRAM traffic and branch misses of each version (no flops here)
+  std::cout << std::flush;
+  perf_group_print(stdout, "critical", &counters_critical, time_end_critical - time_start_critical, 0);
+  perf_group_print(stdout, "mergeOut", &counters_mergeOut, time_end_mergeOut - time_start_mergeOut, 0);
+  perf_group_print(stdout, "atomic", &counters_atomic, time_end_atomic - time_start_atomic, 0);
+  perf_group_close(&counters_critical);
+  perf_group_close(&counters_mergeOut);
+  perf_group_close(&counters_atomic);
+
 
   return 0;
 }
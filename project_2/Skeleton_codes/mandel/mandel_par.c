@@ -1,11 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <omp.h>
 
 #include "consts.h"
+#include "mandel_row.h"
 #include "pngwriter.h"
-#include "walltime.h"
+#include "instrument.h"
+#include "perfcount.h"
 
 int main(int argc, char **argv) {
+  instr_init(-1);
   char output_name[256];
   if (argc > 1) {
     snprintf(output_name, sizeof(output_name), "%s", argv[1]);
@@ -14,7 +18,7 @@ int main(int argc, char **argv) {
   }
   png_data *pPng = png_create(IMAGE_WIDTH, IMAGE_HEIGHT);
 
-  double x, y, x2, y2, cx, cy;
+  double cy;
 
   double fDeltaX = (MAX_X - MIN_X) / (double)IMAGE_WIDTH;
   double fDeltaY = (MAX_Y - MIN_Y) / (double)IMAGE_HEIGHT;
@@ -29,40 +33,39 @@ int main(int argc, char **argv) {
 
   long i, j;
 
+  // variant of the inner loop for the widest vectors this CPU has
+  // (SIMD_ISA=scalar|sse4|avx2|avx512 to force a narrower one)
+  long (*row)(int *, long, long, double, double, double, int) = SIMD_SELECT(mandel_row);
+
+  // before the first parallel region, so that the workers are counted
+  perf_group counters;
+  perf_group_open(&counters);
+
   double time_start = walltime();
+  perf_group_start(&counters);
+  instr_begin("compute");
   // do the calculation
   cy = MIN_Y;
   for (j = 0; j < IMAGE_HEIGHT; j++) {
-#pragma omp parallel for schedule(static) reduction(+ : nTotalIterationsCount) private(x, y, x2, y2, cx)
-    for (i = 0; i < IMAGE_WIDTH; i++) {
-      cx = MIN_X + i * fDeltaX;
-      x = cx;
-      y = cy;
-      x2 = x * x;
-      y2 = y * y;
-      // compute the orbit z, f(z), f^2(z), f^3(z), ...
-      // count the iterations until the orbit leaves the circle |z|=2.
-      // stop if the number of iterations exceeds the bound MAX_ITERS.
-      int n = 0;
-      while ((x2 + y2 <= 4.0) && (n < MAX_ITERS)) {
-        double xy = x * y;
-        y = 2.0 * xy + cy;
-        x = x2 - y2 + cx;
-        x2 = x * x;
-        y2 = y * y;
-        n++;
-      }
-      nTotalIterationsCount += n;
-      // n indicates if the point belongs to the mandelbrot set
-      // plot the number of iterations at point (i, j)
-      int c = ((long)n * 255) / MAX_ITERS;
-      colors[j * IMAGE_WIDTH + i] = c;
+#pragma omp parallel reduction(+ : nTotalIterationsCount)
+    {
+      // one region per thread and row: the trace shows the imbalance
+      instr_begin("row");
+      // contiguous chunk of the row, computed a vector of points at a time
+      long nt = omp_get_num_threads(), t = omp_get_thread_num();
+      long begin = IMAGE_WIDTH * t / nt, end = IMAGE_WIDTH * (t + 1) / nt;
+      nTotalIterationsCount += row(colors + j * IMAGE_WIDTH + begin, begin, end,
+                                   cy, MIN_X, fDeltaX, MAX_ITERS);
+      instr_end();
     }
     cy += fDeltaY;
   }
+  instr_end();
+  perf_group_stop(&counters);
   double time_end = walltime();
 
   // print benchmark data
+  printf("SIMD:                       %s\n", simd_isa_name(simd_detect()));
   printf("Total time:                 %g seconds\n",
          (time_end - time_start));
   printf("Image size:                 %ld x %ld = %ld Pixels\n",
@@ -78,7 +81,11 @@ int main(int argc, char **argv) {
   // assume there are 8 floating point operations per iteration
   printf("MFlop/s:                    %g\n",
          nTotalIterationsCount * 8.0 / (time_end - time_start) * 1.e-6);
+  perf_group_print(stdout, "compute", &counters, time_end - time_start,
+                   nTotalIterationsCount * 8.0);
+  perf_group_close(&counters);
 
+  instr_begin("png");
   for (j = 0; j < IMAGE_HEIGHT; j++) {
     for (i = 0; i < IMAGE_WIDTH; i++) {
       int c = colors[j * IMAGE_WIDTH + i];
@@ -89,5 +96,7 @@ int main(int argc, char **argv) {
   free(colors);
 
   png_write(pPng, output_name);
+  instr_end();
+  instr_finalize();
   return 0;
 }
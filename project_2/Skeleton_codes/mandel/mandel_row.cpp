@@ -0,0 +1,41 @@
+// Mandelbrot inner loop on vectors of points, compiled once per ISA
+// (see mandel_row.h): the lanes whose orbit has left the circle, or that
+// reached max_iters, are frozen by the mask while the others go on, and
+// the vector is done when no lane is active.
+
+#include "simd.hpp"
+#include "mandel_row.h"
+
+typedef simd::native<double> V;
+
+extern "C" long SIMD_NAME(mandel_row)(int *colors, long begin, long end, double cy,
+                                      double min_x, double dx, int max_iters) {
+  alignas(64) double lane[V::width], count[V::width];
+  long total = 0;
+
+  for (long i0 = begin; i0 < end; i0 += V::width) {
+    for (int l = 0; l < V::width; l++) lane[l] = min_x + (i0 + l) * dx;
+    V cx = V::load(lane);
+    V x = cx, y = V(cy), n = V(0.);
+    V x2 = x * x, y2 = y * y;
+    V::mask active = (x2 + y2 <= V(4.0)) & (n < V(max_iters));
+    while (any(active)) {
+      V xy = x * y;
+      y = select(active, V(2.0) * xy + V(cy), y);
+      x = select(active, x2 - y2 + cx, x);
+      x2 = x * x;
+      y2 = y * y;
+      n = select(active, n + V(1.0), n);
+      active = (x2 + y2 <= V(4.0)) & (n < V(max_iters));
+    }
+
+    n.store(count);
+    int k = (end - i0 < V::width) ? int(end - i0) : V::width;
+    for (int l = 0; l < k; l++) {
+      long it = (long) count[l];
+      total += it;
+      colors[i0 - begin + l] = int((it * 255) / max_iters);
+    }
+  }
+  return total;
+}
@@ -0,0 +1,21 @@
+#ifndef MANDEL_ROW_H_
+#define MANDEL_ROW_H_
+
+#include "dispatch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// colors[i - begin] of the points begin <= i < end of the row at height cy,
+// cx = min_x + i * dx, as in mandel_seq.c; returns the sum of the
+// iteration counts. One copy per ISA (mandel_row.cpp), pick it with
+// SIMD_SELECT(mandel_row).
+SIMD_DECLARE(long, mandel_row, (int *colors, long begin, long end, double cy,
+                                double min_x, double dx, int max_iters));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDEL_ROW_H_ */
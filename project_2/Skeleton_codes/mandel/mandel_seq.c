@@ -3,9 +3,10 @@
 
 #include "consts.h"
 #include "pngwriter.h"
-#include "walltime.h"
+#include "instrument.h"
 
 int main(int argc, char **argv) {
+  instr_init(-1);
   char output_name[256];
   if (argc > 1) {
     snprintf(output_name, sizeof(output_name), "%s", argv[1]);
@@ -30,6 +31,7 @@ int main(int argc, char **argv) {
   long i, j;
 
   double time_start = walltime();
+  instr_begin("compute");
   // do the calculation
   cy = MIN_Y;
   for (j = 0; j < IMAGE_HEIGHT; j++) {
@@ -60,6 +62,7 @@ int main(int argc, char **argv) {
     }
     cy += fDeltaY;
   }
+  instr_end();
   double time_end = walltime();
 
   // print benchmark data
@@ -79,6 +82,7 @@ int main(int argc, char **argv) {
   printf("MFlop/s:                    %g\n",
          nTotalIterationsCount * 8.0 / (time_end - time_start) * 1.e-6);
 
+  instr_begin("png");
   for (j = 0; j < IMAGE_HEIGHT; j++) {
     for (i = 0; i < IMAGE_WIDTH; i++) {
       int c = colors[j * IMAGE_WIDTH + i];
@@ -89,5 +93,7 @@ int main(int argc, char **argv) {
   free(colors);
 
   png_write(pPng, output_name);
+  instr_end();
+  instr_finalize();
   return 0;
 }
@@ -0,0 +1,149 @@
+// thread placement and NUMA page placement diagnostics
+// uses raw Linux syscalls so that we do not have to link against libnuma
+
+#include <iostream>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
+#include "affinity.h"
+
+namespace affinity {
+
+// number of pages per thread that are queried in report_pages
+static const int samples_per_thread = 64;
+
+// only report misplaced pages if more than this fraction is on the wrong node
+static const double misplaced_tolerance = 0.1;
+
+// core and NUMA node the calling thread is currently running on
+static void current_cpu(int& cpu, int& node) {
+    cpu = -1;
+    node = -1;
+#ifdef SYS_getcpu
+    unsigned c, n;
+    if (syscall(SYS_getcpu, &c, &n, NULL) == 0) {
+        cpu = c;
+        node = n;
+    }
+#endif
+}
+
+static int max_threads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+static int thread_num() {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+void report_threads() {
+    int threads = max_threads();
+    std::vector<int> cpus(threads), nodes(threads);
+
+    #pragma omp parallel
+    {
+        int tid = thread_num();
+        current_cpu(cpus[tid], nodes[tid]);
+    }
+
+    std::cout << "placement :: ";
+    for (int t = 0; t < threads; t++) {
+        if (t && t % 2 == 0) std::cout << std::endl << "             ";
+        std::cout << "thread " << t << " -> core " << cpus[t]
+                  << " node " << nodes[t] << (t+1 < threads ? ", " : "");
+    }
+    std::cout << std::endl;
+
+    if (threads > 1) {
+        if (!getenv("OMP_PROC_BIND")) {
+            std::cout << "WARNING   :: OMP_PROC_BIND is not set, threads may "
+                         "migrate away from the pages they touched first"
+                      << std::endl;
+        }
+        if (!getenv("OMP_PLACES")) {
+            std::cout << "WARNING   :: OMP_PLACES is not set, try "
+                         "OMP_PLACES=cores OMP_PROC_BIND=close" << std::endl;
+        }
+    }
+}
+
+double report_pages(data::Field const& x, const char* name) {
+#ifdef SYS_move_pages
+    int threads = max_threads();
+    int N = x.length();
+    if (threads < 2 || N == 0) return 0.;
+
+    // find the index range each thread owns with the same schedule(static)
+    // distribution that fill() and the linalg kernels use
+    std::vector<int> lo(threads, N), hi(threads, -1), nodes(threads, -1);
+    #pragma omp parallel
+    {
+        int tid = thread_num();
+        int cpu;
+        current_cpu(cpu, nodes[tid]);
+        #pragma omp for schedule(static)
+        for (int i = 0; i < N; i++) {
+            if (i < lo[tid]) lo[tid] = i;
+            hi[tid] = i;
+        }
+    }
+
+    // sample pages in each thread's range and ask the kernel where they are
+    long page_size = sysconf(_SC_PAGESIZE);
+    std::vector<void*> pages;
+    std::vector<int> owner;
+    for (int t = 0; t < threads; t++) {
+        if (hi[t] < lo[t]) continue;
+        int stride = (hi[t] - lo[t]) / samples_per_thread + 1;
+        for (int i = lo[t]; i <= hi[t]; i += stride) {
+            long addr = (long)(x.data() + i);
+            pages.push_back((void*)(addr - addr % page_size));
+            owner.push_back(nodes[t]);
+        }
+    }
+
+    std::vector<int> status(pages.size(), -1);
+    if (syscall(SYS_move_pages, 0, pages.size(), pages.data(), NULL,
+                status.data(), 0) != 0) {
+        return 0.;
+    }
+
+    int misplaced = 0;
+    int queried = 0;
+    for (size_t p = 0; p < pages.size(); p++) {
+        if (status[p] < 0) continue; // not yet touched or not queryable
+        queried++;
+        if (status[p] != owner[p]) misplaced++;
+    }
+    if (queried == 0) return 0.;
+
+    double fraction = double(misplaced) / queried;
+    if (fraction > misplaced_tolerance) {
+        std::cout << "WARNING   :: " << int(100*fraction) << "% of sampled "
+                  << "pages of " << name << " are not on the NUMA node of "
+                  << "the thread that works on them" << std::endl;
+    }
+    return fraction;
+#else
+    return 0.;
+#endif
+}
+
+} // namespace affinity
@@ -0,0 +1,21 @@
+// thread placement and NUMA page placement diagnostics
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include "data.h"
+
+namespace affinity {
+
+    // print the core and NUMA node every OpenMP thread is running on, and
+    // warn if OMP_PROC_BIND/OMP_PLACES are unset (threads may migrate and
+    // lose the pages they first touched)
+    void report_threads();
+
+    // check that the pages of x live on the NUMA node of the thread that
+    // owns them under the schedule(static) distribution used by the kernels
+    // returns the fraction of sampled pages that are on the wrong node
+    double report_pages(data::Field const& x, const char* name);
+}
+
+#endif /* AFFINITY_H */
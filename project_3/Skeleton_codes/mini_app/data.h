@@ -31,6 +31,8 @@ class Field {
         #endif
         ptr_ = new double[xdim*ydim];
         // initialize (OpenMP: do first touch)
+        // new[] does not touch the pages, so they are mapped on the NUMA
+        // node of the thread that writes them first in fill()
         fill(0.);
     }
     // destructor
@@ -48,6 +50,8 @@ class Field {
         xdim_ = xdim;
         ydim_ = ydim;
         // initialize (OpenMP: do first touch)
+        // new[] does not touch the pages, so they are mapped on the NUMA
+        // node of the thread that writes them first in fill()
         fill(0.);
     }
     
@@ -88,8 +92,10 @@ class Field {
 
     private:
     // set to a constant value
+    // uses the same schedule(static) distribution as the linalg kernels, so
+    // that every thread later works on the pages it touched first
     void fill(double val) {
-        #pragma omp parallel for
+        #pragma omp parallel for schedule(static)
         for(int i=0; i<xdim_*ydim_; ++i) {
             ptr_[i] = val;
         }
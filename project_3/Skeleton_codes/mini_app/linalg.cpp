@@ -11,6 +11,8 @@
 #include "operators.h"
 #include "stats.h"
 #include "data.h"
+#include "instrument.h"
+#include "linalg_simd.h"
 
 namespace linalg {
 
@@ -42,43 +44,31 @@ void cg_init(int nx) {
 
 ////////////////////////////////////////////////////////////////////////////////
 //  blas level 1 reductions
+//  the loops are in linalg_simd.cpp, one copy per ISA: the first call of
+//  each routine picks the best one this CPU runs (SIMD_ISA=... to force a
+//  lower one)
 ////////////////////////////////////////////////////////////////////////////////
 
 // computes the inner product of x and y
 // x and y are vectors on length N
 double hpc_dot(Field const& x, Field const& y, const int N) {
-    double result = 0;
-
-    #pragma omp parallel for reduction(+:result)
-    for (int i = 0; i < N; i++) {
-        result += x[i] * y[i];
-    }
-    return result;
+    static auto const dot = SIMD_SELECT(simd_dot);
+    return dot(x.data(), y.data(), N);
 }
 
 // computes the 2-norm of x
 // x is a vector on length N
 double hpc_norm2(Field const& x, const int N) {
-    double result = 0;
-
-    #pragma omp parallel for reduction(+:result)
-    for (int i = 0; i < N; i++) {
-        double val = x[i];
-        result += val * val;
-    }
-
-    return sqrt(result);
+    static auto const sum_squares = SIMD_SELECT(simd_sum_squares);
+    return sqrt(sum_squares(x.data(), N));
 }
 
 // sets entries in a vector to value
 // x is a vector on length N
 // value is a scalar
 void hpc_fill(Field& x, const double value, const int N) {
-    #pragma omp parallel for
-    for (int i = 0; i < N; i++) {
-        x[i] = value;
-    }
-
+    static auto const fill = SIMD_SELECT(simd_fill);
+    fill(x.data(), value, N);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -89,10 +79,8 @@ void hpc_fill(Field& x, const double value, const int N) {
 // x and y are vectors on length N
 // alpha is a scalar
 void hpc_axpy(Field& y, const double alpha, Field const& x, const int N) {
-    #pragma omp parallel for
-    for (int i = 0; i < N; i++) {
-        y[i] += alpha * x[i];
-    }
+    static auto const axpy = SIMD_SELECT(simd_axpy);
+    axpy(y.data(), alpha, x.data(), N);
 }
 
 // computes y = x + alpha*(l-r)
@@ -100,10 +88,8 @@ void hpc_axpy(Field& y, const double alpha, Field const& x, const int N) {
 // alpha is a scalar
 void hpc_add_scaled_diff(Field& y, Field const& x, const double alpha,
                          Field const& l, Field const& r, const int N) {
-    #pragma omp parallel for
-    for (int i = 0; i < N; i++) {
-        y[i] = x[i] + alpha * (l[i] - r[i]);
-    }
+    static auto const add_scaled_diff = SIMD_SELECT(simd_add_scaled_diff);
+    add_scaled_diff(y.data(), x.data(), alpha, l.data(), r.data(), N);
 }
 
 // computes y = alpha*(l-r)
@@ -111,20 +97,16 @@ void hpc_add_scaled_diff(Field& y, Field const& x, const double alpha,
 // alpha is a scalar
 void hpc_scaled_diff(Field& y, const double alpha, Field const& l,
                      Field const& r, const int N) {
-    #pragma omp parallel for
-    for (int i = 0; i < N; i++) {
-        y[i] = alpha * (l[i] - r[i]);
-    }
+    static auto const scaled_diff = SIMD_SELECT(simd_scaled_diff);
+    scaled_diff(y.data(), alpha, l.data(), r.data(), N);
 }
 
 // computes y := alpha*x
 // alpha is scalar
 // y and x are vectors on length n
 void hpc_scale(Field& y, const double alpha, Field const& x, const int N) {
-    #pragma omp parallel for
-    for (int i = 0; i < N; i++) {
-        y[i] = alpha * x[i];
-    }
+    static auto const scale = SIMD_SELECT(simd_scale);
+    scale(y.data(), alpha, x.data(), N);
 }
 
 // computes linear combination of two vectors y := alpha*x + beta*z
@@ -132,19 +114,15 @@ void hpc_scale(Field& y, const double alpha, Field const& x, const int N) {
 // y, x and z are vectors on length n
 void hpc_lcomb(Field& y, const double alpha, Field const& x, const double beta,
                Field const& z, const int N) {
-    #pragma omp parallel for
-    for (int i = 0; i < N; i++) {
-        y[i] = alpha * x[i] + beta * z[i];
-    }
+    static auto const lcomb = SIMD_SELECT(simd_lcomb);
+    lcomb(y.data(), alpha, x.data(), beta, z.data(), N);
 }
 
 // copy one vector into another y := x
 // x and y are vectors of length N
 void hpc_copy(Field& y, Field const& x, const int N) {
-    #pragma omp parallel for
-    for (int i = 0; i < N; i++) {
-        y[i] = x[i];
-    }
+    static auto const copy = SIMD_SELECT(simd_copy);
+    copy(y.data(), x.data(), N);
 }
 
 // conjugate gradient solver
@@ -156,6 +134,8 @@ void hpc_copy(Field& y, Field const& x, const int N) {
 void hpc_cg(Field& deltay, Field const& y_old, Field const& y_new,
             Field const& f, const int maxiters, const double tol,
             bool& success) {
+    INSTR_SCOPE("cg");
+
     // this is the dimension of the linear system that we are to solve
     int N = data::options.N;
     int nx = data::options.nx;
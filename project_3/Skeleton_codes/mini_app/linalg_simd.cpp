@@ -0,0 +1,114 @@
+// blas level 1 kernels for one ISA, see linalg_simd.h
+// no std:: templates here: their out-of-line copies would carry the
+// instructions of this ISA into the other variants
+
+#include <omp.h>
+
+#include "simd.hpp"
+#include "linalg_simd.h"
+
+namespace {
+
+typedef simd::native<double> V;
+
+// [begin, end) of the calling thread: n split in whole vectors
+inline void thread_range(int n, int& begin, int& end) {
+    long blocks = (n + V::width - 1) / V::width;
+    int nt = omp_get_num_threads(), t = omp_get_thread_num();
+    begin = int(blocks * t / nt) * V::width;
+    end   = int(blocks * (t + 1) / nt) * V::width;
+    if (begin > n) begin = n;
+    if (end > n) end = n;
+}
+
+// f(i, k) on the vector at i with k valid lanes (k < V::width in the tail)
+template <class F> void parallel_for(int n, F f) {
+    #pragma omp parallel
+    {
+        int begin, end;
+        thread_range(n, begin, end);
+        int i = begin;
+        for (; i + V::width <= end; i += V::width) f(i, V::width);
+        if (i < end) f(i, end - i);
+    }
+}
+
+// sum over i of f(i, k), two accumulators to hide the FMA latency
+template <class F> double parallel_sum(int n, F f) {
+    double result = 0;
+    #pragma omp parallel reduction(+:result)
+    {
+        int begin, end;
+        thread_range(n, begin, end);
+        V acc0(0.), acc1(0.);
+        int i = begin;
+        for (; i + 2 * V::width <= end; i += 2 * V::width) {
+            acc0 = f(i, V::width, acc0);
+            acc1 = f(i + V::width, V::width, acc1);
+        }
+        for (; i < end; i += V::width) acc0 = f(i, end - i, acc0);
+        result += reduce_add(acc0 + acc1);
+    }
+    return result;
+}
+
+} // namespace
+
+extern "C" {
+
+double SIMD_NAME(simd_dot)(const double* x, const double* y, int n) {
+    return parallel_sum(n, [=](int i, int k, V acc) {
+        return fma(V::load(x + i, k), V::load(y + i, k), acc);
+    });
+}
+
+double SIMD_NAME(simd_sum_squares)(const double* x, int n) {
+    return parallel_sum(n, [=](int i, int k, V acc) {
+        V xi = V::load(x + i, k);
+        return fma(xi, xi, acc);
+    });
+}
+
+void SIMD_NAME(simd_fill)(double* x, double value, int n) {
+    parallel_for(n, [=](int i, int k) { V(value).store(x + i, k); });
+}
+
+void SIMD_NAME(simd_axpy)(double* y, double alpha, const double* x, int n) {
+    parallel_for(n, [=](int i, int k) {
+        fma(V(alpha), V::load(x + i, k), V::load(y + i, k)).store(y + i, k);
+    });
+}
+
+void SIMD_NAME(simd_add_scaled_diff)(double* y, const double* x, double alpha,
+                                     const double* l, const double* r, int n) {
+    parallel_for(n, [=](int i, int k) {
+        V d = V::load(l + i, k) - V::load(r + i, k);
+        fma(V(alpha), d, V::load(x + i, k)).store(y + i, k);
+    });
+}
+
+void SIMD_NAME(simd_scaled_diff)(double* y, double alpha, const double* l,
+                                 const double* r, int n) {
+    parallel_for(n, [=](int i, int k) {
+        (V(alpha) * (V::load(l + i, k) - V::load(r + i, k))).store(y + i, k);
+    });
+}
+
+void SIMD_NAME(simd_scale)(double* y, double alpha, const double* x, int n) {
+    parallel_for(n, [=](int i, int k) {
+        (V(alpha) * V::load(x + i, k)).store(y + i, k);
+    });
+}
+
+void SIMD_NAME(simd_lcomb)(double* y, double alpha, const double* x,
+                           double beta, const double* z, int n) {
+    parallel_for(n, [=](int i, int k) {
+        fma(V(alpha), V::load(x + i, k), V(beta) * V::load(z + i, k)).store(y + i, k);
+    });
+}
+
+void SIMD_NAME(simd_copy)(double* y, const double* x, int n) {
+    parallel_for(n, [=](int i, int k) { V::load(x + i, k).store(y + i, k); });
+}
+
+}
@@ -0,0 +1,29 @@
+// blas level 1 kernels on plain arrays, written once with common/simd and
+// compiled once per ISA (linalg_simd_<isa>.o); linalg.cpp picks the variant
+// the CPU supports when it first calls them
+// every kernel opens its own OpenMP parallel region, with a static
+// schedule in whole vectors
+
+#ifndef LINALG_SIMD_H
+#define LINALG_SIMD_H
+
+#include "dispatch.h"
+
+extern "C" {
+
+SIMD_DECLARE(double, simd_dot, (const double* x, const double* y, int n));
+SIMD_DECLARE(double, simd_sum_squares, (const double* x, int n));
+SIMD_DECLARE(void, simd_fill, (double* x, double value, int n));
+SIMD_DECLARE(void, simd_axpy, (double* y, double alpha, const double* x, int n));
+SIMD_DECLARE(void, simd_add_scaled_diff, (double* y, const double* x, double alpha,
+                                          const double* l, const double* r, int n));
+SIMD_DECLARE(void, simd_scaled_diff, (double* y, double alpha, const double* l,
+                                      const double* r, int n));
+SIMD_DECLARE(void, simd_scale, (double* y, double alpha, const double* x, int n));
+SIMD_DECLARE(void, simd_lcomb, (double* y, double alpha, const double* x,
+                                double beta, const double* z, int n));
+SIMD_DECLARE(void, simd_copy, (double* y, const double* x, int n));
+
+}
+
+#endif /* LINALG_SIMD_H */
@@ -22,10 +22,12 @@
     #include <omp.h>
 #endif
 
+#include "affinity.h"
 #include "data.h"
+#include "dispatch.h"
 #include "linalg.h"
 #include "operators.h"
-#include "walltime.h"
+#include "instrument.h"
 #include "stats.h"
 
 using namespace data;
@@ -96,6 +98,8 @@ static void readcmdline(Discretization& options, int argc, char* argv[]) {
 // =============================================================================
 
 int main(int argc, char* argv[]) {
+    instr_init(-1);
+
     // read command line arguments
     readcmdline(options, argc, argv);
     int nx = options.nx;
@@ -128,6 +132,10 @@ int main(int argc, char* argv[]) {
     std::cout << "iteration :: " << "CG "          << max_cg_iters
                                  << ", Newton "    << max_newton_iters
                                  << ", tolerance " << tolerance << std::endl;
+    std::cout << "simd      :: " << simd_isa_name(simd_detect()) << std::endl;
+#ifdef _OPENMP
+    affinity::report_threads();
+#endif
     std::cout << std::string(80, '=') << std::endl;
 
     // allocate global fields
@@ -141,6 +149,11 @@ int main(int argc, char* argv[]) {
     Field f(nx, nx);
     Field deltay(nx, nx);
 
+#ifdef _OPENMP
+    // the fields were first touched in parallel, check where the pages ended up
+    affinity::report_pages(y_new, "y_new");
+#endif
+
     // set Dirichlet boundary conditions to 0 all around
     double const_bdy = 0.1;
     hpc_fill(bndN, const_bdy, nx);
@@ -175,6 +188,8 @@ int main(int argc, char* argv[]) {
 
     // main time loop
     for (int timestep = 1; timestep <= nt; timestep++) {
+        INSTR_SCOPE("timestep");
+
         // set y_new and y_old to be the solution
         hpc_copy(y_old, y_new, N);
 
@@ -183,8 +198,11 @@ int main(int argc, char* argv[]) {
         int it;
         for (it = 0; it < max_newton_iters; it++) {
             // compute residual
-            diffusion(y_old, y_new, f);
-            residual = hpc_norm2(f, N);
+            {
+                INSTR_SCOPE("residual");
+                diffusion(y_old, y_new, f);
+                residual = hpc_norm2(f, N);
+            }
 
             // check for convergence
             if (residual < tolerance) {
@@ -229,6 +247,7 @@ int main(int argc, char* argv[]) {
 
     // binary data
     {
+        INSTR_SCOPE("output");
         FILE* output = fopen("output.bin", "w");
         fwrite(y_new.data(), sizeof(double), nx * nx, output);
         fclose(output);
@@ -267,6 +286,7 @@ int main(int argc, char* argv[]) {
               << " ###" << std::endl;
     std::cout << "Goodbye!" << std::endl;
 
+    instr_finalize();
 
     return 0;
 }
@@ -9,6 +9,7 @@
 #include "data.h"
 #include "operators.h"
 #include "stats.h"
+#include "instrument.h"
 #include <omp.h>
 
 namespace operators {
@@ -20,6 +21,8 @@ namespace operators {
 // only neighbouring non-boundary points are called inner grid points
 void diffusion(data::Field const& s_old, data::Field const& s_new,
                data::Field& f) {
+    INSTR_SCOPE("diffusion");
+
     using data::options;
 
     using data::bndE;
@@ -35,7 +38,7 @@ void diffusion(data::Field const& s_old, data::Field const& s_new,
     int jend  = nx - 1;
 
     // the interior grid points
-    #pragma omp parallel for collapse(2)
+    #pragma omp parallel for collapse(2) schedule(static)
     for (int j=1; j < jend; j++) {
         for (int i=1; i < iend; i++) {
             f(i,j) = -(4. + alpha) * s_new(i,j)
@@ -0,0 +1,199 @@
+/*
+ * HPC Assignment: Heat Equation Play Code (Explicit Matrix-Free Scheme)
+ *
+ * Description:
+ * Implementation of the flat double-buffered diffusion engine, see heat.hpp.
+ */
+
+#include "heat.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+HeatSolver::HeatSolver(int nx, int ny, double c)
+    : cur_(nx, ny), next_(nx, ny), c_(c), tile_x_(128), tile_y_(128), depth_(8),
+      guard_(false), blown_up_(false), norm1_(0.0), norm_max_(0.0), norm1_limit_(0.0),
+      norm_max_limit_(0.0) {}
+
+void HeatSolver::set_tiling(int tile_x, int tile_y, int depth) {
+    tile_x_ = std::max(1, tile_x);
+    tile_y_ = std::max(1, tile_y);
+    depth_  = std::max(1, depth);
+}
+
+/**
+ * @brief The boundary is never written by the sweeps, so carry it over to the
+ *        second buffer in case the caller changed it in solution().
+ */
+void HeatSolver::copy_boundary() {
+    const int nx = cur_.nx, ny = cur_.ny;
+    std::copy(cur_.row(0), cur_.row(0) + ny, next_.row(0));
+    std::copy(cur_.row(nx-1), cur_.row(nx-1) + ny, next_.row(nx-1));
+    for (int i = 1; i < nx - 1; ++i) {
+        next_(i, 0)    = cur_(i, 0);
+        next_(i, ny-1) = cur_(i, ny-1);
+    }
+}
+
+/**
+ * @brief A stable step (c <= 1/4) makes every interior point a convex
+ *        combination of its stencil, so max|S| can never exceed the largest
+ *        |value| on the grid, boundary included (discrete maximum principle).
+ *        With a zero boundary the same step also moves no mass into the
+ *        interior, and its L1 norm can only decrease; with a non-zero one heat
+ *        flows in legitimately and only the max norm is checked. An unstable
+ *        step amplifies the checkerboard mode by |1 - 8c| > 1, which breaks
+ *        one of the two bounds within a few steps.
+ */
+void HeatSolver::enable_guard(double growth) {
+    const int nx = cur_.nx, ny = cur_.ny;
+    double sum = 0.0, peak = 0.0, edge = 0.0;
+    #pragma omp parallel for schedule(static) reduction(+:sum, edge) reduction(max:peak)
+    for (int i = 0; i < nx; ++i) {
+        for (int j = 0; j < ny; ++j) {
+            double v = std::fabs(cur_(i, j));
+            peak = std::max(peak, v);
+            if (i > 0 && i < nx - 1 && j > 0 && j < ny - 1) sum += v;
+            else edge += v;
+        }
+    }
+    guard_ = true;
+    blown_up_ = false;
+    norm1_ = sum;
+    norm_max_ = peak;
+    norm1_limit_ = edge == 0.0 ? growth * sum : HUGE_VAL;
+    norm_max_limit_ = growth * peak;
+}
+
+/**
+ * @brief NaN and Inf propagate through the sum and the max, and fail the
+ *        comparisons.
+ */
+void HeatSolver::check(double norm1, double norm_max) {
+    norm1_ = norm1;
+    norm_max_ = norm_max;
+    if (guard_ && !(norm1 <= norm1_limit_ && norm_max <= norm_max_limit_)) blown_up_ = true;
+}
+
+void HeatSolver::step() {
+    const int nx = cur_.nx, ny = cur_.ny;
+    if (blown_up_) return;
+    copy_boundary();
+
+    // boundary points are fixed, so only the interior enters the norms
+    double sum = 0.0, peak = 0.0;
+    #pragma omp parallel for schedule(static) reduction(+:sum) reduction(max:peak)
+    for (int i = 1; i < nx - 1; ++i) {
+        double* out = next_.row(i);
+        update_row(cur_.row(i-1), cur_.row(i), cur_.row(i+1), out, 1, ny - 1, c_);
+        #pragma omp simd reduction(+:sum) reduction(max:peak)
+        for (int j = 1; j < ny - 1; ++j) {
+            double v = std::fabs(out[j]);
+            sum += v;
+            peak = v > peak ? v : peak;
+        }
+    }
+
+    std::swap(cur_, next_);
+    check(sum, peak);
+}
+
+void HeatSolver::advance(int steps) {
+    if (depth_ == 1) {
+        for (int t = 0; t < steps && !blown_up_; ++t) step();
+        return;
+    }
+
+    if (blown_up_) return;
+    copy_boundary();
+    while (steps > 0 && !blown_up_) {
+        int d = std::min(depth_, steps);
+        advance_tiles(d);
+        std::swap(cur_, next_);
+        steps -= d;
+    }
+}
+
+/**
+ * @brief Does `depth` time steps from cur_ into next_, tile by tile, and
+ *        updates the norms of the interior from the tile cores.
+ */
+void HeatSolver::advance_tiles(int depth) {
+    const int nx = cur_.nx, ny = cur_.ny;
+    const int ntx = (nx - 2 + tile_x_ - 1) / tile_x_;
+    const int nty = (ny - 2 + tile_y_ - 1) / tile_y_;
+    const int sx = tile_x_ + 2 * depth;
+    const int sy = tile_y_ + 2 * depth;
+
+    double sum = 0.0, peak = 0.0;
+    #pragma omp parallel reduction(+:sum) reduction(max:peak)
+    {
+        // per-thread scratch buffers holding one tile and its halo
+        std::vector<double> buf_a(static_cast<std::size_t>(sx) * sy);
+        std::vector<double> buf_b(static_cast<std::size_t>(sx) * sy);
+
+        #pragma omp for collapse(2) schedule(dynamic)
+        for (int bx = 0; bx < ntx; ++bx) {
+            for (int by = 0; by < nty; ++by) {
+                // tile core in grid coordinates, interior points only
+                const int i0 = 1 + bx * tile_x_, i1 = std::min(i0 + tile_x_, nx - 1);
+                const int j0 = 1 + by * tile_y_, j1 = std::min(j0 + tile_y_, ny - 1);
+
+                // core plus halo, clipped to the grid (boundary points included)
+                const int ei0 = std::max(0, i0 - depth), ei1 = std::min(nx, i1 + depth);
+                const int ej0 = std::max(0, j0 - depth), ej1 = std::min(ny, j1 + depth);
+                const int w = ej1 - ej0;
+
+                double* a = buf_a.data();
+                double* b = buf_b.data();
+
+                // the boundary points are copied into both buffers since they
+                // are read at every step but never written
+                for (int i = ei0; i < ei1; ++i) {
+                    const double* src = cur_.row(i) + ej0;
+                    std::copy(src, src + w, a + (i - ei0) * w);
+                    std::copy(src, src + w, b + (i - ei0) * w);
+                }
+
+                // the region that is still valid shrinks by one point per step
+                for (int s = 1; s <= depth; ++s) {
+                    const int ci0 = std::max(1, i0 - depth + s), ci1 = std::min(nx - 1, i1 + depth - s);
+                    const int cj0 = std::max(1, j0 - depth + s), cj1 = std::min(ny - 1, j1 + depth - s);
+                    for (int i = ci0; i < ci1; ++i) {
+                        const int li = i - ei0;
+                        update_row(a + (li-1) * w, a + li * w, a + (li+1) * w, b + li * w,
+                                   cj0 - ej0, cj1 - ej0, c_);
+                    }
+                    std::swap(a, b);
+                }
+
+                // write the tile core back
+                for (int i = i0; i < i1; ++i) {
+                    const double* src = a + (i - ei0) * w + (j0 - ej0);
+                    std::copy(src, src + (j1 - j0), next_.row(i) + j0);
+                    #pragma omp simd reduction(+:sum) reduction(max:peak)
+                    for (int j = 0; j < j1 - j0; ++j) {
+                        double v = std::fabs(src[j]);
+                        sum += v;
+                        peak = v > peak ? v : peak;
+                    }
+                }
+            }
+        }
+    }
+    check(sum, peak);
+}
+
+void update_naive(std::vector<std::vector<double>>& S, double c) {
+    const int nx = S.size(), ny = S[0].size();
+    std::vector<std::vector<double>> S_new(nx, std::vector<double>(ny));
+
+    for (int i = 1; i < nx - 1; ++i) {
+        for (int j = 1; j < ny - 1; ++j) {
+            S_new[i][j] = S[i][j] + c * (-4*S[i][j] + S[i+1][j] + S[i-1][j] + S[i][j+1] + S[i][j-1]);
+        }
+    }
+
+    S = S_new;
+}
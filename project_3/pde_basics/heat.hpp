@@ -0,0 +1,149 @@
+/*
+ * HPC Assignment: Heat Equation Play Code (Explicit Matrix-Free Scheme)
+ *
+ * Description:
+ * Flat, double-buffered explicit diffusion engine. One time step computes
+ *     S_new = S + c * (S(i+1,j) + S(i-1,j) + S(i,j+1) + S(i,j-1) - 4 S(i,j))
+ * with c = alpha * tau / h^2 on the interior points; the outermost rows and
+ * columns are Dirichlet boundary points and are never updated.
+ *
+ * advance() uses overlapped temporal blocking: the grid is cut into tiles,
+ * each tile is copied together with a halo of `depth` points into a small
+ * scratch buffer that stays in cache, and `depth` time steps are done there
+ * before the tile core is written back. The halo shrinks by one point per
+ * step, so the tiles are independent (the overlap is recomputed) and can be
+ * distributed over OpenMP threads without any synchronisation.
+ */
+
+#ifndef HEAT_HPP
+#define HEAT_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Row-major grid stored in one contiguous allocation, S(i,j) = data[i*ny + j].
+ */
+struct Grid {
+    Grid(int nx_, int ny_) : nx(nx_), ny(ny_), data(static_cast<std::size_t>(nx_) * ny_, 0.0) {}
+
+    double&       operator()(int i, int j)       { return data[static_cast<std::size_t>(i) * ny + j]; }
+    const double& operator()(int i, int j) const { return data[static_cast<std::size_t>(i) * ny + j]; }
+
+    double*       row(int i)       { return data.data() + static_cast<std::size_t>(i) * ny; }
+    const double* row(int i) const { return data.data() + static_cast<std::size_t>(i) * ny; }
+
+    int nx;
+    int ny;
+    std::vector<double> data;
+};
+
+/**
+ * @brief Updates the points [j0, j1) of one row from the three rows around it.
+ */
+inline void update_row(const double* __restrict up, const double* __restrict mid,
+                       const double* __restrict down, double* __restrict out,
+                       int j0, int j1, double c) {
+    #pragma omp simd
+    for (int j = j0; j < j1; ++j) {
+        out[j] = mid[j] + c * (up[j] + down[j] + mid[j-1] + mid[j+1] - 4.0 * mid[j]);
+    }
+}
+
+/**
+ * @brief Largest stable time step of the explicit scheme. In 2D the update is a
+ *        convex combination of the five stencil points as long as
+ *        alpha * tau / h^2 <= 1/4 (CFL condition); beyond that it blows up.
+ */
+inline double max_stable_tau(double alpha, double h) {
+    return h * h / (4.0 * alpha);
+}
+
+/**
+ * @brief Number of sub-steps needed to cover an output interval `tau_out`
+ *        without exceeding the stable time step.
+ */
+inline int substeps(double tau_out, double alpha, double h) {
+    int m = static_cast<int>(std::ceil(tau_out / max_stable_tau(alpha, h)));
+    return m < 1 ? 1 : m;
+}
+
+/**
+ * @brief Explicit solver for ∂s/∂t = αΔs on a double-buffered flat grid.
+ */
+class HeatSolver {
+public:
+    /**
+     * @param nx, ny Number of grid points (including the boundary points).
+     * @param c      Diffusion number alpha * tau / h^2.
+     */
+    HeatSolver(int nx, int ny, double c);
+
+    /** @brief Current solution; write the initial condition here. */
+    Grid&       solution()       { return cur_; }
+    const Grid& solution() const { return cur_; }
+
+    /** @brief Advances one time step with a single parallel sweep over the grid. */
+    void step();
+
+    /** @brief Advances `steps` time steps using temporal blocking. */
+    void advance(int steps);
+
+    /**
+     * @brief Makes step() and advance() stop as soon as the solution contains
+     *        NaN/Inf or grows past what a stable step preserves: max|S| never
+     *        exceeds its initial value (boundary included), and with a zero
+     *        boundary the L1 norm of the interior never increases. `growth`
+     *        only absorbs rounding, so the first step that amplifies an
+     *        unstable mode trips the guard. The norms are taken while the new
+     *        values are still in cache, so the check costs no extra sweep.
+     */
+    void enable_guard(double growth = 1.0 + 1e-12);
+
+    /** @brief True once the guard has stopped the solver. */
+    bool blown_up() const { return blown_up_; }
+
+    /** @brief L1 norm of the solution after the last step() or advance(). */
+    double norm1() const { return norm1_; }
+
+    /** @brief Max norm of the solution after the last step() or advance(). */
+    double norm_max() const { return norm_max_; }
+
+    /**
+     * @brief Sets the tile shape and the number of time steps done per tile.
+     *        depth = 1 falls back to one sweep per time step.
+     */
+    void set_tiling(int tile_x, int tile_y, int depth);
+
+    int tile_x() const { return tile_x_; }
+    int tile_y() const { return tile_y_; }
+    int depth()  const { return depth_; }
+
+private:
+    void copy_boundary();
+    void advance_tiles(int depth);
+    void check(double norm1, double norm_max);
+
+    Grid cur_;
+    Grid next_;
+    double c_;
+    int tile_x_;
+    int tile_y_;
+    int depth_;
+
+    bool guard_;
+    bool blown_up_;
+    double norm1_;
+    double norm_max_;
+    double norm1_limit_;
+    double norm_max_limit_;
+};
+
+/**
+ * @brief Reference update on a std::vector<std::vector<double>> grid, allocating
+ *        a new grid every step. Kept to benchmark the engine against.
+ */
+void update_naive(std::vector<std::vector<double>>& S, double c);
+
+#endif // HEAT_HPP
@@ -0,0 +1,261 @@
+/*
+ * HPC Assignment: Heat Equation Play Code (Explicit Matrix-Free Scheme)
+ *
+ * Description:
+ * Implementation of the deep-halo distributed solver, see heat_mpi.hpp.
+ */
+
+#include "heat_mpi.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+void SubDomain::init(int nx_global, int ny_global, MPI_Comm comm) {
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // let MPI choose the number of sub-domains in each dimension
+    int dims[2] = {0, 0};
+    MPI_Dims_create(size, 2, dims);
+    ndomx = dims[0];
+    ndomy = dims[1];
+
+    // non-periodic Cartesian topology, no reordering
+    int periods[2] = {0, 0};
+    MPI_Cart_create(comm, 2, dims, periods, 0, &comm_cart);
+
+    int coords[2];
+    MPI_Cart_coords(comm_cart, rank, 2, coords);
+    domx = coords[0];
+    domy = coords[1];
+
+    MPI_Cart_shift(comm_cart, 0, 1, &neighbour_south, &neighbour_north);
+    MPI_Cart_shift(comm_cart, 1, 1, &neighbour_west,  &neighbour_east);
+
+    // spread the remainder over the first sub-domains,
+    // e.g. 10 points on 3 ranks -> 4, 3, 3 points
+    int base_nx = nx_global / ndomx, rem_x = nx_global % ndomx;
+    int base_ny = ny_global / ndomy, rem_y = ny_global % ndomy;
+
+    nx = base_nx + (domx < rem_x ? 1 : 0);
+    ny = base_ny + (domy < rem_y ? 1 : 0);
+
+    startx = domx * base_nx + std::min(domx, rem_x);
+    starty = domy * base_ny + std::min(domy, rem_y);
+    endx = startx + nx;
+    endy = starty + ny;
+}
+
+void SubDomain::print() const {
+    for (int irank = 0; irank < size; irank++) {
+        if (irank == rank) {
+            std::cout << "rank " << rank << " / " << size
+                      << " : (" << domx << ", " << domy << ")"
+                      << " neigh N:S " << neighbour_north
+                      << ":"           << neighbour_south
+                      << " neigh E:W " << neighbour_east
+                      << ":"           << neighbour_west
+                      << " local dims " << nx << " x " << ny
+                      << std::endl;
+        }
+        MPI_Barrier(comm_cart);
+    }
+}
+
+/**
+ * @brief The halo is filled from the neighbours' owned points, so it can not be
+ *        wider than the smallest sub-domain.
+ */
+static int clip_depth(const SubDomain& domain, int max_depth) {
+    int local = std::min(domain.nx, domain.ny);
+    int smallest;
+    MPI_Allreduce(&local, &smallest, 1, MPI_INT, MPI_MIN, domain.comm_cart);
+    return std::max(1, std::min(max_depth, smallest));
+}
+
+DeepHaloSolver::DeepHaloSolver(const SubDomain& domain, int nx, int ny, double c, int max_depth)
+    : domain_(domain), nx_(nx), ny_(ny), c_(c),
+      halo_(clip_depth(domain, max_depth)), depth_(halo_),
+      cur_(domain.nx + 2 * halo_, domain.ny + 2 * halo_),
+      next_(domain.nx + 2 * halo_, domain.ny + 2 * halo_),
+      row_types_(halo_ + 1, MPI_DATATYPE_NULL),
+      col_types_(halo_ + 1, MPI_DATATYPE_NULL) {}
+
+DeepHaloSolver::~DeepHaloSolver() {
+    for (int d = 0; d <= halo_; ++d) {
+        if (row_types_[d] != MPI_DATATYPE_NULL) MPI_Type_free(&row_types_[d]);
+        if (col_types_[d] != MPI_DATATYPE_NULL) MPI_Type_free(&col_types_[d]);
+    }
+}
+
+void DeepHaloSolver::set_depth(int depth) {
+    depth_ = std::max(1, std::min(depth, halo_));
+}
+
+/**
+ * @brief rows x cols block inside the local grid (row-major, row length cur_.ny).
+ */
+MPI_Datatype DeepHaloSolver::block_type(int rows, int cols) const {
+    MPI_Datatype type;
+    MPI_Type_vector(rows, cols, cur_.ny, MPI_DOUBLE, &type);
+    MPI_Type_commit(&type);
+    return type;
+}
+
+/**
+ * @brief Fills the innermost `depth` layers of the halo of cur_. The i direction
+ *        is exchanged first, then the j direction including the rows just
+ *        received, which takes care of the corners.
+ */
+void DeepHaloSolver::exchange(int depth) {
+    const int K = halo_, d = depth;
+    const int nxl = domain_.nx, nyl = domain_.ny;
+    MPI_Comm comm = domain_.comm_cart;
+
+    if (row_types_[d] == MPI_DATATYPE_NULL) {
+        row_types_[d] = block_type(d, nyl);
+        col_types_[d] = block_type(nxl + 2 * d, d);
+    }
+
+    MPI_Request requests[4];
+
+    // north/south: d rows of owned columns
+    MPI_Irecv(&cur_(K - d, K),   1, row_types_[d], domain_.neighbour_south, 0, comm, &requests[0]);
+    MPI_Irecv(&cur_(K + nxl, K), 1, row_types_[d], domain_.neighbour_north, 1, comm, &requests[1]);
+    MPI_Isend(&cur_(K + nxl - d, K), 1, row_types_[d], domain_.neighbour_north, 0, comm, &requests[2]);
+    MPI_Isend(&cur_(K, K),           1, row_types_[d], domain_.neighbour_south, 1, comm, &requests[3]);
+    MPI_Waitall(4, requests, MPI_STATUSES_IGNORE);
+
+    // east/west: d columns, including the north/south halo rows
+    MPI_Irecv(&cur_(K - d, K - d),   1, col_types_[d], domain_.neighbour_west, 2, comm, &requests[0]);
+    MPI_Irecv(&cur_(K - d, K + nyl), 1, col_types_[d], domain_.neighbour_east, 3, comm, &requests[1]);
+    MPI_Isend(&cur_(K - d, K + nyl - d), 1, col_types_[d], domain_.neighbour_east, 2, comm, &requests[2]);
+    MPI_Isend(&cur_(K - d, K),           1, col_types_[d], domain_.neighbour_west, 3, comm, &requests[3]);
+    MPI_Waitall(4, requests, MPI_STATUSES_IGNORE);
+}
+
+/**
+ * @brief Bytes this rank sends in one exchange of the given depth.
+ */
+double DeepHaloSolver::exchange_bytes(int depth) const {
+    double rows = double(depth) * domain_.ny;
+    double cols = double(depth) * (domain_.nx + 2 * depth);
+    int ns = (domain_.neighbour_north != MPI_PROC_NULL) + (domain_.neighbour_south != MPI_PROC_NULL);
+    int ew = (domain_.neighbour_east  != MPI_PROC_NULL) + (domain_.neighbour_west  != MPI_PROC_NULL);
+    return sizeof(double) * (ns * rows + ew * cols);
+}
+
+void DeepHaloSolver::advance(int steps) {
+    const int K = halo_;
+    while (steps > 0) {
+        const int d = std::min(depth_, steps);
+        exchange(d);
+
+        // after step s only the points at distance <= d - s from the owned
+        // block are still valid; the global boundary is never updated
+        for (int s = 1; s <= d; ++s) {
+            const int r = d - s;
+            const int gi0 = std::max(1, domain_.startx - r), gi1 = std::min(nx_ - 1, domain_.endx + r);
+            const int gj0 = std::max(1, domain_.starty - r), gj1 = std::min(ny_ - 1, domain_.endy + r);
+            const int lj0 = gj0 - domain_.starty + K, lj1 = gj1 - domain_.starty + K;
+
+            #pragma omp parallel for schedule(static)
+            for (int gi = gi0; gi < gi1; ++gi) {
+                const int li = gi - domain_.startx + K;
+                update_row(cur_.row(li-1), cur_.row(li), cur_.row(li+1), next_.row(li), lj0, lj1, c_);
+            }
+            std::swap(cur_, next_);
+        }
+        steps -= d;
+    }
+}
+
+int DeepHaloSolver::autotune(int reps) {
+    MPI_Comm comm = domain_.comm_cart;
+    const int K = halo_;
+
+    // exchange time for the shallowest and the deepest halo
+    auto time_exchange = [&](int d) {
+        MPI_Barrier(comm);
+        double start = MPI_Wtime();
+        for (int r = 0; r < reps; ++r) exchange(d);
+        return (MPI_Wtime() - start) / reps;
+    };
+    const double t1 = time_exchange(1);
+    const double tK = time_exchange(K);
+
+    // fit t(d) = latency + bytes(d) / bandwidth through both measurements
+    const double b1 = exchange_bytes(1), bK = exchange_bytes(K);
+    const double inv_bw  = (bK > b1) ? std::max(0.0, (tK - t1) / (bK - b1)) : 0.0;
+    const double latency = std::max(0.0, t1 - b1 * inv_bw);
+
+    // time per cell update from a sweep over the owned block; the result is
+    // written to next_, which is overwritten before it is read in advance()
+    const int gi0 = std::max(1, domain_.startx), gi1 = std::min(nx_ - 1, domain_.endx);
+    const int gj0 = std::max(1, domain_.starty), gj1 = std::min(ny_ - 1, domain_.endy);
+    double t_cell = 0.0;
+    if (gi1 > gi0 && gj1 > gj0) {
+        double best = std::numeric_limits<double>::max();
+        for (int r = 0; r < 3; ++r) {
+            double start = MPI_Wtime();
+            #pragma omp parallel for schedule(static)
+            for (int gi = gi0; gi < gi1; ++gi) {
+                const int li = gi - domain_.startx + K;
+                update_row(cur_.row(li-1), cur_.row(li), cur_.row(li+1), next_.row(li),
+                           gj0 - domain_.starty + K, gj1 - domain_.starty + K, c_);
+            }
+            best = std::min(best, MPI_Wtime() - start);
+        }
+        t_cell = best / (double(gi1 - gi0) * (gj1 - gj0));
+    }
+
+    // modelled time per step for every depth on this rank; the slowest rank
+    // sets the pace, so take the maximum over all ranks before choosing
+    std::vector<double> cost(K), worst(K);
+    for (int d = 1; d <= K; ++d) {
+        double cells = 0.0;
+        for (int s = 1; s <= d; ++s) {
+            cells += double(domain_.nx + 2 * (d - s)) * (domain_.ny + 2 * (d - s));
+        }
+        cost[d-1] = (latency + exchange_bytes(d) * inv_bw) / d + t_cell * cells / d;
+    }
+    MPI_Allreduce(cost.data(), worst.data(), K, MPI_DOUBLE, MPI_MAX, comm);
+
+    set_depth(int(std::min_element(worst.begin(), worst.end()) - worst.begin()) + 1);
+    return depth_;
+}
+
+void DeepHaloSolver::gather(Grid& global, int root) const {
+    const int K = halo_;
+    MPI_Comm comm = domain_.comm_cart;
+
+    // pack the owned block together with its position in the global grid
+    int header[4] = {domain_.startx, domain_.starty, domain_.nx, domain_.ny};
+    std::vector<double> block(static_cast<std::size_t>(domain_.nx) * domain_.ny);
+    for (int i = 0; i < domain_.nx; ++i) {
+        std::copy(cur_.row(i + K) + K, cur_.row(i + K) + K + domain_.ny, block.data() + i * domain_.ny);
+    }
+
+    if (domain_.rank != root) {
+        MPI_Send(header, 4, MPI_INT, root, 10, comm);
+        MPI_Send(block.data(), int(block.size()), MPI_DOUBLE, root, 11, comm);
+        return;
+    }
+
+    auto unpack = [&] {
+        for (int i = 0; i < header[2]; ++i) {
+            std::copy(block.data() + i * header[3], block.data() + (i + 1) * header[3],
+                      global.row(header[0] + i) + header[1]);
+        }
+    };
+    unpack();
+    for (int r = 0; r < domain_.size; ++r) {
+        if (r == root) continue;
+        MPI_Recv(header, 4, MPI_INT, r, 10, comm, MPI_STATUS_IGNORE);
+        block.resize(static_cast<std::size_t>(header[2]) * header[3]);
+        MPI_Recv(block.data(), int(block.size()), MPI_DOUBLE, r, 11, comm, MPI_STATUS_IGNORE);
+        unpack();
+    }
+}
@@ -0,0 +1,131 @@
+/*
+ * HPC Assignment: Heat Equation Play Code (Explicit Matrix-Free Scheme)
+ *
+ * Description:
+ * Distributed-memory version of the explicit solver with a deep halo.
+ * Every rank owns a block of a 2D Cartesian decomposition (same scheme as
+ * data::SubDomain in the mini_app) and keeps a halo of width k around it.
+ * The halo is exchanged once every k time steps; in between, the rank
+ * redoes the neighbours' work on the part of the halo that is still valid,
+ * so it needs one message round per k steps instead of one per step.
+ */
+
+#ifndef HEAT_MPI_HPP
+#define HEAT_MPI_HPP
+
+#include <mpi.h>
+
+#include <vector>
+
+#include "heat.hpp"
+
+/**
+ * @brief Block of the global grid owned by one rank in a 2D Cartesian topology.
+ */
+struct SubDomain {
+    /**
+     * @brief Splits the global nx x ny grid over the ranks of comm, using
+     *        MPI_Dims_create and a non-periodic MPI_Cart_create.
+     */
+    void init(int nx_global, int ny_global, MPI_Comm comm);
+
+    // print sub-domain information
+    void print() const;
+
+    // number of sub-domains in the i and j dimensions
+    int ndomx;
+    int ndomy;
+
+    // the i and j index of this sub-domain (0-based)
+    int domx;
+    int domy;
+
+    // global index range [startx, endx) x [starty, endy) owned by this rank
+    int startx;
+    int starty;
+    int endx;
+    int endy;
+
+    // the rank of neighbouring domains (MPI_PROC_NULL at the global boundary)
+    int neighbour_north; // i + 1
+    int neighbour_east;  // j + 1
+    int neighbour_south; // i - 1
+    int neighbour_west;  // j - 1
+
+    // mpi info
+    int size;
+    int rank;
+    MPI_Comm comm_cart;
+
+    // grid points in i and j dimension of this sub-domain
+    int nx;
+    int ny;
+};
+
+/**
+ * @brief Explicit solver on a SubDomain with a halo of width up to max_depth,
+ *        exchanged every depth() time steps.
+ */
+class DeepHaloSolver {
+public:
+    /**
+     * @param domain    Decomposition of the global grid.
+     * @param nx, ny    Global number of grid points (including the boundary points).
+     * @param c         Diffusion number alpha * tau / h^2.
+     * @param max_depth Allocated halo width, clipped to the smallest sub-domain.
+     */
+    DeepHaloSolver(const SubDomain& domain, int nx, int ny, double c, int max_depth);
+    ~DeepHaloSolver();
+
+    /**
+     * @brief Sets the owned points to f(i, j) (global indices) and fills the halos.
+     */
+    template <typename F>
+    void fill(F f) {
+        for (int i = domain_.startx; i < domain_.endx; ++i) {
+            for (int j = domain_.starty; j < domain_.endy; ++j) {
+                cur_(i - domain_.startx + halo_, j - domain_.starty + halo_) = f(i, j);
+            }
+        }
+        exchange(halo_);
+        next_.data = cur_.data;
+    }
+
+    /** @brief Advances `steps` time steps, exchanging the halo every depth() steps. */
+    void advance(int steps);
+
+    /**
+     * @brief Picks the depth that minimises the modelled time per step,
+     *            t(k) = (latency + bytes(k) / bandwidth) / k + t_cell * cells(k),
+     *        where latency, bandwidth and t_cell are measured on the fly and
+     *        cells(k) counts the redundant overlap. Collective over comm_cart.
+     */
+    int autotune(int reps = 20);
+
+    void set_depth(int depth);
+    int depth()     const { return depth_; }
+    int max_depth() const { return halo_; }
+
+    /** @brief Collects the owned blocks of all ranks into `global` on `root`. */
+    void gather(Grid& global, int root) const;
+
+private:
+    void exchange(int depth);
+    MPI_Datatype block_type(int rows, int cols) const;
+    double exchange_bytes(int depth) const;
+
+    const SubDomain& domain_;
+    int nx_;
+    int ny_;
+    double c_;
+    int halo_;
+    int depth_;
+    Grid cur_;
+    Grid next_;
+
+    // cached halo datatypes, indexed by depth
+    std::vector<MPI_Datatype> row_types_;
+    std::vector<MPI_Datatype> col_types_;
+};
+
+#endif // HEAT_MPI_HPP
@@ -9,11 +9,18 @@
  *
  * Compilation Instructions:
  * To compile the program, use the following command:
- * g++ -o main.exe main.cpp
+ * g++ -O3 -fopenmp -o main.exe main.cpp heat.cpp   (or simply: make)
  *
  * Run Instructions:
  * To run the program:
  * $ ./heat_equation_solver
+ * $ ./main.exe [tau] [alpha] [h] [fixed]
+ * `tau` is the time between two printed frames. It is split into the smallest number of
+ * sub-steps that satisfy the CFL condition alpha * dt / h^2 <= 1/4; pass `fixed` to use
+ * tau itself as the time step. Runs that blow up (NaN, or growth of max|S| or of |S|_1
+ * beyond what a stable step allows) are stopped at the first frame that shows it.
+ * To benchmark the naive update against the flat engine (cell updates per second):
+ * $ ./main.exe bench [n] [steps] [depth] [tile]
  *
  *
  * TODO:
@@ -21,9 +28,15 @@
  * See the Courant-Friedrichs-Lewy (CFL) condition for stability: https://people.math.ethz.ch/~grsam/SS21/NAII/resources/slides/ODE-Lecture6.pdf
  */
 
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <vector>
 
+#include "heat.hpp"
+
 // Grid and time parameters
 int nx = 20;          // Number of spatial grid points in x direction
 int ny = 20;          // Number of spatial grid points in y direction
@@ -36,39 +49,21 @@ int T = 500;          // Number of time steps
  * @brief Initializes the solution grid with the initial condition (hotspot in the center) 
  *        and zero boundary conditions.
  * 
- * @param S Solution grid (2D vector).
+ * @param S Solution grid.
  */
-void initialize(std::vector<std::vector<double>>& S) {
-    for (int i = 0; i < nx; ++i) {
-        for (int j = 0; j < ny; ++j) {
-            S[i][j] = 0.0;
+void initialize(Grid& S) {
+    for (int i = 0; i < S.nx; ++i) {
+        for (int j = 0; j < S.ny; ++j) {
+            S(i, j) = 0.0;
             
             // Initial condition: set a hot spot in the center
             if (i > 1 && i < 5 && j > 1 && j < 5) {
-                S[i][j] = 1.0;
+                S(i, j) = 1.0;
             }
         }
     }
 }
 
-/**
- * @brief Updates the solution grid using the explicit time-stepping method.
- * 
- * @param S Solution grid (2D vector).
- */
-void update(std::vector<std::vector<double>>& S) {
-    std::vector<std::vector<double>> S_new(nx, std::vector<double>(ny));
-
-    for (int i = 1; i < nx - 1; ++i) {
-        for (int j = 1; j < ny - 1; ++j) {
-            double temp = (-4*S[i][j] + S[i+1][j] + S[i-1][j] + S[i][j+1] + S[i][j-1]) / (h*h);
-            S_new[i][j] = S[i][j] + alpha * tau * temp;
-        }
-    }
-
-    S = S_new;
-}
-
 /**
  * @brief Converts a value in the range [0,1] to a corresponding ASCII character for visualization.
  * 
@@ -93,26 +88,119 @@ char ascii(double val) {
 /**
  * @brief Prints the solution grid either as numerical values or ASCII characters.
  * 
- * @param S Solution grid (2D vector).
+ * @param S Solution grid.
  * @param print_ascii If true, prints ASCII representation; otherwise, prints numerical values.
  */
-void print(const std::vector<std::vector<double>>& S, bool print_ascii = true) {
-    for (int i = 0; i < nx; ++i) {
-        for (int j = 0; j < ny; ++j) {
+void print(const Grid& S, bool print_ascii = true) {
+    for (int i = 0; i < S.nx; ++i) {
+        for (int j = 0; j < S.ny; ++j) {
             if (print_ascii) {
-                std::cout << ascii(S[i][j]) << " ";
+                std::cout << ascii(S(i, j)) << " ";
             } else {
-                std::cout << S[i][j] << " ";
+                std::cout << S(i, j) << " ";
             }
         }
         std::cout << std::endl;
     }
 }
 
-int main() {
+/**
+ * @brief Returns the time in seconds it takes to run f().
+ */
+template <typename F>
+double time_it(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Benchmark mode: compares the naive update against the flat engine with
+ *        one sweep per step and with temporal blocking, in cell updates per second.
+ *
+ * Usage: ./main.exe bench [n] [steps] [depth] [tile]
+ */
+int benchmark(int argc, char* argv[]) {
+    int n     = argc > 2 ? std::atoi(argv[2]) : 2048;
+    int steps = argc > 3 ? std::atoi(argv[3]) : 64;
+    int depth = argc > 4 ? std::atoi(argv[4]) : 8;
+    int tile  = argc > 5 ? std::atoi(argv[5]) : 128;
+    if (n < 3 || steps < 1 || depth < 1 || tile < 1) {
+        std::cerr << "Usage: ./main.exe bench [n >= 3] [steps] [depth] [tile]" << std::endl;
+        return 1;
+    }
+
+    const double c = alpha * tau / (h * h);
+    const double updates = double(n - 2) * (n - 2) * steps;
+
+    // same smooth initial condition for all three variants
+    std::vector<std::vector<double>> S_naive(n, std::vector<double>(n, 0.0));
+    HeatSolver sweep(n, n, c);
+    HeatSolver blocked(n, n, c);
+    blocked.set_tiling(tile, tile, depth);
+    for (int i = 1; i < n - 1; ++i) {
+        for (int j = 1; j < n - 1; ++j) {
+            double v = std::sin(0.01 * i) * std::cos(0.013 * j);
+            S_naive[i][j] = v;
+            sweep.solution()(i, j) = v;
+            blocked.solution()(i, j) = v;
+        }
+    }
+
+    double t_naive   = time_it([&] { for (int t = 0; t < steps; ++t) update_naive(S_naive, c); });
+    double t_sweep   = time_it([&] { for (int t = 0; t < steps; ++t) sweep.step(); });
+    double t_blocked = time_it([&] { blocked.advance(steps); });
+
+    double err = 0.0;
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            err = std::fmax(err, std::fabs(S_naive[i][j] - blocked.solution()(i, j)));
+            err = std::fmax(err, std::fabs(S_naive[i][j] - sweep.solution()(i, j)));
+        }
+    }
+
+    std::cout << "grid " << n << " x " << n << ", " << steps << " steps, c = " << c
+              << ", tile " << tile << " x " << tile << ", depth " << depth << std::endl;
+    std::cout << "naive   : " << t_naive   << " s, " << updates / t_naive   * 1e-6 << " MLUP/s" << std::endl;
+    std::cout << "sweep   : " << t_sweep   << " s, " << updates / t_sweep   * 1e-6 << " MLUP/s"
+              << " (x" << t_naive / t_sweep << ")" << std::endl;
+    std::cout << "blocked : " << t_blocked << " s, " << updates / t_blocked * 1e-6 << " MLUP/s"
+              << " (x" << t_naive / t_blocked << ")" << std::endl;
+    std::cout << "max |naive - engine| = " << err << std::endl;
+    return err < 1e-10 ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::strcmp(argv[1], "bench") == 0) {
+        return benchmark(argc, argv);
+    }
+
+    // Read the optional parameters
+    if (argc > 1) tau   = std::atof(argv[1]);
+    if (argc > 2) alpha = std::atof(argv[2]);
+    if (argc > 3) h     = std::atof(argv[3]);
+    bool fixed = argc > 4 && std::strcmp(argv[4], "fixed") == 0;
+    if (tau <= 0 || alpha <= 0 || h <= 0) {
+        std::cerr << "Usage: ./main.exe [tau > 0] [alpha > 0] [h > 0] [fixed]" << std::endl;
+        return 1;
+    }
+
+    // Sub-cycle each frame with the largest stable time step
+    double tau_max = max_stable_tau(alpha, h);
+    int m = fixed ? 1 : substeps(tau, alpha, h);
+    double dt = tau / m;
+    std::cout << "tau = " << tau << ", stable step = " << tau_max
+              << ", " << m << " sub-step(s) of dt = " << dt
+              << " (alpha * dt / h^2 = " << alpha * dt / (h * h) << ")" << std::endl;
+    if (dt > tau_max) {
+        std::cout << "WARNING: dt exceeds the CFL limit, the solution will blow up" << std::endl;
+    }
+
     // Initialize the solution grid
-    std::vector<std::vector<double>> S(nx, std::vector<double>(ny));
+    HeatSolver solver(nx, ny, alpha * dt / (h * h));
+    Grid& S = solver.solution();
     initialize(S);
+    solver.enable_guard();
 
     std::cout << "###################" << std::endl;
     std::cout << "# Initial Condition #" << std::endl;
@@ -122,11 +210,19 @@ int main() {
 
     // Time-stepping loop
     for (int t = 1; t < T; ++t) {
-        update(S);
+        solver.advance(m);
+
+        // Stop as soon as the run is lost instead of printing garbage
+        if (solver.blown_up()) {
+            std::cerr << "Solution blew up in time step " << t << " (|S|_1 = " << solver.norm1()
+                      << ", max|S| = " << solver.norm_max() << "), reduce tau or drop `fixed`"
+                      << std::endl;
+            return 1;
+        }
 
         // Print the solution grid and clear the screen
-        print(S);
-        std::cout << "Time Step = " << t << std::endl;
+        print(solver.solution());
+        std::cout << "Time Step = " << t << ", t = " << t * tau << std::endl;
 
         // Wait for user input to proceed
         std::cin.get();
@@ -0,0 +1,114 @@
+/*
+ * HPC Assignment: Heat Equation Play Code (Explicit Matrix-Free Scheme)
+ *
+ * Description:
+ * Distributed driver for the explicit heat solver with a deep halo (see
+ * heat_mpi.hpp). Reports the aggregate cell-update rate and, for small
+ * grids, checks the result against the serial HeatSolver on rank 0.
+ *
+ * Compilation Instructions:
+ * make main_mpi.exe
+ *
+ * Run Instructions:
+ * $ mpirun -n 4 ./main_mpi.exe [n] [steps] [k] [max_k]
+ *   n      global grid is n x n (default 2048)
+ *   steps  number of time steps (default 200)
+ *   k      halo width / steps between exchanges, 0 = auto-tune (default 0)
+ *   max_k  largest halo width considered by the auto-tuner (default 16)
+ */
+
+#include <mpi.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include "heat.hpp"
+#include "heat_mpi.hpp"
+
+// Grid and time parameters
+double h = 0.01;      // Spatial step size in x and y direction
+double tau = 0.0001;  // Time step size
+double alpha = 0.01;  // Thermal diffusivity
+
+// grids up to this size are checked against the serial solver
+const int max_check = 2048;
+
+/**
+ * @brief Smooth initial condition, zero on the boundary.
+ */
+double initial(int i, int j, int n) {
+    if (i == 0 || j == 0 || i == n - 1 || j == n - 1) return 0.0;
+    return std::sin(0.01 * i) * std::cos(0.013 * j);
+}
+
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+
+    int n     = argc > 1 ? std::atoi(argv[1]) : 2048;
+    int steps = argc > 2 ? std::atoi(argv[2]) : 200;
+    int k     = argc > 3 ? std::atoi(argv[3]) : 0;
+    int max_k = argc > 4 ? std::atoi(argv[4]) : 16;
+
+    SubDomain domain;
+    domain.init(n, n, MPI_COMM_WORLD);
+    if (n < 3 || steps < 1 || k < 0 || max_k < 1 || domain.nx < 1 || domain.ny < 1) {
+        if (domain.rank == 0) {
+            std::cerr << "Usage: mpirun -n P ./main_mpi.exe [n >= 3] [steps] [k] [max_k]" << std::endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    // the solver owns MPI datatypes, so it has to go before MPI_Finalize
+    {
+        const double c = alpha * tau / (h * h);
+        DeepHaloSolver solver(domain, n, n, c, max_k);
+        solver.fill([n](int i, int j) { return initial(i, j, n); });
+
+        if (k == 0) {
+            solver.autotune();
+        } else {
+            solver.set_depth(k);
+        }
+
+        MPI_Barrier(domain.comm_cart);
+        double start = MPI_Wtime();
+        solver.advance(steps);
+        MPI_Barrier(domain.comm_cart);
+        double elapsed = MPI_Wtime() - start;
+
+        if (domain.rank == 0) {
+            double updates = double(n - 2) * (n - 2) * steps;
+            std::cout << "ranks " << domain.size << " (" << domain.ndomx << " x " << domain.ndomy << ")"
+                      << ", grid " << n << " x " << n << ", " << steps << " steps" << std::endl;
+            std::cout << "halo depth " << solver.depth() << (k == 0 ? " (auto-tuned)" : "")
+                      << ", max " << solver.max_depth() << std::endl;
+            std::cout << "time " << elapsed << " s, " << updates / elapsed * 1e-6 << " MLUP/s" << std::endl;
+        }
+
+        if (n <= max_check) {
+            Grid result(n, n);
+            solver.gather(result, 0);
+            if (domain.rank == 0) {
+                HeatSolver serial(n, n, c);
+                for (int i = 0; i < n; ++i) {
+                    for (int j = 0; j < n; ++j) {
+                        serial.solution()(i, j) = initial(i, j, n);
+                    }
+                }
+                for (int t = 0; t < steps; ++t) serial.step();
+
+                double err = 0.0;
+                for (std::size_t p = 0; p < result.data.size(); ++p) {
+                    err = std::fmax(err, std::fabs(result.data[p] - serial.solution().data[p]));
+                }
+                std::cout << "max |serial - distributed| = " << err << std::endl;
+            }
+        }
+    }
+
+    MPI_Comm_free(&domain.comm_cart);
+    MPI_Finalize();
+    return 0;
+}
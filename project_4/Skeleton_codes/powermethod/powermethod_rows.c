@@ -4,7 +4,8 @@
 
 #include <mpi.h> // MPI
 
-#include "walltime.h"
+#include "instrument.h"
+#include "matrix.h"
 
 
 /*******************************************************************************
@@ -28,6 +29,7 @@ int main(int argc, char* argv[]) {
   MPI_Init(&argc, &argv);
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
   MPI_Comm_size(MPI_COMM_WORLD, &size);
+  instr_init(rank);
 
   // Process command line arguments
   if (argc < 5) {
@@ -89,8 +91,8 @@ int main(int argc, char* argv[]) {
     offset       += rows_r;
   }
 
-  // Initialize matrix A
-  double* A = (double*) calloc(nrows_local*n, sizeof(double));
+  // Initialize matrix A: the local rows, in one aligned row-major block
+  matrix A = matrix_create(nrows_local, n, MATRIX_ROW_MAJOR);
   for (int i_local = 0; i_local < nrows_local; ++i_local) {
     int i_global = row_beg_local + i_local;
     for (int j_global = 0; j_global < n; ++j_global) {
@@ -98,30 +100,30 @@ int main(int argc, char* argv[]) {
         case 1:
           // Test case 1: A(i, j) = 1 for 1 <= i, j <= n
           //              theta = n
-          A[i_local*n + j_global] = 1.;
+          *matrix_at(&A, i_local, j_global) = 1.;
           break;
         case 2:
           // Test case 2: A(i, j) = 1 if i == j for 1 <= i, j <= n
           //              theta = 1
           if ( i_global == j_global ) {
-            A[i_local*n + j_global] = 1.;
+            *matrix_at(&A, i_local, j_global) = 1.;
           } else {
-            A[i_local*n + j_global] = 0.;
+            *matrix_at(&A, i_local, j_global) = 0.;
           }
           break;
         case 3:
           // Test case 3: A(i, j) = i if i == j for 1 <= i, j <= n
           //              theta = n
           if ( i_global == j_global ) {
-            A[i_local*n + j_global] = i_global + 1;
+            *matrix_at(&A, i_local, j_global) = i_global + 1;
           } else {
-            A[i_local*n + j_global] = 0.;
+            *matrix_at(&A, i_local, j_global) = 0.;
           }
           break;
         case 4:
           // Test case 4: A(i, j) = uniform random number [0, 1[ for 1 <= i, j <= n
           //              theta = unknown
-          A[i_local*n + j_global] = (double) rand() / (double) (RAND_MAX + 1u);
+          *matrix_at(&A, i_local, j_global) = (double) rand() / (double) (RAND_MAX + 1u);
           break;
         default:
           if (rank == 0) printf("Error: test_case = 1, 2, 3 or 4!\n");
@@ -158,12 +160,15 @@ int main(int argc, char* argv[]) {
   double* v       = (double*) calloc(n, sizeof(double));
   int iter;
   double time_start = walltime();
+  instr_begin("power method");
   for (iter = 0; iter < niter; ++iter) {
+    instr_begin("iteration");
     // To do: Implement parallel power method here.
     // Hint : Do the matrix-vector multiply y = A v below over the local
     //        (to the process) rows, and use MPI_Allgather / MPI_Allgatherv
     //        to synchronize the result.
     // Normalize vector: v = y / || y ||_2
+    instr_begin("normalize");
     double norm2 = 0.;
     for (int i_global = 0; i_global < n; ++i_global) {
       norm2 += y[i_global]*y[i_global];
@@ -175,16 +180,17 @@ int main(int argc, char* argv[]) {
     // Matrix-vector multiply: y = A v
     // Hint: Compute only the local rows, save them in the buffer y_local
     //       and synchronize the result using MPI_Allgather / MPI_Allgatherv.
-    for (int i_local = 0; i_local < nrows_local; ++i_local) {
-      y_local[i_local] = 0.;
-      for (int j_global = 0; j_global < n; ++j_global) {
-        y_local[i_local] += A[i_local*n + j_global]*v[j_global];
-      }
-    }
+    instr_end();
+    instr_begin("matvec");
+    matrix_gemv(1., &A, v, 0., y_local);
+    instr_end();
+    instr_begin("allgatherv");
     MPI_Allgatherv(y_local, nrows_local, MPI_DOUBLE,
                    y, recvcounts, displs, MPI_DOUBLE,
                    MPI_COMM_WORLD);
+    instr_end();
     // Compute eigenvalue: theta = v^T y
+    instr_begin("convergence");
     theta = 0.;
     for (int i_global = 0; i_global < n; ++i_global) {
       theta += v[i_global]*y[i_global];
@@ -196,10 +202,13 @@ int main(int argc, char* argv[]) {
               *(y[i_global] - theta*v[i_global]);
     }
     error = sqrt(error2);
+    instr_end();
+    instr_end();
     if (rank == 0) printf("iteration / theta/ error: %4d / %15.5f / %25.15e\n",
                           iter, theta, error);
     if (error < tol*fabs(theta)) break;
   }
+  instr_end();
   double time_end = walltime();
 
   // Report result
@@ -220,12 +229,13 @@ int main(int argc, char* argv[]) {
   // Free
   free(recvcounts);
   free(displs);
-  free(A);
+  matrix_destroy(&A);
   free(y);
   free(y_local);
   free(v);
 
   // Finalize MPI
+  instr_finalize();
   MPI_Finalize();
 
   return 0;
@@ -1,6 +0,0 @@
-#ifndef WALLTIME_H
-#define WALLTIME_H
-
-double walltime();
-
-#endif /* WALLTIME_H */
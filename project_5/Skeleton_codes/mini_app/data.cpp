@@ -27,7 +27,7 @@ Discretization options;
 SubDomain      domain;
 
 void SubDomain::init(int mpi_rank, int mpi_size,
-                     Discretization& discretization) {
+                     Discretization& discretization, MPI_Comm comm) {
     // DONE: determine the number of sub-domains in the x and y dimensions
     //       using MPI_Dims_create
     int dims[2] = {0, 0}; // 0 let mpi decide I can for some reason enforce a specific decomposition like {0,1} 
@@ -37,7 +37,7 @@ void SubDomain::init(int mpi_rank, int mpi_size,
 
     // DONE: create a 2D non-periodic Cartesian topology using MPI_Cart_create
     int periods[2] = {0, 0}; // dice per ogni dimensione se e' periodica o no (se deve fare il wrap around)
-    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &comm_cart); // 0: reorder, dice se MPI puo' riordinare i rank per ottimizzare, 0 significa no reorder
+    MPI_Cart_create(comm, 2, dims, periods, 0, &comm_cart); // 0: reorder, dice se MPI puo' riordinare i rank per ottimizzare, 0 significa no reorder
 
     // DONE: retrieve coordinates of the rank in the topology using
     // MPI_Cart_coords
@@ -20,7 +20,9 @@ struct Discretization {
 // local domain (i.e., sub-domain of each process)
 struct SubDomain {
     // initialize a sub-domain
-    void init(int, int, Discretization&);
+    // the Cartesian topology is built on comm, which may be a sub-communicator
+    // (used by the --sweep mode)
+    void init(int, int, Discretization&, MPI_Comm comm = MPI_COMM_WORLD);
 
     // print sub-domain information
     void print();
@@ -11,6 +11,7 @@
 #include "operators.h"
 #include "stats.h"
 #include "data.h"
+#include "instrument.h"
 
 namespace linalg {
 
@@ -57,7 +58,10 @@ double hpc_dot(Field const& x, Field const& y) {
         local += x[i] * y[i];
 
     double global = 0.0;
-    MPI_Allreduce(&local, &global, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD); // tutti i rank mandano il loro local e restituisce il risultato a TUTTI i processi (al contrario di MPI_Reduce che lo restituisce solo al rank 0)
+    INSTR_SCOPE("allreduce");
+    double time_start = walltime();
+    MPI_Allreduce(&local, &global, 1, MPI_DOUBLE, MPI_SUM, data::domain.comm_cart); // tutti i rank mandano il loro local e restituisce il risultato a TUTTI i processi (al contrario di MPI_Reduce che lo restituisce solo al rank 0)
+    stats::time_reduce += walltime() - time_start;
 
     return global;
 }
@@ -72,7 +76,10 @@ double hpc_norm2(Field const& x) {
         local += x[i] * x[i];
 
     double global = 0.0;
-    MPI_Allreduce(&local, &global, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    INSTR_SCOPE("allreduce");
+    double time_start = walltime();
+    MPI_Allreduce(&local, &global, 1, MPI_DOUBLE, MPI_SUM, data::domain.comm_cart);
+    stats::time_reduce += walltime() - time_start;
 
     return sqrt(global);
 }
@@ -167,6 +174,8 @@ void hpc_copy(Field& y, Field const& x) {
 void hpc_cg(Field& deltay, Field const& y_old, Field const& y_new,
             Field const& f, const int maxiters, const double tol,
             bool& success) {
+    INSTR_SCOPE("cg");
+
     // this is the dimension of the linear system that we are to solve
     int nx = data::domain.nx;
     int ny = data::domain.ny;
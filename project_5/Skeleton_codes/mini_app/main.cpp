@@ -7,11 +7,13 @@
 // finite differences.
 
 // Syntax: ./main nx nt t
+//         ./main --sweep strong|weak nt t reps n1 [n2 ...]
 
 #include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <vector>
 
 #include <cstdio>
 #include <cmath>
@@ -27,7 +29,7 @@
 #include "data.h"
 #include "linalg.h"
 #include "operators.h"
-#include "walltime.h"
+#include "instrument.h"
 #include "stats.h"
 
 using namespace data;
@@ -51,7 +53,7 @@ void write_binary(std::string fname, Field &u, SubDomain &domain,
 
     // Create MPI file handle
     MPI_File fh;
-    MPI_File_open(MPI_COMM_WORLD, fname.c_str(), // nome del file in char* perche MPI e' in C
+    MPI_File_open(domain.comm_cart, fname.c_str(), // nome del file in char* perche MPI e' in C
                   MPI_MODE_CREATE | MPI_MODE_WRONLY, // modalita' di apertura del file
                   MPI_INFO_NULL, &fh); 
     
@@ -82,6 +84,31 @@ void write_binary(std::string fname, Field &u, SubDomain &domain,
     MPI_File_close(&fh);
 }
 
+// set the derived discretization parameters for a global grid of nx * nx
+// points, nt time steps and total time t
+void set_discretization(Discretization& options, int nx, int nt, double t) {
+    options.nx = nx;
+    options.nt = nt;
+
+    // set total number of grid points
+    options.N = options.nx * options.nx;
+
+    // set time step size
+    options.dt = t / options.nt;
+
+    // set distance between grid points
+    // assume that x dimension has length 1.0
+    options.dx = 1. / (options.nx - 1);
+
+    // set alpha, assume diffusion coefficient D is 1
+    double D = 1.;
+    options.alpha = (options.dx * options.dx) / (D * options.dt);
+
+    // set beta, assume diffusion coefficient D=1, reaction coefficient R=1000
+    double R = 500.;
+    options.beta = (R * options.dx * options.dx)/D;
+}
+
 // read command line arguments
 void readcmdline(Discretization& options, int argc, char* argv[]) {
     if (argc<4 || argc>5) {
@@ -121,54 +148,44 @@ void readcmdline(Discretization& options, int argc, char* argv[]) {
         verbose_output = (domain.rank==0);
     }
 
-    // set total number of grid points
-    options.N = options.nx * options.nx;
-
-    // set time step size
-    options.dt = t / options.nt;
-
-    // set distance between grid points
-    // assume that x dimension has length 1.0
-    options.dx = 1. / (options.nx - 1);
-
-    // set alpha, assume diffusion coefficient D is 1
-    double D = 1.;
-    options.alpha = (options.dx * options.dx) / (D * options.dt);
-
-    // set beta, assume diffusion coefficient D=1, reaction coefficient R=1000
-    double R = 500.;
-    options.beta = (R * options.dx * options.dx)/D;
+    set_discretization(options, options.nx, options.nt, t);
 }
 
 // =============================================================================
 
-int main(int argc, char* argv[]) {
-    // read command line arguments
-    readcmdline(options, argc, argv);
-
+// timings and iteration counts of one simulation, as seen by rank 0
+struct RunResult {
+    double time;           // time spent in the time loop
+    unsigned int iters_cg;
+    unsigned int iters_newton;
+    double time_diffusion; // stencil, including the halo exchange
+    double time_halo;      // waiting for the halo exchange
+    double time_reduce;    // global reductions in hpc_dot/hpc_norm2
+};
+
+// run the simulation described by options on the ranks of comm
+// the banner, summary and output files are only produced if verbose is set
+RunResult simulate(MPI_Comm comm, bool verbose) {
     // set iteration parameters
     int max_cg_iters     = 300;
     int max_newton_iters = 50;
     double tolerance     = 1.e-6;
 
-    // initialize MPI
-    MPI_Init(&argc, &argv);
     int rank, size;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
 
     // TODO: initialize sub-domain (data.{h,cpp})
-    domain.init(rank, size, options);
+    domain.init(rank, size, options, comm);
     // domain.print(); // for debugging
     // if (rank == 0) std::cout << "Domain initialized. Printing neighbors..." << std::endl;
     // domain.print();
 
     int nx = domain.nx; // nx is local sub-domain size in x direction specifically is the number of grid points in x direction for each sub-domain
     int ny = domain.ny;
-    int N  = domain.N; // N is total number of grid points, nx * ny would have been too clear
     int nt  = options.nt;
 
-    if (rank == 0) {
+    if (verbose && rank == 0) {
         std::cout << std::string(80, '=') << std::endl;
         std::cout << "                      Welcome to mini-stencil!" << std::endl;
 
@@ -191,6 +208,8 @@ int main(int argc, char* argv[]) {
     }
 
     // allocate global fields
+    // (the cg fields have to be reallocated as well if the sub-domain changed)
+    cg_initialized = false;
     y_new.init(nx, ny);
     y_old.init(nx, ny);
     bndN.init(nx, 1);
@@ -233,12 +252,16 @@ int main(int argc, char* argv[]) {
 
     iters_cg = 0;
     iters_newton = 0;
+    time_diffusion = 0;
+    time_halo = 0;
+    time_reduce = 0;
 
     // start timer
     double time_start = walltime();
 
     // main time loop
     for (int timestep = 1; timestep <= nt; timestep++) {
+        INSTR_SCOPE("timestep");
         // if (rank == 0 && timestep % 10 == 0) std::cout << "Starting step " << timestep << std::endl;
 
         // set y_new and y_old to be the solution
@@ -249,8 +272,11 @@ int main(int argc, char* argv[]) {
         int it;
         for (it = 0; it < max_newton_iters; it++) {
             // compute residual
-            diffusion(y_old, y_new, f);
-            residual = hpc_norm2(f);
+            {
+                INSTR_SCOPE("residual");
+                diffusion(y_old, y_new, f);
+                residual = hpc_norm2(f);
+            }
 
             // check for convergence
             if (residual < tolerance) {
@@ -288,6 +314,13 @@ int main(int argc, char* argv[]) {
     // get times
     double time_end = walltime();
 
+    RunResult result = {time_end - time_start, iters_cg, iters_newton,
+                        time_diffusion, time_halo, time_reduce};
+    if (!verbose) {
+        MPI_Comm_free(&domain.comm_cart);
+        return result;
+    }
+
     ////////////////////////////////////////////////////////////////////
     // write final solution to BOV file for visualization
     ////////////////////////////////////////////////////////////////////
@@ -296,9 +329,12 @@ int main(int argc, char* argv[]) {
     // DONE: Implement write_binary using MPI-IO
     // binary data
     // DONE: Implement write_binary using MPI-IO
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(comm);
     // if (rank == 0) std::cout << "All ranks reached write_binary." << std::endl;
-    write_binary("output.bin", y_old, domain, options);
+    {
+        INSTR_SCOPE("output");
+        write_binary("output.bin", y_old, domain, options);
+    }
     
 
     // metadata
@@ -341,8 +377,160 @@ int main(int argc, char* argv[]) {
         std::cout << "Goodbye!" << std::endl;
     }
 
-    // DONE: finalize MPI
     MPI_Comm_free(&domain.comm_cart);
+    return result;
+}
+
+// =============================================================================
+
+// efficiency of a run of time t on p ranks, relative to the reference run of
+// time t_ref on p_ref ranks (same problem for strong, same load per rank for
+// weak scaling)
+double efficiency(bool strong, double t, int p, double t_ref, int p_ref) {
+    return strong ? (t_ref * p_ref) / (t * p) : t_ref / t;
+}
+
+double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    int n = v.size();
+    return n % 2 ? v[n/2] : 0.5 * (v[n/2 - 1] + v[n/2]);
+}
+
+// scaling study inside one MPI job:
+//   ./main --sweep strong|weak nt t reps n1 [n2 ...]
+// for every n and for 1, 2, 4, ... up to all ranks, the simulation is run reps
+// times on a sub-communicator of the first p ranks. For strong scaling n is
+// the global grid size, for weak scaling the size on one rank and the global
+// grid is n*sqrt(p) (as in weak_scaling_test.sh). Every run is appended to
+// sweep.csv and printed as a ### line that performances.py understands.
+int sweep(int argc, char* argv[]) {
+    int world_rank, world_size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+    bool strong = argc > 2 && strcmp(argv[2], "strong") == 0;
+    bool weak   = argc > 2 && strcmp(argv[2], "weak") == 0;
+    int nt      = argc > 3 ? atoi(argv[3]) : 0;
+    double t    = argc > 4 ? atof(argv[4]) : -1;
+    int reps    = argc > 5 ? atoi(argv[5]) : 0;
+    std::vector<int> sizes;
+    for (int a = 6; a < argc; a++) sizes.push_back(atoi(argv[a]));
+
+    if (!(strong || weak) || nt < 1 || t < 0 || reps < 1 || sizes.empty()
+        || *std::min_element(sizes.begin(), sizes.end()) < 1) {
+        if (world_rank == 0) {
+            std::cerr << "Usage: main --sweep strong|weak nt t reps n1 [n2 ...]\n";
+            std::cerr << "  strong|weak  fixed global grid n, or n x n points per rank\n";
+            std::cerr << "  nt           number of time steps\n";
+            std::cerr << "  t            total time\n";
+            std::cerr << "  reps         repetitions of every configuration\n";
+            std::cerr << "  n1 n2 ...    grid sizes\n";
+        }
+        return 1;
+    }
+
+    // 1, 2, 4, ... ranks, always finishing with all of them
+    std::vector<int> ranks;
+    for (int p = 1; p < world_size; p *= 2) ranks.push_back(p);
+    ranks.push_back(world_size);
+
+    std::ofstream csv;
+    if (world_rank == 0) {
+        csv.open("sweep.csv");
+        csv << "mode,ranks,nx,nt,rep,time,iters_cg,iters_newton,efficiency,"
+               "time_diffusion,time_halo,time_reduce,time_other" << std::endl;
+    }
+
+    verbose_output = false;
+    for (int n : sizes) {
+        double t_ref = 0;
+        int p_ref = 0;
+        for (int p : ranks) {
+            int nx = weak ? int(std::lround(n * std::sqrt(double(p)))) : n;
+            set_discretization(options, nx, nt, t);
+
+            // the first p ranks work, the others wait at the barrier
+            MPI_Comm sub;
+            MPI_Comm_split(MPI_COMM_WORLD, world_rank < p ? 0 : MPI_UNDEFINED,
+                           world_rank, &sub);
+
+            std::vector<RunResult> results;
+            for (int rep = 0; rep < reps; rep++) {
+                if (sub != MPI_COMM_NULL) {
+                    results.push_back(simulate(sub, false));
+                }
+                MPI_Barrier(MPI_COMM_WORLD);
+            }
+            if (sub != MPI_COMM_NULL) MPI_Comm_free(&sub);
+
+            // world rank 0 is part of every sub-communicator
+            if (world_rank != 0) continue;
+
+            std::vector<double> times;
+            for (auto const& r : results) times.push_back(r.time);
+            double t_med = median(times);
+            if (p_ref == 0) {
+                t_ref = t_med;
+                p_ref = p;
+            }
+
+            for (int rep = 0; rep < reps; rep++) {
+                RunResult const& r = results[rep];
+                csv << (strong ? "strong" : "weak") << ","
+                    << p << "," << nx << "," << nt << "," << rep << ","
+                    << r.time << "," << r.iters_cg << "," << r.iters_newton << ","
+                    << efficiency(strong, r.time, p, t_ref, p_ref) << ","
+                    << r.time_diffusion << "," << r.time_halo << ","
+                    << r.time_reduce << ","
+                    << r.time - r.time_diffusion - r.time_reduce << std::endl;
+                std::cout << "### " << p << ", "
+                                    << nx << ", "
+                                    << nt << ", "
+                                    << r.iters_cg << ", "
+                                    << r.iters_newton << ", "
+                                    << r.time
+                          << " ###" << std::endl;
+            }
+            std::cout << "ranks " << p << ", n " << nx << " : median "
+                      << t_med << " s, min "
+                      << *std::min_element(times.begin(), times.end())
+                      << " s, efficiency "
+                      << efficiency(strong, t_med, p, t_ref, p_ref)
+                      << std::endl;
+        }
+    }
+
+    return 0;
+}
+
+// =============================================================================
+
+int main(int argc, char* argv[]) {
+    // scaling study mode
+    if (argc > 1 && strcmp(argv[1], "--sweep") == 0) {
+        MPI_Init(&argc, &argv);
+        int world_rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+        instr_init(world_rank);
+        int status = sweep(argc, argv);
+        instr_finalize();
+        MPI_Finalize();
+        return status;
+    }
+
+    // read command line arguments
+    readcmdline(options, argc, argv);
+
+    // initialize MPI
+    MPI_Init(&argc, &argv);
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    instr_init(rank);
+
+    simulate(MPI_COMM_WORLD, true);
+
+    // DONE: finalize MPI
+    instr_finalize();
     MPI_Finalize();
 
     return 0;
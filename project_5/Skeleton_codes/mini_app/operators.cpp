@@ -9,6 +9,7 @@
 #include "data.h"
 #include "operators.h"
 #include "stats.h"
+#include "instrument.h"
 
 #include <iostream>
 
@@ -19,6 +20,8 @@ namespace operators {
 // and f is the residual (see Eq. (7) in Project 3).
 void diffusion(data::Field const& s_old, data::Field const& s_new,
                data::Field& f) {
+    INSTR_SCOPE("diffusion");
+
     using data::options;
     using data::domain;
 
@@ -40,6 +43,8 @@ void diffusion(data::Field const& s_old, data::Field const& s_new,
     int iend  = nx - 1;
     int jend  = ny - 1;
 
+    double time_start = walltime();
+
     // TODO: exchange the ghost cells using non-blocking point-to-point
     //       communication
     MPI_Request requests[8];
@@ -56,10 +61,10 @@ void diffusion(data::Field const& s_old, data::Field const& s_new,
             buffN[i] = s_new(i, ny - 1);
         }
         MPI_Irecv(bndN.data(), nx, MPI_DOUBLE,
-                  domain.neighbour_north, 0, MPI_COMM_WORLD,
+                  domain.neighbour_north, 0, domain.comm_cart,
                   &requests[req_count++]);
         MPI_Isend(buffN.data(), nx, MPI_DOUBLE,
-                  domain.neighbour_north, 1, MPI_COMM_WORLD,
+                  domain.neighbour_north, 1, domain.comm_cart,
                   &requests[req_count++]);
     }
 
@@ -69,10 +74,10 @@ void diffusion(data::Field const& s_old, data::Field const& s_new,
             buffS[i] = s_new(i, 0);
         }
         MPI_Irecv(bndS.data(), nx, MPI_DOUBLE,
-                  domain.neighbour_south, 1, MPI_COMM_WORLD,
+                  domain.neighbour_south, 1, domain.comm_cart,
                   &requests[req_count++]);
         MPI_Isend(buffS.data(), nx, MPI_DOUBLE,
-                  domain.neighbour_south, 0, MPI_COMM_WORLD,
+                  domain.neighbour_south, 0, domain.comm_cart,
                   &requests[req_count++]);
     }
 
@@ -83,10 +88,10 @@ void diffusion(data::Field const& s_old, data::Field const& s_new,
             buffE[j] = s_new(nx - 1, j);
         }
         MPI_Irecv(bndE.data(), ny, MPI_DOUBLE,
-                  domain.neighbour_east, 2, MPI_COMM_WORLD,
+                  domain.neighbour_east, 2, domain.comm_cart,
                   &requests[req_count++]);
         MPI_Isend(buffE.data(), ny, MPI_DOUBLE,
-                  domain.neighbour_east, 3, MPI_COMM_WORLD,
+                  domain.neighbour_east, 3, domain.comm_cart,
                   &requests[req_count++]);
     }
 
@@ -96,10 +101,10 @@ void diffusion(data::Field const& s_old, data::Field const& s_new,
             buffW[j] = s_new(0, j);
         }
         MPI_Irecv(bndW.data(), ny, MPI_DOUBLE,
-                  domain.neighbour_west, 3, MPI_COMM_WORLD,
+                  domain.neighbour_west, 3, domain.comm_cart,
                   &requests[req_count++]);
         MPI_Isend(buffW.data(), ny, MPI_DOUBLE,
-                  domain.neighbour_west, 2, MPI_COMM_WORLD,
+                  domain.neighbour_west, 2, domain.comm_cart,
                   &requests[req_count++]);
     }
 
@@ -116,7 +121,10 @@ void diffusion(data::Field const& s_old, data::Field const& s_new,
 
     if (req_count > 0) {
         // std::cout << "Rank " << domain.rank << " waiting for " << req_count << " requests" << std::endl;
+        INSTR_SCOPE("halo wait");
+        double time_wait = walltime();
         MPI_Waitall(req_count, requests, MPI_STATUSES_IGNORE);
+        stats::time_halo += walltime() - time_wait;
         // std::cout << "Rank " << domain.rank << " finished waitall" << std::endl;
     }
 
@@ -210,6 +218,8 @@ void diffusion(data::Field const& s_old, data::Field const& s_new,
 
     // Accumulate the flop counts
     // 8 ops total per point
+    stats::time_diffusion += walltime() - time_start;
+
     stats::flops_diff += 12 * (nx - 2) * (ny - 2) // interior points
                       +  11 * (nx - 2  +  ny - 2) // NESW boundary points
                       +  11 * 4;                  // corner points
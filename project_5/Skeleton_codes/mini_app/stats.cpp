@@ -7,6 +7,9 @@ unsigned long long flops_bc;
 unsigned long long flops_blas1;
 unsigned int iters_cg;
 unsigned int iters_newton;
+double time_diffusion;
+double time_halo;
+double time_reduce;
 bool verbose_output;
 
 }
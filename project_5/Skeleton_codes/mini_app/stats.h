@@ -5,6 +5,9 @@ namespace stats {
 
 extern unsigned long long flops_diff, flops_bc, flops_blas1;
 extern unsigned int iters_cg, iters_newton;
+// seconds spent in diffusion (including the halo exchange), waiting for the
+// halo exchange, and in the global reductions of hpc_dot/hpc_norm2
+extern double time_diffusion, time_halo, time_reduce;
 extern bool verbose_output;
 
 }
@@ -0,0 +1,26 @@
+#!/bin/bash
+#SBATCH --job-name=pde_sweep
+#SBATCH --nodes=16
+#SBATCH --ntasks-per-node=1
+#SBATCH --cpus-per-task=1
+#SBATCH --time=01:00:00
+#SBATCH --exclusive
+#SBATCH --output=sweep_%j.out
+#SBATCH --error=sweep_%j.err
+
+module load gcc openmpi
+
+make clean
+make
+
+# one job for the whole study: every configuration runs on a sub-communicator
+# of 1, 2, 4, ... 16 ranks, results go to sweep.csv
+t_steps=100
+dt=0.005
+reps=5
+
+srun ./main --sweep strong $t_steps $dt $reps 64 128 256 512 1024
+mv sweep.csv sweep_strong.csv
+
+srun ./main --sweep weak $t_steps $dt $reps 64 128 256
+mv sweep.csv sweep_weak.csv